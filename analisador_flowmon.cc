@@ -0,0 +1,165 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+//
+// Analisa os XML do FlowMonitor gravados por simulacao_redes (um por
+// execucao) e grava uma tabela unica com as metricas por fluxo e por
+// cenario. Cada thread le um arquivo inteiro por vez; os resultados sao
+// gravados na ordem dos arquivos, e no maximo 2 por thread ficam
+// esperando na memoria.
+//
+//   analisador_flowmon --Lista=execucoes.txt --Saida=analise.bin
+//   analisador_flowmon --Arquivos=a.xml,b.xml --Formato=csv --Saida=analise.csv
+//
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ns3/core-module.h"
+
+#include "analise_flowmon.h"
+#include "medicao.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("AnalisadorFlowmon");
+
+/** Arquivos separados por virgula em --Arquivos e um por linha em --Lista. */
+std::vector<std::string> arquivos_de_entrada (const std::string &arquivos, const std::string &lista) {
+    std::vector<std::string> entrada;
+    size_t inicio = 0;
+    while (inicio < arquivos.size ()) {
+        size_t virgula = arquivos.find (',', inicio);
+        if (virgula == std::string::npos) {
+            virgula = arquivos.size ();
+        }
+        if (virgula > inicio) {
+            entrada.push_back (arquivos.substr (inicio, virgula - inicio));
+        }
+        inicio = virgula + 1;
+    }
+    if (!lista.empty ()) {
+        std::ifstream arquivo (lista.c_str ());
+        if (!arquivo) {
+            NS_FATAL_ERROR ("Nao foi possivel abrir " << lista);
+        }
+        std::string linha;
+        while (std::getline (arquivo, linha)) {
+            size_t fim = linha.find_last_not_of (" \t\r");
+            if (fim != std::string::npos) {
+                entrada.push_back (linha.substr (0, fim + 1));
+            }
+        }
+    }
+    return entrada;
+}
+
+int main (int argc, char *argv[]) {
+  std::string arquivos;
+  std::string lista;
+  std::string saida = "analise_flowmon.bin";
+  std::string formato = "binario";
+  uint32_t threads = 0;
+
+  CommandLine cmd;
+  cmd.AddValue ("Arquivos", "XML do FlowMonitor a analisar, separados por virgula", arquivos);
+  cmd.AddValue ("Lista", "Arquivo com um XML do FlowMonitor por linha", lista);
+  cmd.AddValue ("Saida", "Tabela com as metricas por fluxo e por cenario", saida);
+  cmd.AddValue ("Formato", "Tabela: binario (colunar) ou csv", formato);
+  cmd.AddValue ("Threads", "Arquivos lidos ao mesmo tempo (0 usa todos os nucleos)", threads);
+  cmd.Parse (argc, argv);
+
+  if (formato != "binario" && formato != "csv") {
+      NS_FATAL_ERROR ("Formato desconhecido: " << formato << " (use binario ou csv)");
+  }
+  std::vector<std::string> entrada = arquivos_de_entrada (arquivos, lista);
+  if (entrada.empty ()) {
+      NS_FATAL_ERROR ("Nenhum arquivo para analisar (use --Arquivos ou --Lista)");
+  }
+  if (threads == 0) {
+      threads = std::thread::hardware_concurrency ();
+  }
+  threads = std::max<uint32_t> (1, std::min<uint32_t> (threads, entrada.size ()));
+
+  std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now ();
+  EscritorAnalise escritor (saida, formato == "binario");
+
+  // Quem termina o arquivo que falta na ordem grava ele e os seguintes ja
+  // prontos. Uma thread so pega um arquivo novo se ele estiver a menos de
+  // "janela" do proximo a gravar, o que limita os resultados em espera
+  const size_t janela = 2 * threads;
+  std::mutex mutex;
+  std::condition_variable liberado;
+  size_t proximo = 0;
+  size_t gravado = 0;
+  std::map<size_t, AnaliseArquivo> prontos;
+  std::vector<std::string> falhas;
+  uint64_t fluxos = 0;
+
+  std::vector<std::thread> trabalhadores;
+  for (uint32_t t = 0; t < threads; ++t) {
+      trabalhadores.push_back (std::thread ([&] () {
+          AnaliseArquivo analise;
+          while (true) {
+              size_t indice;
+              {
+                  std::unique_lock<std::mutex> trava (mutex);
+                  liberado.wait (trava, [&] { return proximo >= entrada.size () || proximo < gravado + janela; });
+                  if (proximo >= entrada.size ()) {
+                      break;
+                  }
+                  indice = proximo++;
+              }
+
+              analisar_arquivo_flowmon (entrada[indice], analise);
+
+              std::lock_guard<std::mutex> trava (mutex);
+              std::swap (prontos[indice], analise);
+              for (std::map<size_t, AnaliseArquivo>::iterator it = prontos.begin (); it != prontos.end () && it->first == gravado; it = prontos.begin ()) {
+                  if (it->second.erro.empty ()) {
+                      escritor.gravar (it->second);
+                      fluxos += it->second.linhas.size () - 1;
+                  } else {
+                      falhas.push_back (it->second.arquivo + ": " + it->second.erro);
+                  }
+                  prontos.erase (it);
+                  gravado++;
+              }
+              liberado.notify_all ();
+          }
+      }));
+  }
+  for (size_t t = 0; t < trabalhadores.size (); ++t) {
+      trabalhadores[t].join ();
+  }
+  escritor.fechar ();
+
+  for (size_t i = 0; i < falhas.size (); ++i) {
+      std::cerr << "Ignorado " << falhas[i] << std::endl;
+  }
+  std::cout << "Analise: " << entrada.size () - falhas.size () << " de " << entrada.size () << " arquivos, "
+            << fluxos << " fluxos, " << escritor.linhas () << " linhas em " << saida << " (" << threads << " threads, "
+            << segundos_desde (inicio) << " s, pico " << pico_memoria_kb () << " KB)" << std::endl;
+  return falhas.empty () ? 0 : 1;
+}
@@ -0,0 +1,720 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Analise dos XML do FlowMonitor (SerializeToXmlFile) de varias execucoes,
+// usada pelo analisador_flowmon.cc.
+//
+// O XML eh lido em blocos de tamanho fixo por um leitor no estilo SAX, que
+// entrega cada tag com seus atributos e esquece o texto ja lido: so ficam
+// na memoria os contadores de cada fluxo (os histogramas e as sondas, que
+// dominam o tamanho do arquivo quando habilitados, sao ignorados). As
+// metricas seguem resumo.h: vazao entre o primeiro e o ultimo pacote
+// recebido, atraso e jitter medios por pacote, fluxos de controle do
+// roteamento (RIP/OLSR) de fora.
+//
+// Tabela (uma linha por fluxo e uma por cenario, coluna "nivel"):
+// - csv: cabecalho_analise_csv ()
+// - binario: cabecalho "FMAN" + versao (u32), seguido de um bloco por
+//   arquivo com o nome (u32 + caracteres), n (u32) e as colunas, cada uma
+//   com n valores: nivel (u8), fluxo (u32), protocolo (u8), classe (u8),
+//   origem (u32), destino (u32), porta_origem (u16), porta_destino (u16),
+//   fluxos (u32), bytes_tx (u64), bytes_rx (u64), pacotes_tx (u64),
+//   pacotes_rx (u64), pacotes_perdidos (u64), vazao_mbps (f64),
+//   atraso_ms (f64), jitter_ms (f64), perda (f64), jain (f64),
+//   jain_tcp (f64), jain_udp (f64). Inteiros na ordem de bytes da maquina,
+//   enderecos IPv4 como inteiros (a.b.c.d = a << 24 | ...).
+//
+
+#ifndef ANALISE_FLOWMON_H
+#define ANALISE_FLOWMON_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "roteamento.h"
+
+/**
+ * Leitor de XML em blocos. Para cada tag chama tratador.inicio (nome,
+ * atributos) e, ao fechar, tratador.fim (nome); texto, comentarios e
+ * declaracoes sao pulados. Nao decodifica entidades: os atributos do
+ * FlowMonitor sao numeros e enderecos.
+ */
+class LeitorXml {
+public:
+    typedef std::vector<std::pair<const char *, const char *> > Atributos;
+
+    explicit LeitorXml (size_t tamanho_bloco = 1 << 16)
+        : m_bloco (tamanho_bloco > 0 ? tamanho_bloco : 1), m_arquivo (0), m_posicao (0), m_fim (0) {}
+
+    /** Devolve false (com o motivo em erro) se o arquivo nao abrir ou estiver truncado. */
+    template <typename Tratador>
+    bool ler (const std::string &arquivo, Tratador &tratador, std::string &erro) {
+        m_arquivo = std::fopen (arquivo.c_str (), "rb");
+        if (!m_arquivo) {
+            erro = "nao foi possivel abrir";
+            return false;
+        }
+        m_posicao = m_fim = 0;
+        bool ok = percorrer (tratador, erro);
+        std::fclose (m_arquivo);
+        m_arquivo = 0;
+        return ok;
+    }
+
+    /** Valor do atributo, ou 0 se a tag nao o tiver. */
+    static const char *valor (const Atributos &atributos, const char *nome) {
+        for (size_t i = 0; i < atributos.size (); ++i) {
+            if (std::strcmp (atributos[i].first, nome) == 0) {
+                return atributos[i].second;
+            }
+        }
+        return 0;
+    }
+
+private:
+    int proximo () {
+        if (m_posicao == m_fim) {
+            m_fim = std::fread (&m_bloco[0], 1, m_bloco.size (), m_arquivo);
+            m_posicao = 0;
+            if (m_fim == 0) {
+                return EOF;
+            }
+        }
+        return static_cast<unsigned char> (m_bloco[m_posicao++]);
+    }
+
+    /** Le ate o '>' que fecha a tag (fora de aspas) e deixa o conteudo em m_tag. */
+    bool ler_tag () {
+        m_tag.clear ();
+        int aspas = 0;
+        int c;
+        while ((c = proximo ()) != EOF) {
+            if (aspas) {
+                if (c == aspas) {
+                    aspas = 0;
+                }
+            } else if ((c == '"' || c == '\'') && (m_tag.empty () || m_tag[0] != '!')) {
+                aspas = c;
+            } else if (c == '>') {
+                // Comentarios podem conter '>'
+                if (m_tag.compare (0, 3, "!--") != 0 || (m_tag.size () >= 5 && m_tag.compare (m_tag.size () - 2, 2, "--") == 0)) {
+                    return true;
+                }
+            }
+            m_tag.push_back (static_cast<char> (c));
+        }
+        return false;
+    }
+
+    static bool espaco (char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    /** Separa nome e atributos de m_tag, terminando cada um com '\0'. */
+    const char *separar (Atributos &atributos) {
+        atributos.clear ();
+        char *p = &m_tag[0];
+        char *nome = p;
+        while (*p && !espaco (*p)) {
+            ++p;
+        }
+        while (*p) {
+            *p++ = '\0';
+            while (espaco (*p)) {
+                ++p;
+            }
+            char *chave = p;
+            while (*p && *p != '=' && !espaco (*p)) {
+                ++p;
+            }
+            char *fim_chave = p;
+            while (espaco (*p)) {
+                ++p;
+            }
+            if (*p != '=') {
+                break;
+            }
+            ++p;
+            while (espaco (*p)) {
+                ++p;
+            }
+            char aspas = *p;
+            if (aspas != '"' && aspas != '\'') {
+                break;
+            }
+            char *conteudo = ++p;
+            while (*p && *p != aspas) {
+                ++p;
+            }
+            *fim_chave = '\0';
+            atributos.push_back (std::make_pair (const_cast<const char *> (chave), const_cast<const char *> (conteudo)));
+            if (!*p) {
+                break;
+            }
+        }
+        return nome;
+    }
+
+    template <typename Tratador>
+    bool percorrer (Tratador &tratador, std::string &erro) {
+        Atributos atributos;
+        uint32_t profundidade = 0;
+        int c;
+        while ((c = proximo ()) != EOF) {
+            if (c != '<') {
+                continue;
+            }
+            if (!ler_tag ()) {
+                erro = "tag incompleta no fim do arquivo";
+                return false;
+            }
+            if (m_tag.empty () || m_tag[0] == '?' || m_tag[0] == '!') {
+                continue;
+            }
+            if (m_tag[0] == '/') {
+                if (profundidade == 0) {
+                    erro = "tag fechada sem ter sido aberta: " + m_tag;
+                    return false;
+                }
+                profundidade--;
+                atributos.clear ();
+                m_tag.push_back ('\0');
+                tratador.fim (separar (atributos) + 1);
+                continue;
+            }
+            bool vazia = m_tag[m_tag.size () - 1] == '/';
+            if (vazia) {
+                m_tag.resize (m_tag.size () - 1);
+            }
+            m_tag.push_back ('\0');
+            const char *nome = separar (atributos);
+            tratador.inicio (nome, atributos);
+            if (vazia) {
+                tratador.fim (nome);
+            } else {
+                profundidade++;
+            }
+        }
+        if (std::ferror (m_arquivo)) {
+            erro = "erro de leitura";
+            return false;
+        }
+        if (profundidade != 0) {
+            erro = "arquivo truncado";
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<char> m_bloco;
+    std::FILE *m_arquivo;
+    size_t m_posicao;
+    size_t m_fim;
+    std::string m_tag;
+};
+
+/**
+ * Tempo do FlowMonitor ("+1.5e+09ns", "+2.3s"...) em nanossegundos. Sem
+ * unidade, nanossegundos.
+ */
+inline int64_t ler_tempo_ns(const char *texto) {
+    if (!texto) {
+        return 0;
+    }
+    char *unidade;
+    double valor = std::strtod (texto, &unidade);
+    double escala = 1;
+    if (std::strcmp (unidade, "fs") == 0) escala = 1e-6;
+    else if (std::strcmp (unidade, "ps") == 0) escala = 1e-3;
+    else if (std::strcmp (unidade, "us") == 0) escala = 1e3;
+    else if (std::strcmp (unidade, "ms") == 0) escala = 1e6;
+    else if (std::strcmp (unidade, "s") == 0) escala = 1e9;
+    else if (std::strcmp (unidade, "min") == 0) escala = 60e9;
+    else if (std::strcmp (unidade, "h") == 0) escala = 3600e9;
+    else if (std::strcmp (unidade, "d") == 0) escala = 86400e9;
+    return static_cast<int64_t> (std::llround (valor * escala));
+}
+
+inline uint64_t ler_inteiro(const char *texto) {
+    return texto ? std::strtoull (texto, 0, 10) : 0;
+}
+
+/** "a.b.c.d" como inteiro; 0 se nao for um endereco. */
+inline uint32_t ler_ipv4(const char *texto) {
+    if (!texto) {
+        return 0;
+    }
+    uint32_t endereco = 0;
+    for (int i = 0; i < 4; ++i) {
+        char *fim;
+        unsigned long parte = std::strtoul (texto, &fim, 10);
+        if (fim == texto || parte > 255 || (i < 3 && *fim != '.')) {
+            return 0;
+        }
+        endereco = (endereco << 8) | parte;
+        texto = fim + 1;
+    }
+    return endereco;
+}
+
+inline std::string texto_ipv4(uint32_t endereco) {
+    std::ostringstream texto;
+    texto << (endereco >> 24) << '.' << ((endereco >> 16) & 0xff) << '.' << ((endereco >> 8) & 0xff) << '.' << (endereco & 0xff);
+    return texto.str ();
+}
+
+enum NivelAnalise {
+    NIVEL_FLUXO = 0,
+    NIVEL_CENARIO = 1
+};
+
+/**
+ * dados: fluxo que disputa a rede; retorno: sentido inverso de um fluxo
+ * TCP (os ACKs), fora do indice de Jain; controle: RIP/OLSR, fora de tudo.
+ */
+enum ClasseFluxo {
+    CLASSE_DADOS = 0,
+    CLASSE_RETORNO = 1,
+    CLASSE_CONTROLE = 2
+};
+
+inline const char *nome_classe(uint8_t classe) {
+    switch (classe) {
+    case CLASSE_DADOS: return "dados";
+    case CLASSE_RETORNO: return "retorno";
+    default: return "controle";
+    }
+}
+
+/** Contadores de um fluxo como estao no XML. */
+struct FluxoFlowmon {
+    bool presente = false;
+    int64_t primeiro_rx_ns = 0;
+    int64_t ultimo_rx_ns = 0;
+    int64_t soma_atraso_ns = 0;
+    int64_t soma_jitter_ns = 0;
+    uint64_t bytes_tx = 0;
+    uint64_t bytes_rx = 0;
+    uint64_t pacotes_tx = 0;
+    uint64_t pacotes_rx = 0;
+    uint64_t pacotes_perdidos = 0;
+    uint32_t origem = 0;
+    uint32_t destino = 0;
+    uint16_t porta_origem = 0;
+    uint16_t porta_destino = 0;
+    uint8_t protocolo = 0;
+};
+
+/** Uma linha da tabela. */
+struct LinhaAnalise {
+    uint8_t nivel = NIVEL_FLUXO;
+    uint32_t fluxo = 0;
+    uint8_t protocolo = 0;
+    uint8_t classe = CLASSE_DADOS;
+    uint32_t origem = 0;
+    uint32_t destino = 0;
+    uint16_t porta_origem = 0;
+    uint16_t porta_destino = 0;
+    uint32_t fluxos = 0;
+    uint64_t bytes_tx = 0;
+    uint64_t bytes_rx = 0;
+    uint64_t pacotes_tx = 0;
+    uint64_t pacotes_rx = 0;
+    uint64_t pacotes_perdidos = 0;
+    double vazao_mbps = 0;
+    double atraso_ms = 0;
+    double jitter_ms = 0;
+    double perda = 0;
+    double jain = 0;
+    double jain_tcp = 0;
+    double jain_udp = 0;
+};
+
+/** Resultado de um arquivo: os fluxos em ordem de id e, por ultimo, o cenario. */
+struct AnaliseArquivo {
+    std::string arquivo;
+    std::string erro;
+    std::vector<LinhaAnalise> linhas;
+};
+
+/**
+ * Recebe as tags do LeitorXml. Os Flow de FlowStats trazem os contadores
+ * e os de Ipv4FlowClassifier a 5-tupla; os dois sao juntados pelo flowId.
+ * A profundidade distingue as secoes de primeiro nivel dos FlowStats
+ * dentro de FlowProbes.
+ */
+class TratadorFlowmon {
+public:
+    TratadorFlowmon () : m_profundidade (0), m_secao (FORA) {}
+
+    void inicio (const char *nome, const LeitorXml::Atributos &atributos) {
+        if (m_profundidade == 1) {
+            if (std::strcmp (nome, "FlowStats") == 0) {
+                m_secao = ESTATISTICAS;
+            } else if (std::strcmp (nome, "Ipv4FlowClassifier") == 0) {
+                m_secao = CLASSIFICADOR;
+            } else {
+                m_secao = FORA;
+            }
+        } else if (m_profundidade == 2 && m_secao != FORA && std::strcmp (nome, "Flow") == 0) {
+            uint64_t id = ler_inteiro (LeitorXml::valor (atributos, "flowId"));
+            if (id > 0) {
+                if (m_secao == ESTATISTICAS) {
+                    ler_estatisticas (fluxo (id), atributos);
+                } else {
+                    ler_tupla (fluxo (id), atributos);
+                }
+            }
+        }
+        m_profundidade++;
+    }
+
+    void fim (const char *) {
+        m_profundidade--;
+        if (m_profundidade == 1) {
+            m_secao = FORA;
+        }
+    }
+
+    /** Indexado por flowId - 1 (o FlowMonitor numera a partir de 1). */
+    std::vector<FluxoFlowmon> &fluxos () {
+        return m_fluxos;
+    }
+
+private:
+    enum Secao {
+        FORA,
+        ESTATISTICAS,
+        CLASSIFICADOR
+    };
+
+    FluxoFlowmon &fluxo (uint64_t id) {
+        if (id > m_fluxos.size ()) {
+            m_fluxos.resize (id);
+        }
+        return m_fluxos[id - 1];
+    }
+
+    static void ler_estatisticas (FluxoFlowmon &fluxo, const LeitorXml::Atributos &a) {
+        fluxo.presente = true;
+        fluxo.primeiro_rx_ns = ler_tempo_ns (LeitorXml::valor (a, "timeFirstRxPacket"));
+        fluxo.ultimo_rx_ns = ler_tempo_ns (LeitorXml::valor (a, "timeLastRxPacket"));
+        fluxo.soma_atraso_ns = ler_tempo_ns (LeitorXml::valor (a, "delaySum"));
+        fluxo.soma_jitter_ns = ler_tempo_ns (LeitorXml::valor (a, "jitterSum"));
+        fluxo.bytes_tx = ler_inteiro (LeitorXml::valor (a, "txBytes"));
+        fluxo.bytes_rx = ler_inteiro (LeitorXml::valor (a, "rxBytes"));
+        fluxo.pacotes_tx = ler_inteiro (LeitorXml::valor (a, "txPackets"));
+        fluxo.pacotes_rx = ler_inteiro (LeitorXml::valor (a, "rxPackets"));
+        fluxo.pacotes_perdidos = ler_inteiro (LeitorXml::valor (a, "lostPackets"));
+    }
+
+    static void ler_tupla (FluxoFlowmon &fluxo, const LeitorXml::Atributos &a) {
+        fluxo.origem = ler_ipv4 (LeitorXml::valor (a, "sourceAddress"));
+        fluxo.destino = ler_ipv4 (LeitorXml::valor (a, "destinationAddress"));
+        fluxo.protocolo = ler_inteiro (LeitorXml::valor (a, "protocol"));
+        fluxo.porta_origem = ler_inteiro (LeitorXml::valor (a, "sourcePort"));
+        fluxo.porta_destino = ler_inteiro (LeitorXml::valor (a, "destinationPort"));
+    }
+
+    uint32_t m_profundidade;
+    Secao m_secao;
+    std::vector<FluxoFlowmon> m_fluxos;
+};
+
+/**
+ * Indice de Jain, (soma x)^2 / (n soma x^2): 1 quando todos recebem o
+ * mesmo, 1/n quando um so recebe tudo. 0 sem fluxos; 1 se todos tiverem
+ * vazao zero.
+ */
+class IndiceJain {
+public:
+    IndiceJain () : m_n (0), m_soma (0), m_soma_quadrados (0) {}
+
+    void adicionar (double x) {
+        m_n++;
+        m_soma += x;
+        m_soma_quadrados += x * x;
+    }
+
+    double valor () const {
+        if (m_n == 0) {
+            return 0;
+        }
+        if (m_soma_quadrados <= 0) {
+            return 1;
+        }
+        return m_soma * m_soma / (m_n * m_soma_quadrados);
+    }
+
+private:
+    uint32_t m_n;
+    double m_soma;
+    double m_soma_quadrados;
+};
+
+typedef std::pair<uint64_t, uint32_t> TuplaTcp;
+
+inline TuplaTcp tupla_tcp(uint32_t origem, uint32_t destino, uint16_t porta_origem, uint16_t porta_destino) {
+    return TuplaTcp (uint64_t (origem) << 32 | destino, uint32_t (porta_origem) << 16 | porta_destino);
+}
+
+/**
+ * Marca controle (RIP/OLSR) e retorno: um fluxo TCP cujo sentido inverso
+ * tambem existe e transmitiu mais bytes eh o dos ACKs.
+ */
+inline std::vector<uint8_t> classificar_fluxos(const std::vector<FluxoFlowmon> &fluxos) {
+    std::vector<uint8_t> classes (fluxos.size (), CLASSE_DADOS);
+    std::map<TuplaTcp, uint64_t> bytes_tcp;
+    for (size_t i = 0; i < fluxos.size (); ++i) {
+        const FluxoFlowmon &f = fluxos[i];
+        if (f.protocolo == 6) {
+            bytes_tcp[tupla_tcp (f.origem, f.destino, f.porta_origem, f.porta_destino)] = f.bytes_tx;
+        }
+    }
+    for (size_t i = 0; i < fluxos.size (); ++i) {
+        const FluxoFlowmon &f = fluxos[i];
+        if (porta_de_controle (f.porta_origem) || porta_de_controle (f.porta_destino)) {
+            classes[i] = CLASSE_CONTROLE;
+        } else if (f.protocolo == 6) {
+            std::map<TuplaTcp, uint64_t>::const_iterator inverso = bytes_tcp.find (tupla_tcp (f.destino, f.origem, f.porta_destino, f.porta_origem));
+            if (inverso != bytes_tcp.end () && inverso->second > f.bytes_tx) {
+                classes[i] = CLASSE_RETORNO;
+            }
+        }
+    }
+    return classes;
+}
+
+/**
+ * Linhas de fluxo e a linha do cenario. O cenario soma os fluxos de dados
+ * e de retorno, como resumir_fluxos; o indice de Jain usa so os de dados.
+ */
+inline void analisar_fluxos(const std::vector<FluxoFlowmon> &fluxos, std::vector<LinhaAnalise> &linhas) {
+    std::vector<uint8_t> classes = classificar_fluxos (fluxos);
+    LinhaAnalise cenario;
+    cenario.nivel = NIVEL_CENARIO;
+    int64_t soma_atraso_ns = 0;
+    int64_t soma_jitter_ns = 0;
+    IndiceJain jain, jain_tcp, jain_udp;
+
+    linhas.clear ();
+    linhas.reserve (fluxos.size () + 1);
+    for (size_t i = 0; i < fluxos.size (); ++i) {
+        const FluxoFlowmon &f = fluxos[i];
+        if (!f.presente) {
+            continue;
+        }
+        LinhaAnalise linha;
+        linha.fluxo = i + 1;
+        linha.protocolo = f.protocolo;
+        linha.classe = classes[i];
+        linha.origem = f.origem;
+        linha.destino = f.destino;
+        linha.porta_origem = f.porta_origem;
+        linha.porta_destino = f.porta_destino;
+        linha.fluxos = 1;
+        linha.bytes_tx = f.bytes_tx;
+        linha.bytes_rx = f.bytes_rx;
+        linha.pacotes_tx = f.pacotes_tx;
+        linha.pacotes_rx = f.pacotes_rx;
+        linha.pacotes_perdidos = f.pacotes_perdidos;
+        double duracao = (f.ultimo_rx_ns - f.primeiro_rx_ns) / 1e9;
+        if (duracao > 0) {
+            linha.vazao_mbps = f.bytes_rx * 8.0 / duracao / 1e6;
+        }
+        if (f.pacotes_rx > 0) {
+            linha.atraso_ms = f.soma_atraso_ns / 1e6 / f.pacotes_rx;
+        }
+        if (f.pacotes_rx > 1) {
+            linha.jitter_ms = f.soma_jitter_ns / 1e6 / (f.pacotes_rx - 1);
+        }
+        if (f.pacotes_tx > 0) {
+            linha.perda = double (f.pacotes_perdidos) / f.pacotes_tx;
+        }
+        linhas.push_back (linha);
+
+        if (linha.classe == CLASSE_CONTROLE) {
+            continue;
+        }
+        cenario.fluxos++;
+        cenario.bytes_tx += f.bytes_tx;
+        cenario.bytes_rx += f.bytes_rx;
+        cenario.pacotes_tx += f.pacotes_tx;
+        cenario.pacotes_rx += f.pacotes_rx;
+        cenario.pacotes_perdidos += f.pacotes_perdidos;
+        cenario.vazao_mbps += linha.vazao_mbps;
+        soma_atraso_ns += f.soma_atraso_ns;
+        soma_jitter_ns += f.soma_jitter_ns;
+        if (linha.classe == CLASSE_DADOS) {
+            jain.adicionar (linha.vazao_mbps);
+            if (f.protocolo == 6) {
+                jain_tcp.adicionar (linha.vazao_mbps);
+            } else if (f.protocolo == 17) {
+                jain_udp.adicionar (linha.vazao_mbps);
+            }
+        }
+    }
+    if (cenario.pacotes_rx > 0) {
+        cenario.atraso_ms = soma_atraso_ns / 1e6 / cenario.pacotes_rx;
+    }
+    if (cenario.pacotes_rx > 1) {
+        cenario.jitter_ms = soma_jitter_ns / 1e6 / (cenario.pacotes_rx - 1);
+    }
+    if (cenario.pacotes_tx > 0) {
+        cenario.perda = double (cenario.pacotes_perdidos) / cenario.pacotes_tx;
+    }
+    cenario.jain = jain.valor ();
+    cenario.jain_tcp = jain_tcp.valor ();
+    cenario.jain_udp = jain_udp.valor ();
+    linhas.push_back (cenario);
+}
+
+/** Le e analisa um arquivo; em caso de erro, resultado.erro fica preenchido e nao ha linhas. */
+inline void analisar_arquivo_flowmon(const std::string &arquivo, AnaliseArquivo &resultado) {
+    resultado.arquivo = arquivo;
+    resultado.erro.clear ();
+    resultado.linhas.clear ();
+    LeitorXml leitor;
+    TratadorFlowmon tratador;
+    if (!leitor.ler (arquivo, tratador, resultado.erro)) {
+        return;
+    }
+    analisar_fluxos (tratador.fluxos (), resultado.linhas);
+}
+
+inline std::string cabecalho_analise_csv() {
+    return "arquivo,nivel,fluxo,protocolo,classe,origem,destino,porta_origem,porta_destino,fluxos,bytes_tx,bytes_rx,"
+           "pacotes_tx,pacotes_rx,pacotes_perdidos,vazao_mbps,atraso_ms,jitter_ms,perda,jain,jain_tcp,jain_udp";
+}
+
+/** Grava a tabela em csv ou no formato colunar descrito no inicio do arquivo. */
+class EscritorAnalise {
+public:
+    EscritorAnalise (const std::string &arquivo, bool binario) : m_binario (binario), m_linhas (0) {
+        m_saida.open (arquivo.c_str (), binario ? std::ios::out | std::ios::binary : std::ios::out);
+        if (!m_saida) {
+            NS_FATAL_ERROR ("Nao foi possivel criar " << arquivo);
+        }
+        if (m_binario) {
+            const uint32_t versao = 1;
+            m_saida.write ("FMAN", 4);
+            m_saida.write (reinterpret_cast<const char *> (&versao), sizeof (versao));
+        } else {
+            m_saida << cabecalho_analise_csv () << '\n';
+        }
+    }
+
+    void gravar (const AnaliseArquivo &analise) {
+        if (m_binario) {
+            gravar_binario (analise);
+        } else {
+            gravar_csv (analise);
+        }
+        m_linhas += analise.linhas.size ();
+    }
+
+    uint64_t linhas () const {
+        return m_linhas;
+    }
+
+    void fechar () {
+        m_saida.close ();
+    }
+
+private:
+    void gravar_csv (const AnaliseArquivo &analise) {
+        for (size_t i = 0; i < analise.linhas.size (); ++i) {
+            const LinhaAnalise &l = analise.linhas[i];
+            m_saida << analise.arquivo << ',';
+            if (l.nivel == NIVEL_FLUXO) {
+                m_saida << "fluxo," << l.fluxo << ',' << unsigned (l.protocolo) << ',' << nome_classe (l.classe) << ','
+                        << texto_ipv4 (l.origem) << ',' << texto_ipv4 (l.destino) << ',' << l.porta_origem << ',' << l.porta_destino << ',';
+            } else {
+                m_saida << "cenario,,,,,,,,";
+            }
+            m_saida << l.fluxos << ',' << l.bytes_tx << ',' << l.bytes_rx << ',' << l.pacotes_tx << ',' << l.pacotes_rx << ','
+                    << l.pacotes_perdidos << ',' << l.vazao_mbps << ',' << l.atraso_ms << ',' << l.jitter_ms << ',' << l.perda << ',';
+            if (l.nivel == NIVEL_CENARIO) {
+                m_saida << l.jain << ',' << l.jain_tcp << ',' << l.jain_udp;
+            } else {
+                m_saida << ",,";
+            }
+            m_saida << '\n';
+        }
+    }
+
+    template <typename T, typename Campo>
+    void gravar_coluna (const std::vector<LinhaAnalise> &linhas, Campo campo) {
+        m_coluna.resize (linhas.size () * sizeof (T));
+        T *valores = reinterpret_cast<T *> (&m_coluna[0]);
+        for (size_t i = 0; i < linhas.size (); ++i) {
+            valores[i] = linhas[i].*campo;
+        }
+        m_saida.write (&m_coluna[0], m_coluna.size ());
+    }
+
+    void gravar_binario (const AnaliseArquivo &analise) {
+        uint32_t tamanho = analise.arquivo.size ();
+        uint32_t n = analise.linhas.size ();
+        m_saida.write (reinterpret_cast<const char *> (&tamanho), sizeof (tamanho));
+        m_saida.write (analise.arquivo.data (), tamanho);
+        m_saida.write (reinterpret_cast<const char *> (&n), sizeof (n));
+        if (n == 0) {
+            return;
+        }
+        const std::vector<LinhaAnalise> &l = analise.linhas;
+        gravar_coluna<uint8_t> (l, &LinhaAnalise::nivel);
+        gravar_coluna<uint32_t> (l, &LinhaAnalise::fluxo);
+        gravar_coluna<uint8_t> (l, &LinhaAnalise::protocolo);
+        gravar_coluna<uint8_t> (l, &LinhaAnalise::classe);
+        gravar_coluna<uint32_t> (l, &LinhaAnalise::origem);
+        gravar_coluna<uint32_t> (l, &LinhaAnalise::destino);
+        gravar_coluna<uint16_t> (l, &LinhaAnalise::porta_origem);
+        gravar_coluna<uint16_t> (l, &LinhaAnalise::porta_destino);
+        gravar_coluna<uint32_t> (l, &LinhaAnalise::fluxos);
+        gravar_coluna<uint64_t> (l, &LinhaAnalise::bytes_tx);
+        gravar_coluna<uint64_t> (l, &LinhaAnalise::bytes_rx);
+        gravar_coluna<uint64_t> (l, &LinhaAnalise::pacotes_tx);
+        gravar_coluna<uint64_t> (l, &LinhaAnalise::pacotes_rx);
+        gravar_coluna<uint64_t> (l, &LinhaAnalise::pacotes_perdidos);
+        gravar_coluna<double> (l, &LinhaAnalise::vazao_mbps);
+        gravar_coluna<double> (l, &LinhaAnalise::atraso_ms);
+        gravar_coluna<double> (l, &LinhaAnalise::jitter_ms);
+        gravar_coluna<double> (l, &LinhaAnalise::perda);
+        gravar_coluna<double> (l, &LinhaAnalise::jain);
+        gravar_coluna<double> (l, &LinhaAnalise::jain_tcp);
+        gravar_coluna<double> (l, &LinhaAnalise::jain_udp);
+    }
+
+    bool m_binario;
+    std::ofstream m_saida;
+    std::vector<char> m_coluna;
+    uint64_t m_linhas;
+};
+
+#endif /* ANALISE_FLOWMON_H */
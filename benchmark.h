@@ -0,0 +1,159 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Resultados do benchmark (uma linha por execucao de referencia) e
+// comparacao com uma base gravada antes. Uma metrica regrediu quando piorou
+// mais que a tolerancia relativa: tempo, memoria (pico e bytes por noh e
+// por enlace) e alocacoes para cima, eventos por segundo para baixo.
+//
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct ResultadoBenchmark {
+    std::string referencia;
+    uint32_t nos = 0;
+    uint32_t enlaces = 0;
+    uint64_t eventos = 0;
+    double tempo_total_s = 0;
+    double tempo_montagem_s = 0;
+    double tempo_execucao_s = 0;
+    double eventos_por_s = 0;
+    long pico_memoria_kb = 0;
+    uint64_t alocacoes = 0;
+    int64_t bytes_por_no = 0;
+    int64_t bytes_por_enlace = 0;
+};
+
+inline const char *cabecalho_benchmark_csv() {
+    return "referencia,nos,enlaces,eventos,tempo_total_s,tempo_montagem_s,tempo_execucao_s,eventos_por_s,pico_memoria_kb,alocacoes,bytes_por_no,bytes_por_enlace";
+}
+
+inline void escrever_benchmark_csv(std::ostream &saida, const ResultadoBenchmark &resultado) {
+    saida << resultado.referencia << ',' << resultado.nos << ',' << resultado.enlaces << ',' << resultado.eventos << ','
+          << resultado.tempo_total_s << ',' << resultado.tempo_montagem_s << ',' << resultado.tempo_execucao_s << ','
+          << resultado.eventos_por_s << ',' << resultado.pico_memoria_kb << ',' << resultado.alocacoes << ','
+          << resultado.bytes_por_no << ',' << resultado.bytes_por_enlace << std::endl;
+}
+
+/**
+ * Le um CSV gravado por escrever_benchmark_csv (com o cabecalho). Bases
+ * antigas, sem as colunas de bytes, ficam com bytes zerados.
+ */
+inline std::map<std::string, ResultadoBenchmark> ler_benchmark_csv(std::istream &entrada) {
+    std::map<std::string, ResultadoBenchmark> resultados;
+    std::string linha;
+    while (std::getline (entrada, linha)) {
+        if (linha.empty () || linha.compare (0, 11, "referencia,") == 0) {
+            continue;
+        }
+        std::vector<std::string> campos;
+        size_t inicio = 0;
+        while (true) {
+            size_t virgula = linha.find (',', inicio);
+            campos.push_back (linha.substr (inicio, virgula - inicio));
+            if (virgula == std::string::npos) {
+                break;
+            }
+            inicio = virgula + 1;
+        }
+        if (campos.size () != 10 && campos.size () != 12) {
+            continue;
+        }
+        ResultadoBenchmark resultado;
+        resultado.referencia = campos[0];
+        resultado.nos = std::strtoul (campos[1].c_str (), 0, 10);
+        resultado.enlaces = std::strtoul (campos[2].c_str (), 0, 10);
+        resultado.eventos = std::strtoull (campos[3].c_str (), 0, 10);
+        resultado.tempo_total_s = std::atof (campos[4].c_str ());
+        resultado.tempo_montagem_s = std::atof (campos[5].c_str ());
+        resultado.tempo_execucao_s = std::atof (campos[6].c_str ());
+        resultado.eventos_por_s = std::atof (campos[7].c_str ());
+        resultado.pico_memoria_kb = std::atol (campos[8].c_str ());
+        resultado.alocacoes = std::strtoull (campos[9].c_str (), 0, 10);
+        if (campos.size () == 12) {
+            resultado.bytes_por_no = std::strtoll (campos[10].c_str (), 0, 10);
+            resultado.bytes_por_enlace = std::strtoll (campos[11].c_str (), 0, 10);
+        }
+        resultados[resultado.referencia] = resultado;
+    }
+    return resultados;
+}
+
+/**
+ * Imprime a variacao de cada metrica em relacao a base e devolve quantas
+ * regrediram. Referencias sem base aparecem como novas.
+ */
+inline uint32_t comparar_benchmark(const std::map<std::string, ResultadoBenchmark> &base,
+                                   const std::vector<ResultadoBenchmark> &atuais,
+                                   double tolerancia, std::ostream &saida) {
+    uint32_t regressoes = 0;
+    for (size_t i = 0; i < atuais.size (); ++i) {
+        const ResultadoBenchmark &atual = atuais[i];
+        std::map<std::string, ResultadoBenchmark>::const_iterator it = base.find (atual.referencia);
+        saida << atual.referencia << ":";
+        if (it == base.end ()) {
+            saida << " sem base" << std::endl;
+            continue;
+        }
+        const ResultadoBenchmark &anterior = it->second;
+        struct Metrica {
+            const char *nome;
+            double antes;
+            double agora;
+            bool maior_melhor;
+        };
+        Metrica metricas[] = {
+            { "tempo_total_s", anterior.tempo_total_s, atual.tempo_total_s, false },
+            { "tempo_execucao_s", anterior.tempo_execucao_s, atual.tempo_execucao_s, false },
+            { "eventos_por_s", anterior.eventos_por_s, atual.eventos_por_s, true },
+            { "pico_memoria_kb", double (anterior.pico_memoria_kb), double (atual.pico_memoria_kb), false },
+            { "alocacoes", double (anterior.alocacoes), double (atual.alocacoes), false },
+            { "bytes_por_no", double (anterior.bytes_por_no), double (atual.bytes_por_no), false },
+            { "bytes_por_enlace", double (anterior.bytes_por_enlace), double (atual.bytes_por_enlace), false },
+        };
+        for (size_t k = 0; k < sizeof (metricas) / sizeof (metricas[0]); ++k) {
+            const Metrica &metrica = metricas[k];
+            if (metrica.antes <= 0) {
+                continue;
+            }
+            double variacao = (metrica.agora - metrica.antes) / metrica.antes;
+            bool regrediu = metrica.maior_melhor ? variacao < -tolerancia : variacao > tolerancia;
+            saida << " " << metrica.nome << " " << (variacao >= 0 ? "+" : "") << variacao * 100 << "%";
+            if (regrediu) {
+                saida << " (REGRESSAO)";
+                regressoes++;
+            }
+        }
+        if (anterior.eventos != atual.eventos) {
+            saida << " [eventos mudaram: " << anterior.eventos << " -> " << atual.eventos << "]";
+        }
+        saida << std::endl;
+    }
+    return regressoes;
+}
+
+#endif /* BENCHMARK_H */
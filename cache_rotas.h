@@ -0,0 +1,341 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Cache em disco das tabelas do roteamento global, para as execucoes de
+// lote e varredura que montam a mesma topologia muitas vezes.
+//
+// O PopulateRoutingTables roda um SPF a partir de cada roteador. O
+// resultado so depende do grafo da camada IP, entao a chave do cache eh um
+// hash (FNV-1a) do que o GlobalRouteManager enxerga: para cada noh, os
+// enderecos e as adjacencias (vizinho, enlace, interface, gateway e
+// metrica). Os enderecos continuam sendo atribuidos na montagem, que eh
+// barata e le a descricao em sequencia; como entram no hash, um cache so eh
+// usado com os mesmos enderecos com que foi gravado.
+//
+// Formato (<diretorio>/rotas_<hash>.bin):
+//
+//   "ROTA", versao (u32), hash (u64), segundos do calculo original
+//   (double), segundos da extracao das tabelas (double), nohs (u32), e
+//   para cada noh: rotas (u32) e as rotas, cada uma com destino, mascara,
+//   gateway, interface e tipo (u32; 0 host, 1 rede), na ordem do
+//   Ipv4GlobalRouting. Inteiros na ordem de bytes da maquina.
+//
+
+#ifndef CACHE_ROTAS_H
+#define CACHE_ROTAS_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/ipv4-routing-table-entry.h"
+
+#include "grafo_roteamento.h"
+#include "medicao.h"
+#include "topologia.h"
+
+static const uint32_t VERSAO_CACHE_ROTAS = 2;
+
+struct RotaCache {
+    uint32_t destino;
+    uint32_t mascara;
+    uint32_t gateway;
+    uint32_t interface;
+    uint32_t tipo;
+};
+
+inline bool operator==(const RotaCache &x, const RotaCache &y) {
+    return x.destino == y.destino && x.mascara == y.mascara && x.gateway == y.gateway
+        && x.interface == y.interface && x.tipo == y.tipo;
+}
+
+typedef std::vector<std::vector<RotaCache> > TabelasCache;
+
+class HashFnv {
+public:
+    template <typename T>
+    void somar (const T &valor) {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *> (&valor);
+        for (size_t i = 0; i < sizeof (valor); ++i) {
+            m_valor = (m_valor ^ bytes[i]) * 1099511628211ULL;
+        }
+    }
+
+    uint64_t valor () const {
+        return m_valor;
+    }
+
+private:
+    uint64_t m_valor = 14695981039346656037ULL;
+};
+
+inline uint64_t hash_topologia(const Topologia &topologia) {
+    GrafoRoteamento grafo;
+    montar_grafo_roteamento (topologia, grafo);
+    HashFnv hash;
+    hash.somar (VERSAO_CACHE_ROTAS);
+    hash.somar (uint32_t (grafo.adjacencias.size ()));
+    for (size_t i = 0; i < grafo.adjacencias.size (); ++i) {
+        hash.somar (uint32_t (grafo.enderecos[i].size ()));
+        for (size_t k = 0; k < grafo.enderecos[i].size (); ++k) {
+            hash.somar (grafo.enderecos[i][k].Get ());
+        }
+        hash.somar (uint32_t (grafo.adjacencias[i].size ()));
+        for (size_t k = 0; k < grafo.adjacencias[i].size (); ++k) {
+            const Adjacencia &adjacencia = grafo.adjacencias[i][k];
+            hash.somar (adjacencia.vizinho);
+            hash.somar (adjacencia.enlace);
+            hash.somar (adjacencia.interface);
+            hash.somar (adjacencia.gateway.Get ());
+            hash.somar (adjacencia.custo);
+        }
+    }
+    for (size_t i = 0; i < topologia.enlaces.size (); ++i) {
+        hash.somar (topologia.enlaces[i].mascara.Get ());
+    }
+    return hash.valor ();
+}
+
+inline std::string arquivo_cache_rotas(const std::string &diretorio, uint64_t hash) {
+    std::ostringstream nome;
+    nome << diretorio << "/rotas_" << std::hex << hash << ".bin";
+    return nome.str ();
+}
+
+inline ns3::Ptr<ns3::Ipv4GlobalRouting> roteamento_global(ns3::Ptr<ns3::Node> no) {
+    ns3::Ptr<ns3::GlobalRouter> roteador = no->GetObject<ns3::GlobalRouter> ();
+    return roteador ? roteador->GetRoutingProtocol () : ns3::Ptr<ns3::Ipv4GlobalRouting> ();
+}
+
+/** Copia as rotas do Ipv4GlobalRouting de cada noh (ver ler_rotas). */
+inline void extrair_rotas_globais(const Topologia &topologia, TabelasCache &tabelas) {
+    tabelas.assign (topologia.nos.size (), std::vector<RotaCache> ());
+    std::vector<ns3::Ipv4RoutingTableEntry> entradas;
+    for (size_t i = 0; i < topologia.nos.size (); ++i) {
+        ns3::Ptr<ns3::Ipv4GlobalRouting> global = roteamento_global (topologia.nos[i]);
+        if (!global) {
+            continue;
+        }
+        ler_rotas (global, entradas);
+        tabelas[i].reserve (entradas.size ());
+        for (size_t k = 0; k < entradas.size (); ++k) {
+            const ns3::Ipv4RoutingTableEntry &entrada = entradas[k];
+            RotaCache rota;
+            rota.destino = entrada.IsHost () ? entrada.GetDest ().Get () : entrada.GetDestNetwork ().Get ();
+            rota.mascara = entrada.IsHost () ? 0xffffffff : entrada.GetDestNetworkMask ().Get ();
+            rota.gateway = entrada.GetGateway ().Get ();
+            rota.interface = entrada.GetInterface ();
+            rota.tipo = entrada.IsHost () ? 0 : 1;
+            tabelas[i].push_back (rota);
+        }
+    }
+}
+
+/** Instala as rotas nos Ipv4GlobalRouting, ainda vazios, dos nohs. */
+inline void instalar_rotas_globais(const Topologia &topologia, const TabelasCache &tabelas) {
+    for (size_t i = 0; i < topologia.nos.size (); ++i) {
+        ns3::Ptr<ns3::Ipv4GlobalRouting> global = roteamento_global (topologia.nos[i]);
+        if (!global) {
+            continue;
+        }
+        const std::vector<RotaCache> &rotas = tabelas[i];
+        for (size_t k = 0; k < rotas.size (); ++k) {
+            const RotaCache &rota = rotas[k];
+            if (rota.tipo == 0) {
+                global->AddHostRouteTo (ns3::Ipv4Address (rota.destino), ns3::Ipv4Address (rota.gateway), rota.interface);
+            } else {
+                global->AddNetworkRouteTo (ns3::Ipv4Address (rota.destino), ns3::Ipv4Mask (rota.mascara),
+                                           ns3::Ipv4Address (rota.gateway), rota.interface);
+            }
+        }
+    }
+}
+
+/**
+ * Grava num arquivo temporario e renomeia, para que execucoes paralelas do
+ * lote nunca leiam um cache pela metade.
+ */
+inline bool gravar_cache_rotas(const std::string &arquivo, uint64_t hash, double segundos, double segundos_extracao,
+                               const TabelasCache &tabelas) {
+    std::ostringstream temporario;
+    temporario << arquivo << "." << getpid () << ".tmp";
+    {
+        std::ofstream saida (temporario.str ().c_str (), std::ios::out | std::ios::binary);
+        if (!saida) {
+            return false;
+        }
+        uint32_t nos = tabelas.size ();
+        saida.write ("ROTA", 4);
+        saida.write (reinterpret_cast<const char *> (&VERSAO_CACHE_ROTAS), sizeof (VERSAO_CACHE_ROTAS));
+        saida.write (reinterpret_cast<const char *> (&hash), sizeof (hash));
+        saida.write (reinterpret_cast<const char *> (&segundos), sizeof (segundos));
+        saida.write (reinterpret_cast<const char *> (&segundos_extracao), sizeof (segundos_extracao));
+        saida.write (reinterpret_cast<const char *> (&nos), sizeof (nos));
+        for (size_t i = 0; i < tabelas.size (); ++i) {
+            uint32_t rotas = tabelas[i].size ();
+            saida.write (reinterpret_cast<const char *> (&rotas), sizeof (rotas));
+            if (rotas > 0) {
+                saida.write (reinterpret_cast<const char *> (&tabelas[i][0]), rotas * sizeof (RotaCache));
+            }
+        }
+        if (!saida) {
+            std::remove (temporario.str ().c_str ());
+            return false;
+        }
+    }
+    return std::rename (temporario.str ().c_str (), arquivo.c_str ()) == 0;
+}
+
+/** Le o cache; false se nao existir ou nao for desta topologia. */
+inline bool ler_cache_rotas(const std::string &arquivo, uint64_t hash, uint32_t nos, double &segundos, double &segundos_extracao,
+                            TabelasCache &tabelas) {
+    std::ifstream entrada (arquivo.c_str (), std::ios::in | std::ios::binary);
+    if (!entrada) {
+        return false;
+    }
+    char magico[4];
+    uint32_t versao = 0;
+    uint64_t hash_gravado = 0;
+    uint32_t nos_gravados = 0;
+    entrada.read (magico, 4);
+    entrada.read (reinterpret_cast<char *> (&versao), sizeof (versao));
+    entrada.read (reinterpret_cast<char *> (&hash_gravado), sizeof (hash_gravado));
+    entrada.read (reinterpret_cast<char *> (&segundos), sizeof (segundos));
+    entrada.read (reinterpret_cast<char *> (&segundos_extracao), sizeof (segundos_extracao));
+    entrada.read (reinterpret_cast<char *> (&nos_gravados), sizeof (nos_gravados));
+    if (!entrada || std::string (magico, 4) != "ROTA" || versao != VERSAO_CACHE_ROTAS
+        || hash_gravado != hash || nos_gravados != nos) {
+        return false;
+    }
+    tabelas.assign (nos, std::vector<RotaCache> ());
+    for (uint32_t i = 0; i < nos; ++i) {
+        uint32_t rotas = 0;
+        entrada.read (reinterpret_cast<char *> (&rotas), sizeof (rotas));
+        tabelas[i].resize (rotas);
+        if (rotas > 0) {
+            entrada.read (reinterpret_cast<char *> (&tabelas[i][0]), rotas * sizeof (RotaCache));
+        }
+        if (!entrada) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct ResumoCacheRotas {
+    std::string arquivo;
+    bool encontrado = false;
+    bool gravado = false;
+    // Tempo do PopulateRoutingTables (o de quando o cache foi gravado, se
+    // nao foi recalculado agora) e o da leitura do cache
+    double segundos_calculo = 0;
+    double segundos_leitura = 0;
+    // Extracao das tabelas calculadas, paga uma vez por cache gravado
+    double segundos_extracao = 0;
+    uint64_t rotas = 0;
+    // Com verificacao: o cache foi comparado com as tabelas recalculadas
+    bool verificado = false;
+    uint32_t nos_divergentes = 0;
+};
+
+/**
+ * Substitui o PopulateRoutingTables: instala as tabelas do cache, se houver
+ * um para esta topologia, ou calcula e grava. Com verificar, calcula mesmo
+ * com o cache e compara noh a noh; ficam as tabelas recalculadas.
+ */
+inline ResumoCacheRotas popular_rotas_com_cache(const Topologia &topologia, const std::string &diretorio, bool verificar) {
+    ResumoCacheRotas resumo;
+    uint64_t hash = hash_topologia (topologia);
+    resumo.arquivo = arquivo_cache_rotas (diretorio, hash);
+
+    TabelasCache cache;
+    std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now ();
+    double segundos_gravados = 0;
+    double extracao_gravada = 0;
+    resumo.encontrado = ler_cache_rotas (resumo.arquivo, hash, topologia.nos.size (), segundos_gravados, extracao_gravada, cache);
+    if (resumo.encontrado && !verificar) {
+        instalar_rotas_globais (topologia, cache);
+        resumo.segundos_leitura = segundos_desde (inicio);
+        resumo.segundos_calculo = segundos_gravados;
+        resumo.segundos_extracao = extracao_gravada;
+        for (size_t i = 0; i < cache.size (); ++i) {
+            resumo.rotas += cache[i].size ();
+        }
+        return resumo;
+    }
+    resumo.segundos_leitura = segundos_desde (inicio);
+
+    inicio = std::chrono::steady_clock::now ();
+    ns3::Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+    resumo.segundos_calculo = segundos_desde (inicio);
+    inicio = std::chrono::steady_clock::now ();
+    TabelasCache calculadas;
+    extrair_rotas_globais (topologia, calculadas);
+    resumo.segundos_extracao = segundos_desde (inicio);
+    for (size_t i = 0; i < calculadas.size (); ++i) {
+        resumo.rotas += calculadas[i].size ();
+    }
+
+    if (resumo.encontrado) {
+        resumo.verificado = true;
+        for (size_t i = 0; i < calculadas.size (); ++i) {
+            if (cache[i] != calculadas[i]) {
+                resumo.nos_divergentes++;
+            }
+        }
+    }
+    if (!resumo.encontrado || resumo.nos_divergentes > 0) {
+        resumo.gravado = gravar_cache_rotas (resumo.arquivo, hash, resumo.segundos_calculo, resumo.segundos_extracao, calculadas);
+    }
+    return resumo;
+}
+
+inline void imprimir_cache_rotas(const ResumoCacheRotas &resumo, std::ostream &saida) {
+    saida << "Cache de rotas " << resumo.arquivo << ": ";
+    if (resumo.verificado) {
+        saida << "verificado, ";
+        if (resumo.nos_divergentes == 0) {
+            saida << "identico as tabelas calculadas";
+        } else {
+            saida << "DIVERGE em " << resumo.nos_divergentes << " nohs" << (resumo.gravado ? " (regravado)" : "");
+        }
+        saida << "; calculo em " << resumo.segundos_calculo << " s, leitura em " << resumo.segundos_leitura << " s, extracao em "
+              << resumo.segundos_extracao << " s";
+    } else if (resumo.encontrado) {
+        saida << resumo.rotas << " rotas carregadas em " << resumo.segundos_leitura << " s, economia de "
+              << resumo.segundos_calculo - resumo.segundos_leitura << " s sobre o calculo (" << resumo.segundos_calculo
+              << " s); a extracao custou " << resumo.segundos_extracao << " s, uma vez";
+    } else {
+        saida << "ausente, " << resumo.rotas << " rotas calculadas em " << resumo.segundos_calculo << " s"
+              << (resumo.gravado ? " e gravadas" : "; nao foi possivel gravar") << " (extracao em " << resumo.segundos_extracao << " s)";
+    }
+    saida << std::endl;
+}
+
+#endif /* CACHE_ROTAS_H */
@@ -0,0 +1,160 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Registro dos cenarios de simulacao. Cada cenario eh um conjunto nomeado
+// de fluxos entre nohs da topologia, escolhido em tempo de execucao.
+//
+
+#ifndef CENARIOS_H
+#define CENARIOS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Fluxo {
+    bool udp;
+    std::string origem;
+    std::string destino;
+    double inicio;
+    double fim;
+    uint16_t porta;
+};
+
+struct Cenario {
+    std::string nome;
+    std::vector<Fluxo> fluxos;
+};
+
+inline Fluxo fluxo_tcp(const std::string &origem, const std::string &destino, double tempo_fim, uint16_t porta) {
+    Fluxo fluxo = { false, origem, destino, 0.0, tempo_fim, porta };
+    return fluxo;
+}
+
+inline Fluxo fluxo_udp(const std::string &origem, const std::string &destino, double tempo_fim, uint16_t porta) {
+    Fluxo fluxo = { true, origem, destino, 0.0, tempo_fim, porta };
+    return fluxo;
+}
+
+/**
+ * Cenarios simulacao_01 a simulacao_08 sobre a topologia padrao. Todos os
+ * fluxos vao de 0 ate tempo_fim.
+ */
+inline std::vector<Cenario> cenarios_padrao(double tempo_fim) {
+    std::vector<Cenario> cenarios (8);
+
+    cenarios[0].nome = "simulacao_01";
+    cenarios[0].fluxos.push_back (fluxo_tcp ("N2", "S3", tempo_fim, 10));
+    cenarios[0].fluxos.push_back (fluxo_tcp ("N2", "S3", tempo_fim, 11));
+    cenarios[0].fluxos.push_back (fluxo_tcp ("N1", "N3", tempo_fim, 12));
+    cenarios[0].fluxos.push_back (fluxo_tcp ("N2", "S3", tempo_fim, 13));
+    cenarios[0].fluxos.push_back (fluxo_tcp ("S1", "S2", tempo_fim, 14));
+    cenarios[0].fluxos.push_back (fluxo_tcp ("N1", "N3", tempo_fim, 15));
+    cenarios[0].fluxos.push_back (fluxo_tcp ("S1", "S2", tempo_fim, 16));
+    cenarios[0].fluxos.push_back (fluxo_tcp ("N1", "N3", tempo_fim, 17));
+
+    cenarios[1].nome = "simulacao_02";
+    cenarios[1].fluxos.push_back (fluxo_tcp ("N1", "N3", tempo_fim, 18));
+    cenarios[1].fluxos.push_back (fluxo_tcp ("S1", "S2", tempo_fim, 19));
+    cenarios[1].fluxos.push_back (fluxo_tcp ("N1", "N3", tempo_fim, 20));
+    cenarios[1].fluxos.push_back (fluxo_tcp ("S1", "S2", tempo_fim, 21));
+    cenarios[1].fluxos.push_back (fluxo_tcp ("N2", "S3", tempo_fim, 22));
+
+    cenarios[2].nome = "simulacao_03";
+    cenarios[2].fluxos.push_back (fluxo_udp ("N2", "S3", tempo_fim, 23));
+    cenarios[2].fluxos.push_back (fluxo_udp ("N2", "S3", tempo_fim, 24));
+    cenarios[2].fluxos.push_back (fluxo_udp ("N1", "N3", tempo_fim, 25));
+    cenarios[2].fluxos.push_back (fluxo_udp ("N2", "S3", tempo_fim, 26));
+    cenarios[2].fluxos.push_back (fluxo_udp ("S1", "S2", tempo_fim, 27));
+    cenarios[2].fluxos.push_back (fluxo_udp ("S1", "S2", tempo_fim, 28));
+    cenarios[2].fluxos.push_back (fluxo_udp ("N1", "N3", tempo_fim, 29));
+    cenarios[2].fluxos.push_back (fluxo_udp ("N2", "S3", tempo_fim, 30));
+
+    cenarios[3].nome = "simulacao_04";
+    cenarios[3].fluxos.push_back (fluxo_udp ("N1", "N3", tempo_fim, 31));
+    cenarios[3].fluxos.push_back (fluxo_udp ("S1", "S2", tempo_fim, 32));
+    cenarios[3].fluxos.push_back (fluxo_udp ("N1", "N3", tempo_fim, 33));
+    cenarios[3].fluxos.push_back (fluxo_udp ("S1", "S2", tempo_fim, 34));
+    cenarios[3].fluxos.push_back (fluxo_udp ("N2", "S3", tempo_fim, 35));
+
+    cenarios[4].nome = "simulacao_05";
+    cenarios[4].fluxos.push_back (fluxo_tcp ("N2", "S3", tempo_fim, 36));
+    cenarios[4].fluxos.push_back (fluxo_udp ("N1", "N3", tempo_fim, 37));
+    cenarios[4].fluxos.push_back (fluxo_tcp ("N2", "S3", tempo_fim, 38));
+    cenarios[4].fluxos.push_back (fluxo_udp ("S1", "S2", tempo_fim, 39));
+    cenarios[4].fluxos.push_back (fluxo_tcp ("N2", "S3", tempo_fim, 40));
+    cenarios[4].fluxos.push_back (fluxo_udp ("S1", "S2", tempo_fim, 41));
+    cenarios[4].fluxos.push_back (fluxo_udp ("N1", "N3", tempo_fim, 42));
+
+    cenarios[5].nome = "simulacao_06";
+    cenarios[5].fluxos.push_back (fluxo_tcp ("N1", "N3", tempo_fim, 43));
+    cenarios[5].fluxos.push_back (fluxo_tcp ("S1", "S2", tempo_fim, 44));
+    cenarios[5].fluxos.push_back (fluxo_udp ("N2", "S3", tempo_fim, 45));
+
+    cenarios[6].nome = "simulacao_07";
+    cenarios[6].fluxos.push_back (fluxo_udp ("N2", "S3", tempo_fim, 46));
+    cenarios[6].fluxos.push_back (fluxo_tcp ("N1", "N3", tempo_fim, 47));
+    cenarios[6].fluxos.push_back (fluxo_udp ("N2", "S3", tempo_fim, 48));
+    cenarios[6].fluxos.push_back (fluxo_tcp ("S1", "S2", tempo_fim, 49));
+    cenarios[6].fluxos.push_back (fluxo_udp ("N2", "S3", tempo_fim, 50));
+    cenarios[6].fluxos.push_back (fluxo_tcp ("S1", "S2", tempo_fim, 51));
+    cenarios[6].fluxos.push_back (fluxo_tcp ("N1", "N3", tempo_fim, 52));
+
+    cenarios[7].nome = "simulacao_08";
+    cenarios[7].fluxos.push_back (fluxo_udp ("N1", "N3", tempo_fim, 53));
+    cenarios[7].fluxos.push_back (fluxo_udp ("S1", "S2", tempo_fim, 54));
+    cenarios[7].fluxos.push_back (fluxo_tcp ("N2", "S3", tempo_fim, 55));
+
+    return cenarios;
+}
+
+inline const Cenario *buscar_cenario(const std::vector<Cenario> &cenarios, const std::string &nome) {
+    for (size_t i = 0; i < cenarios.size (); ++i) {
+        if (cenarios[i].nome == nome) {
+            return &cenarios[i];
+        }
+    }
+    return 0;
+}
+
+/**
+ * Nomes separados por virgula. "todos" seleciona todos os cenarios.
+ */
+inline std::vector<std::string> separar_nomes(const std::vector<Cenario> &cenarios, const std::string &lista) {
+    std::vector<std::string> nomes;
+    if (lista == "todos") {
+        for (size_t i = 0; i < cenarios.size (); ++i) {
+            nomes.push_back (cenarios[i].nome);
+        }
+        return nomes;
+    }
+    size_t inicio = 0;
+    while (inicio <= lista.size ()) {
+        size_t virgula = lista.find (',', inicio);
+        if (virgula == std::string::npos) {
+            virgula = lista.size ();
+        }
+        if (virgula > inicio) {
+            nomes.push_back (lista.substr (inicio, virgula - inicio));
+        }
+        inicio = virgula + 1;
+    }
+    return nomes;
+}
+
+#endif /* CENARIOS_H */
@@ -0,0 +1,174 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Escolha do escalonador de eventos: os do ns-3 (map, heap, list,
+// calendar) e o heap4 daqui.
+//
+// O MapScheduler, padrao do ns-3, guarda cada evento pendente num noh de
+// arvore rubro-negra alocado separadamente: com milhoes de timers (RED,
+// retransmissao do TCP, envios do OnOff) cada insercao eh uma alocacao e
+// cada comparacao um acesso fora do cache. O heap4 guarda os eventos num
+// vetor contiguo e cada noh tem 4 filhos vizinhos na memoria, entao a
+// altura cai pela metade em relacao ao heap binario do HeapScheduler e os
+// filhos comparados na descida ficam nas mesmas linhas de cache.
+//
+
+#ifndef ESCALONADOR_H
+#define ESCALONADOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+
+class EscalonadorHeap4 : public ns3::Scheduler {
+public:
+    static ns3::TypeId GetTypeId (void) {
+        static ns3::TypeId tid = ns3::TypeId ("EscalonadorHeap4")
+            .SetParent<ns3::Scheduler> ()
+            .AddConstructor<EscalonadorHeap4> ();
+        return tid;
+    }
+
+    virtual void Insert (const Event &evento) {
+        m_eventos.push_back (evento);
+        subir (m_eventos.size () - 1);
+    }
+
+    virtual bool IsEmpty (void) const {
+        return m_eventos.empty ();
+    }
+
+    virtual Event PeekNext (void) const {
+        return m_eventos.front ();
+    }
+
+    virtual Event RemoveNext (void) {
+        Event primeiro = m_eventos.front ();
+        remover_posicao (0);
+        return primeiro;
+    }
+
+    /** Busca linear pelo uid, como no HeapScheduler: Remove eh raro. */
+    virtual void Remove (const Event &evento) {
+        for (size_t i = 0; i < m_eventos.size (); ++i) {
+            if (m_eventos[i].key.m_uid == evento.key.m_uid) {
+                remover_posicao (i);
+                return;
+            }
+        }
+        NS_FATAL_ERROR ("EscalonadorHeap4: evento " << evento.key.m_uid << " nao esta na fila");
+    }
+
+private:
+    static const size_t GRAU = 4;
+
+    void remover_posicao (size_t i) {
+        Event ultimo = m_eventos.back ();
+        m_eventos.pop_back ();
+        if (i == m_eventos.size ()) {
+            return;
+        }
+        m_eventos[i] = ultimo;
+        if (i > 0 && ultimo.key < m_eventos[(i - 1) / GRAU].key) {
+            subir (i);
+        } else {
+            descer (i);
+        }
+    }
+
+    void subir (size_t i) {
+        Event evento = m_eventos[i];
+        while (i > 0) {
+            size_t pai = (i - 1) / GRAU;
+            if (!(evento.key < m_eventos[pai].key)) {
+                break;
+            }
+            m_eventos[i] = m_eventos[pai];
+            i = pai;
+        }
+        m_eventos[i] = evento;
+    }
+
+    void descer (size_t i) {
+        Event evento = m_eventos[i];
+        size_t n = m_eventos.size ();
+        while (true) {
+            size_t primeiro = GRAU * i + 1;
+            if (primeiro >= n) {
+                break;
+            }
+            size_t menor = primeiro;
+            size_t fim = std::min (primeiro + GRAU, n);
+            for (size_t filho = primeiro + 1; filho < fim; ++filho) {
+                if (m_eventos[filho].key < m_eventos[menor].key) {
+                    menor = filho;
+                }
+            }
+            if (!(m_eventos[menor].key < evento.key)) {
+                break;
+            }
+            m_eventos[i] = m_eventos[menor];
+            i = menor;
+        }
+        m_eventos[i] = evento;
+    }
+
+    std::vector<Event> m_eventos;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (EscalonadorHeap4);
+
+/** Nomes aceitos em --Escalonador, na ordem do benchmark. */
+inline std::vector<std::string> nomes_escalonadores() {
+    std::vector<std::string> nomes;
+    nomes.push_back ("map");
+    nomes.push_back ("heap");
+    nomes.push_back ("list");
+    nomes.push_back ("calendar");
+    nomes.push_back ("heap4");
+    return nomes;
+}
+
+/** TypeId do escalonador; vazio para nomes desconhecidos. */
+inline std::string tipo_do_escalonador(const std::string &nome) {
+    if (nome == "map") return "ns3::MapScheduler";
+    if (nome == "heap") return "ns3::HeapScheduler";
+    if (nome == "list") return "ns3::ListScheduler";
+    if (nome == "calendar") return "ns3::CalendarScheduler";
+    if (nome == "heap4") return "EscalonadorHeap4";
+    return "";
+}
+
+/**
+ * Troca o escalonador do simulador. O Simulator::Destroy do fim de cada
+ * execucao volta ao padrao, entao eh chamada no inicio de cada uma.
+ */
+inline void configurar_escalonador(const std::string &nome) {
+    std::string tipo = tipo_do_escalonador (nome);
+    if (tipo.empty ()) {
+        NS_FATAL_ERROR ("Escalonador desconhecido: " << nome << " (use map, heap, list, calendar ou heap4)");
+    }
+    ns3::ObjectFactory fabrica;
+    fabrica.SetTypeId (tipo);
+    ns3::Simulator::SetScheduler (fabrica);
+}
+
+#endif /* ESCALONADOR_H */
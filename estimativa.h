@@ -0,0 +1,350 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Estimativa analitica da vazao de cada fluxo, sem simular: divisao
+// max-min justa da capacidade de cada sentido de enlace entre os fluxos que
+// passam por ele, limitada pela taxa oferecida de cada fluxo (enchimento
+// progressivo). Todos os fluxos sao considerados simultaneos.
+//
+// Os caminhos sao os das tabelas de roteamento ja instaladas (consulta ao
+// RouteOutput de cada noh, salto a salto, com cache por noh e destino); sem
+// tabelas (rip/olsr antes da simulacao), os caminhos de menor custo do
+// grafo IP. Taxas e capacidades sao contadas com os cabecalhos; as vazoes
+// informadas sao as das aplicacoes.
+//
+
+#ifndef ESTIMATIVA_H
+#define ESTIMATIVA_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include "grafo_roteamento.h"
+#include "matriz_fluxos.h"
+#include "medicao.h"
+#include "topologia.h"
+
+class CaminhosRoteados {
+public:
+    CaminhosRoteados (const Topologia &topologia, bool usar_tabelas)
+        : m_topologia (topologia), m_usar_tabelas (usar_tabelas) {
+        if (usar_tabelas) {
+            mapear_sentidos (topologia, m_sentido_do_dispositivo);
+        } else {
+            montar_grafo_roteamento (topologia, m_grafo);
+            m_primeiro_salto.assign (topologia.nos.size (), std::vector<int32_t> ());
+        }
+    }
+
+    /** Sentidos de enlace de origem ate destino; false se nao houver rota. */
+    bool caminho (uint32_t origem, uint32_t destino, std::vector<uint32_t> &sentidos) {
+        sentidos.clear ();
+        uint32_t atual = origem;
+        for (uint32_t saltos = 0; atual != destino; ++saltos) {
+            int32_t sentido = proximo_sentido (atual, destino);
+            if (sentido < 0 || saltos >= m_topologia.nos.size ()) {
+                sentidos.clear ();
+                return false;
+            }
+            sentidos.push_back (sentido);
+            atual = fim_do_sentido (m_topologia, sentido);
+        }
+        return true;
+    }
+
+private:
+    int32_t proximo_sentido (uint32_t no, uint32_t destino) {
+        uint64_t chave = (uint64_t (no) << 32) | destino;
+        std::unordered_map<uint64_t, int32_t>::const_iterator it = m_cache.find (chave);
+        if (it != m_cache.end ()) {
+            return it->second;
+        }
+        int32_t sentido = -1;
+        if (m_usar_tabelas) {
+            sentido = sentido_da_tabela (m_topologia, m_sentido_do_dispositivo, no, destino);
+        } else {
+            std::vector<int32_t> &primeiro = m_primeiro_salto[no];
+            if (primeiro.empty ()) {
+                std::vector<uint32_t> distancia;
+                caminhos_minimos (m_grafo, no, distancia, &primeiro);
+            }
+            if (primeiro[destino] >= 0) {
+                const Adjacencia &adjacencia = m_grafo.adjacencias[no][primeiro[destino]];
+                sentido = 2 * adjacencia.enlace + (m_topologia.enlaces[adjacencia.enlace].a == no ? 0 : 1);
+            }
+        }
+        m_cache[chave] = sentido;
+        return sentido;
+    }
+
+    const Topologia &m_topologia;
+    bool m_usar_tabelas;
+    SentidosDispositivos m_sentido_do_dispositivo;
+    std::unordered_map<uint64_t, int32_t> m_cache;
+    GrafoRoteamento m_grafo;
+    std::vector<std::vector<int32_t> > m_primeiro_salto;
+};
+
+/**
+ * Enchimento progressivo: todos os fluxos ainda livres crescem juntos ate
+ * que um sentido de enlace sature (os fluxos dele congelam nesse nivel) ou
+ * que o nivel alcance a demanda de algum fluxo (que congela na demanda).
+ *
+ * O nivel em que cada sentido satura, (capacidade - ocupada) / livres, so
+ * cresce conforme os fluxos congelam, entao os sentidos ficam num heap de
+ * minimo com remocao preguicosa: ao congelar um fluxo, so os sentidos do
+ * caminho dele recebem uma entrada nova, e as antigas sao descartadas ao
+ * chegar ao topo. O custo fica O(P log P), com P a soma dos comprimentos
+ * dos caminhos, em vez de varrer todos os sentidos a cada iteracao.
+ *
+ * Em gargalo fica o sentido que limitou cada fluxo (-1 quando foi a propria
+ * demanda ou nao ha rota).
+ */
+inline void max_min_justo(const std::vector<double> &capacidade, const std::vector<std::vector<uint32_t> > &caminhos,
+                          const std::vector<double> &demanda, std::vector<double> &taxa, std::vector<int32_t> &gargalo) {
+    size_t fluxos = caminhos.size ();
+    size_t sentidos = capacidade.size ();
+    taxa.assign (fluxos, 0);
+    gargalo.assign (fluxos, -1);
+
+    // Fluxos de cada sentido, em formato compacto
+    std::vector<uint32_t> inicio (sentidos + 1, 0);
+    for (size_t f = 0; f < fluxos; ++f) {
+        for (size_t k = 0; k < caminhos[f].size (); ++k) {
+            inicio[caminhos[f][k] + 1]++;
+        }
+    }
+    std::partial_sum (inicio.begin (), inicio.end (), inicio.begin ());
+    std::vector<uint32_t> fluxos_do_sentido (inicio[sentidos]);
+    std::vector<uint32_t> posicao (inicio.begin (), inicio.end () - 1);
+    for (size_t f = 0; f < fluxos; ++f) {
+        for (size_t k = 0; k < caminhos[f].size (); ++k) {
+            fluxos_do_sentido[posicao[caminhos[f][k]]++] = f;
+        }
+    }
+
+    std::vector<uint32_t> livres (sentidos, 0);
+    std::vector<double> ocupada (sentidos, 0);
+    std::vector<bool> congelado (fluxos, false);
+    size_t restantes = 0;
+    for (size_t f = 0; f < fluxos; ++f) {
+        if (caminhos[f].empty () || demanda[f] <= 0) {
+            congelado[f] = true;
+            continue;
+        }
+        restantes++;
+        for (size_t k = 0; k < caminhos[f].size (); ++k) {
+            livres[caminhos[f][k]]++;
+        }
+    }
+    std::vector<uint32_t> ordem (fluxos);
+    std::iota (ordem.begin (), ordem.end (), 0);
+    std::sort (ordem.begin (), ordem.end (), [&] (uint32_t a, uint32_t b) {
+        return demanda[a] < demanda[b];
+    });
+    size_t proxima = 0;
+
+    // (nivel de saturacao, sentido); so vale a entrada com o nivel atual
+    typedef std::pair<double, uint32_t> EntradaSentido;
+    std::priority_queue<EntradaSentido, std::vector<EntradaSentido>, std::greater<EntradaSentido> > heap;
+    auto nivel_do_sentido = [&] (uint32_t s) {
+        return std::max (0.0, capacidade[s] - ocupada[s]) / livres[s];
+    };
+    for (uint32_t s = 0; s < sentidos; ++s) {
+        if (livres[s] > 0) {
+            heap.push (EntradaSentido (nivel_do_sentido (s), s));
+        }
+    }
+
+    auto congelar = [&] (uint32_t f, double valor, int32_t limitante) {
+        congelado[f] = true;
+        taxa[f] = valor;
+        gargalo[f] = limitante;
+        for (size_t k = 0; k < caminhos[f].size (); ++k) {
+            uint32_t s = caminhos[f][k];
+            livres[s]--;
+            ocupada[s] += valor;
+            if (livres[s] > 0) {
+                heap.push (EntradaSentido (nivel_do_sentido (s), s));
+            }
+        }
+        restantes--;
+    };
+
+    while (restantes > 0) {
+        while (!heap.empty () && (livres[heap.top ().second] == 0 || heap.top ().first != nivel_do_sentido (heap.top ().second))) {
+            heap.pop ();
+        }
+        while (congelado[ordem[proxima]]) {
+            proxima++;
+        }
+        double nivel_demanda = demanda[ordem[proxima]];
+        double nivel_enlace = heap.empty () ? std::numeric_limits<double>::infinity () : heap.top ().first;
+
+        if (nivel_demanda <= nivel_enlace) {
+            while (proxima < fluxos && demanda[ordem[proxima]] <= nivel_demanda) {
+                if (!congelado[ordem[proxima]]) {
+                    congelar (ordem[proxima], demanda[ordem[proxima]], -1);
+                }
+                proxima++;
+            }
+            proxima = std::min (proxima, fluxos - 1);
+            continue;
+        }
+        uint32_t s = heap.top ().second;
+        heap.pop ();
+        for (uint32_t k = inicio[s]; k < inicio[s + 1]; ++k) {
+            if (!congelado[fluxos_do_sentido[k]]) {
+                congelar (fluxos_do_sentido[k], nivel_enlace, s);
+            }
+        }
+    }
+}
+
+struct ResumoEstimativa {
+    uint32_t fluxos = 0;
+    uint32_t sem_rota = 0;
+    uint32_t limitados = 0;
+    double demanda_mbps = 0;
+    double vazao_mbps = 0;
+    uint32_t enlaces_saturados = 0;
+    double utilizacao_maxima = 0;
+    std::string gargalo = "-";
+    double tempo_ms = 0;
+};
+
+class EstimativaVazao {
+public:
+    EstimativaVazao (const Topologia &topologia, const std::vector<FluxoMatriz> &fluxos)
+        : m_topologia (topologia), m_fluxos (fluxos) {
+    }
+
+    ResumoEstimativa calcular (bool usar_tabelas) {
+        std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now ();
+        size_t sentidos = 2 * m_topologia.enlaces.size ();
+        m_capacidade.assign (sentidos, 0);
+        for (size_t i = 0; i < m_topologia.enlaces.size (); ++i) {
+            double capacidade = ns3::DataRate (m_topologia.classes[m_topologia.enlaces[i].classe].taxa).GetBitRate ();
+            m_capacidade[2 * i] = m_capacidade[2 * i + 1] = capacidade;
+        }
+
+        CaminhosRoteados rotas (m_topologia, usar_tabelas);
+        m_caminhos.assign (m_fluxos.size (), std::vector<uint32_t> ());
+        std::vector<double> demanda (m_fluxos.size ());
+        ResumoEstimativa resumo;
+        resumo.fluxos = m_fluxos.size ();
+        for (size_t f = 0; f < m_fluxos.size (); ++f) {
+            if (!rotas.caminho (m_fluxos[f].origem, m_fluxos[f].destino, m_caminhos[f])) {
+                resumo.sem_rota++;
+            }
+            demanda[f] = taxa_com_cabecalhos (m_fluxos[f]);
+        }
+        max_min_justo (m_capacidade, m_caminhos, demanda, m_taxa, m_gargalo);
+
+        m_carga.assign (sentidos, 0);
+        m_quantidade.assign (sentidos, 0);
+        for (size_t f = 0; f < m_fluxos.size (); ++f) {
+            for (size_t k = 0; k < m_caminhos[f].size (); ++k) {
+                m_carga[m_caminhos[f][k]] += m_taxa[f];
+                m_quantidade[m_caminhos[f][k]]++;
+            }
+            resumo.demanda_mbps += m_fluxos[f].taxa.GetBitRate () / 1e6;
+            resumo.vazao_mbps += vazao_aplicacao (f) / 1e6;
+            if (m_taxa[f] < demanda[f] * (1 - 1e-9)) {
+                resumo.limitados++;
+            }
+        }
+        for (size_t s = 0; s < sentidos; ++s) {
+            double utilizacao = m_capacidade[s] > 0 ? m_carga[s] / m_capacidade[s] : 0;
+            if (utilizacao >= 1 - 1e-9) {
+                resumo.enlaces_saturados++;
+            }
+            if (utilizacao > resumo.utilizacao_maxima) {
+                resumo.utilizacao_maxima = utilizacao;
+                resumo.gargalo = nome_do_sentido (m_topologia, s);
+            }
+        }
+        resumo.tempo_ms = segundos_desde (inicio) * 1e3;
+        return resumo;
+    }
+
+    void escrever_fluxos_csv (std::ostream &saida) const {
+        saida << "origem,destino,protocolo,porta,demanda_mbps,vazao_mbps,gargalo" << std::endl;
+        for (size_t f = 0; f < m_fluxos.size (); ++f) {
+            const FluxoMatriz &fluxo = m_fluxos[f];
+            saida << m_topologia.nomes[fluxo.origem] << ',' << m_topologia.nomes[fluxo.destino] << ','
+                  << (fluxo.udp ? "udp" : "tcp") << ',' << fluxo.porta << ',' << fluxo.taxa.GetBitRate () / 1e6 << ','
+                  << vazao_aplicacao (f) / 1e6 << ','
+                  << (m_caminhos[f].empty () ? "sem_rota" : m_gargalo[f] < 0 ? "demanda" : nome_do_sentido (m_topologia, m_gargalo[f]))
+                  << std::endl;
+        }
+    }
+
+    void escrever_enlaces_csv (std::ostream &saida) const {
+        saida << "sentido,classe,capacidade_mbps,carga_mbps,utilizacao,fluxos" << std::endl;
+        for (size_t s = 0; s < m_carga.size (); ++s) {
+            if (m_quantidade[s] == 0) {
+                continue;
+            }
+            saida << nome_do_sentido (m_topologia, s) << ',' << m_topologia.classes[m_topologia.enlaces[s / 2].classe].nome << ','
+                  << m_capacidade[s] / 1e6 << ',' << m_carga[s] / 1e6 << ',' << m_carga[s] / m_capacidade[s] << ','
+                  << m_quantidade[s] << std::endl;
+        }
+    }
+
+private:
+    /** Taxa estimada sem os cabecalhos, em bit/s. */
+    double vazao_aplicacao (size_t f) const {
+        return m_taxa[f] * m_fluxos[f].taxa.GetBitRate () / taxa_com_cabecalhos (m_fluxos[f]);
+    }
+
+    const Topologia &m_topologia;
+    const std::vector<FluxoMatriz> &m_fluxos;
+    std::vector<double> m_capacidade;
+    std::vector<std::vector<uint32_t> > m_caminhos;
+    std::vector<double> m_taxa;
+    std::vector<int32_t> m_gargalo;
+    std::vector<double> m_carga;
+    std::vector<uint32_t> m_quantidade;
+};
+
+inline const char *cabecalho_estimativa_csv() {
+    return "fluxos,sem_rota,limitados,demanda_mbps,vazao_mbps,fracao_atendida,enlaces_saturados,utilizacao_maxima,gargalo,tempo_ms";
+}
+
+inline void escrever_estimativa_csv(std::ostream &saida, const ResumoEstimativa &resumo) {
+    saida << resumo.fluxos << ',' << resumo.sem_rota << ',' << resumo.limitados << ',' << resumo.demanda_mbps << ','
+          << resumo.vazao_mbps << ',' << (resumo.demanda_mbps > 0 ? resumo.vazao_mbps / resumo.demanda_mbps : 0) << ','
+          << resumo.enlaces_saturados << ',' << resumo.utilizacao_maxima << ',' << resumo.gargalo << ',' << resumo.tempo_ms;
+}
+
+#endif /* ESTIMATIVA_H */
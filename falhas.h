@@ -0,0 +1,411 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Agenda de falhas e recuperacoes de enlaces.
+//
+// Formato (uma mudanca por linha, '#' inicia comentario):
+//
+//   <tempo em s> <enlace> down|up
+//
+// onde <enlace> eh o nome a_b da topologia (L1_G2, L4_G3...). Na linha de
+// comando as mudancas sao separadas por virgula e os campos podem ser
+// separados por ':' (10:L1_G2:down,20:L1_G2:up).
+//
+// A falha desliga as interfaces IP dos dois lados. RIP e OLSR reagem
+// sozinhos; no roteamento global as rotas sao refeitas pelo
+// RoteamentoIncremental, so nos roteadores cujos caminhos minimos podem
+// mudar, em vez de recalcular as tabelas de todos os nohs.
+//
+
+#ifndef FALHAS_H
+#define FALHAS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include "grafo_roteamento.h"
+#include "medicao.h"
+#include "sonda_fluxos.h"
+#include "topologia.h"
+
+struct EventoFalha {
+    double tempo;
+    uint32_t enlace;
+    bool ativo;
+};
+
+/**
+ * Le a agenda de entrada e devolve as mudancas ordenadas pelo tempo.
+ */
+inline void ler_falhas(std::istream &entrada, const Topologia &topologia, std::vector<EventoFalha> &eventos) {
+    std::string linha;
+    std::vector<std::string> palavras;
+    uint64_t numero_linha = 0;
+    while (std::getline (entrada, linha)) {
+        numero_linha++;
+        std::replace (linha.begin (), linha.end (), ':', ' ');
+        separar_palavras (linha, palavras);
+        if (palavras.empty ()) {
+            continue;
+        }
+        if (palavras.size () != 3 || (palavras[2] != "down" && palavras[2] != "up")) {
+            NS_FATAL_ERROR ("Falhas, linha " << numero_linha << ": esperado '<tempo> <enlace> down|up'");
+        }
+        EventoFalha evento;
+        evento.tempo = std::atof (palavras[0].c_str ());
+        evento.enlace = indice_ou_erro (topologia.indice_enlaces, palavras[1], "enlace", numero_linha);
+        evento.ativo = palavras[2] == "up";
+        eventos.push_back (evento);
+    }
+    std::stable_sort (eventos.begin (), eventos.end (), [] (const EventoFalha &x, const EventoFalha &y) {
+        return x.tempo < y.tempo;
+    });
+}
+
+/**
+ * Rotas do roteamento global refeitas a cada mudanca de enlace.
+ *
+ * Um roteador s so pode ter rotas mudadas pela queda do enlace a-b se o
+ * enlace esta num caminho minimo de s, ou seja, d(s,b) = d(s,a) + custo (ou
+ * o contrario); pela volta do enlace, se ele encurta o caminho de s ate a
+ * ou b. Bastam entao dois Dijkstra (a partir de a e de b, supondo metricas
+ * simetricas) para achar os afetados, e so eles refazem o proprio Dijkstra
+ * e as mesmas rotas que o GlobalRouteManager instala: de host para os
+ * enderecos dos outros nohs e de rede para as sub-redes dos enlaces ativos
+ * que nao tocam o roteador (as diretamente ligadas ficam com o roteamento
+ * estatico), pelo primeiro salto ate a ponta mais proxima. Com completo,
+ * usa RecomputeRoutingTables (todos os roteadores) para comparacao.
+ */
+class RoteamentoIncremental {
+public:
+    RoteamentoIncremental (const Topologia &topologia, bool completo)
+        : m_topologia (topologia), m_completo (completo) {
+        montar_grafo_roteamento (topologia, m_grafo);
+        std::vector<bool> com_ip (topologia.enlaces.size (), false);
+        for (size_t no = 0; no < m_grafo.adjacencias.size (); ++no) {
+            for (size_t k = 0; k < m_grafo.adjacencias[no].size (); ++k) {
+                com_ip[m_grafo.adjacencias[no][k].enlace] = true;
+            }
+        }
+        for (uint32_t i = 0; i < com_ip.size (); ++i) {
+            if (com_ip[i]) {
+                m_enlaces_ip.push_back (i);
+            }
+        }
+    }
+
+    /** Atualiza as rotas e devolve o numero de roteadores recalculados. */
+    uint32_t enlace_mudou (uint32_t enlace, bool ativo) {
+        const Enlace &mudou = m_topologia.enlaces[enlace];
+        uint32_t custo = DISTANCIA_INFINITA;
+        const std::vector<Adjacencia> &de_a = m_grafo.adjacencias[mudou.a];
+        for (size_t k = 0; k < de_a.size (); ++k) {
+            if (de_a[k].enlace == enlace) {
+                custo = de_a[k].custo;
+            }
+        }
+        if (custo == DISTANCIA_INFINITA || m_grafo.enlace_ativo[enlace] == ativo) {
+            return 0;
+        }
+
+        if (m_completo) {
+            m_grafo.enlace_ativo[enlace] = ativo;
+            ns3::Ipv4GlobalRoutingHelper::RecomputeRoutingTables ();
+            return m_topologia.nos.size ();
+        }
+
+        std::vector<uint32_t> distancia_a;
+        std::vector<uint32_t> distancia_b;
+        caminhos_minimos (m_grafo, mudou.a, distancia_a);
+        caminhos_minimos (m_grafo, mudou.b, distancia_b);
+        m_grafo.enlace_ativo[enlace] = ativo;
+
+        uint32_t recalculados = 0;
+        for (uint32_t s = 0; s < m_topologia.nos.size (); ++s) {
+            uint32_t da = distancia_a[s];
+            uint32_t db = distancia_b[s];
+            bool afetado;
+            if (!ativo) {
+                afetado = da != DISTANCIA_INFINITA && db != DISTANCIA_INFINITA && (db == da + custo || da == db + custo);
+            } else {
+                afetado = (da != DISTANCIA_INFINITA && (db == DISTANCIA_INFINITA || da + custo < db))
+                    || (db != DISTANCIA_INFINITA && (da == DISTANCIA_INFINITA || db + custo < da));
+            }
+            if (afetado && m_topologia.nos[s]->GetSystemId () == ns3::Simulator::GetSystemId ()) {
+                reinstalar (s);
+                recalculados++;
+            }
+        }
+        return recalculados;
+    }
+
+private:
+    void reinstalar (uint32_t origem) {
+        ns3::Ptr<ns3::Ipv4GlobalRouting> global = m_topologia.nos[origem]->GetObject<ns3::GlobalRouter> ()->GetRoutingProtocol ();
+        esvaziar_rotas (global);
+
+        caminhos_minimos (m_grafo, origem, m_distancia, &m_primeiro_salto);
+        for (uint32_t destino = 0; destino < m_topologia.nos.size (); ++destino) {
+            if (destino == origem || m_primeiro_salto[destino] < 0) {
+                continue;
+            }
+            const Adjacencia &salto = m_grafo.adjacencias[origem][m_primeiro_salto[destino]];
+            const std::vector<ns3::Ipv4Address> &enderecos = m_grafo.enderecos[destino];
+            for (size_t k = 0; k < enderecos.size (); ++k) {
+                global->AddHostRouteTo (enderecos[k], salto.gateway, salto.interface);
+            }
+        }
+
+        for (size_t k = 0; k < m_enlaces_ip.size (); ++k) {
+            const Enlace &enlace = m_topologia.enlaces[m_enlaces_ip[k]];
+            if (!m_grafo.enlace_ativo[m_enlaces_ip[k]] || enlace.a == origem || enlace.b == origem) {
+                continue;
+            }
+            uint32_t ponta = m_distancia[enlace.a] <= m_distancia[enlace.b] ? enlace.a : enlace.b;
+            if (m_primeiro_salto[ponta] < 0) {
+                continue;
+            }
+            const Adjacencia &salto = m_grafo.adjacencias[origem][m_primeiro_salto[ponta]];
+            global->AddNetworkRouteTo (enlace.ip_a.CombineMask (enlace.mascara), enlace.mascara, salto.gateway, salto.interface);
+        }
+    }
+
+    const Topologia &m_topologia;
+    bool m_completo;
+    GrafoRoteamento m_grafo;
+    // Enlaces com interfaces IP, cujas sub-redes recebem rotas de rede
+    std::vector<uint32_t> m_enlaces_ip;
+    std::vector<uint32_t> m_distancia;
+    std::vector<int32_t> m_primeiro_salto;
+};
+
+/**
+ * Aplica as mudancas da agenda nos tempos marcados.
+ */
+class AgendaFalhas {
+public:
+    struct Aplicado {
+        EventoFalha evento;
+        uint32_t recalculados;
+        double tempo_recalculo_s;
+    };
+
+    AgendaFalhas (const Topologia &topologia, const std::vector<EventoFalha> &eventos, RoteamentoIncremental *incremental)
+        : m_topologia (topologia), m_eventos (eventos), m_incremental (incremental) {
+    }
+
+    void agendar () {
+        for (uint32_t i = 0; i < m_eventos.size (); ++i) {
+            ns3::Simulator::Schedule (ns3::Seconds (m_eventos[i].tempo), &AgendaFalhas::aplicar, this, i);
+        }
+    }
+
+    const std::vector<Aplicado> &aplicados () const {
+        return m_aplicados;
+    }
+
+    void imprimir (std::ostream &saida) const {
+        for (size_t i = 0; i < m_aplicados.size (); ++i) {
+            const Aplicado &aplicado = m_aplicados[i];
+            saida << "Falha em " << aplicado.evento.tempo << " s: "
+                  << nome_do_enlace (m_topologia, m_topologia.enlaces[aplicado.evento.enlace])
+                  << (aplicado.evento.ativo ? " up" : " down");
+            if (m_incremental) {
+                saida << ", " << aplicado.recalculados << " de " << m_topologia.nos.size ()
+                      << " roteadores recalculados em " << aplicado.tempo_recalculo_s * 1e3 << " ms";
+            }
+            saida << std::endl;
+        }
+    }
+
+private:
+    void aplicar (uint32_t indice) {
+        const EventoFalha &evento = m_eventos[indice];
+        const Enlace &enlace = m_topologia.enlaces[evento.enlace];
+        mudar_interface (m_topologia.nos[enlace.a], enlace.dispositivo_a, evento.ativo);
+        mudar_interface (m_topologia.nos[enlace.b], enlace.dispositivo_b, evento.ativo);
+
+        Aplicado aplicado = { evento, 0, 0 };
+        if (m_incremental) {
+            std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now ();
+            aplicado.recalculados = m_incremental->enlace_mudou (evento.enlace, evento.ativo);
+            aplicado.tempo_recalculo_s = segundos_desde (inicio);
+        }
+        m_aplicados.push_back (aplicado);
+    }
+
+    static void mudar_interface (ns3::Ptr<ns3::Node> no, ns3::Ptr<ns3::NetDevice> dispositivo, bool ativo) {
+        ns3::Ptr<ns3::Ipv4> ipv4 = no->GetObject<ns3::Ipv4> ();
+        int32_t interface = ipv4->GetInterfaceForDevice (dispositivo);
+        if (interface < 0) {
+            return;
+        }
+        if (ativo) {
+            ipv4->SetUp (interface);
+        } else {
+            ipv4->SetDown (interface);
+        }
+    }
+
+    const Topologia &m_topologia;
+    std::vector<EventoFalha> m_eventos;
+    RoteamentoIncremental *m_incremental;
+    std::vector<Aplicado> m_aplicados;
+};
+
+/**
+ * Perda e tempo de recuperacao de cada fluxo em cada queda de enlace, a
+ * partir dos pacotes vistos pela SondaFluxos. A janela de uma queda vai
+ * ate o enlace voltar (ou ate o fim da simulacao):
+ * - perdidos: pacotes enviados dentro da janela que nunca chegaram;
+ * - recuperacao: do instante da queda ate o envio do primeiro pacote, a
+ *   partir da queda, que chegou ao destino (pouco mais que o intervalo
+ *   entre pacotes para fluxos que nao passavam pelo enlace).
+ */
+class MedidorRecuperacao {
+public:
+    explicit MedidorRecuperacao (const std::vector<EventoFalha> &eventos) {
+        for (size_t i = 0; i < eventos.size (); ++i) {
+            if (eventos[i].ativo) {
+                continue;
+            }
+            Janela janela;
+            janela.enlace = eventos[i].enlace;
+            janela.inicio = int64_t (eventos[i].tempo * 1e9);
+            janela.fim = -1;
+            for (size_t j = i + 1; j < eventos.size (); ++j) {
+                if (eventos[j].enlace == janela.enlace && eventos[j].ativo) {
+                    janela.fim = int64_t (eventos[j].tempo * 1e9);
+                    break;
+                }
+            }
+            m_janelas.push_back (janela);
+        }
+    }
+
+    void observar (SondaFluxos &sonda) {
+        sonda.observar (std::bind (&MedidorRecuperacao::enviado, this, std::placeholders::_1, std::placeholders::_2),
+                        std::bind (&MedidorRecuperacao::entregue, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    }
+
+    void escrever_csv (std::ostream &saida, const Topologia &topologia, const std::vector<EstatisticaFluxo> &fluxos) const {
+        saida << "enlace,inicio_s,fim_s,origem,destino,protocolo,porta_origem,porta_destino,pacotes_tx,pacotes_perdidos,recuperacao_s" << std::endl;
+        for (size_t j = 0; j < m_janelas.size (); ++j) {
+            const Janela &janela = m_janelas[j];
+            for (size_t f = 0; f < janela.fluxos.size () && f < fluxos.size (); ++f) {
+                const Contagem &contagem = janela.fluxos[f];
+                if (contagem.pacotes_tx == 0) {
+                    continue;
+                }
+                const EstatisticaFluxo &fluxo = fluxos[f];
+                saida << nome_do_enlace (topologia, topologia.enlaces[janela.enlace]) << ','
+                      << janela.inicio / 1e9 << ',' << (janela.fim < 0 ? -1 : janela.fim / 1e9) << ','
+                      << ns3::Ipv4Address (fluxo.origem) << ',' << ns3::Ipv4Address (fluxo.destino) << ','
+                      << fluxo.protocolo << ',' << fluxo.porta_origem << ',' << fluxo.porta_destino << ','
+                      << contagem.pacotes_tx << ',' << contagem.pacotes_tx - contagem.pacotes_rx << ','
+                      << (contagem.primeiro_entregue < 0 ? -1 : (contagem.primeiro_entregue - janela.inicio) / 1e9) << std::endl;
+            }
+        }
+    }
+
+    /** Por queda: fluxos com perda e maior tempo de recuperacao entre eles. */
+    void imprimir (std::ostream &saida, const Topologia &topologia) const {
+        for (size_t j = 0; j < m_janelas.size (); ++j) {
+            const Janela &janela = m_janelas[j];
+            uint32_t afetados = 0;
+            uint64_t perdidos = 0;
+            double pior = 0;
+            for (size_t f = 0; f < janela.fluxos.size (); ++f) {
+                const Contagem &contagem = janela.fluxos[f];
+                if (contagem.pacotes_tx == contagem.pacotes_rx) {
+                    continue;
+                }
+                afetados++;
+                perdidos += contagem.pacotes_tx - contagem.pacotes_rx;
+                double recuperacao = contagem.primeiro_entregue < 0 ? -1 : (contagem.primeiro_entregue - janela.inicio) / 1e9;
+                if (recuperacao < 0 || (pior >= 0 && recuperacao > pior)) {
+                    pior = recuperacao;
+                }
+            }
+            saida << "Queda de " << nome_do_enlace (topologia, topologia.enlaces[janela.enlace]) << " em " << janela.inicio / 1e9
+                  << " s: " << afetados << " fluxos com perda, " << perdidos << " pacotes perdidos, pior recuperacao "
+                  << (pior < 0 ? std::string ("nunca") : std::to_string (pior) + " s") << std::endl;
+        }
+    }
+
+private:
+    struct Contagem {
+        uint64_t pacotes_tx = 0;
+        uint64_t pacotes_rx = 0;
+        int64_t primeiro_entregue = -1;
+    };
+
+    struct Janela {
+        uint32_t enlace;
+        int64_t inicio;
+        int64_t fim;
+        std::vector<Contagem> fluxos;
+    };
+
+    static Contagem &contagem (Janela &janela, uint32_t fluxo) {
+        if (janela.fluxos.size () <= fluxo) {
+            janela.fluxos.resize (fluxo + 1);
+        }
+        return janela.fluxos[fluxo];
+    }
+
+    void enviado (uint32_t fluxo, int64_t envio) {
+        for (size_t j = 0; j < m_janelas.size (); ++j) {
+            Janela &janela = m_janelas[j];
+            if (envio >= janela.inicio && (janela.fim < 0 || envio < janela.fim)) {
+                contagem (janela, fluxo).pacotes_tx++;
+            }
+        }
+    }
+
+    void entregue (uint32_t fluxo, int64_t envio, int64_t chegada) {
+        for (size_t j = 0; j < m_janelas.size (); ++j) {
+            Janela &janela = m_janelas[j];
+            if (envio < janela.inicio) {
+                continue;
+            }
+            Contagem &c = contagem (janela, fluxo);
+            if (janela.fim < 0 || envio < janela.fim) {
+                c.pacotes_rx++;
+            }
+            if (c.primeiro_entregue < 0 || envio < c.primeiro_entregue) {
+                c.primeiro_entregue = envio;
+            }
+        }
+    }
+
+    std::vector<Janela> m_janelas;
+};
+
+#endif /* FALHAS_H */
@@ -0,0 +1,136 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Gerador de topologias hierarquicas no formato lido por topologia.h.
+//
+// Segue o formato da topologia original em escala, com as mesmas classes de
+// enlace (taxa, atraso e fila) da TOPOLOGIA_PADRAO:
+//
+//   - nucleo global G1-G2-...-Gk ligado em cadeia; G1_G2 e G2_G3 usam
+//     global_20ms e global_100ms, e os enlaces seguintes a classe nucleo;
+//   - as regioes alternam entre o perfil da America do Sul (regional_sul,
+//     acesso_sul) e o da America do Norte (L3_G3 na subida do primeiro
+//     roteador, regional_norte nas demais, acesso_norte);
+//   - o roteador i da regiao r sobe para o noh do nucleo G((r + i) mod k),
+//     como L1->G2 e L2->G1 na America do Sul;
+//   - "redundancia" enlaces laterais por regiao, do primeiro roteador da
+//     regiao para os seguintes, com as classes de L1_L2 (sul) e de L3_L4 e
+//     L3_L5 (norte); os que passam disso usam a classe lateral;
+//   - cada roteador atende hosts H*.
+//
+// Numero de nohs: k + regioes * roteadores * (1 + hosts).
+//
+
+#ifndef GERADOR_TOPOLOGIA_H
+#define GERADOR_TOPOLOGIA_H
+
+#include <cstdint>
+#include <ostream>
+
+struct ParametrosGerador {
+    uint32_t nucleo = 3;
+    uint32_t regioes = 2;
+    uint32_t roteadores_por_regiao = 3;
+    uint32_t hosts_por_roteador = 3;
+    uint32_t redundancia = 1;
+    uint32_t prefixo = 30;
+};
+
+inline uint64_t nos_gerados(const ParametrosGerador &parametros) {
+    return parametros.nucleo + (uint64_t) parametros.regioes * parametros.roteadores_por_regiao * (1 + parametros.hosts_por_roteador);
+}
+
+/** Classe do enlace G<g>-G<g+1>. */
+inline const char *classe_do_nucleo(uint32_t g) {
+    if (g == 1) return "global_20ms";
+    if (g == 2) return "global_100ms";
+    return "nucleo";
+}
+
+/** Regioes pares seguem a America do Sul e as impares a do Norte. */
+inline bool regiao_norte(uint32_t r) {
+    return r % 2 == 1;
+}
+
+/** Classe da subida do roteador i da regiao r para o nucleo. */
+inline const char *classe_da_subida(uint32_t r, uint32_t i) {
+    if (!regiao_norte (r)) return "regional_sul";
+    return i == 0 ? "L3_G3" : "regional_norte";
+}
+
+inline const char *classe_do_acesso(uint32_t r) {
+    return regiao_norte (r) ? "acesso_norte" : "acesso_sul";
+}
+
+/** Classe do i-esimo enlace lateral da regiao r (i a partir de 1). */
+inline const char *classe_lateral(uint32_t r, uint32_t i) {
+    if (!regiao_norte (r)) return i == 1 ? "regional_sul" : "lateral";
+    if (i == 1) return "regional_norte";
+    return i == 2 ? "L3_L5" : "lateral";
+}
+
+/**
+ * Escreve em saida a descricao da topologia. Os enderecos sao atribuidos
+ * automaticamente a partir de 10.0.0.0, uma sub-rede /prefixo por enlace.
+ */
+inline void gerar_topologia(const ParametrosGerador &parametros, std::ostream &saida) {
+    uint32_t nucleo = parametros.nucleo > 0 ? parametros.nucleo : 1;
+
+    saida << "classe global_20ms    100Mbps 20ms  global\n";
+    saida << "classe global_100ms   100Mbps 100ms global\n";
+    saida << "classe acesso_sul     5Mbps   10ms  comum\n";
+    saida << "classe regional_sul   20Mbps  20ms  comum\n";
+    saida << "classe regional_norte 20Mbps  20ms  comum\n";
+    saida << "classe L3_G3          50Mbps  40ms  comum\n";
+    saida << "classe L3_L5          100Mbps 40ms  comum\n";
+    saida << "classe acesso_norte   10Mbps  5ms   comum\n";
+    saida << "classe nucleo         100Mbps 20ms  global\n";
+    saida << "classe lateral        20Mbps  20ms  comum\n";
+    saida << "enderecamento 10.0.0.0 " << parametros.prefixo << "\n";
+
+    for (uint32_t g = 1; g <= nucleo; ++g) {
+        saida << "no G" << g << " global\n";
+    }
+    for (uint32_t g = 1; g < nucleo; ++g) {
+        saida << "enlace G" << g << " G" << g + 1 << " " << classe_do_nucleo (g) << "\n";
+    }
+
+    uint64_t roteador = 0;
+    uint64_t host = 0;
+    for (uint32_t r = 0; r < parametros.regioes; ++r) {
+        uint64_t primeiro_roteador = roteador + 1;
+
+        for (uint32_t i = 0; i < parametros.roteadores_por_regiao; ++i) {
+            ++roteador;
+            saida << "no L" << roteador << " regiao_" << r + 1 << "\n";
+            saida << "enlace L" << roteador << " G" << (r + i) % nucleo + 1 << " " << classe_da_subida (r, i) << "\n";
+
+            for (uint32_t h = 0; h < parametros.hosts_por_roteador; ++h) {
+                ++host;
+                saida << "no H" << host << " regiao_" << r + 1 << "\n";
+                saida << "enlace H" << host << " L" << roteador << " " << classe_do_acesso (r) << "\n";
+            }
+        }
+
+        for (uint32_t i = 1; i <= parametros.redundancia && i < parametros.roteadores_por_regiao; ++i) {
+            saida << "enlace L" << primeiro_roteador << " L" << primeiro_roteador + i << " " << classe_lateral (r, i) << "\n";
+        }
+    }
+}
+
+#endif /* GERADOR_TOPOLOGIA_H */
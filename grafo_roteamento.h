@@ -0,0 +1,246 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Grafo da camada IP da topologia, para calcular caminhos minimos sem
+// passar pelo GlobalRouteManager. So entram enlaces com endereco IP (os
+// mesmos que o roteamento global enxerga) e o custo de cada sentido eh a
+// metrica da interface de saida, como no Ipv4GlobalRouting.
+//
+
+#ifndef GRAFO_ROTEAMENTO_H
+#define GRAFO_ROTEAMENTO_H
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/ipv4-routing-table-entry.h"
+
+#include "topologia.h"
+
+static const uint32_t DISTANCIA_INFINITA = std::numeric_limits<uint32_t>::max ();
+
+struct Adjacencia {
+    uint32_t vizinho;
+    uint32_t enlace;
+    uint32_t interface;
+    ns3::Ipv4Address gateway;
+    uint32_t custo;
+};
+
+struct GrafoRoteamento {
+    std::vector<std::vector<Adjacencia> > adjacencias;
+    // Enderecos IP de cada noh, destinos das rotas de host
+    std::vector<std::vector<ns3::Ipv4Address> > enderecos;
+    std::vector<bool> enlace_ativo;
+};
+
+inline void montar_grafo_roteamento(const Topologia &topologia, GrafoRoteamento &grafo) {
+    grafo.adjacencias.assign (topologia.nos.size (), std::vector<Adjacencia> ());
+    grafo.enderecos.assign (topologia.nos.size (), std::vector<ns3::Ipv4Address> ());
+    grafo.enlace_ativo.assign (topologia.enlaces.size (), true);
+
+    for (uint32_t i = 0; i < topologia.enlaces.size (); ++i) {
+        const Enlace &enlace = topologia.enlaces[i];
+        ns3::Ptr<ns3::Ipv4> ipv4_a = topologia.nos[enlace.a]->GetObject<ns3::Ipv4> ();
+        ns3::Ptr<ns3::Ipv4> ipv4_b = topologia.nos[enlace.b]->GetObject<ns3::Ipv4> ();
+        int32_t interface_a = ipv4_a->GetInterfaceForDevice (enlace.dispositivo_a);
+        int32_t interface_b = ipv4_b->GetInterfaceForDevice (enlace.dispositivo_b);
+        if (interface_a < 0 || interface_b < 0) {
+            continue;
+        }
+        Adjacencia de_a = { enlace.b, i, uint32_t (interface_a), enlace.ip_b, ipv4_a->GetMetric (interface_a) };
+        Adjacencia de_b = { enlace.a, i, uint32_t (interface_b), enlace.ip_a, ipv4_b->GetMetric (interface_b) };
+        grafo.adjacencias[enlace.a].push_back (de_a);
+        grafo.adjacencias[enlace.b].push_back (de_b);
+        grafo.enderecos[enlace.a].push_back (enlace.ip_a);
+        grafo.enderecos[enlace.b].push_back (enlace.ip_b);
+    }
+}
+
+/**
+ * Dijkstra a partir de origem, so pelos enlaces ativos. Em primeiro_salto
+ * fica, para cada destino, o indice em adjacencias[origem] do primeiro
+ * enlace do caminho (-1 para a origem e para os inalcancaveis); em
+ * enlace_anterior, o enlace pelo qual o caminho chega a cada noh (a arvore
+ * de caminhos minimos). Empates ficam com o caminho encontrado primeiro.
+ */
+inline void caminhos_minimos(const GrafoRoteamento &grafo, uint32_t origem, std::vector<uint32_t> &distancia,
+                             std::vector<int32_t> *primeiro_salto = 0, std::vector<int32_t> *enlace_anterior = 0) {
+    uint32_t nos = grafo.adjacencias.size ();
+    distancia.assign (nos, DISTANCIA_INFINITA);
+    if (primeiro_salto) {
+        primeiro_salto->assign (nos, -1);
+    }
+    if (enlace_anterior) {
+        enlace_anterior->assign (nos, -1);
+    }
+
+    typedef std::pair<uint32_t, uint32_t> Entrada;
+    std::priority_queue<Entrada, std::vector<Entrada>, std::greater<Entrada> > fila;
+    distancia[origem] = 0;
+    fila.push (Entrada (0, origem));
+    while (!fila.empty ()) {
+        Entrada atual = fila.top ();
+        fila.pop ();
+        uint32_t no = atual.second;
+        if (atual.first > distancia[no]) {
+            continue;
+        }
+        const std::vector<Adjacencia> &vizinhos = grafo.adjacencias[no];
+        for (size_t k = 0; k < vizinhos.size (); ++k) {
+            const Adjacencia &adjacencia = vizinhos[k];
+            if (!grafo.enlace_ativo[adjacencia.enlace]) {
+                continue;
+            }
+            uint32_t nova = distancia[no] + adjacencia.custo;
+            if (nova < distancia[adjacencia.vizinho]) {
+                distancia[adjacencia.vizinho] = nova;
+                if (primeiro_salto) {
+                    (*primeiro_salto)[adjacencia.vizinho] = no == origem ? int32_t (k) : (*primeiro_salto)[no];
+                }
+                if (enlace_anterior) {
+                    (*enlace_anterior)[adjacencia.vizinho] = adjacencia.enlace;
+                }
+                fila.push (Entrada (nova, adjacencia.vizinho));
+            }
+        }
+    }
+}
+
+/** Sentido de enlace: 2 * enlace saindo de a, 2 * enlace + 1 saindo de b. */
+inline std::string nome_do_sentido(const Topologia &topologia, uint32_t sentido) {
+    const Enlace &enlace = topologia.enlaces[sentido / 2];
+    return sentido % 2 == 0 ? topologia.nomes[enlace.a] + "_" + topologia.nomes[enlace.b]
+                            : topologia.nomes[enlace.b] + "_" + topologia.nomes[enlace.a];
+}
+
+/** Noh do outro lado do sentido. */
+inline uint32_t fim_do_sentido(const Topologia &topologia, uint32_t sentido) {
+    const Enlace &enlace = topologia.enlaces[sentido / 2];
+    return sentido % 2 == 0 ? enlace.b : enlace.a;
+}
+
+typedef std::unordered_map<const ns3::NetDevice *, uint32_t> SentidosDispositivos;
+
+/** Sentido de saida de cada dispositivo de enlace. */
+inline void mapear_sentidos(const Topologia &topologia, SentidosDispositivos &sentidos) {
+    sentidos.clear ();
+    sentidos.reserve (2 * topologia.enlaces.size ());
+    for (uint32_t i = 0; i < topologia.enlaces.size (); ++i) {
+        sentidos[ns3::PeekPointer (topologia.enlaces[i].dispositivo_a)] = 2 * i;
+        sentidos[ns3::PeekPointer (topologia.enlaces[i].dispositivo_b)] = 2 * i + 1;
+    }
+}
+
+/**
+ * Sentido pelo qual a tabela de roteamento instalada em no envia pacotes
+ * para o endereco principal de destino (RouteOutput); -1 sem rota ou com
+ * saida por um dispositivo que nao eh enlace da topologia.
+ */
+inline int32_t sentido_da_tabela(const Topologia &topologia, const SentidosDispositivos &sentidos, uint32_t no, uint32_t destino) {
+    ns3::Ipv4Header cabecalho;
+    cabecalho.SetDestination (topologia.endereco_principal[destino]);
+    ns3::Socket::SocketErrno erro;
+    ns3::Ptr<ns3::Ipv4RoutingProtocol> roteamento = topologia.nos[no]->GetObject<ns3::Ipv4> ()->GetRoutingProtocol ();
+    ns3::Ptr<ns3::Ipv4Route> rota = roteamento->RouteOutput (ns3::Ptr<ns3::Packet> (), cabecalho, ns3::Ptr<ns3::NetDevice> (), erro);
+    if (!rota) {
+        return -1;
+    }
+    SentidosDispositivos::const_iterator it = sentidos.find (ns3::PeekPointer (rota->GetOutputDevice ()));
+    return it == sentidos.end () ? -1 : int32_t (it->second);
+}
+
+/**
+ * Remove todas as rotas de um Ipv4GlobalRouting e devolve quantas eram.
+ * Remover sempre a primeira evita percorrer as listas a cada remocao.
+ */
+inline uint32_t esvaziar_rotas(ns3::Ptr<ns3::Ipv4GlobalRouting> global) {
+    uint32_t removidas = global->GetNRoutes ();
+    while (global->GetNRoutes () > 0) {
+        global->RemoveRoute (0);
+    }
+    return removidas;
+}
+
+/**
+ * Copia as rotas de um Ipv4GlobalRouting, na ordem do GetRoute. O GetRoute
+ * (k) percorre as listas do protocolo ate k, entao ler pelo indice custa
+ * O(R^2) por noh. Aqui cada rota eh lida e retirada na primeira posicao, e
+ * no fim todas sao reinstaladas na mesma ordem: O(R).
+ */
+inline void ler_rotas(ns3::Ptr<ns3::Ipv4GlobalRouting> global, std::vector<ns3::Ipv4RoutingTableEntry> &rotas) {
+    rotas.clear ();
+    rotas.reserve (global->GetNRoutes ());
+    while (global->GetNRoutes () > 0) {
+        rotas.push_back (*global->GetRoute (0));
+        global->RemoveRoute (0);
+    }
+    for (size_t k = 0; k < rotas.size (); ++k) {
+        const ns3::Ipv4RoutingTableEntry &rota = rotas[k];
+        if (rota.IsHost ()) {
+            if (rota.IsGateway ()) {
+                global->AddHostRouteTo (rota.GetDest (), rota.GetGateway (), rota.GetInterface ());
+            } else {
+                global->AddHostRouteTo (rota.GetDest (), rota.GetInterface ());
+            }
+        } else if (rota.IsGateway ()) {
+            global->AddNetworkRouteTo (rota.GetDestNetwork (), rota.GetDestNetworkMask (), rota.GetGateway (), rota.GetInterface ());
+        } else {
+            global->AddNetworkRouteTo (rota.GetDestNetwork (), rota.GetDestNetworkMask (), rota.GetInterface ());
+        }
+    }
+}
+
+/** O mesmo para o Ipv4StaticRouting, que tambem guarda a metrica de cada rota. */
+inline void ler_rotas(ns3::Ptr<ns3::Ipv4StaticRouting> estatico, std::vector<ns3::Ipv4RoutingTableEntry> &rotas) {
+    rotas.clear ();
+    rotas.reserve (estatico->GetNRoutes ());
+    std::vector<uint32_t> metricas;
+    metricas.reserve (estatico->GetNRoutes ());
+    while (estatico->GetNRoutes () > 0) {
+        rotas.push_back (estatico->GetRoute (0));
+        metricas.push_back (estatico->GetMetric (0));
+        estatico->RemoveRoute (0);
+    }
+    for (size_t k = 0; k < rotas.size (); ++k) {
+        const ns3::Ipv4RoutingTableEntry &rota = rotas[k];
+        if (rota.IsHost ()) {
+            if (rota.IsGateway ()) {
+                estatico->AddHostRouteTo (rota.GetDest (), rota.GetGateway (), rota.GetInterface (), metricas[k]);
+            } else {
+                estatico->AddHostRouteTo (rota.GetDest (), rota.GetInterface (), metricas[k]);
+            }
+        } else if (rota.IsGateway ()) {
+            estatico->AddNetworkRouteTo (rota.GetDestNetwork (), rota.GetDestNetworkMask (), rota.GetGateway (), rota.GetInterface (),
+                                         metricas[k]);
+        } else {
+            estatico->AddNetworkRouteTo (rota.GetDestNetwork (), rota.GetDestNetworkMask (), rota.GetInterface (), metricas[k]);
+        }
+    }
+}
+
+#endif /* GRAFO_ROTEAMENTO_H */
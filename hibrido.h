@@ -0,0 +1,415 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Modo hibrido: os fluxos de fundo nao geram pacotes. Cada um vira uma taxa
+// constante (a do OnOff mais os cabecalhos) somada em cada sentido de
+// enlace do seu caminho, o mesmo que o roteamento IP escolheria (menor
+// custo, salto a salto). Nos sentidos com carga de fundo L e capacidade C:
+// - o dispositivo passa a transmitir a C - L (no minimo 1% de C), o que
+//   reproduz o tempo de transmissao e a fila que o trafego de frente
+//   encontraria disputando o enlace;
+// - a fila do dispositivo perde a ocupacao media que o fundo teria sozinho
+//   (M/D/1: rho^2 / (2 (1 - rho)) pacotes, rho = L / C), mantendo pelo
+//   menos um pacote. Se a fila tiver mais pacotes que o novo tamanho, a
+//   reducao espera o tempo de transmitir o excesso e tenta de novo. Filas
+//   dadas em bytes sao convertidas em pacotes pelo tamanho medio dos
+//   pacotes de fundo no enlace.
+// A carga eh recalculada quando algum fluxo de fundo comeca ou termina.
+// Fluxos TCP de fundo entram com a taxa oferecida, sem controle de
+// congestionamento.
+//
+// Para medir o erro da aproximacao, escrever_fluxos_frente grava as medidas
+// dos fluxos de frente de uma execucao e comparar_hibrido compara uma
+// execucao hibrida com a completa (todos os fluxos em pacotes).
+//
+
+#ifndef HIBRIDO_H
+#define HIBRIDO_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/flow-monitor.h"
+#include "ns3/ipv4-flow-classifier.h"
+
+#include "grafo_roteamento.h"
+#include "matriz_fluxos.h"
+#include "topologia.h"
+
+/**
+ * Marca como fundo uma fracao dos fluxos, espalhada pela lista (o fluxo i
+ * eh fundo quando floor((i + 1) fracao) > floor(i fracao)). Fluxos ja
+ * marcados na matriz continuam marcados.
+ */
+inline void marcar_fundo(std::vector<FluxoMatriz> &fluxos, double fracao) {
+    if (fracao <= 0) {
+        return;
+    }
+    for (size_t i = 0; i < fluxos.size (); ++i) {
+        if (std::floor ((i + 1) * fracao) > std::floor (i * fracao)) {
+            fluxos[i].fundo = true;
+        }
+    }
+}
+
+class ModeloFluido {
+public:
+    ModeloFluido (const Topologia &topologia, const std::vector<FluxoMatriz> &fluxos)
+        : m_topologia (topologia) {
+        for (size_t i = 0; i < fluxos.size (); ++i) {
+            if (fluxos[i].fundo) {
+                m_fundo.push_back (fluxos[i]);
+            }
+        }
+    }
+
+    /**
+     * Calcula os caminhos dos fluxos de fundo e agenda a aplicacao da carga
+     * no inicio e no fim de cada um. Deve ser chamada depois que as
+     * interfaces IP foram configuradas.
+     */
+    void agendar () {
+        uint32_t sentidos = 2 * m_topologia.enlaces.size ();
+        m_capacidade.assign (sentidos, 0);
+        m_fila.assign (sentidos, 0);
+        m_carga.assign (sentidos, 0);
+        m_maxima.assign (sentidos, 0);
+        m_tamanho.assign (sentidos, 0);
+        m_taxa.assign (sentidos, 0);
+        m_adiado.assign (sentidos, false);
+        double tamanho_medio = tamanho_medio_fundo ();
+        for (size_t i = 0; i < m_topologia.enlaces.size (); ++i) {
+            const ClasseEnlace &classe = m_topologia.classes[m_topologia.enlaces[i].classe];
+            double capacidade = ns3::DataRate (classe.taxa).GetBitRate ();
+            ns3::QueueSize tamanho_fila (classe.fila);
+            uint32_t fila = tamanho_fila.GetValue ();
+            if (tamanho_fila.GetUnit () == ns3::QueueSizeUnit::BYTES) {
+                fila = std::max<uint32_t> (1, uint32_t (fila / tamanho_medio));
+            }
+            m_capacidade[2 * i] = m_capacidade[2 * i + 1] = capacidade;
+            m_fila[2 * i] = m_fila[2 * i + 1] = fila;
+        }
+
+        montar_grafo_roteamento (m_topologia, m_grafo);
+        m_primeiro_salto.assign (m_topologia.nos.size (), std::vector<int32_t> ());
+        std::set<double> instantes;
+        m_caminhos.assign (m_fundo.size (), std::vector<uint32_t> ());
+        for (size_t i = 0; i < m_fundo.size (); ++i) {
+            if (!caminho (m_fundo[i].origem, m_fundo[i].destino, m_caminhos[i])) {
+                m_sem_rota++;
+            }
+            instantes.insert (m_fundo[i].inicio);
+            instantes.insert (m_fundo[i].fim);
+        }
+        for (std::set<double>::const_iterator it = instantes.begin (); it != instantes.end (); ++it) {
+            ns3::Simulator::Schedule (ns3::Seconds (*it), &ModeloFluido::atualizar, this);
+        }
+    }
+
+    uint32_t fluxos_fundo () const {
+        return m_fundo.size ();
+    }
+
+    void imprimir (std::ostream &saida) const {
+        uint32_t carregados = 0;
+        uint32_t saturados = 0;
+        double maior = 0;
+        for (size_t d = 0; d < m_maxima.size (); ++d) {
+            if (m_maxima[d] > 0) {
+                carregados++;
+                maior = std::max (maior, m_maxima[d] / m_capacidade[d]);
+                if (m_maxima[d] >= m_capacidade[d]) {
+                    saturados++;
+                }
+            }
+        }
+        saida << "Hibrido: " << m_fundo.size () << " fluxos de fundo fluidos em " << carregados
+              << " sentidos de enlace, utilizacao maxima " << maior * 100 << "%";
+        if (saturados > 0) {
+            saida << ", " << saturados << " saturados";
+        }
+        if (m_sem_rota > 0) {
+            saida << ", " << m_sem_rota << " sem rota";
+        }
+        if (m_filas_adiadas > 0) {
+            saida << ", " << m_filas_adiadas << " reducoes de fila adiadas ate a fila escoar";
+        }
+        saida << std::endl;
+    }
+
+private:
+    /** Sentido de enlace: 2 * enlace quando sai de a, 2 * enlace + 1 quando sai de b. */
+    bool caminho (uint32_t origem, uint32_t destino, std::vector<uint32_t> &sentidos) {
+        uint32_t atual = origem;
+        for (uint32_t saltos = 0; atual != destino; ++saltos) {
+            std::vector<int32_t> &primeiro = m_primeiro_salto[atual];
+            if (primeiro.empty ()) {
+                std::vector<uint32_t> distancia;
+                caminhos_minimos (m_grafo, atual, distancia, &primeiro);
+            }
+            if (primeiro[destino] < 0 || saltos >= m_topologia.nos.size ()) {
+                sentidos.clear ();
+                return false;
+            }
+            const Adjacencia &adjacencia = m_grafo.adjacencias[atual][primeiro[destino]];
+            sentidos.push_back (2 * adjacencia.enlace + (m_topologia.enlaces[adjacencia.enlace].a == atual ? 0 : 1));
+            atual = adjacencia.vizinho;
+        }
+        return true;
+    }
+
+    void atualizar () {
+        double agora = ns3::Simulator::Now ().GetSeconds ();
+        std::vector<double> carga (m_carga.size (), 0);
+        for (size_t i = 0; i < m_fundo.size (); ++i) {
+            const FluxoMatriz &fluxo = m_fundo[i];
+            if (agora < fluxo.inicio || agora >= fluxo.fim) {
+                continue;
+            }
+            double taxa = taxa_com_cabecalhos (fluxo);
+            for (size_t k = 0; k < m_caminhos[i].size (); ++k) {
+                carga[m_caminhos[i][k]] += taxa;
+            }
+        }
+        for (size_t d = 0; d < carga.size (); ++d) {
+            if (carga[d] != m_carga[d]) {
+                aplicar (d, carga[d]);
+                m_carga[d] = carga[d];
+                m_maxima[d] = std::max (m_maxima[d], carga[d]);
+            }
+        }
+    }
+
+    /**
+     * Tamanho medio, em bytes no enlace (com os cabecalhos), dos pacotes dos
+     * fluxos de fundo, ponderado pela taxa de pacotes de cada um.
+     */
+    double tamanho_medio_fundo () const {
+        double bits = 0;
+        double pacotes = 0;
+        for (size_t i = 0; i < m_fundo.size (); ++i) {
+            double taxa = taxa_com_cabecalhos (m_fundo[i]);
+            bits += taxa;
+            pacotes += taxa / (8.0 * (m_fundo[i].tamanho + 20 + (m_fundo[i].udp ? 8 : 20) + 2));
+        }
+        // Sem fundo nenhuma fila eh reduzida; o MTU so evita dividir por 0
+        return pacotes > 0 ? bits / pacotes / 8 : 1502;
+    }
+
+    ns3::Ptr<ns3::PointToPointNetDevice> dispositivo_do_sentido (uint32_t sentido) const {
+        const Enlace &enlace = m_topologia.enlaces[sentido / 2];
+        return ns3::DynamicCast<ns3::PointToPointNetDevice> (sentido % 2 == 0 ? enlace.dispositivo_a : enlace.dispositivo_b);
+    }
+
+    void aplicar (uint32_t sentido, double carga) {
+        ns3::Ptr<ns3::PointToPointNetDevice> dispositivo = dispositivo_do_sentido (sentido);
+        if (!dispositivo) {
+            return;
+        }
+        double capacidade = m_capacidade[sentido];
+        m_taxa[sentido] = std::max (capacidade - carga, 0.01 * capacidade);
+        dispositivo->SetDataRate (ns3::DataRate (uint64_t (m_taxa[sentido])));
+
+        double rho = std::min (carga / capacidade, 0.99);
+        uint32_t ocupada = uint32_t (std::lround (rho * rho / (2 * (1 - rho))));
+        m_tamanho[sentido] = m_fila[sentido] > ocupada ? m_fila[sentido] - ocupada : 1;
+        // Com uma tentativa ja agendada, ela usa o tamanho novo
+        if (!m_adiado[sentido]) {
+            redimensionar (sentido);
+        }
+    }
+
+    /**
+     * A fila nao pode ficar menor que o que ja esta nela: nesse caso tenta
+     * de novo depois do tempo de transmitir o excesso na taxa atual.
+     */
+    void redimensionar (uint32_t sentido) {
+        ns3::Ptr<ns3::PointToPointNetDevice> dispositivo = dispositivo_do_sentido (sentido);
+        ns3::Ptr<ns3::Queue<ns3::Packet> > fila = dispositivo->GetQueue ();
+        uint32_t tamanho = m_tamanho[sentido];
+        uint32_t pacotes = fila->GetNPackets ();
+        if (pacotes <= tamanho) {
+            std::ostringstream texto;
+            texto << tamanho << "p";
+            fila->SetMaxSize (ns3::QueueSize (texto.str ()));
+            m_adiado[sentido] = false;
+            return;
+        }
+        if (!m_adiado[sentido]) {
+            m_filas_adiadas++;
+            m_adiado[sentido] = true;
+        }
+        // Pacotes de tamanho maximo: MTU mais o cabecalho PPP
+        double escoar = (pacotes - tamanho) * (dispositivo->GetMtu () + 2) * 8.0 / m_taxa[sentido];
+        ns3::Simulator::Schedule (ns3::Seconds (escoar), &ModeloFluido::redimensionar, this, sentido);
+    }
+
+    const Topologia &m_topologia;
+    std::vector<FluxoMatriz> m_fundo;
+    std::vector<std::vector<uint32_t> > m_caminhos;
+    GrafoRoteamento m_grafo;
+    std::vector<std::vector<int32_t> > m_primeiro_salto;
+    std::vector<double> m_capacidade;
+    std::vector<uint32_t> m_fila;
+    std::vector<double> m_carga;
+    std::vector<double> m_maxima;
+    // Tamanho desejado da fila do dispositivo e taxa atual de cada sentido
+    std::vector<uint32_t> m_tamanho;
+    std::vector<double> m_taxa;
+    std::vector<bool> m_adiado;
+    uint32_t m_sem_rota = 0;
+    uint32_t m_filas_adiadas = 0;
+};
+
+/** Medidas de um fluxo de frente, identificado por origem, destino, porta e protocolo. */
+struct MedidaFrente {
+    std::string chave;
+    uint64_t pacotes_tx = 0;
+    uint64_t pacotes_rx = 0;
+    uint64_t pacotes_perdidos = 0;
+    uint64_t bytes_rx = 0;
+    double soma_atraso_s = 0;
+    double duracao_s = 0;
+};
+
+inline std::string chave_fluxo_frente(const Topologia &topologia, const FluxoMatriz &fluxo) {
+    std::ostringstream chave;
+    chave << topologia.nomes[fluxo.origem] << "->" << topologia.nomes[fluxo.destino] << ":" << fluxo.porta << "/" << (fluxo.udp ? "udp" : "tcp");
+    return chave.str ();
+}
+
+/**
+ * Grava, uma linha por fluxo de frente, as medidas do FlowMonitor. O fluxo
+ * eh reconhecido pelos enderecos principais da origem e do destino, porta
+ * de destino e protocolo; fluxos de fundo com a mesma identificacao que um
+ * de frente entram na mesma linha.
+ */
+inline void escrever_fluxos_frente(std::ostream &saida, ns3::Ptr<ns3::FlowMonitor> monitor,
+                                   ns3::Ptr<ns3::Ipv4FlowClassifier> classificador,
+                                   const Topologia &topologia, const std::vector<FluxoMatriz> &fluxos) {
+    std::map<std::string, MedidaFrente> medidas;
+    std::map<std::string, std::string> chave_da_tupla;
+    for (size_t i = 0; i < fluxos.size (); ++i) {
+        if (fluxos[i].fundo) {
+            continue;
+        }
+        std::ostringstream tupla;
+        tupla << topologia.endereco_principal[fluxos[i].origem] << ' ' << topologia.endereco_principal[fluxos[i].destino]
+              << ' ' << fluxos[i].porta << ' ' << (fluxos[i].udp ? 17 : 6);
+        std::string chave = chave_fluxo_frente (topologia, fluxos[i]);
+        chave_da_tupla[tupla.str ()] = chave;
+        medidas[chave].chave = chave;
+    }
+
+    monitor->CheckForLostPackets ();
+    const ns3::FlowMonitor::FlowStatsContainer &estatisticas = monitor->GetFlowStats ();
+    for (ns3::FlowMonitor::FlowStatsContainer::const_iterator it = estatisticas.begin (); it != estatisticas.end (); ++it) {
+        ns3::Ipv4FlowClassifier::FiveTuple cinco = classificador->FindFlow (it->first);
+        std::ostringstream tupla;
+        tupla << cinco.sourceAddress << ' ' << cinco.destinationAddress << ' ' << cinco.destinationPort << ' ' << uint32_t (cinco.protocol);
+        std::map<std::string, std::string>::const_iterator chave = chave_da_tupla.find (tupla.str ());
+        if (chave == chave_da_tupla.end ()) {
+            continue;
+        }
+        const ns3::FlowMonitor::FlowStats &fluxo = it->second;
+        MedidaFrente &medida = medidas[chave->second];
+        medida.pacotes_tx += fluxo.txPackets;
+        medida.pacotes_rx += fluxo.rxPackets;
+        medida.pacotes_perdidos += fluxo.lostPackets;
+        medida.bytes_rx += fluxo.rxBytes;
+        medida.soma_atraso_s += fluxo.delaySum.GetSeconds ();
+        medida.duracao_s = std::max (medida.duracao_s, (fluxo.timeLastRxPacket - fluxo.timeFirstRxPacket).GetSeconds ());
+    }
+
+    for (std::map<std::string, MedidaFrente>::const_iterator it = medidas.begin (); it != medidas.end (); ++it) {
+        const MedidaFrente &medida = it->second;
+        saida << medida.chave << ' ' << medida.pacotes_tx << ' ' << medida.pacotes_rx << ' ' << medida.pacotes_perdidos << ' '
+              << medida.bytes_rx << ' ' << medida.soma_atraso_s << ' ' << medida.duracao_s << std::endl;
+    }
+}
+
+inline std::map<std::string, MedidaFrente> ler_fluxos_frente(std::istream &entrada) {
+    std::map<std::string, MedidaFrente> medidas;
+    MedidaFrente medida;
+    while (entrada >> medida.chave >> medida.pacotes_tx >> medida.pacotes_rx >> medida.pacotes_perdidos
+                   >> medida.bytes_rx >> medida.soma_atraso_s >> medida.duracao_s) {
+        medidas[medida.chave] = medida;
+    }
+    return medidas;
+}
+
+/**
+ * Compara os fluxos de frente da execucao hibrida com os da completa: erro
+ * relativo do atraso medio e da vazao e diferenca absoluta da fracao de
+ * perda. Grava uma linha por fluxo em tabela e o resumo em saida.
+ */
+inline void comparar_hibrido(const std::map<std::string, MedidaFrente> &completo, const std::map<std::string, MedidaFrente> &hibrido,
+                             std::ostream &tabela, std::ostream &saida) {
+    tabela << "fluxo,atraso_completo_ms,atraso_hibrido_ms,erro_atraso,perda_completo,perda_hibrido,erro_perda,"
+           << "vazao_completo_mbps,vazao_hibrido_mbps,erro_vazao" << std::endl;
+    double soma_atraso = 0;
+    double maior_atraso = 0;
+    double soma_perda = 0;
+    double soma_vazao = 0;
+    uint32_t comparados = 0;
+    for (std::map<std::string, MedidaFrente>::const_iterator it = completo.begin (); it != completo.end (); ++it) {
+        std::map<std::string, MedidaFrente>::const_iterator outro = hibrido.find (it->first);
+        if (outro == hibrido.end ()) {
+            continue;
+        }
+        const MedidaFrente &a = it->second;
+        const MedidaFrente &b = outro->second;
+        double atraso_a = a.pacotes_rx > 0 ? a.soma_atraso_s / a.pacotes_rx * 1e3 : 0;
+        double atraso_b = b.pacotes_rx > 0 ? b.soma_atraso_s / b.pacotes_rx * 1e3 : 0;
+        double perda_a = a.pacotes_tx > 0 ? double (a.pacotes_perdidos) / a.pacotes_tx : 0;
+        double perda_b = b.pacotes_tx > 0 ? double (b.pacotes_perdidos) / b.pacotes_tx : 0;
+        double vazao_a = a.duracao_s > 0 ? a.bytes_rx * 8.0 / a.duracao_s / 1e6 : 0;
+        double vazao_b = b.duracao_s > 0 ? b.bytes_rx * 8.0 / b.duracao_s / 1e6 : 0;
+        double erro_atraso = atraso_a > 0 ? std::fabs (atraso_b - atraso_a) / atraso_a : 0;
+        double erro_perda = std::fabs (perda_b - perda_a);
+        double erro_vazao = vazao_a > 0 ? std::fabs (vazao_b - vazao_a) / vazao_a : 0;
+        tabela << it->first << ',' << atraso_a << ',' << atraso_b << ',' << erro_atraso << ',' << perda_a << ',' << perda_b << ','
+               << erro_perda << ',' << vazao_a << ',' << vazao_b << ',' << erro_vazao << std::endl;
+        soma_atraso += erro_atraso;
+        maior_atraso = std::max (maior_atraso, erro_atraso);
+        soma_perda += erro_perda;
+        soma_vazao += erro_vazao;
+        comparados++;
+    }
+    if (comparados == 0) {
+        saida << "Hibrido x completo: nenhum fluxo de frente em comum" << std::endl;
+        return;
+    }
+    saida << "Hibrido x completo: " << comparados << " fluxos de frente, erro medio do atraso " << soma_atraso / comparados * 100
+          << "% (maximo " << maior_atraso * 100 << "%), da vazao " << soma_vazao / comparados * 100
+          << "%, diferenca media da perda " << soma_perda / comparados * 100 << " pontos percentuais" << std::endl;
+}
+
+#endif /* HIBRIDO_H */
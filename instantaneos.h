@@ -0,0 +1,341 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Instantaneos periodicos do FlowMonitor, no lugar do XML escrito no fim da
+// simulacao. A cada periodo (tempo simulado) o AmostradorFluxos calcula, para
+// cada fluxo que mudou, a diferenca desde o instantaneo anterior e entrega o
+// lote ao EscritorInstantaneos, que grava em uma thread propria. A fila entre
+// os dois tem capacidade fixa, entao a memoria nao cresce com a duracao.
+//
+// Formatos:
+// - csv: uma linha por fluxo por instantaneo
+//     tempo_s,fluxo,bytes_tx,bytes_rx,pacotes_tx,pacotes_rx,pacotes_perdidos,soma_atraso_s,soma_jitter_s
+// - binario: cabecalho "FMIN" + versao (u32), seguido de um bloco por
+//   instantaneo com tempo_ns (u64), n (u32) e as colunas, cada uma com n
+//   valores: fluxo (u32), bytes_tx (u64), bytes_rx (u64), pacotes_tx (u32),
+//   pacotes_rx (u32), pacotes_perdidos (u32), soma_atraso_ns (i64),
+//   soma_jitter_ns (i64). Inteiros na ordem de bytes da maquina.
+//
+// Nos dois formatos a 5-tupla de cada fluxo vai para <arquivo>.fluxos.csv
+// quando o fluxo aparece pela primeira vez.
+//
+
+#ifndef INSTANTANEOS_H
+#define INSTANTANEOS_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/flow-monitor.h"
+#include "ns3/flow-monitor-helper.h"
+#include "ns3/ipv4-flow-classifier.h"
+
+/** Variacao de um fluxo entre dois instantaneos. */
+struct RegistroInstantaneo {
+    uint32_t fluxo;
+    uint64_t bytes_tx;
+    uint64_t bytes_rx;
+    uint32_t pacotes_tx;
+    uint32_t pacotes_rx;
+    uint32_t pacotes_perdidos;
+    int64_t soma_atraso_ns;
+    int64_t soma_jitter_ns;
+};
+
+struct DescricaoFluxo {
+    uint32_t fluxo;
+    std::string origem;
+    std::string destino;
+    uint32_t protocolo;
+    uint16_t porta_origem;
+    uint16_t porta_destino;
+};
+
+struct Instantaneo {
+    uint64_t tempo_ns = 0;
+    std::vector<RegistroInstantaneo> registros;
+    std::vector<DescricaoFluxo> novos_fluxos;
+};
+
+class EscritorInstantaneos {
+public:
+    EscritorInstantaneos (const std::string &arquivo, bool binario, size_t capacidade = 16)
+        : m_binario (binario), m_capacidade (capacidade > 0 ? capacidade : 1) {
+        m_saida.open (arquivo.c_str (), binario ? std::ios::out | std::ios::binary : std::ios::out);
+        m_fluxos.open ((arquivo + ".fluxos.csv").c_str ());
+        if (m_binario) {
+            uint32_t versao = 1;
+            m_saida.write ("FMIN", 4);
+            m_saida.write (reinterpret_cast<const char *> (&versao), sizeof (versao));
+        } else {
+            m_saida << "tempo_s,fluxo,bytes_tx,bytes_rx,pacotes_tx,pacotes_rx,pacotes_perdidos,soma_atraso_s,soma_jitter_s\n";
+        }
+        m_fluxos << "fluxo,origem,destino,protocolo,porta_origem,porta_destino\n";
+        m_thread = std::thread (&EscritorInstantaneos::gravar, this);
+    }
+
+    ~EscritorInstantaneos () {
+        fechar ();
+    }
+
+    bool aberto () const {
+        return m_saida.is_open () && m_fluxos.is_open ();
+    }
+
+    /** Entrega um instantaneo para gravacao; espera se a fila estiver cheia. */
+    void enviar (Instantaneo &instantaneo) {
+        std::unique_lock<std::mutex> trava (m_mutex);
+        m_espaco.wait (trava, [this] { return m_fila.size () < m_capacidade; });
+        m_fila.push_back (Instantaneo ());
+        m_fila.back ().tempo_ns = instantaneo.tempo_ns;
+        m_fila.back ().registros.swap (instantaneo.registros);
+        m_fila.back ().novos_fluxos.swap (instantaneo.novos_fluxos);
+        m_pendentes.notify_one ();
+    }
+
+    /** Grava o que restou na fila e encerra a thread. */
+    void fechar () {
+        {
+            std::lock_guard<std::mutex> trava (m_mutex);
+            if (m_fechado) {
+                return;
+            }
+            m_fechado = true;
+        }
+        m_pendentes.notify_one ();
+        m_thread.join ();
+        m_saida.close ();
+        m_fluxos.close ();
+    }
+
+    uint64_t instantaneos_gravados () const {
+        return m_instantaneos;
+    }
+
+    uint64_t registros_gravados () const {
+        return m_registros;
+    }
+
+private:
+    void gravar () {
+        Instantaneo atual;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> trava (m_mutex);
+                m_pendentes.wait (trava, [this] { return m_fechado || !m_fila.empty (); });
+                if (m_fila.empty ()) {
+                    break;
+                }
+                atual.tempo_ns = m_fila.front ().tempo_ns;
+                atual.registros.swap (m_fila.front ().registros);
+                atual.novos_fluxos.swap (m_fila.front ().novos_fluxos);
+                m_fila.pop_front ();
+                m_espaco.notify_one ();
+            }
+
+            for (size_t i = 0; i < atual.novos_fluxos.size (); ++i) {
+                const DescricaoFluxo &fluxo = atual.novos_fluxos[i];
+                m_fluxos << fluxo.fluxo << ',' << fluxo.origem << ',' << fluxo.destino << ',' << fluxo.protocolo << ','
+                         << fluxo.porta_origem << ',' << fluxo.porta_destino << '\n';
+            }
+            if (m_binario) {
+                gravar_binario (atual);
+            } else {
+                gravar_csv (atual);
+            }
+            m_instantaneos++;
+            m_registros += atual.registros.size ();
+            atual.registros.clear ();
+            atual.novos_fluxos.clear ();
+        }
+        m_saida.flush ();
+        m_fluxos.flush ();
+    }
+
+    void gravar_csv (const Instantaneo &instantaneo) {
+        double tempo = instantaneo.tempo_ns / 1e9;
+        for (size_t i = 0; i < instantaneo.registros.size (); ++i) {
+            const RegistroInstantaneo &r = instantaneo.registros[i];
+            m_saida << tempo << ',' << r.fluxo << ',' << r.bytes_tx << ',' << r.bytes_rx << ','
+                    << r.pacotes_tx << ',' << r.pacotes_rx << ',' << r.pacotes_perdidos << ','
+                    << r.soma_atraso_ns / 1e9 << ',' << r.soma_jitter_ns / 1e9 << '\n';
+        }
+    }
+
+    template <typename T, typename Campo>
+    void gravar_coluna (const std::vector<RegistroInstantaneo> &registros, Campo campo) {
+        m_coluna.resize (registros.size () * sizeof (T));
+        T *valores = reinterpret_cast<T *> (&m_coluna[0]);
+        for (size_t i = 0; i < registros.size (); ++i) {
+            valores[i] = registros[i].*campo;
+        }
+        m_saida.write (&m_coluna[0], m_coluna.size ());
+    }
+
+    void gravar_binario (const Instantaneo &instantaneo) {
+        uint32_t n = instantaneo.registros.size ();
+        m_saida.write (reinterpret_cast<const char *> (&instantaneo.tempo_ns), sizeof (uint64_t));
+        m_saida.write (reinterpret_cast<const char *> (&n), sizeof (n));
+        if (n == 0) {
+            return;
+        }
+        const std::vector<RegistroInstantaneo> &r = instantaneo.registros;
+        gravar_coluna<uint32_t> (r, &RegistroInstantaneo::fluxo);
+        gravar_coluna<uint64_t> (r, &RegistroInstantaneo::bytes_tx);
+        gravar_coluna<uint64_t> (r, &RegistroInstantaneo::bytes_rx);
+        gravar_coluna<uint32_t> (r, &RegistroInstantaneo::pacotes_tx);
+        gravar_coluna<uint32_t> (r, &RegistroInstantaneo::pacotes_rx);
+        gravar_coluna<uint32_t> (r, &RegistroInstantaneo::pacotes_perdidos);
+        gravar_coluna<int64_t> (r, &RegistroInstantaneo::soma_atraso_ns);
+        gravar_coluna<int64_t> (r, &RegistroInstantaneo::soma_jitter_ns);
+    }
+
+    bool m_binario;
+    size_t m_capacidade;
+    std::ofstream m_saida;
+    std::ofstream m_fluxos;
+    std::vector<char> m_coluna;
+
+    std::mutex m_mutex;
+    std::condition_variable m_pendentes;
+    std::condition_variable m_espaco;
+    std::deque<Instantaneo> m_fila;
+    bool m_fechado = false;
+    std::thread m_thread;
+
+    uint64_t m_instantaneos = 0;
+    uint64_t m_registros = 0;
+};
+
+/**
+ * Os instantaneos so usam os totais de cada fluxo. Com uma faixa de largura
+ * enorme, os histogramas de atraso, jitter, tamanho e interrupcoes que o
+ * FlowMonitor mantem por fluxo ficam com uma so faixa. Deve ser chamada
+ * antes de instalar o monitor.
+ */
+inline void desligar_histogramas(ns3::FlowMonitorHelper &helper) {
+    const double largura = 1e9;
+    helper.SetMonitorAttribute ("DelayBinWidth", ns3::DoubleValue (largura));
+    helper.SetMonitorAttribute ("JitterBinWidth", ns3::DoubleValue (largura));
+    helper.SetMonitorAttribute ("PacketSizeBinWidth", ns3::DoubleValue (largura));
+    helper.SetMonitorAttribute ("FlowInterruptionsBinWidth", ns3::DoubleValue (largura));
+}
+
+/**
+ * Tira um instantaneo do FlowMonitor a cada periodo de tempo simulado. So
+ * guarda os totais do instantaneo anterior (um por fluxo) para calcular as
+ * diferencas.
+ */
+class AmostradorFluxos {
+public:
+    AmostradorFluxos (ns3::Ptr<ns3::FlowMonitor> monitor, ns3::Ptr<ns3::Ipv4FlowClassifier> classificador,
+                      ns3::Time periodo, EscritorInstantaneos &escritor)
+        : m_monitor (monitor), m_classificador (classificador), m_periodo (periodo), m_escritor (escritor) {
+    }
+
+    void iniciar () {
+        ns3::Simulator::Schedule (m_periodo, &AmostradorFluxos::amostrar, this);
+    }
+
+    /**
+     * Ultimo instantaneo, com o que mudou desde o anterior ate o fim da
+     * simulacao. Durante a simulacao o proprio FlowMonitor verifica os
+     * perdidos periodicamente; no fim a verificacao eh feita aqui, como no
+     * SerializeToXml.
+     */
+    void finalizar () {
+        m_monitor->CheckForLostPackets ();
+        registrar ();
+    }
+
+private:
+    void amostrar () {
+        registrar ();
+        ns3::Simulator::Schedule (m_periodo, &AmostradorFluxos::amostrar, this);
+    }
+
+    void registrar () {
+        Instantaneo instantaneo;
+        instantaneo.tempo_ns = ns3::Simulator::Now ().GetNanoSeconds ();
+        const ns3::FlowMonitor::FlowStatsContainer &estatisticas = m_monitor->GetFlowStats ();
+        for (ns3::FlowMonitor::FlowStatsContainer::const_iterator it = estatisticas.begin (); it != estatisticas.end (); ++it) {
+            const ns3::FlowMonitor::FlowStats &fluxo = it->second;
+            if (it->first >= m_anterior.size ()) {
+                m_anterior.resize (it->first + 1);
+            }
+            RegistroInstantaneo &anterior = m_anterior[it->first];
+            if (anterior.fluxo == 0) {
+                anterior.fluxo = it->first;
+                descrever (it->first, instantaneo.novos_fluxos);
+            }
+
+            RegistroInstantaneo total;
+            total.fluxo = it->first;
+            total.bytes_tx = fluxo.txBytes;
+            total.bytes_rx = fluxo.rxBytes;
+            total.pacotes_tx = fluxo.txPackets;
+            total.pacotes_rx = fluxo.rxPackets;
+            total.pacotes_perdidos = fluxo.lostPackets;
+            total.soma_atraso_ns = fluxo.delaySum.GetNanoSeconds ();
+            total.soma_jitter_ns = fluxo.jitterSum.GetNanoSeconds ();
+            if (total.pacotes_tx == anterior.pacotes_tx && total.pacotes_rx == anterior.pacotes_rx
+                && total.pacotes_perdidos == anterior.pacotes_perdidos) {
+                continue;
+            }
+
+            RegistroInstantaneo delta;
+            delta.fluxo = it->first;
+            delta.bytes_tx = total.bytes_tx - anterior.bytes_tx;
+            delta.bytes_rx = total.bytes_rx - anterior.bytes_rx;
+            delta.pacotes_tx = total.pacotes_tx - anterior.pacotes_tx;
+            delta.pacotes_rx = total.pacotes_rx - anterior.pacotes_rx;
+            delta.pacotes_perdidos = total.pacotes_perdidos - anterior.pacotes_perdidos;
+            delta.soma_atraso_ns = total.soma_atraso_ns - anterior.soma_atraso_ns;
+            delta.soma_jitter_ns = total.soma_jitter_ns - anterior.soma_jitter_ns;
+            instantaneo.registros.push_back (delta);
+            anterior = total;
+        }
+        m_escritor.enviar (instantaneo);
+    }
+
+    void descrever (ns3::FlowId id, std::vector<DescricaoFluxo> &novos) {
+        ns3::Ipv4FlowClassifier::FiveTuple tupla = m_classificador->FindFlow (id);
+        std::ostringstream origem, destino;
+        origem << tupla.sourceAddress;
+        destino << tupla.destinationAddress;
+        DescricaoFluxo descricao = { id, origem.str (), destino.str (), tupla.protocol, tupla.sourcePort, tupla.destinationPort };
+        novos.push_back (descricao);
+    }
+
+    ns3::Ptr<ns3::FlowMonitor> m_monitor;
+    ns3::Ptr<ns3::Ipv4FlowClassifier> m_classificador;
+    ns3::Time m_periodo;
+    EscritorInstantaneos &m_escritor;
+    // Totais no instantaneo anterior, indexados pelo FlowId (sequencial, a partir de 1)
+    std::vector<RegistroInstantaneo> m_anterior;
+};
+
+#endif /* INSTANTANEOS_H */
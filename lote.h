@@ -0,0 +1,134 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Execucao de varias simulacoes em processos filhos. Cada simulacao roda
+// em um fork proprio, isolada das demais (o simulador do ns-3 eh global
+// por processo), e a fila de trabalho mantem todos os nucleos ocupados.
+//
+
+#ifndef LOTE_H
+#define LOTE_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+inline uint32_t processadores_disponiveis() {
+    long processadores = sysconf (_SC_NPROCESSORS_ONLN);
+    return processadores > 0 ? processadores : 1;
+}
+
+/**
+ * Executa tarefas em ate "processos" filhos ao mesmo tempo. Assim que um
+ * filho termina, a proxima tarefa eh iniciada, para que tarefas longas nao
+ * segurem as outras.
+ *
+ * - proxima(i) roda no pai e diz se existe a tarefa i. Se devolver false
+ *   com filhos ainda rodando, eh consultada de novo quando um deles termina
+ *   (permite decidir o que rodar a partir dos resultados ja obtidos);
+ * - tarefa(i) roda no filho e o valor devolvido vira o codigo de saida;
+ * - concluida(i, sucesso) roda no pai quando o filho da tarefa i termina.
+ */
+inline void executar_em_processos(uint32_t processos,
+                                  std::function<bool (uint32_t)> proxima,
+                                  std::function<int (uint32_t)> tarefa,
+                                  std::function<void (uint32_t, bool)> concluida) {
+    if (processos == 0) {
+        processos = processadores_disponiveis ();
+    }
+
+    std::map<pid_t, uint32_t> em_execucao;
+    uint32_t indice = 0;
+    bool consultar = true;
+
+    while (true) {
+        while (consultar && em_execucao.size () < processos) {
+            if (!proxima (indice)) {
+                consultar = false;
+                break;
+            }
+            std::cout.flush ();
+            std::cerr.flush ();
+            std::fflush (0);
+
+            pid_t pid = fork ();
+            if (pid < 0) {
+                std::perror ("fork");
+                std::exit (1);
+            }
+            if (pid == 0) {
+                int codigo = tarefa (indice);
+                std::cout.flush ();
+                std::cerr.flush ();
+                std::fflush (0);
+                _exit (codigo);
+            }
+            em_execucao[pid] = indice++;
+        }
+
+        if (em_execucao.empty ()) {
+            break;
+        }
+
+        int status;
+        pid_t pid = waitpid (-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::perror ("waitpid");
+            break;
+        }
+        std::map<pid_t, uint32_t>::iterator it = em_execucao.find (pid);
+        if (it == em_execucao.end ()) {
+            continue;
+        }
+        uint32_t terminada = it->second;
+        em_execucao.erase (it);
+        concluida (terminada, WIFEXITED (status) && WEXITSTATUS (status) == 0);
+        consultar = true;
+    }
+}
+
+/**
+ * Anexa o conteudo do arquivo parcial escrito por um filho ao arquivo
+ * consolidado e remove o parcial.
+ */
+inline bool juntar_arquivo(const std::string &parcial, std::ostream &consolidado) {
+    std::ifstream entrada (parcial.c_str ());
+    if (!entrada) {
+        return false;
+    }
+    consolidado << entrada.rdbuf ();
+    consolidado.flush ();
+    entrada.close ();
+    std::remove (parcial.c_str ());
+    return true;
+}
+
+#endif /* LOTE_H */
@@ -0,0 +1,292 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Matriz de trafego: todos os fluxos de uma simulacao, validados e
+// instalados de uma vez.
+//
+// Formato do arquivo (um fluxo por linha, '#' inicia comentario):
+//
+//   <origem> <destino> tcp|udp <taxa> <tamanho> <inicio> <fim> <porta> [fundo]
+//
+// com origem e destino pelo nome do noh, taxa no formato do DataRate
+// ("4Mbps", "500kb/s"), tamanho do pacote em bytes e tempos em segundos.
+// "fundo" marca trafego de fundo, que no modo hibrido vira carga fluida
+// (ver hibrido.h).
+// Os cenarios fixos e os fluxos aleatorios das topologias geradas tambem
+// viram uma matriz antes da instalacao.
+//
+// Fluxos para o mesmo noh, porta e protocolo compartilham um unico
+// PacketSink, ativo do menor inicio ao maior fim entre eles. Os OnOff sao
+// instalados ordenados por protocolo, taxa e tamanho, entao cada helper so
+// tem os atributos trocados quando esses valores mudam.
+//
+
+#ifndef MATRIZ_FLUXOS_H
+#define MATRIZ_FLUXOS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <istream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+
+#include "cenarios.h"
+#include "medicao.h"
+#include "topologia.h"
+
+static const char *FABRICA_TCP = "ns3::TcpSocketFactory";
+static const char *FABRICA_UDP = "ns3::UdpSocketFactory";
+
+struct FluxoMatriz {
+    uint32_t origem;
+    uint32_t destino;
+    bool udp;
+    ns3::DataRate taxa;
+    uint32_t tamanho;
+    double inicio;
+    double fim;
+    uint16_t porta;
+    bool fundo;
+};
+
+struct ResumoInstalacao {
+    uint32_t enviadores = 0;
+    uint32_t receptores = 0;
+    double tempo_s = 0;
+};
+
+/**
+ * Taxa do fluxo nos enlaces, em bit/s: a do OnOff mais os cabecalhos IP,
+ * UDP/TCP e PPP de cada pacote.
+ */
+inline double taxa_com_cabecalhos(const FluxoMatriz &fluxo) {
+    uint32_t cabecalhos = 20 + (fluxo.udp ? 8 : 20) + 2;
+    return fluxo.taxa.GetBitRate () * double (fluxo.tamanho + cabecalhos) / fluxo.tamanho;
+}
+
+/**
+ * Confere se taxa esta no formato aceito pelo DataRate: numero seguido de
+ * bps, b/s, Bps ou B/s, com prefixo opcional k, K, M ou G (e i).
+ */
+inline bool taxa_valida(const std::string &taxa) {
+    const char *inicio = taxa.c_str ();
+    char *fim;
+    double valor = std::strtod (inicio, &fim);
+    if (fim == inicio || valor <= 0) {
+        return false;
+    }
+    std::string unidade (fim);
+    if (!unidade.empty () && (unidade[0] == 'k' || unidade[0] == 'K' || unidade[0] == 'M' || unidade[0] == 'G')) {
+        unidade.erase (0, 1);
+        if (!unidade.empty () && unidade[0] == 'i') {
+            unidade.erase (0, 1);
+        }
+    }
+    return unidade == "bps" || unidade == "b/s" || unidade == "Bps" || unidade == "B/s";
+}
+
+/**
+ * Valida os campos de um fluxo e resolve os nomes dos nohs. contexto
+ * identifica a origem do fluxo nas mensagens de erro.
+ */
+inline FluxoMatriz validar_fluxo(const Topologia &topologia, const std::string &origem, const std::string &destino,
+                                 const std::string &protocolo, const std::string &taxa, long tamanho,
+                                 double inicio, double fim, long porta, const std::string &contexto) {
+    std::unordered_map<std::string, uint32_t>::const_iterator de = topologia.indice_nos.find (origem);
+    std::unordered_map<std::string, uint32_t>::const_iterator para = topologia.indice_nos.find (destino);
+    if (de == topologia.indice_nos.end ()) {
+        NS_FATAL_ERROR (contexto << ": noh de origem desconhecido: " << origem);
+    }
+    if (para == topologia.indice_nos.end ()) {
+        NS_FATAL_ERROR (contexto << ": noh de destino desconhecido: " << destino);
+    }
+    if (de->second == para->second) {
+        NS_FATAL_ERROR (contexto << ": origem e destino iguais (" << origem << ")");
+    }
+    if (topologia.endereco_principal[para->second] == ns3::Ipv4Address ()) {
+        NS_FATAL_ERROR (contexto << ": destino " << destino << " nao tem endereco IP");
+    }
+    if (protocolo != "tcp" && protocolo != "udp") {
+        NS_FATAL_ERROR (contexto << ": protocolo deve ser tcp ou udp, nao " << protocolo);
+    }
+    if (!taxa_valida (taxa)) {
+        NS_FATAL_ERROR (contexto << ": taxa invalida: " << taxa);
+    }
+    if (tamanho <= 0 || tamanho > 65507) {
+        NS_FATAL_ERROR (contexto << ": tamanho de pacote invalido: " << tamanho);
+    }
+    if (inicio < 0 || fim <= inicio) {
+        NS_FATAL_ERROR (contexto << ": intervalo invalido: " << inicio << " a " << fim);
+    }
+    if (porta <= 0 || porta > 65535) {
+        NS_FATAL_ERROR (contexto << ": porta invalida: " << porta);
+    }
+    FluxoMatriz fluxo = { de->second, para->second, protocolo == "udp", ns3::DataRate (taxa),
+                          uint32_t (tamanho), inicio, fim, uint16_t (porta), false };
+    return fluxo;
+}
+
+inline void ler_matriz_fluxos(std::istream &entrada, const Topologia &topologia, std::vector<FluxoMatriz> &fluxos) {
+    std::string linha;
+    std::vector<std::string> palavras;
+    uint64_t numero_linha = 0;
+    while (std::getline (entrada, linha)) {
+        numero_linha++;
+        separar_palavras (linha, palavras);
+        if (palavras.empty ()) {
+            continue;
+        }
+        std::ostringstream contexto;
+        contexto << "Matriz de fluxos, linha " << numero_linha;
+        if ((palavras.size () != 8 && palavras.size () != 9) || (palavras.size () == 9 && palavras[8] != "fundo")) {
+            NS_FATAL_ERROR (contexto.str () << ": esperado '<origem> <destino> tcp|udp <taxa> <tamanho> <inicio> <fim> <porta> [fundo]'");
+        }
+        fluxos.push_back (validar_fluxo (topologia, palavras[0], palavras[1], palavras[2], palavras[3],
+                                         std::atol (palavras[4].c_str ()), std::atof (palavras[5].c_str ()),
+                                         std::atof (palavras[6].c_str ()), std::atol (palavras[7].c_str ()),
+                                         contexto.str ()));
+        fluxos.back ().fundo = palavras.size () == 9;
+    }
+}
+
+/**
+ * Fluxos do cenario, todos com a mesma taxa e tamanho de pacote.
+ */
+inline void matriz_do_cenario(const Topologia &topologia, const Cenario &cenario, const std::string &taxa, uint32_t tamanho,
+                              std::vector<FluxoMatriz> &fluxos) {
+    for (size_t i = 0; i < cenario.fluxos.size (); ++i) {
+        const Fluxo &fluxo = cenario.fluxos[i];
+        fluxos.push_back (validar_fluxo (topologia, fluxo.origem, fluxo.destino, fluxo.udp ? "udp" : "tcp", taxa, tamanho,
+                                         fluxo.inicio, fluxo.fim, fluxo.porta, cenario.nome));
+    }
+}
+
+/**
+ * Instala os PacketSink dos fluxos, um por noh/porta/protocolo, nos nohs
+ * do processo atual. Devolve quantos foram instalados.
+ */
+inline uint32_t instalar_receptores(const Topologia &topologia, const std::vector<FluxoMatriz> &fluxos) {
+    uint32_t instalados = 0;
+    uint32_t sistema = ns3::Simulator::GetSystemId ();
+
+    // Receptores agrupados por (destino, porta, protocolo)
+    struct Receptor {
+        uint32_t no;
+        uint16_t porta;
+        bool udp;
+        double inicio;
+        double fim;
+    };
+    std::vector<Receptor> receptores;
+    std::unordered_map<uint64_t, uint32_t> indice_receptores;
+    indice_receptores.reserve (fluxos.size ());
+    for (size_t i = 0; i < fluxos.size (); ++i) {
+        const FluxoMatriz &fluxo = fluxos[i];
+        uint64_t chave = (uint64_t (fluxo.destino) << 17) | (uint64_t (fluxo.porta) << 1) | (fluxo.udp ? 1 : 0);
+        std::unordered_map<uint64_t, uint32_t>::iterator it = indice_receptores.find (chave);
+        if (it == indice_receptores.end ()) {
+            indice_receptores[chave] = receptores.size ();
+            Receptor receptor = { fluxo.destino, fluxo.porta, fluxo.udp, fluxo.inicio, fluxo.fim };
+            receptores.push_back (receptor);
+        } else {
+            Receptor &receptor = receptores[it->second];
+            receptor.inicio = std::min (receptor.inicio, fluxo.inicio);
+            receptor.fim = std::max (receptor.fim, fluxo.fim);
+        }
+    }
+
+    ns3::PacketSinkHelper sink_tcp (FABRICA_TCP, ns3::Address (ns3::InetSocketAddress (ns3::Ipv4Address::GetAny (), 0)));
+    ns3::PacketSinkHelper sink_udp (FABRICA_UDP, ns3::Address (ns3::InetSocketAddress (ns3::Ipv4Address::GetAny (), 0)));
+    for (size_t i = 0; i < receptores.size (); ++i) {
+        const Receptor &receptor = receptores[i];
+        ns3::Ptr<ns3::Node> no = topologia.nos[receptor.no];
+        if (no->GetSystemId () != sistema) {
+            continue;
+        }
+        ns3::PacketSinkHelper &sink = receptor.udp ? sink_udp : sink_tcp;
+        sink.SetAttribute ("Local", ns3::AddressValue (ns3::InetSocketAddress (ns3::Ipv4Address::GetAny (), receptor.porta)));
+        ns3::ApplicationContainer apps = sink.Install (no);
+        apps.Start (ns3::Seconds (receptor.inicio));
+        apps.Stop (ns3::Seconds (receptor.fim));
+        instalados++;
+    }
+    return instalados;
+}
+
+/**
+ * Instala os PacketSink (um por noh/porta/protocolo) e os OnOff da matriz.
+ * So os nohs do processo atual recebem aplicacoes.
+ */
+inline ResumoInstalacao instalar_fluxos(const Topologia &topologia, const std::vector<FluxoMatriz> &fluxos) {
+    std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now ();
+    ResumoInstalacao resumo;
+    uint32_t sistema = ns3::Simulator::GetSystemId ();
+    resumo.receptores = instalar_receptores (topologia, fluxos);
+
+    // Enviadores, ordenados para trocar taxa e tamanho o minimo de vezes
+    std::vector<uint32_t> ordem (fluxos.size ());
+    std::iota (ordem.begin (), ordem.end (), 0);
+    std::stable_sort (ordem.begin (), ordem.end (), [&] (uint32_t x, uint32_t y) {
+        const FluxoMatriz &a = fluxos[x];
+        const FluxoMatriz &b = fluxos[y];
+        if (a.udp != b.udp) {
+            return a.udp < b.udp;
+        }
+        if (a.taxa != b.taxa) {
+            return a.taxa < b.taxa;
+        }
+        return a.tamanho < b.tamanho;
+    });
+
+    ns3::OnOffHelper onoff_tcp (FABRICA_TCP, ns3::Address ());
+    ns3::OnOffHelper onoff_udp (FABRICA_UDP, ns3::Address ());
+    const FluxoMatriz *anterior[2] = { 0, 0 };
+    for (size_t k = 0; k < ordem.size (); ++k) {
+        const FluxoMatriz &fluxo = fluxos[ordem[k]];
+        ns3::Ptr<ns3::Node> no = topologia.nos[fluxo.origem];
+        if (no->GetSystemId () != sistema) {
+            continue;
+        }
+        ns3::OnOffHelper &onoff = fluxo.udp ? onoff_udp : onoff_tcp;
+        const FluxoMatriz *&ultimo = anterior[fluxo.udp ? 1 : 0];
+        if (!ultimo || ultimo->taxa != fluxo.taxa || ultimo->tamanho != fluxo.tamanho) {
+            onoff.SetConstantRate (fluxo.taxa, fluxo.tamanho);
+            ultimo = &fluxo;
+        }
+        onoff.SetAttribute ("Remote", ns3::AddressValue (ns3::InetSocketAddress (topologia.endereco_principal[fluxo.destino], fluxo.porta)));
+        ns3::ApplicationContainer apps = onoff.Install (no);
+        apps.Start (ns3::Seconds (fluxo.inicio));
+        apps.Stop (ns3::Seconds (fluxo.fim));
+        resumo.enviadores++;
+    }
+
+    resumo.tempo_s = segundos_desde (inicio);
+    return resumo;
+}
+
+#endif /* MATRIZ_FLUXOS_H */
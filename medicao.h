@@ -0,0 +1,58 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Medidas de tempo de parede e memoria do proprio processo.
+//
+
+#ifndef MEDICAO_H
+#define MEDICAO_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <sys/resource.h>
+
+inline double segundos_desde(std::chrono::steady_clock::time_point inicio) {
+    return std::chrono::duration<double> (std::chrono::steady_clock::now () - inicio).count ();
+}
+
+/**
+ * Pico de memoria residente (RSS) do processo, em KB.
+ */
+inline long pico_memoria_kb() {
+    struct rusage uso;
+    getrusage (RUSAGE_SELF, &uso);
+    return uso.ru_maxrss;
+}
+
+/**
+ * Bytes em uso no heap, somados e subtraidos pelo operator new/delete do
+ * programa (ver simulacao_redes.cc) pelo tamanho util de cada bloco. A
+ * diferenca entre duas leituras eh o que uma etapa deixou alocado.
+ */
+inline std::atomic<int64_t> &contador_bytes() {
+    static std::atomic<int64_t> contador (0);
+    return contador;
+}
+
+inline int64_t bytes_em_uso() {
+    return contador_bytes ().load (std::memory_order_relaxed);
+}
+
+#endif /* MEDICAO_H */
@@ -0,0 +1,185 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Monitoramento seletivo. As estatisticas por fluxo sao de ponta a ponta
+// (envio na origem, entrega no destino), entao basta colocar as sondas do
+// FlowMonitor nos nohs que tem aplicacoes, e nao em todos os roteadores do
+// caminho. O que se perde sao so os motivos de descarte nos saltos
+// intermediarios; os pacotes perdidos continuam contados pela origem.
+//
+// Os histogramas amostrados medem atraso e jitter de 1 em cada N pacotes
+// (escolhidos pelo uid, sem estado por pacote) nos mesmos pontos da camada
+// IP que o FlowMonitor. O jitter eh a diferenca entre atrasos de amostras
+// consecutivas do mesmo fluxo.
+//
+
+#ifndef MONITORAMENTO_H
+#define MONITORAMENTO_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include "topologia.h"
+
+/** Nohs com alguma aplicacao instalada: origens e destinos dos fluxos. */
+inline ns3::NodeContainer nos_extremos(const Topologia &topologia) {
+    ns3::NodeContainer extremos;
+    for (size_t i = 0; i < topologia.nos.size (); ++i) {
+        if (topologia.nos[i]->GetNApplications () > 0) {
+            extremos.Add (topologia.nos[i]);
+        }
+    }
+    return extremos;
+}
+
+class EtiquetaAmostra : public ns3::Tag {
+public:
+    static ns3::TypeId GetTypeId (void) {
+        static ns3::TypeId tid = ns3::TypeId ("EtiquetaAmostra")
+            .SetParent<ns3::Tag> ()
+            .AddConstructor<EtiquetaAmostra> ();
+        return tid;
+    }
+    virtual ns3::TypeId GetInstanceTypeId (void) const {
+        return GetTypeId ();
+    }
+    virtual uint32_t GetSerializedSize (void) const {
+        return 8;
+    }
+    virtual void Serialize (ns3::TagBuffer buffer) const {
+        buffer.WriteU64 (envio);
+    }
+    virtual void Deserialize (ns3::TagBuffer buffer) {
+        envio = buffer.ReadU64 ();
+    }
+    virtual void Print (std::ostream &saida) const {
+        saida << "envio=" << envio;
+    }
+
+    /** Instante de envio, em ns. */
+    uint64_t envio = 0;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (EtiquetaAmostra);
+
+/** Contagens por faixa de largura fixa; a faixa k cobre [k, k + 1) * largura. */
+class Histograma {
+public:
+    explicit Histograma (double largura)
+        : m_largura (largura) {
+    }
+
+    void adicionar (double valor) {
+        size_t faixa = valor > 0 ? size_t (valor / m_largura) : 0;
+        if (faixa >= m_contagens.size ()) {
+            m_contagens.resize (faixa + 1, 0);
+        }
+        m_contagens[faixa]++;
+        m_total++;
+    }
+
+    uint64_t total () const {
+        return m_total;
+    }
+
+    void escrever_csv (std::ostream &saida, const char *metrica) const {
+        for (size_t k = 0; k < m_contagens.size (); ++k) {
+            if (m_contagens[k] > 0) {
+                saida << metrica << ',' << k * m_largura << ',' << (k + 1) * m_largura << ',' << m_contagens[k] << std::endl;
+            }
+        }
+    }
+
+private:
+    double m_largura;
+    std::vector<uint64_t> m_contagens;
+    uint64_t m_total = 0;
+};
+
+class HistogramasAmostrados {
+public:
+    /** Amostra 1 em cada amostragem pacotes; largura das faixas em ms. */
+    HistogramasAmostrados (uint32_t amostragem, double largura_ms)
+        : m_amostragem (amostragem), m_atraso (largura_ms), m_jitter (largura_ms) {
+    }
+
+    void instalar (ns3::Ptr<ns3::Node> no) {
+        ns3::Ptr<ns3::Ipv4L3Protocol> ipv4 = no->GetObject<ns3::Ipv4L3Protocol> ();
+        ipv4->TraceConnectWithoutContext ("SendOutgoing", ns3::MakeCallback (&HistogramasAmostrados::enviado, this));
+        ipv4->TraceConnectWithoutContext ("LocalDeliver", ns3::MakeCallback (&HistogramasAmostrados::entregue, this));
+    }
+
+    uint64_t amostras () const {
+        return m_atraso.total ();
+    }
+
+    void escrever_csv (std::ostream &saida) const {
+        saida << "metrica,inicio_ms,fim_ms,pacotes" << std::endl;
+        m_atraso.escrever_csv (saida, "atraso");
+        m_jitter.escrever_csv (saida, "jitter");
+    }
+
+private:
+    void enviado (const ns3::Ipv4Header &cabecalho, ns3::Ptr<const ns3::Packet> pacote, uint32_t interface) {
+        if (pacote->GetUid () % m_amostragem != 0) {
+            return;
+        }
+        EtiquetaAmostra etiqueta;
+        etiqueta.envio = ns3::Simulator::Now ().GetNanoSeconds ();
+        pacote->AddPacketTag (etiqueta);
+    }
+
+    void entregue (const ns3::Ipv4Header &cabecalho, ns3::Ptr<const ns3::Packet> pacote, uint32_t interface) {
+        EtiquetaAmostra etiqueta;
+        if (!pacote->PeekPacketTag (etiqueta)) {
+            return;
+        }
+        int64_t atraso = ns3::Simulator::Now ().GetNanoSeconds () - int64_t (etiqueta.envio);
+        m_atraso.adicionar (atraso / 1e6);
+
+        // Fluxo pela 5-tupla, como na SondaFluxos
+        uint8_t portas[4] = { 0, 0, 0, 0 };
+        if (pacote->GetSize () >= 4) {
+            pacote->CopyData (portas, 4);
+        }
+        std::pair<uint64_t, uint64_t> chave (
+            (uint64_t (cabecalho.GetSource ().Get ()) << 32) | cabecalho.GetDestination ().Get (),
+            (uint64_t (cabecalho.GetProtocol ()) << 32) | (uint64_t (portas[0]) << 24) | (portas[1] << 16) | (portas[2] << 8) | portas[3]);
+        std::map<std::pair<uint64_t, uint64_t>, int64_t>::iterator anterior = m_ultimo_atraso.find (chave);
+        if (anterior != m_ultimo_atraso.end ()) {
+            m_jitter.adicionar (std::llabs (atraso - anterior->second) / 1e6);
+            anterior->second = atraso;
+        } else {
+            m_ultimo_atraso[chave] = atraso;
+        }
+    }
+
+    uint32_t m_amostragem;
+    Histograma m_atraso;
+    Histograma m_jitter;
+    std::map<std::pair<uint64_t, uint64_t>, int64_t> m_ultimo_atraso;
+};
+
+#endif /* MONITORAMENTO_H */
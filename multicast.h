@@ -0,0 +1,214 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Grupos multicast com rotas estaticas na arvore de caminhos minimos da
+// origem (mesma metrica do roteamento global). Cada pacote passa uma vez
+// por enlace da arvore, em vez de uma vez por membro em cada enlace
+// compartilhado, como no envio unicast para cada membro.
+//
+// Formato do arquivo (um grupo por linha, '#' inicia comentario):
+//
+//   <grupo> <origem> <taxa> <tamanho> <inicio> <fim> <porta> <membro> [<membro> ...]
+//
+// com grupo um endereco IPv4 multicast (224.0.0.0/4), nohs pelo nome e os
+// demais campos como na matriz de fluxos (sempre UDP).
+//
+// Cada noh interno da arvore recebe uma rota multicast (origem, grupo,
+// interface de entrada, interfaces de saida); a origem, uma rota de host
+// para o grupo pela unica interface da arvore que sai dela. O ns-3 entrega
+// o multicast localmente em todo noh por onde ele passa, entao so os
+// membros tem PacketSink na porta.
+//
+
+#ifndef MULTICAST_H
+#define MULTICAST_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+
+#include "grafo_roteamento.h"
+#include "matriz_fluxos.h"
+#include "topologia.h"
+
+struct GrupoMulticast {
+    ns3::Ipv4Address endereco;
+    // Um fluxo da origem para cada membro: o equivalente em unicast
+    std::vector<FluxoMatriz> membros;
+};
+
+inline void ler_grupos_multicast(std::istream &entrada, const Topologia &topologia, std::vector<GrupoMulticast> &grupos) {
+    std::string linha;
+    std::vector<std::string> palavras;
+    std::set<uint32_t> enderecos;
+    uint64_t numero_linha = 0;
+    while (std::getline (entrada, linha)) {
+        numero_linha++;
+        separar_palavras (linha, palavras);
+        if (palavras.empty ()) {
+            continue;
+        }
+        std::ostringstream contexto;
+        contexto << "Grupos multicast, linha " << numero_linha;
+        if (palavras.size () < 8) {
+            NS_FATAL_ERROR (contexto.str () << ": esperado '<grupo> <origem> <taxa> <tamanho> <inicio> <fim> <porta> <membro> [<membro> ...]'");
+        }
+        GrupoMulticast grupo;
+        grupo.endereco = ns3::Ipv4Address (palavras[0].c_str ());
+        if (!grupo.endereco.IsMulticast ()) {
+            NS_FATAL_ERROR (contexto.str () << ": " << palavras[0] << " nao eh um endereco multicast (224.0.0.0/4)");
+        }
+        if (!enderecos.insert (grupo.endereco.Get ()).second) {
+            NS_FATAL_ERROR (contexto.str () << ": grupo repetido: " << palavras[0]);
+        }
+        std::set<std::string> membros;
+        for (size_t k = 7; k < palavras.size (); ++k) {
+            if (!membros.insert (palavras[k]).second) {
+                NS_FATAL_ERROR (contexto.str () << ": membro repetido: " << palavras[k]);
+            }
+            grupo.membros.push_back (validar_fluxo (topologia, palavras[1], palavras[k], "udp", palavras[2],
+                                                    std::atol (palavras[3].c_str ()), std::atof (palavras[4].c_str ()),
+                                                    std::atof (palavras[5].c_str ()), std::atol (palavras[6].c_str ()),
+                                                    contexto.str ()));
+        }
+        grupos.push_back (grupo);
+    }
+}
+
+/** Envio unicast para cada membro, para comparacao com o multicast. */
+inline void fluxos_dos_grupos(const std::vector<GrupoMulticast> &grupos, std::vector<FluxoMatriz> &fluxos) {
+    for (size_t g = 0; g < grupos.size (); ++g) {
+        fluxos.insert (fluxos.end (), grupos[g].membros.begin (), grupos[g].membros.end ());
+    }
+}
+
+struct ResumoMulticast {
+    uint32_t grupos = 0;
+    uint32_t membros = 0;
+    // Copias de cada pacote nos enlaces: na arvore e no envio unicast
+    uint32_t enlaces_arvore = 0;
+    uint32_t enlaces_unicast = 0;
+};
+
+inline ns3::Ptr<ns3::NetDevice> dispositivo_no_enlace(const Topologia &topologia, uint32_t enlace, uint32_t no) {
+    const Enlace &ligacao = topologia.enlaces[enlace];
+    return ligacao.a == no ? ligacao.dispositivo_a : ligacao.dispositivo_b;
+}
+
+inline uint32_t vizinho_pelo_enlace(const Topologia &topologia, uint32_t enlace, uint32_t no) {
+    const Enlace &ligacao = topologia.enlaces[enlace];
+    return ligacao.a == no ? ligacao.b : ligacao.a;
+}
+
+/**
+ * Monta a arvore de cada grupo, instala as rotas estaticas (em todos os
+ * nohs, pois o roteamento existe em todos os processos) e as aplicacoes
+ * dos nohs locais.
+ */
+inline ResumoMulticast instalar_multicast(const Topologia &topologia, const std::vector<GrupoMulticast> &grupos) {
+    ResumoMulticast resumo;
+    GrafoRoteamento grafo;
+    montar_grafo_roteamento (topologia, grafo);
+    ns3::Ipv4StaticRoutingHelper estatico;
+    uint32_t sistema = ns3::Simulator::GetSystemId ();
+    std::vector<uint32_t> distancia;
+    std::vector<int32_t> anterior;
+
+    for (size_t g = 0; g < grupos.size (); ++g) {
+        const GrupoMulticast &grupo = grupos[g];
+        uint32_t origem = grupo.membros[0].origem;
+        caminhos_minimos (grafo, origem, distancia, 0, &anterior);
+
+        // Sobe de cada membro ate a origem ou ate um noh ja ligado a arvore
+        std::map<uint32_t, ns3::NetDeviceContainer> saidas;
+        std::vector<bool> ligado (topologia.nos.size (), false);
+        for (size_t m = 0; m < grupo.membros.size (); ++m) {
+            uint32_t no = grupo.membros[m].destino;
+            if (distancia[no] == DISTANCIA_INFINITA) {
+                NS_FATAL_ERROR ("Grupo " << grupo.endereco << ": membro " << topologia.nomes[no] << " inalcancavel a partir de "
+                                << topologia.nomes[origem]);
+            }
+            while (no != origem && !ligado[no]) {
+                ligado[no] = true;
+                uint32_t pai = vizinho_pelo_enlace (topologia, anterior[no], no);
+                saidas[pai].Add (dispositivo_no_enlace (topologia, anterior[no], pai));
+                resumo.enlaces_arvore++;
+                resumo.enlaces_unicast++;
+                no = pai;
+            }
+            // Trecho compartilhado: uma copia a mais por membro no unicast
+            while (no != origem) {
+                resumo.enlaces_unicast++;
+                no = vizinho_pelo_enlace (topologia, anterior[no], no);
+            }
+        }
+
+        ns3::NetDeviceContainer &da_origem = saidas[origem];
+        if (da_origem.GetN () != 1) {
+            NS_FATAL_ERROR ("Grupo " << grupo.endereco << ": a arvore sai de " << topologia.nomes[origem] << " por "
+                            << da_origem.GetN () << " interfaces; a origem so envia multicast por uma");
+        }
+        ns3::Ptr<ns3::Ipv4> ipv4_origem = topologia.nos[origem]->GetObject<ns3::Ipv4> ();
+        uint32_t interface_origem = ipv4_origem->GetInterfaceForDevice (da_origem.Get (0));
+        ns3::Ipv4Address endereco_origem = ipv4_origem->GetAddress (interface_origem, 0).GetLocal ();
+        estatico.GetStaticRouting (ipv4_origem)->AddHostRouteTo (grupo.endereco, interface_origem);
+        for (std::map<uint32_t, ns3::NetDeviceContainer>::iterator it = saidas.begin (); it != saidas.end (); ++it) {
+            if (it->first == origem) {
+                continue;
+            }
+            estatico.AddMulticastRoute (topologia.nos[it->first], endereco_origem, grupo.endereco,
+                                        dispositivo_no_enlace (topologia, anterior[it->first], it->first), it->second);
+        }
+
+        // Aplicacoes: um PacketSink por membro e um OnOff na origem
+        const FluxoMatriz &modelo = grupo.membros[0];
+        ns3::PacketSinkHelper sink (FABRICA_UDP, ns3::Address (ns3::InetSocketAddress (ns3::Ipv4Address::GetAny (), modelo.porta)));
+        for (size_t m = 0; m < grupo.membros.size (); ++m) {
+            ns3::Ptr<ns3::Node> membro = topologia.nos[grupo.membros[m].destino];
+            if (membro->GetSystemId () != sistema) {
+                continue;
+            }
+            ns3::ApplicationContainer apps = sink.Install (membro);
+            apps.Start (ns3::Seconds (modelo.inicio));
+            apps.Stop (ns3::Seconds (modelo.fim));
+        }
+        if (topologia.nos[origem]->GetSystemId () == sistema) {
+            ns3::OnOffHelper onoff (FABRICA_UDP, ns3::Address (ns3::InetSocketAddress (grupo.endereco, modelo.porta)));
+            onoff.SetConstantRate (modelo.taxa, modelo.tamanho);
+            ns3::ApplicationContainer apps = onoff.Install (topologia.nos[origem]);
+            apps.Start (ns3::Seconds (modelo.inicio));
+            apps.Stop (ns3::Seconds (modelo.fim));
+        }
+        resumo.grupos++;
+        resumo.membros += grupo.membros.size ();
+    }
+    return resumo;
+}
+
+#endif /* MULTICAST_H */
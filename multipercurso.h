@@ -0,0 +1,445 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Roteamento multipercurso (ECMP) com hash por fluxo. O Ipv4GlobalRouting
+// so sabe sortear um caminho por pacote (RandomEcmpRouting), o que
+// reordena os pacotes do TCP; aqui cada roteador espalha os fluxos entre
+// os vizinhos que levam ao destino, e todos os pacotes do mesmo fluxo
+// (5-tupla) seguem pelo mesmo vizinho.
+//
+// Um vizinho v serve para chegar a d a partir de u quando
+//
+//   dist(v, d) < dist(u, d)  e  custo(u, v) + dist(v, d) <= (1 + tolerancia) * dist(u, d)
+//
+// A primeira condicao garante que nao ha lacos (a distancia sempre cai) e
+// a segunda limita o quanto o caminho pode ser mais longo que o minimo. O
+// custo eh a metrica da interface (como no roteamento global, em geral
+// saltos) ou o atraso do enlace; com saltos so os caminhos de mesmo
+// comprimento passam, entao a tolerancia so faz diferenca com atraso. Com
+// divisao ponderada os fluxos sao repartidos na proporcao da taxa de cada
+// enlace de saida.
+//
+// As distancias sao calculadas sob demanda, uma coluna (Dijkstra reverso)
+// por destino que aparece nos pacotes, entao a memoria cresce com o numero
+// de destinos em uso e nao com o quadrado do numero de nohs. Uma falha de
+// enlace invalida as colunas, que sao refeitas no proximo pacote.
+//
+// Na origem o pacote ainda nao tem o cabecalho de transporte quando a rota
+// eh escolhida, entao o primeiro salto usa so os enderecos e o protocolo.
+//
+
+#ifndef MULTIPERCURSO_H
+#define MULTIPERCURSO_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/ipv4-list-routing.h"
+
+#include "grafo_roteamento.h"
+#include "topologia.h"
+
+struct OpcoesMultipercurso {
+    // Fracao a mais de custo aceita em relacao ao caminho minimo
+    double tolerancia = 0;
+    // Divide os fluxos na proporcao da taxa dos enlaces de saida
+    bool ponderado = false;
+    // saltos (metrica das interfaces) ou atraso (atraso dos enlaces)
+    std::string custo = "saltos";
+};
+
+/** Mistura de 64 bits (finalizador do MurmurHash3). */
+inline uint64_t misturar_bits(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/**
+ * Grafo, distancias e pesos compartilhados pelos protocolos de todos os
+ * nohs.
+ */
+class TabelaMultipercurso {
+public:
+    TabelaMultipercurso (const Topologia &topologia, const OpcoesMultipercurso &opcoes)
+        : m_opcoes (opcoes) {
+        if (opcoes.custo != "saltos" && opcoes.custo != "atraso") {
+            NS_FATAL_ERROR ("Custo do ECMP desconhecido: " << opcoes.custo << " (use saltos ou atraso)");
+        }
+        if (opcoes.tolerancia < 0) {
+            NS_FATAL_ERROR ("A tolerancia do ECMP nao pode ser negativa");
+        }
+        montar_grafo_roteamento (topologia, m_grafo);
+        uint32_t nos = topologia.nos.size ();
+        m_ipv4.resize (nos);
+        for (uint32_t i = 0; i < nos; ++i) {
+            m_ipv4[i] = topologia.nos[i]->GetObject<ns3::Ipv4> ();
+            for (size_t k = 0; k < m_grafo.enderecos[i].size (); ++k) {
+                m_no_do_endereco[m_grafo.enderecos[i][k].Get ()] = i;
+            }
+        }
+
+        m_peso.resize (nos);
+        m_entrada.assign (nos, std::vector<std::pair<uint32_t, uint32_t> > ());
+        for (uint32_t u = 0; u < nos; ++u) {
+            std::vector<Adjacencia> &vizinhos = m_grafo.adjacencias[u];
+            m_peso[u].resize (vizinhos.size (), 1.0);
+            for (size_t k = 0; k < vizinhos.size (); ++k) {
+                const ClasseEnlace &classe = topologia.classes[topologia.enlaces[vizinhos[k].enlace].classe];
+                if (opcoes.custo == "atraso") {
+                    vizinhos[k].custo = std::max<int64_t> (1, ns3::Time (classe.atraso).GetMicroSeconds ());
+                }
+                if (opcoes.ponderado) {
+                    m_peso[u][k] = ns3::DataRate (classe.taxa).GetBitRate ();
+                }
+                m_entrada[vizinhos[k].vizinho].push_back (std::make_pair (u, uint32_t (k)));
+            }
+        }
+    }
+
+    const GrafoRoteamento &grafo () const {
+        return m_grafo;
+    }
+
+    /** Noh dono do endereco, ou -1 se nao for de nenhum enlace da topologia. */
+    int32_t no_do_endereco (ns3::Ipv4Address endereco) const {
+        std::unordered_map<uint32_t, uint32_t>::const_iterator it = m_no_do_endereco.find (endereco.Get ());
+        return it == m_no_do_endereco.end () ? -1 : int32_t (it->second);
+    }
+
+    /**
+     * Coloca em candidatos os indices (em adjacencias[no]) dos vizinhos que
+     * servem para chegar a destino. Com interface >= 0, so os que saem por ela.
+     */
+    void candidatos (uint32_t no, uint32_t destino, int32_t interface, std::vector<uint32_t> &candidatos) {
+        candidatos.clear ();
+        const std::vector<uint32_t> &distancia = coluna (destino);
+        if (distancia[no] == DISTANCIA_INFINITA || no == destino) {
+            return;
+        }
+        double limite = distancia[no] * (1 + m_opcoes.tolerancia);
+        const std::vector<Adjacencia> &vizinhos = m_grafo.adjacencias[no];
+        for (size_t k = 0; k < vizinhos.size (); ++k) {
+            const Adjacencia &adjacencia = vizinhos[k];
+            uint32_t restante = distancia[adjacencia.vizinho];
+            if (!m_grafo.enlace_ativo[adjacencia.enlace] || restante >= distancia[no]
+                || (interface >= 0 && adjacencia.interface != uint32_t (interface))) {
+                continue;
+            }
+            if (adjacencia.custo + double (restante) <= limite) {
+                candidatos.push_back (k);
+            }
+        }
+    }
+
+    /**
+     * Escolhe o vizinho de no para destino pelo hash do fluxo; -1 sem rota.
+     * O hash eh misturado com o noh para que roteadores seguidos nao tomem
+     * sempre a mesma decisao.
+     */
+    int32_t escolher (uint32_t no, uint32_t destino, int32_t interface, uint64_t chave) {
+        candidatos (no, destino, interface, m_candidatos);
+        m_consultas++;
+        if (m_candidatos.empty ()) {
+            return -1;
+        }
+        if (m_candidatos.size () == 1) {
+            return m_candidatos[0];
+        }
+        m_consultas_divididas++;
+        double total = 0;
+        for (size_t i = 0; i < m_candidatos.size (); ++i) {
+            total += m_peso[no][m_candidatos[i]];
+        }
+        uint64_t sorteio = misturar_bits (chave ^ misturar_bits (no + 1));
+        double alvo = (sorteio >> 11) * (1.0 / 9007199254740992.0) * total;
+        for (size_t i = 0; i < m_candidatos.size (); ++i) {
+            alvo -= m_peso[no][m_candidatos[i]];
+            if (alvo < 0) {
+                return m_candidatos[i];
+            }
+        }
+        return m_candidatos.back ();
+    }
+
+    /** Descarta as distancias; chamada quando uma interface muda de estado. */
+    void invalidar () {
+        m_colunas.clear ();
+        m_atualizar_enlaces = true;
+    }
+
+    uint64_t consultas () const {
+        return m_consultas;
+    }
+
+    uint64_t consultas_divididas () const {
+        return m_consultas_divididas;
+    }
+
+    void imprimir (std::ostream &saida) const {
+        saida << "Multipercurso: " << m_consultas << " consultas, " << m_consultas_divididas
+              << " com mais de um caminho, " << m_colunas.size () << " destinos calculados" << std::endl;
+    }
+
+private:
+    /** Distancia de cada noh ate destino (Dijkstra pelas arestas invertidas). */
+    const std::vector<uint32_t> &coluna (uint32_t destino) {
+        std::unordered_map<uint32_t, std::vector<uint32_t> >::iterator it = m_colunas.find (destino);
+        if (it != m_colunas.end ()) {
+            return it->second;
+        }
+        if (m_atualizar_enlaces) {
+            atualizar_enlaces ();
+        }
+        std::vector<uint32_t> &distancia = m_colunas[destino];
+        distancia.assign (m_grafo.adjacencias.size (), DISTANCIA_INFINITA);
+
+        typedef std::pair<uint32_t, uint32_t> Entrada;
+        std::priority_queue<Entrada, std::vector<Entrada>, std::greater<Entrada> > fila;
+        distancia[destino] = 0;
+        fila.push (Entrada (0, destino));
+        while (!fila.empty ()) {
+            Entrada atual = fila.top ();
+            fila.pop ();
+            uint32_t no = atual.second;
+            if (atual.first > distancia[no]) {
+                continue;
+            }
+            const std::vector<std::pair<uint32_t, uint32_t> > &entrada = m_entrada[no];
+            for (size_t i = 0; i < entrada.size (); ++i) {
+                const Adjacencia &adjacencia = m_grafo.adjacencias[entrada[i].first][entrada[i].second];
+                if (!m_grafo.enlace_ativo[adjacencia.enlace]) {
+                    continue;
+                }
+                uint32_t nova = distancia[no] + adjacencia.custo;
+                if (nova < distancia[entrada[i].first]) {
+                    distancia[entrada[i].first] = nova;
+                    fila.push (Entrada (nova, entrada[i].first));
+                }
+            }
+        }
+        return distancia;
+    }
+
+    /** Um enlace esta ativo quando as interfaces dos dois lados estao up. */
+    void atualizar_enlaces () {
+        std::fill (m_grafo.enlace_ativo.begin (), m_grafo.enlace_ativo.end (), true);
+        for (uint32_t u = 0; u < m_grafo.adjacencias.size (); ++u) {
+            const std::vector<Adjacencia> &vizinhos = m_grafo.adjacencias[u];
+            for (size_t k = 0; k < vizinhos.size (); ++k) {
+                if (!m_ipv4[u]->IsUp (vizinhos[k].interface)) {
+                    m_grafo.enlace_ativo[vizinhos[k].enlace] = false;
+                }
+            }
+        }
+        m_atualizar_enlaces = false;
+    }
+
+    OpcoesMultipercurso m_opcoes;
+    GrafoRoteamento m_grafo;
+    std::vector<ns3::Ptr<ns3::Ipv4> > m_ipv4;
+    std::unordered_map<uint32_t, uint32_t> m_no_do_endereco;
+    // Peso de cada adjacencia na divisao dos fluxos
+    std::vector<std::vector<double> > m_peso;
+    // Para cada noh, as adjacencias (noh, indice) que chegam nele
+    std::vector<std::vector<std::pair<uint32_t, uint32_t> > > m_entrada;
+    std::unordered_map<uint32_t, std::vector<uint32_t> > m_colunas;
+    bool m_atualizar_enlaces = false;
+    std::vector<uint32_t> m_candidatos;
+    uint64_t m_consultas = 0;
+    uint64_t m_consultas_divididas = 0;
+};
+
+/**
+ * Protocolo de um noh. Fica na lista de roteamento abaixo do estatico, que
+ * cuida das redes diretamente ligadas; a entrega local tambem eh feita pela
+ * lista.
+ */
+class RoteamentoMultipercurso : public ns3::Ipv4RoutingProtocol {
+public:
+    static ns3::TypeId GetTypeId (void) {
+        static ns3::TypeId tid = ns3::TypeId ("RoteamentoMultipercurso")
+            .SetParent<ns3::Ipv4RoutingProtocol> ()
+            .AddConstructor<RoteamentoMultipercurso> ();
+        return tid;
+    }
+
+    void configurar (std::shared_ptr<TabelaMultipercurso> tabela, uint32_t no) {
+        m_tabela = tabela;
+        m_no = no;
+    }
+
+    virtual ns3::Ptr<ns3::Ipv4Route> RouteOutput (ns3::Ptr<ns3::Packet> pacote, const ns3::Ipv4Header &cabecalho,
+                                                  ns3::Ptr<ns3::NetDevice> saida, ns3::Socket::SocketErrno &erro) {
+        int32_t interface = saida ? m_ipv4->GetInterfaceForDevice (saida) : -1;
+        ns3::Ptr<ns3::Ipv4Route> rota = rotear (cabecalho, 0, interface);
+        erro = rota ? ns3::Socket::ERROR_NOTERROR : ns3::Socket::ERROR_NOROUTETOHOST;
+        return rota;
+    }
+
+    virtual bool RouteInput (ns3::Ptr<const ns3::Packet> pacote, const ns3::Ipv4Header &cabecalho, ns3::Ptr<const ns3::NetDevice> entrada,
+                             UnicastForwardCallback encaminhar, MulticastForwardCallback multicast,
+                             LocalDeliverCallback local, ErrorCallback erro) {
+        if (cabecalho.GetDestination ().IsMulticast () || cabecalho.GetDestination ().IsBroadcast ()) {
+            return false;
+        }
+        ns3::Ptr<ns3::Ipv4Route> rota = rotear (cabecalho, pacote, -1);
+        if (!rota) {
+            return false;
+        }
+        encaminhar (rota, pacote, cabecalho);
+        return true;
+    }
+
+    virtual void NotifyInterfaceUp (uint32_t interface) {
+        if (m_tabela) {
+            m_tabela->invalidar ();
+        }
+    }
+
+    virtual void NotifyInterfaceDown (uint32_t interface) {
+        if (m_tabela) {
+            m_tabela->invalidar ();
+        }
+    }
+
+    virtual void NotifyAddAddress (uint32_t interface, ns3::Ipv4InterfaceAddress endereco) {
+    }
+
+    virtual void NotifyRemoveAddress (uint32_t interface, ns3::Ipv4InterfaceAddress endereco) {
+    }
+
+    virtual void SetIpv4 (ns3::Ptr<ns3::Ipv4> ipv4) {
+        m_ipv4 = ipv4;
+    }
+
+    virtual void PrintRoutingTable (ns3::Ptr<ns3::OutputStreamWrapper> fluxo, ns3::Time::Unit unidade = ns3::Time::S) const {
+        std::ostream &saida = *fluxo->GetStream ();
+        if (!m_tabela) {
+            saida << "Multipercurso: sem tabela" << std::endl;
+            return;
+        }
+        const GrafoRoteamento &grafo = m_tabela->grafo ();
+        std::vector<uint32_t> candidatos;
+        saida << "Destino\t\tProximos saltos" << std::endl;
+        for (uint32_t destino = 0; destino < grafo.adjacencias.size (); ++destino) {
+            if (grafo.enderecos[destino].empty ()) {
+                continue;
+            }
+            m_tabela->candidatos (m_no, destino, -1, candidatos);
+            saida << grafo.enderecos[destino][0] << "\t";
+            for (size_t i = 0; i < candidatos.size (); ++i) {
+                const Adjacencia &adjacencia = grafo.adjacencias[m_no][candidatos[i]];
+                saida << "\t" << adjacencia.gateway << " (if " << adjacencia.interface << ")";
+            }
+            saida << std::endl;
+        }
+    }
+
+protected:
+    virtual void DoDispose (void) {
+        m_ipv4 = 0;
+        m_tabela.reset ();
+        ns3::Ipv4RoutingProtocol::DoDispose ();
+    }
+
+private:
+    /**
+     * Rota para o destino do cabecalho. As portas vem dos 4 primeiros bytes
+     * do pacote (o cabecalho IP ja foi retirado), quando ele existe.
+     */
+    ns3::Ptr<ns3::Ipv4Route> rotear (const ns3::Ipv4Header &cabecalho, ns3::Ptr<const ns3::Packet> pacote, int32_t interface) {
+        if (!m_tabela) {
+            return 0;
+        }
+        int32_t destino = m_tabela->no_do_endereco (cabecalho.GetDestination ());
+        if (destino < 0) {
+            return 0;
+        }
+        uint8_t portas[4] = { 0, 0, 0, 0 };
+        if (pacote && pacote->GetSize () >= 4) {
+            pacote->CopyData (portas, 4);
+        }
+        uint64_t chave = misturar_bits ((uint64_t (cabecalho.GetSource ().Get ()) << 32) | cabecalho.GetDestination ().Get ())
+                         ^ ((uint64_t (cabecalho.GetProtocol ()) << 32) | (uint64_t (portas[0]) << 24) | (portas[1] << 16) | (portas[2] << 8) | portas[3]);
+        int32_t escolhido = m_tabela->escolher (m_no, destino, interface, chave);
+        if (escolhido < 0) {
+            return 0;
+        }
+        const Adjacencia &adjacencia = m_tabela->grafo ().adjacencias[m_no][escolhido];
+        ns3::Ptr<ns3::Ipv4Route> rota = ns3::Create<ns3::Ipv4Route> ();
+        rota->SetDestination (cabecalho.GetDestination ());
+        rota->SetGateway (adjacencia.gateway);
+        rota->SetOutputDevice (m_ipv4->GetNetDevice (adjacencia.interface));
+        rota->SetSource (m_ipv4->GetAddress (adjacencia.interface, 0).GetLocal ());
+        return rota;
+    }
+
+    ns3::Ptr<ns3::Ipv4> m_ipv4;
+    std::shared_ptr<TabelaMultipercurso> m_tabela;
+    uint32_t m_no = 0;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (RoteamentoMultipercurso);
+
+class RoteamentoMultipercursoHelper : public ns3::Ipv4RoutingHelper {
+public:
+    virtual RoteamentoMultipercursoHelper *Copy (void) const {
+        return new RoteamentoMultipercursoHelper (*this);
+    }
+
+    virtual ns3::Ptr<ns3::Ipv4RoutingProtocol> Create (ns3::Ptr<ns3::Node> no) const {
+        return ns3::CreateObject<RoteamentoMultipercurso> ();
+    }
+};
+
+/**
+ * Monta a tabela compartilhada e a entrega ao protocolo de cada noh. Precisa
+ * vir depois de carregar_topologia, com a pilha configurada pelo
+ * configurar_roteamento ("ecmp").
+ */
+inline std::shared_ptr<TabelaMultipercurso> preparar_multipercurso(const Topologia &topologia, const OpcoesMultipercurso &opcoes) {
+    std::shared_ptr<TabelaMultipercurso> tabela (new TabelaMultipercurso (topologia, opcoes));
+    for (uint32_t i = 0; i < topologia.nos.size (); ++i) {
+        ns3::Ptr<ns3::Ipv4ListRouting> lista = ns3::DynamicCast<ns3::Ipv4ListRouting> (topologia.nos[i]->GetObject<ns3::Ipv4> ()->GetRoutingProtocol ());
+        for (uint32_t k = 0; lista && k < lista->GetNRoutingProtocols (); ++k) {
+            int16_t prioridade;
+            ns3::Ptr<RoteamentoMultipercurso> protocolo = ns3::DynamicCast<RoteamentoMultipercurso> (lista->GetRoutingProtocol (k, prioridade));
+            if (protocolo) {
+                protocolo->configurar (tabela, i);
+            }
+        }
+    }
+    return tabela;
+}
+
+#endif /* MULTIPERCURSO_H */
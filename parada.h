@@ -0,0 +1,291 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Parada automatica da simulacao. Em vez de rodar sempre ate o limite
+// fixo, o ControleParada termina a simulacao:
+// - quando a ultima aplicacao OnOff (ou trace reproduzido) parou, todas
+//   as filas (queue discs e filas dos dispositivos) estao vazias, nenhum
+//   socket TCP tem dados sem confirmacao no buffer de envio e nenhum
+//   pacote de dados (TCP/UDP fora do roteamento) foi enviado ha um
+//   intervalo de silencio. Sem a verificacao dos sockets, uma
+//   retransmissao pendente (o RTO minimo do TCP eh 1 s, e dobra a cada
+//   tentativa) passaria por silencio e o fluxo seria cortado;
+// - opcionalmente, quando a vazao de cada fluxo ficou dentro de uma
+//   tolerancia ao longo de uma janela deslizante (regime estacionario). Um
+//   PacketSink recebe todos os fluxos da mesma porta, entao os bytes sao
+//   separados pelo endereco e porta de origem de cada pacote recebido.
+// O limite de tempo continua valendo como ultimo recurso.
+//
+
+#ifndef PARADA_H
+#define PARADA_H
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "roteamento.h"
+#include "topologia.h"
+
+struct OpcoesParada {
+    double periodo = 0.1;
+    double silencio = 1.0;
+    bool estacionario = false;
+    double periodo_estacionario = 1.0;
+    double janela_estacionario = 10.0;
+    double tolerancia_estacionario = 0.05;
+};
+
+class ControleParada {
+public:
+    ControleParada (const Topologia &topologia, const OpcoesParada &opcoes)
+        : m_topologia (topologia), m_opcoes (opcoes) {
+    }
+
+    /**
+     * Fontes de trafego que nao sao aplicacoes OnOff (a reproducao de
+     * traces) informam aqui quando comecam e terminam. Deve ser chamada
+     * antes de armar.
+     */
+    void acrescentar_fonte (ns3::Time inicio, ns3::Time fim) {
+        m_inicio_fontes = std::max (m_inicio_fontes, inicio);
+        m_fim_fontes = std::max (m_fim_fontes, fim);
+    }
+
+    /**
+     * Localiza as aplicacoes ja instaladas e agenda as verificacoes. Deve
+     * ser chamada depois que todos os fluxos foram criados.
+     */
+    void armar () {
+        ns3::Time fim_aplicacoes = m_fim_fontes;
+        ns3::Time inicio_aplicacoes = m_inicio_fontes;
+        for (size_t i = 0; i < m_topologia.nos.size (); ++i) {
+            ns3::Ptr<ns3::Node> no = m_topologia.nos[i];
+            for (uint32_t j = 0; j < no->GetNApplications (); ++j) {
+                ns3::Ptr<ns3::Application> aplicacao = no->GetApplication (j);
+                if (ns3::DynamicCast<ns3::OnOffApplication> (aplicacao)) {
+                    ns3::TimeValue inicio;
+                    ns3::TimeValue fim;
+                    aplicacao->GetAttribute ("StartTime", inicio);
+                    aplicacao->GetAttribute ("StopTime", fim);
+                    inicio_aplicacoes = std::max (inicio_aplicacoes, inicio.Get ());
+                    fim_aplicacoes = std::max (fim_aplicacoes, fim.Get ());
+                }
+                ns3::Ptr<ns3::PacketSink> receptor = ns3::DynamicCast<ns3::PacketSink> (aplicacao);
+                if (receptor && m_opcoes.estacionario) {
+                    receptor->TraceConnectWithoutContext ("Rx", ns3::MakeBoundCallback (&ControleParada::recebido, this,
+                                                                                         uint32_t (m_fluxos_do_receptor.size ())));
+                    m_fluxos_do_receptor.push_back (std::unordered_map<uint64_t, uint32_t> ());
+                }
+            }
+            ns3::Ptr<ns3::Ipv4L3Protocol> ipv4 = no->GetObject<ns3::Ipv4L3Protocol> ();
+            ipv4->TraceConnectWithoutContext ("SendOutgoing", ns3::MakeCallback (&ControleParada::enviado, this));
+        }
+        m_fim_aplicacoes = fim_aplicacoes;
+        m_armado = true;
+
+        ns3::Simulator::Schedule (fim_aplicacoes, &ControleParada::verificar_fim, this);
+        if (m_opcoes.estacionario && !m_fluxos_do_receptor.empty ()) {
+            ns3::Simulator::Schedule (inicio_aplicacoes, &ControleParada::verificar_estacionario, this);
+        }
+    }
+
+    /** Motivo da parada, para o relatorio. */
+    std::string motivo () const {
+        return m_motivo.empty () ? "limite de tempo" : m_motivo;
+    }
+
+    /** Nada a informar se o controle nao foi armado (so o limite de tempo valeu). */
+    void imprimir (std::ostream &saida) const {
+        if (!m_armado) {
+            return;
+        }
+        saida << "Parada: " << motivo () << " em " << ns3::Simulator::Now ().GetSeconds () << " s simulados";
+        if (m_motivo.empty () || m_motivo == "regime estacionario") {
+            saida << " (ultima aplicacao terminaria em " << m_fim_aplicacoes.GetSeconds () << " s)";
+        }
+        saida << std::endl;
+    }
+
+private:
+    void parar (const std::string &motivo) {
+        m_motivo = motivo;
+        ns3::Simulator::Stop ();
+    }
+
+    bool filas_vazias () const {
+        for (size_t i = 0; i < m_topologia.enlaces.size (); ++i) {
+            const Enlace &enlace = m_topologia.enlaces[i];
+            if (!dispositivo_vazio (m_topologia.nos[enlace.a], enlace.dispositivo_a)
+                || !dispositivo_vazio (m_topologia.nos[enlace.b], enlace.dispositivo_b)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool dispositivo_vazio (ns3::Ptr<ns3::Node> no, ns3::Ptr<ns3::NetDevice> dispositivo) {
+        ns3::Ptr<ns3::TrafficControlLayer> controle = no->GetObject<ns3::TrafficControlLayer> ();
+        if (controle) {
+            ns3::Ptr<ns3::QueueDisc> disciplina = controle->GetRootQueueDiscOnDevice (dispositivo);
+            if (disciplina && disciplina->GetNPackets () > 0) {
+                return false;
+            }
+        }
+        ns3::Ptr<ns3::PointToPointNetDevice> p2p = ns3::DynamicCast<ns3::PointToPointNetDevice> (dispositivo);
+        return !p2p || p2p->GetQueue ()->GetNPackets () == 0;
+    }
+
+    /** Algum socket TCP ainda tem bytes enviados e nao confirmados (ou nao enviados)? */
+    bool tcp_pendente () const {
+        for (size_t i = 0; i < m_topologia.nos.size (); ++i) {
+            ns3::Ptr<ns3::TcpL4Protocol> tcp = m_topologia.nos[i]->GetObject<ns3::TcpL4Protocol> ();
+            if (!tcp) {
+                continue;
+            }
+            ns3::ObjectVectorValue sockets;
+            tcp->GetAttribute ("SocketList", sockets);
+            for (uint32_t j = 0; j < sockets.GetN (); ++j) {
+                ns3::Ptr<ns3::TcpSocketBase> socket = ns3::DynamicCast<ns3::TcpSocketBase> (sockets.Get (j));
+                if (socket && socket->GetTxBuffer ()->Size () > 0) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void enviado (const ns3::Ipv4Header &cabecalho, ns3::Ptr<const ns3::Packet> pacote, uint32_t interface) {
+        uint8_t protocolo = cabecalho.GetProtocol ();
+        if (protocolo == 17 && pacote->GetSize () >= 4) {
+            uint8_t portas[4];
+            pacote->CopyData (portas, 4);
+            if (porta_de_controle ((portas[0] << 8) | portas[1]) || porta_de_controle ((portas[2] << 8) | portas[3])) {
+                return;
+            }
+        } else if (protocolo != 6 && protocolo != 17) {
+            return;
+        }
+        m_ultimo_envio = ns3::Simulator::Now ();
+    }
+
+    void verificar_fim () {
+        ns3::Time agora = ns3::Simulator::Now ();
+        // Os sockets so sao percorridos depois das verificacoes baratas
+        if (agora - m_ultimo_envio >= ns3::Seconds (m_opcoes.silencio) && filas_vazias () && !tcp_pendente ()) {
+            parar ("aplicacoes terminadas e filas vazias");
+            return;
+        }
+        ns3::Simulator::Schedule (ns3::Seconds (m_opcoes.periodo), &ControleParada::verificar_fim, this);
+    }
+
+    /** Soma os bytes no fluxo (origem e porta) do pacote recebido. */
+    static void recebido (ControleParada *controle, uint32_t receptor, ns3::Ptr<const ns3::Packet> pacote, const ns3::Address &de) {
+        uint64_t chave = 0;
+        if (ns3::InetSocketAddress::IsMatchingType (de)) {
+            ns3::InetSocketAddress origem = ns3::InetSocketAddress::ConvertFrom (de);
+            chave = (uint64_t (origem.GetIpv4 ().Get ()) << 16) | origem.GetPort ();
+        }
+        std::unordered_map<uint64_t, uint32_t> &fluxos = controle->m_fluxos_do_receptor[receptor];
+        std::unordered_map<uint64_t, uint32_t>::iterator it = fluxos.find (chave);
+        if (it == fluxos.end ()) {
+            it = fluxos.insert (std::make_pair (chave, uint32_t (controle->m_totais.size ()))).first;
+            controle->m_totais.push_back (0);
+            controle->m_anteriores.push_back (0);
+            controle->m_amostras.push_back (std::deque<uint64_t> ());
+        }
+        controle->m_totais[it->second] += pacote->GetSize ();
+    }
+
+    /**
+     * Guarda a vazao de cada fluxo no ultimo periodo. Estacionario quando,
+     * em toda a janela, cada fluxo que ja recebeu algo ficou a no maximo
+     * tolerancia (relativa) da propria media.
+     */
+    void verificar_estacionario () {
+        size_t amostras_janela = std::max<size_t> (2, size_t (m_opcoes.janela_estacionario / m_opcoes.periodo_estacionario + 0.5));
+
+        bool estavel = true;
+        uint32_t avaliados = 0;
+        for (size_t i = 0; i < m_totais.size (); ++i) {
+            uint64_t total = m_totais[i];
+            std::deque<uint64_t> &amostras = m_amostras[i];
+            amostras.push_back (total - m_anteriores[i]);
+            m_anteriores[i] = total;
+            if (amostras.size () > amostras_janela) {
+                amostras.pop_front ();
+            }
+            if (total == 0) {
+                continue;
+            }
+            if (amostras.size () < amostras_janela) {
+                estavel = false;
+                continue;
+            }
+            double soma = 0;
+            uint64_t menor = amostras[0];
+            uint64_t maior = amostras[0];
+            for (size_t k = 0; k < amostras.size (); ++k) {
+                soma += amostras[k];
+                menor = std::min (menor, amostras[k]);
+                maior = std::max (maior, amostras[k]);
+            }
+            double media = soma / amostras.size ();
+            avaliados++;
+            if (media <= 0 || (maior - media) > m_opcoes.tolerancia_estacionario * media
+                || (media - menor) > m_opcoes.tolerancia_estacionario * media) {
+                estavel = false;
+            }
+        }
+        if (estavel && avaliados > 0 && ns3::Simulator::Now () < m_fim_aplicacoes) {
+            parar ("regime estacionario");
+            return;
+        }
+        if (ns3::Simulator::Now () < m_fim_aplicacoes) {
+            ns3::Simulator::Schedule (ns3::Seconds (m_opcoes.periodo_estacionario), &ControleParada::verificar_estacionario, this);
+        }
+    }
+
+    const Topologia &m_topologia;
+    OpcoesParada m_opcoes;
+    // Para cada PacketSink, (origem << 16 | porta) -> fluxo
+    std::vector<std::unordered_map<uint64_t, uint32_t> > m_fluxos_do_receptor;
+    // Por fluxo: bytes recebidos, total na amostra anterior e amostras da janela
+    std::vector<uint64_t> m_totais;
+    std::vector<uint64_t> m_anteriores;
+    std::vector<std::deque<uint64_t> > m_amostras;
+    bool m_armado = false;
+    ns3::Time m_fim_aplicacoes;
+    ns3::Time m_inicio_fontes;
+    ns3::Time m_fim_fontes;
+    ns3::Time m_ultimo_envio;
+    std::string m_motivo;
+};
+
+#endif /* PARADA_H */
@@ -0,0 +1,180 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Divisao dos nohs entre os processos da simulacao distribuida.
+//
+// Os enlaces cortados pela particao definem o lookahead (o menor atraso
+// entre processos), entao a particao procura o maior limiar de atraso L tal
+// que, unindo os nohs ligados por enlaces com atraso < L, ainda sobram
+// componentes suficientes para todos os processos. Na topologia padrao com
+// dois processos isso separa America do Sul + G1/G2 de America do Norte + G3
+// pelo enlace G2_G3 de 100ms. Os componentes sao distribuidos entre os
+// processos pelo numero de nohs (maior componente primeiro, no processo
+// menos carregado).
+//
+
+#ifndef PARTICAO_H
+#define PARTICAO_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+struct ArestaParticao {
+    uint32_t a;
+    uint32_t b;
+    double atraso;
+};
+
+struct Particao {
+    std::vector<uint32_t> sistema_do_no;
+    std::vector<uint32_t> nos_por_sistema;
+    uint32_t enlaces_cortados = 0;
+    double lookahead = 0;
+};
+
+inline uint32_t raiz_conjunto(std::vector<uint32_t> &pai, uint32_t x) {
+    while (pai[x] != x) {
+        pai[x] = pai[pai[x]];
+        x = pai[x];
+    }
+    return x;
+}
+
+/**
+ * Distribui os componentes atuais de pai entre os sistemas e devolve a maior
+ * carga (em nohs) de um sistema.
+ */
+inline uint32_t distribuir_componentes(std::vector<uint32_t> &pai, uint32_t sistemas, std::vector<uint32_t> &sistema_do_no, std::vector<uint32_t> &carga) {
+    uint32_t nos = pai.size ();
+    std::vector<uint32_t> tamanho (nos, 0);
+    for (uint32_t i = 0; i < nos; ++i) {
+        tamanho[raiz_conjunto (pai, i)]++;
+    }
+
+    std::vector<uint32_t> raizes;
+    for (uint32_t i = 0; i < nos; ++i) {
+        if (tamanho[i] > 0) {
+            raizes.push_back (i);
+        }
+    }
+    std::stable_sort (raizes.begin (), raizes.end (), [&] (uint32_t x, uint32_t y) {
+        return tamanho[x] > tamanho[y];
+    });
+
+    carga.assign (sistemas, 0);
+    std::vector<uint32_t> sistema_da_raiz (nos, 0);
+    for (size_t i = 0; i < raizes.size (); ++i) {
+        uint32_t menos_carregado = std::min_element (carga.begin (), carga.end ()) - carga.begin ();
+        sistema_da_raiz[raizes[i]] = menos_carregado;
+        carga[menos_carregado] += tamanho[raizes[i]];
+    }
+
+    sistema_do_no.resize (nos);
+    for (uint32_t i = 0; i < nos; ++i) {
+        sistema_do_no[i] = sistema_da_raiz[raiz_conjunto (pai, i)];
+    }
+    return *std::max_element (carga.begin (), carga.end ());
+}
+
+/** O lookahead real eh o menor atraso entre os enlaces efetivamente cortados. */
+inline void medir_cortes(const std::vector<ArestaParticao> &arestas, Particao &particao) {
+    particao.enlaces_cortados = 0;
+    particao.lookahead = std::numeric_limits<double>::infinity ();
+    for (size_t j = 0; j < arestas.size (); ++j) {
+        if (particao.sistema_do_no[arestas[j].a] != particao.sistema_do_no[arestas[j].b]) {
+            particao.enlaces_cortados++;
+            particao.lookahead = std::min (particao.lookahead, arestas[j].atraso);
+        }
+    }
+}
+
+/**
+ * Particiona nos nohs entre sistemas processos. Entre os limiares que deixam
+ * a carga maxima ate desbalanceamento_maximo vezes a carga ideal, fica o de
+ * maior lookahead; se nenhum atende, fica o mais balanceado. Com mais
+ * sistemas que nohs, cada noh fica sozinho em um sistema e os demais ficam
+ * vazios (quem chama deve recusar esse caso).
+ */
+inline Particao particionar_por_atraso(uint32_t nos, std::vector<ArestaParticao> arestas, uint32_t sistemas, double desbalanceamento_maximo = 1.5) {
+    Particao melhor;
+    if (sistemas <= 1 || nos == 0) {
+        melhor.sistema_do_no.assign (nos, 0);
+        melhor.nos_por_sistema.assign (1, nos);
+        melhor.lookahead = std::numeric_limits<double>::infinity ();
+        return melhor;
+    }
+
+    std::sort (arestas.begin (), arestas.end (), [] (const ArestaParticao &x, const ArestaParticao &y) {
+        return x.atraso < y.atraso;
+    });
+
+    std::vector<uint32_t> pai (nos);
+    std::iota (pai.begin (), pai.end (), 0);
+    if (sistemas > nos) {
+        // Nem separando todos os nohs ha componentes para todos os sistemas
+        distribuir_componentes (pai, sistemas, melhor.sistema_do_no, melhor.nos_por_sistema);
+        medir_cortes (arestas, melhor);
+        return melhor;
+    }
+    uint32_t componentes = nos;
+
+    double carga_ideal = double (nos) / sistemas;
+    bool melhor_balanceado = false;
+    uint32_t melhor_carga = std::numeric_limits<uint32_t>::max ();
+
+    std::vector<uint32_t> sistema_do_no;
+    std::vector<uint32_t> carga;
+
+    size_t i = 0;
+    while (true) {
+        double limiar = i < arestas.size () ? arestas[i].atraso : std::numeric_limits<double>::infinity ();
+
+        if (componentes >= sistemas) {
+            uint32_t carga_maxima = distribuir_componentes (pai, sistemas, sistema_do_no, carga);
+            bool balanceado = carga_maxima <= desbalanceamento_maximo * carga_ideal;
+            // Limiares crescentes: um balanceado sempre substitui o anterior
+            if (balanceado || (!melhor_balanceado && carga_maxima <= melhor_carga)) {
+                melhor.sistema_do_no = sistema_do_no;
+                melhor.nos_por_sistema = carga;
+                melhor_balanceado = balanceado;
+                melhor_carga = carga_maxima;
+            }
+        }
+        if (i == arestas.size () || componentes < sistemas) {
+            break;
+        }
+
+        while (i < arestas.size () && arestas[i].atraso == limiar) {
+            uint32_t a = raiz_conjunto (pai, arestas[i].a);
+            uint32_t b = raiz_conjunto (pai, arestas[i].b);
+            if (a != b) {
+                pai[a] = b;
+                componentes--;
+            }
+            ++i;
+        }
+    }
+
+    medir_cortes (arestas, melhor);
+    return melhor;
+}
+
+#endif /* PARTICAO_H */
@@ -0,0 +1,203 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Perfil de uma execucao por fases (montagem da topologia, roteamento,
+// instalacao dos fluxos, Simulator::Run, gravacao dos resultados...): tempo
+// de parede, alocacoes de memoria e pico de RSS ao fim de cada fase, mais
+// os eventos processados por segundo no Run. O resultado vai para JSON.
+//
+// As alocacoes sao contadas pelo operator new do programa (ver
+// simulacao_redes.cc), que incrementa contador_alocacoes ().
+//
+
+#ifndef PERFIL_H
+#define PERFIL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "medicao.h"
+#include "topologia.h"
+
+inline std::atomic<uint64_t> &contador_alocacoes() {
+    static std::atomic<uint64_t> contador (0);
+    return contador;
+}
+
+struct FasePerfil {
+    std::string nome;
+    double segundos = 0;
+    uint64_t alocacoes = 0;
+    long pico_memoria_kb = 0;
+};
+
+class PerfilExecucao {
+public:
+    PerfilExecucao ()
+        : m_inicio_total (std::chrono::steady_clock::now ()) {
+    }
+
+    /**
+     * Encerra a fase atual e comeca a fase nome. Uma fase que se repete
+     * (ex.: relatorios antes e depois da gravacao do XML) acumula.
+     */
+    void fase (const std::string &nome) {
+        terminar ();
+        m_atual = -1;
+        for (size_t i = 0; i < m_fases.size (); ++i) {
+            if (m_fases[i].nome == nome) {
+                m_atual = i;
+            }
+        }
+        if (m_atual < 0) {
+            m_atual = m_fases.size ();
+            m_fases.push_back (FasePerfil ());
+            m_fases.back ().nome = nome;
+        }
+        m_inicio = std::chrono::steady_clock::now ();
+        m_alocacoes = contador_alocacoes ().load (std::memory_order_relaxed);
+    }
+
+    void terminar () {
+        if (m_atual < 0) {
+            return;
+        }
+        FasePerfil &fase = m_fases[m_atual];
+        fase.segundos += segundos_desde (m_inicio);
+        fase.alocacoes += contador_alocacoes ().load (std::memory_order_relaxed) - m_alocacoes;
+        fase.pico_memoria_kb = pico_memoria_kb ();
+        m_atual = -1;
+        m_total = segundos_desde (m_inicio_total);
+    }
+
+    void registrar_topologia (const Topologia &topologia) {
+        m_nos = topologia.nos.size ();
+        m_enlaces = topologia.enlaces.size ();
+        m_montagem = topologia.tempos;
+        m_memoria = topologia.memoria;
+    }
+
+    /** Bytes que o calculo das tabelas de roteamento deixou alocados. */
+    void registrar_roteamento (int64_t bytes) {
+        m_bytes_roteamento = bytes;
+    }
+
+    /** Eventos processados pelo Simulator::Run e o tempo que ele levou. */
+    void registrar_execucao (uint64_t eventos, double segundos) {
+        m_eventos = eventos;
+        m_segundos_execucao = segundos;
+    }
+
+    const std::vector<FasePerfil> &fases () const {
+        return m_fases;
+    }
+
+    double segundos (const std::string &nome) const {
+        for (size_t i = 0; i < m_fases.size (); ++i) {
+            if (m_fases[i].nome == nome) {
+                return m_fases[i].segundos;
+            }
+        }
+        return 0;
+    }
+
+    uint32_t nos () const {
+        return m_nos;
+    }
+
+    uint32_t enlaces () const {
+        return m_enlaces;
+    }
+
+    double total_segundos () const {
+        return m_total;
+    }
+
+    uint64_t eventos () const {
+        return m_eventos;
+    }
+
+    double eventos_por_segundo () const {
+        return m_segundos_execucao > 0 ? m_eventos / m_segundos_execucao : 0;
+    }
+
+    /** Memoria dos nohs (pilha IP e tabelas de roteamento) por noh. */
+    int64_t bytes_por_no () const {
+        return m_nos > 0 ? (m_memoria.nos + m_bytes_roteamento) / int64_t (m_nos) : 0;
+    }
+
+    int64_t bytes_por_enlace () const {
+        return m_enlaces > 0 ? m_memoria.enlaces / int64_t (m_enlaces) : 0;
+    }
+
+    uint64_t alocacoes () const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < m_fases.size (); ++i) {
+            total += m_fases[i].alocacoes;
+        }
+        return total;
+    }
+
+    void escrever_json (std::ostream &saida, const std::string &rotulo) const {
+        const TemposMontagem &tempos = m_montagem;
+        saida << "{\n"
+              << "  \"execucao\": \"" << rotulo << "\",\n"
+              << "  \"nos\": " << m_nos << ",\n"
+              << "  \"enlaces\": " << m_enlaces << ",\n"
+              << "  \"tempo_total_s\": " << m_total << ",\n"
+              << "  \"eventos\": " << m_eventos << ",\n"
+              << "  \"eventos_por_s\": " << eventos_por_segundo () << ",\n"
+              << "  \"alocacoes\": " << alocacoes () << ",\n"
+              << "  \"pico_memoria_kb\": " << pico_memoria_kb () << ",\n"
+              << "  \"montagem\": {\"leitura_s\": " << tempos.leitura << ", \"pilha_ip_s\": " << tempos.nos
+              << ", \"dispositivos_s\": " << tempos.dispositivos << ", \"filas_s\": " << tempos.filas
+              << ", \"enderecos_s\": " << tempos.enderecos << "},\n"
+              << "  \"memoria\": {\"bytes_nos\": " << m_memoria.nos << ", \"bytes_enlaces\": " << m_memoria.enlaces
+              << ", \"bytes_roteamento\": " << m_bytes_roteamento << ", \"bytes_por_no\": " << bytes_por_no ()
+              << ", \"bytes_por_enlace\": " << bytes_por_enlace () << "},\n"
+              << "  \"fases\": [";
+        for (size_t i = 0; i < m_fases.size (); ++i) {
+            const FasePerfil &fase = m_fases[i];
+            saida << (i == 0 ? "\n" : ",\n")
+                  << "    {\"nome\": \"" << fase.nome << "\", \"segundos\": " << fase.segundos
+                  << ", \"alocacoes\": " << fase.alocacoes << ", \"pico_memoria_kb\": " << fase.pico_memoria_kb << "}";
+        }
+        saida << "\n  ]\n}" << std::endl;
+    }
+
+private:
+    std::chrono::steady_clock::time_point m_inicio_total;
+    std::chrono::steady_clock::time_point m_inicio;
+    std::vector<FasePerfil> m_fases;
+    uint32_t m_nos = 0;
+    uint32_t m_enlaces = 0;
+    TemposMontagem m_montagem;
+    MemoriaMontagem m_memoria;
+    int64_t m_bytes_roteamento = 0;
+    int32_t m_atual = -1;
+    uint64_t m_alocacoes = 0;
+    uint64_t m_eventos = 0;
+    double m_segundos_execucao = 0;
+    double m_total = 0;
+};
+
+#endif /* PERFIL_H */
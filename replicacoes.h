@@ -0,0 +1,192 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Parada sequencial das replicacoes de um cenario. Cada replicacao roda com
+// outro numero de execucao do RngSeedManager (fluxos aleatorios
+// independentes) e contribui com uma amostra de cada metrica alvo:
+// - vazao: vazao media por fluxo, em Mbit/s;
+// - atraso: atraso medio dos pacotes, em ms;
+// - perda: fracao de pacotes perdidos.
+// Novas replicacoes sao feitas ate que a meia largura do intervalo de 95%
+// de confianca de cada metrica (t de Student) fique abaixo do limiar,
+// relativo a media, ou ate o maximo de replicacoes.
+//
+
+#ifndef REPLICACOES_H
+#define REPLICACOES_H
+
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "resumo.h"
+
+static const uint32_t METRICAS_REPLICACAO = 3;
+
+inline const char *nome_metrica_replicacao(uint32_t metrica) {
+    static const char *nomes[METRICAS_REPLICACAO] = { "vazao_mbps", "atraso_ms", "perda" };
+    return nomes[metrica];
+}
+
+inline double valor_metrica_replicacao(const ResumoExecucao &resumo, uint32_t metrica) {
+    switch (metrica) {
+    case 0:
+        return resumo.fluxos > 0 ? resumo.vazao_mbps / resumo.fluxos : 0;
+    case 1:
+        return resumo.atraso_medio_ms;
+    default:
+        return resumo.pacotes_tx > 0 ? double (resumo.pacotes_perdidos) / resumo.pacotes_tx : 0;
+    }
+}
+
+/** Quantil 0,975 da t de Student com graus de liberdade. */
+inline double quantil_t_975(uint32_t graus) {
+    static const double tabela[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (graus == 0) {
+        return INFINITY;
+    }
+    if (graus <= sizeof (tabela) / sizeof (tabela[0])) {
+        return tabela[graus - 1];
+    }
+    // Expansao de Cornish-Fisher em torno da normal
+    const double z = 1.959964;
+    return z + (z * z * z + z) / (4.0 * graus);
+}
+
+/** Media e variancia incrementais (Welford). */
+struct AmostraReplicacoes {
+    uint32_t n = 0;
+    double media = 0;
+    double m2 = 0;
+
+    void adicionar (double valor) {
+        n++;
+        double desvio = valor - media;
+        media += desvio / n;
+        m2 += desvio * (valor - media);
+    }
+
+    double meia_largura () const {
+        if (n < 2) {
+            return INFINITY;
+        }
+        return quantil_t_975 (n - 1) * std::sqrt (m2 / (n - 1) / n);
+    }
+};
+
+class ControleReplicacoes {
+public:
+    ControleReplicacoes (uint32_t minimo, uint32_t maximo, double limiar)
+        : m_minimo (minimo < 2 ? 2 : minimo), m_maximo (maximo < m_minimo ? m_minimo : maximo), m_limiar (limiar),
+          m_metricas (METRICAS_REPLICACAO) {
+    }
+
+    /**
+     * Resultado da replicacao de numero dado (1, 2, ...). Com processos
+     * paralelos as curtas terminam primeiro; para nao favorece-las, cada
+     * resultado espera os de numero menor, e as estatisticas (e a parada)
+     * so usam replicacoes consecutivas desde a primeira.
+     */
+    void adicionar (uint32_t replicacao, const ResumoExecucao &resumo) {
+        m_pendentes[replicacao] = resumo;
+        std::map<uint32_t, ResumoExecucao>::iterator it;
+        while ((it = m_pendentes.begin ()) != m_pendentes.end () && it->first == replicacoes () + 1) {
+            for (uint32_t k = 0; k < METRICAS_REPLICACAO; ++k) {
+                m_metricas[k].adicionar (valor_metrica_replicacao (it->second, k));
+            }
+            m_pendentes.erase (it);
+        }
+    }
+
+    uint32_t replicacoes () const {
+        return m_metricas[0].n;
+    }
+
+    /** Concluidas que esperam uma de numero menor. */
+    uint32_t pendentes () const {
+        return m_pendentes.size ();
+    }
+
+    bool metrica_convergiu (uint32_t metrica) const {
+        const AmostraReplicacoes &amostra = m_metricas[metrica];
+        return amostra.n >= 2 && amostra.meia_largura () <= m_limiar * std::fabs (amostra.media);
+    }
+
+    bool convergiu () const {
+        if (replicacoes () < m_minimo) {
+            return false;
+        }
+        for (uint32_t k = 0; k < METRICAS_REPLICACAO; ++k) {
+            if (!metrica_convergiu (k)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** Nao precisa de mais replicacoes alem das ja concluidas. */
+    bool encerrado () const {
+        return convergiu () || replicacoes () >= m_maximo;
+    }
+
+    /**
+     * Pode iniciar mais uma replicacao, dado quantas estao rodando. Abaixo
+     * do minimo inicia todas de uma vez; depois, ate "paralelas" por vez,
+     * para nao passar muito do necessario quando o intervalo fechar.
+     */
+    bool iniciar_mais (uint32_t rodando, uint32_t paralelas) const {
+        uint32_t iniciadas = replicacoes () + pendentes () + rodando;
+        if (encerrado () || iniciadas >= m_maximo) {
+            return false;
+        }
+        return iniciadas < m_minimo || rodando < paralelas;
+    }
+
+    void escrever_csv (std::ostream &saida, const std::string &cenario) const {
+        for (uint32_t k = 0; k < METRICAS_REPLICACAO; ++k) {
+            const AmostraReplicacoes &amostra = m_metricas[k];
+            saida << cenario << ',' << replicacoes () << ',' << nome_metrica_replicacao (k) << ','
+                  << amostra.media << ',' << amostra.meia_largura () << ',' << (metrica_convergiu (k) ? 1 : 0) << std::endl;
+        }
+    }
+
+    void imprimir (std::ostream &saida, const std::string &cenario) const {
+        saida << cenario << ": " << replicacoes () << " replicacoes" << (convergiu () ? "" : " (limite atingido sem convergir)");
+        for (uint32_t k = 0; k < METRICAS_REPLICACAO; ++k) {
+            const AmostraReplicacoes &amostra = m_metricas[k];
+            saida << ", " << nome_metrica_replicacao (k) << " " << amostra.media << " +- " << amostra.meia_largura ();
+        }
+        saida << std::endl;
+    }
+
+private:
+    uint32_t m_minimo;
+    uint32_t m_maximo;
+    double m_limiar;
+    std::vector<AmostraReplicacoes> m_metricas;
+    std::map<uint32_t, ResumoExecucao> m_pendentes;
+};
+
+#endif /* REPLICACOES_H */
@@ -0,0 +1,129 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Resumo de uma execucao a partir das estatisticas do FlowMonitor, em uma
+// linha CSV. As colunas que identificam a execucao (cenario, semente,
+// parametros...) sao escritas por quem chama, antes das metricas.
+//
+
+#ifndef RESUMO_H
+#define RESUMO_H
+
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#include "ns3/core-module.h"
+#include "ns3/flow-monitor.h"
+#include "ns3/ipv4-flow-classifier.h"
+
+#include "roteamento.h"
+
+struct ResumoExecucao {
+    uint32_t fluxos = 0;
+    uint64_t bytes_tx = 0;
+    uint64_t bytes_rx = 0;
+    uint64_t pacotes_tx = 0;
+    uint64_t pacotes_rx = 0;
+    uint64_t pacotes_perdidos = 0;
+    double vazao_mbps = 0;
+    double atraso_medio_ms = 0;
+    double jitter_medio_ms = 0;
+    double tempo_execucao_s = 0;
+    double tempo_simulado_s = 0;
+    // Custo do roteamento: -1 quando nao convergiu
+    double convergencia_s = 0;
+    uint64_t bytes_controle = 0;
+    // Nohs com sonda do FlowMonitor (nao vai para o CSV)
+    uint32_t nos_monitorados = 0;
+};
+
+/**
+ * Soma as estatisticas de todos os fluxos. A vazao eh a soma das vazoes de
+ * cada fluxo, medidas entre o primeiro e o ultimo pacote recebido. Com o
+ * classificador, os fluxos de controle do roteamento (RIP/OLSR) ficam de
+ * fora, para que so o plano de dados seja resumido.
+ */
+inline ResumoExecucao resumir_fluxos(ns3::Ptr<ns3::FlowMonitor> monitor, ns3::Ptr<ns3::Ipv4FlowClassifier> classificador = ns3::Ptr<ns3::Ipv4FlowClassifier> ()) {
+    ResumoExecucao resumo;
+    if (!monitor) {
+        return resumo;
+    }
+    monitor->CheckForLostPackets ();
+
+    double soma_atraso = 0;
+    double soma_jitter = 0;
+    const ns3::FlowMonitor::FlowStatsContainer &estatisticas = monitor->GetFlowStats ();
+    for (ns3::FlowMonitor::FlowStatsContainer::const_iterator it = estatisticas.begin (); it != estatisticas.end (); ++it) {
+        if (classificador) {
+            ns3::Ipv4FlowClassifier::FiveTuple tupla = classificador->FindFlow (it->first);
+            if (porta_de_controle (tupla.sourcePort) || porta_de_controle (tupla.destinationPort)) {
+                continue;
+            }
+        }
+        const ns3::FlowMonitor::FlowStats &fluxo = it->second;
+        resumo.fluxos++;
+        resumo.bytes_tx += fluxo.txBytes;
+        resumo.bytes_rx += fluxo.rxBytes;
+        resumo.pacotes_tx += fluxo.txPackets;
+        resumo.pacotes_rx += fluxo.rxPackets;
+        resumo.pacotes_perdidos += fluxo.lostPackets;
+        soma_atraso += fluxo.delaySum.GetSeconds ();
+        soma_jitter += fluxo.jitterSum.GetSeconds ();
+
+        double duracao = (fluxo.timeLastRxPacket - fluxo.timeFirstRxPacket).GetSeconds ();
+        if (duracao > 0) {
+            resumo.vazao_mbps += fluxo.rxBytes * 8.0 / duracao / 1e6;
+        }
+    }
+    if (resumo.pacotes_rx > 0) {
+        resumo.atraso_medio_ms = soma_atraso / resumo.pacotes_rx * 1e3;
+    }
+    if (resumo.pacotes_rx > 1) {
+        resumo.jitter_medio_ms = soma_jitter / (resumo.pacotes_rx - 1) * 1e3;
+    }
+    return resumo;
+}
+
+inline std::string cabecalho_resumo_csv() {
+    return "fluxos,bytes_tx,bytes_rx,pacotes_tx,pacotes_rx,pacotes_perdidos,vazao_mbps,atraso_medio_ms,jitter_medio_ms,tempo_execucao_s,tempo_simulado_s,convergencia_s,bytes_controle";
+}
+
+inline void escrever_resumo_csv(std::ostream &saida, const ResumoExecucao &resumo) {
+    saida << resumo.fluxos << ',' << resumo.bytes_tx << ',' << resumo.bytes_rx << ','
+          << resumo.pacotes_tx << ',' << resumo.pacotes_rx << ',' << resumo.pacotes_perdidos << ','
+          << resumo.vazao_mbps << ',' << resumo.atraso_medio_ms << ',' << resumo.jitter_medio_ms << ','
+          << resumo.tempo_execucao_s << ',' << resumo.tempo_simulado_s << ',' << resumo.convergencia_s << ',' << resumo.bytes_controle;
+}
+
+/**
+ * Le os campos gravados por escrever_resumo_csv a partir de linha. Devolve
+ * false se faltarem campos.
+ */
+inline bool ler_resumo_csv(const std::string &linha, ResumoExecucao &resumo) {
+    std::istringstream entrada (linha);
+    char virgula;
+    entrada >> resumo.fluxos >> virgula >> resumo.bytes_tx >> virgula >> resumo.bytes_rx >> virgula
+            >> resumo.pacotes_tx >> virgula >> resumo.pacotes_rx >> virgula >> resumo.pacotes_perdidos >> virgula
+            >> resumo.vazao_mbps >> virgula >> resumo.atraso_medio_ms >> virgula >> resumo.jitter_medio_ms >> virgula
+            >> resumo.tempo_execucao_s >> virgula >> resumo.tempo_simulado_s >> virgula >> resumo.convergencia_s >> virgula
+            >> resumo.bytes_controle;
+    return !entrada.fail ();
+}
+
+#endif /* RESUMO_H */
@@ -0,0 +1,403 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Escolha do algoritmo de roteamento e medicao do seu custo:
+// - global: Ipv4GlobalRouting, tabelas calculadas antes da simulacao (sem
+//   trafego de controle e com convergencia instantanea);
+// - ecmp: como o global, mas dividindo os fluxos entre os caminhos de
+//   mesmo custo (ver multipercurso.h);
+// - rip: vetor de distancias (RIPv2, porta UDP 520);
+// - olsr: estado de enlace (OLSR, porta UDP 698).
+//
+// O MedidorControle soma os bytes de controle enviados em cada enlace e o
+// DetectorConvergencia consulta periodicamente a rota de cada noh para o
+// endereco principal de cada outro noh. A convergencia eh o ultimo instante
+// em que alguma dessas rotas mudou, desde que depois dele todas existam e
+// fiquem estaveis por uma janela de tempo.
+//
+
+#ifndef ROTEAMENTO_H
+#define ROTEAMENTO_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/olsr-helper.h"
+#include "ns3/rip-helper.h"
+#include "ns3/ipv4-list-routing-helper.h"
+#include "ns3/ipv4-static-routing-helper.h"
+
+#include "grafo_roteamento.h"
+#include "multipercurso.h"
+#include "topologia.h"
+
+static const uint16_t PORTA_RIP = 520;
+static const uint16_t PORTA_OLSR = 698;
+
+inline bool porta_de_controle(uint16_t porta) {
+    return porta == PORTA_RIP || porta == PORTA_OLSR;
+}
+
+/** RIP e OLSR trocam mensagens durante a simulacao; global e ecmp ja comecam com as tabelas prontas. */
+inline bool roteamento_dinamico(const std::string &roteamento) {
+    return roteamento == "rip" || roteamento == "olsr";
+}
+
+inline bool roteamento_valido(const std::string &roteamento) {
+    return roteamento == "global" || roteamento == "ecmp" || roteamento == "rip" || roteamento == "olsr";
+}
+
+/**
+ * Configura internet para instalar o protocolo escolhido. Precisa ser
+ * chamada antes de carregar_topologia, que instala a pilha nos nohs. Com
+ * rip e olsr o roteamento estatico fica na lista com prioridade menor, para
+ * as rotas locais.
+ */
+inline void configurar_roteamento(const std::string &roteamento, ns3::InternetStackHelper &internet) {
+    if (!roteamento_valido (roteamento)) {
+        NS_FATAL_ERROR ("Roteamento desconhecido: " << roteamento << " (use global, ecmp, rip ou olsr)");
+    }
+    if (roteamento == "global") {
+        return;
+    }
+    ns3::Ipv4StaticRoutingHelper estatico;
+    ns3::Ipv4ListRoutingHelper lista;
+    lista.Add (estatico, 0);
+    if (roteamento == "ecmp") {
+        // Abaixo do estatico, como o global na pilha padrao
+        RoteamentoMultipercursoHelper multipercurso;
+        lista.Add (multipercurso, -10);
+        internet.SetRoutingHelper (lista);
+    } else if (roteamento == "rip") {
+        ns3::RipHelper rip;
+        lista.Add (rip, 10);
+        internet.SetRoutingHelper (lista);
+    } else {
+        ns3::OlsrHelper olsr;
+        lista.Add (olsr, 10);
+        internet.SetRoutingHelper (lista);
+    }
+}
+
+struct ResumoCompactacao {
+    uint32_t hosts = 0;
+    uint64_t rotas_removidas = 0;
+};
+
+/**
+ * Troca a tabela do Ipv4GlobalRouting de cada host (noh com um unico
+ * enlace IP) por uma rota padrao para o vizinho. Todo caminho que sai do
+ * host passa por esse enlace, entao o encaminhamento nao muda, e a tabela
+ * do global tem uma entrada por sub-rede da topologia em cada noh. Deve
+ * ser chamada depois do PopulateRoutingTables.
+ */
+inline ResumoCompactacao compactar_rotas_dos_hosts(const Topologia &topologia) {
+    ResumoCompactacao resumo;
+    GrafoRoteamento grafo;
+    montar_grafo_roteamento (topologia, grafo);
+    uint32_t sistema = ns3::Simulator::GetSystemId ();
+    for (uint32_t i = 0; i < topologia.nos.size (); ++i) {
+        if (grafo.adjacencias[i].size () != 1 || topologia.nos[i]->GetSystemId () != sistema) {
+            continue;
+        }
+        ns3::Ptr<ns3::GlobalRouter> roteador = topologia.nos[i]->GetObject<ns3::GlobalRouter> ();
+        if (!roteador) {
+            continue;
+        }
+        ns3::Ptr<ns3::Ipv4GlobalRouting> global = roteador->GetRoutingProtocol ();
+        resumo.rotas_removidas += esvaziar_rotas (global);
+        const Adjacencia &saida = grafo.adjacencias[i][0];
+        global->AddNetworkRouteTo (ns3::Ipv4Address::GetZero (), ns3::Ipv4Mask::GetZero (), saida.gateway, saida.interface);
+        resumo.hosts++;
+    }
+    return resumo;
+}
+
+/**
+ * Bytes e pacotes IP de controle (RIP/OLSR) transmitidos em cada enlace,
+ * nos dois sentidos, contados no trace Tx do Ipv4L3Protocol. Com global e
+ * ecmp nao ha controle: os contadores ficam em 0 e o trace nao eh ligado,
+ * para nao pesar em cada pacote de dados.
+ */
+class MedidorControle {
+public:
+    void instalar (const Topologia &topologia, const std::string &roteamento) {
+        m_bytes.assign (topologia.enlaces.size (), 0);
+        m_pacotes.assign (topologia.enlaces.size (), 0);
+        m_enlace_da_interface.assign (topologia.nos.size (), std::vector<int32_t> ());
+        if (!roteamento_dinamico (roteamento)) {
+            return;
+        }
+
+        for (uint32_t i = 0; i < topologia.enlaces.size (); ++i) {
+            const Enlace &enlace = topologia.enlaces[i];
+            associar (topologia.nos[enlace.a], enlace.a, enlace.dispositivo_a, i);
+            associar (topologia.nos[enlace.b], enlace.b, enlace.dispositivo_b, i);
+        }
+        for (uint32_t i = 0; i < topologia.nos.size (); ++i) {
+            if (m_enlace_da_interface[i].empty ()) {
+                continue;
+            }
+            ns3::Ptr<ns3::Ipv4L3Protocol> ipv4 = topologia.nos[i]->GetObject<ns3::Ipv4L3Protocol> ();
+            ipv4->TraceConnectWithoutContext ("Tx", ns3::MakeBoundCallback (&MedidorControle::transmitido, this, i));
+        }
+    }
+
+    uint64_t bytes (uint32_t enlace) const {
+        return m_bytes[enlace];
+    }
+
+    uint64_t pacotes (uint32_t enlace) const {
+        return m_pacotes[enlace];
+    }
+
+    uint64_t bytes_total () const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < m_bytes.size (); ++i) {
+            total += m_bytes[i];
+        }
+        return total;
+    }
+
+    void escrever_csv (std::ostream &saida, const Topologia &topologia) const {
+        saida << "enlace,classe,bytes_controle,pacotes_controle" << std::endl;
+        for (size_t i = 0; i < topologia.enlaces.size (); ++i) {
+            const Enlace &enlace = topologia.enlaces[i];
+            saida << nome_do_enlace (topologia, enlace) << ',' << topologia.classes[enlace.classe].nome << ','
+                  << m_bytes[i] << ',' << m_pacotes[i] << std::endl;
+        }
+    }
+
+private:
+    void associar (ns3::Ptr<ns3::Node> no, uint32_t indice_no, ns3::Ptr<ns3::NetDevice> dispositivo, uint32_t enlace) {
+        ns3::Ptr<ns3::Ipv4> ipv4 = no->GetObject<ns3::Ipv4> ();
+        int32_t interface = ipv4->GetInterfaceForDevice (dispositivo);
+        if (interface < 0) {
+            return;
+        }
+        std::vector<int32_t> &enlaces = m_enlace_da_interface[indice_no];
+        if (enlaces.size () <= uint32_t (interface)) {
+            enlaces.resize (interface + 1, -1);
+        }
+        enlaces[interface] = enlace;
+    }
+
+    static void transmitido (MedidorControle *medidor, uint32_t no, ns3::Ptr<const ns3::Packet> pacote, ns3::Ptr<ns3::Ipv4> ipv4, uint32_t interface) {
+        const std::vector<int32_t> &enlaces = medidor->m_enlace_da_interface[no];
+        if (interface >= enlaces.size () || enlaces[interface] < 0) {
+            return;
+        }
+        ns3::Ipv4Header cabecalho;
+        uint32_t tamanho_ip = pacote->PeekHeader (cabecalho);
+        if (cabecalho.GetProtocol () != 17) {
+            return;
+        }
+        // Portas UDP logo depois do cabecalho IP, sem copiar o pacote
+        uint8_t bytes[64];
+        if (pacote->CopyData (bytes, tamanho_ip + 4) < tamanho_ip + 4) {
+            return;
+        }
+        uint16_t origem = (bytes[tamanho_ip] << 8) | bytes[tamanho_ip + 1];
+        uint16_t destino = (bytes[tamanho_ip + 2] << 8) | bytes[tamanho_ip + 3];
+        if (porta_de_controle (destino) || porta_de_controle (origem)) {
+            medidor->m_bytes[enlaces[interface]] += pacote->GetSize ();
+            medidor->m_pacotes[enlaces[interface]]++;
+        }
+    }
+
+    std::vector<uint64_t> m_bytes;
+    std::vector<uint64_t> m_pacotes;
+    // Para cada noh, o enlace de cada interface IP (-1 para loopback)
+    std::vector<std::vector<int32_t> > m_enlace_da_interface;
+};
+
+/**
+ * Bytes IP transmitidos em cada sentido de enlace (trace Tx do
+ * Ipv4L3Protocol), de todo o trafego.
+ */
+class MedidorCarga {
+public:
+    void instalar (const Topologia &topologia) {
+        m_bytes.assign (2 * topologia.enlaces.size (), 0);
+        m_sentido_da_interface.assign (topologia.nos.size (), std::vector<int32_t> ());
+        for (uint32_t i = 0; i < topologia.enlaces.size (); ++i) {
+            const Enlace &enlace = topologia.enlaces[i];
+            associar (topologia.nos[enlace.a], enlace.a, enlace.dispositivo_a, 2 * i);
+            associar (topologia.nos[enlace.b], enlace.b, enlace.dispositivo_b, 2 * i + 1);
+        }
+        for (uint32_t i = 0; i < topologia.nos.size (); ++i) {
+            if (m_sentido_da_interface[i].empty ()) {
+                continue;
+            }
+            ns3::Ptr<ns3::Ipv4L3Protocol> ipv4 = topologia.nos[i]->GetObject<ns3::Ipv4L3Protocol> ();
+            ipv4->TraceConnectWithoutContext ("Tx", ns3::MakeBoundCallback (&MedidorCarga::transmitido, this, i));
+        }
+    }
+
+    const std::vector<uint64_t> &bytes () const {
+        return m_bytes;
+    }
+
+    /** Uma linha por sentido: nome, bytes e taxa do enlace (bit/s). */
+    void escrever (std::ostream &saida, const Topologia &topologia) const {
+        for (uint32_t s = 0; s < m_bytes.size (); ++s) {
+            const ClasseEnlace &classe = topologia.classes[topologia.enlaces[s / 2].classe];
+            saida << nome_do_sentido (topologia, s) << ' ' << m_bytes[s] << ' ' << ns3::DataRate (classe.taxa).GetBitRate () << std::endl;
+        }
+    }
+
+private:
+    void associar (ns3::Ptr<ns3::Node> no, uint32_t indice_no, ns3::Ptr<ns3::NetDevice> dispositivo, uint32_t sentido) {
+        int32_t interface = no->GetObject<ns3::Ipv4> ()->GetInterfaceForDevice (dispositivo);
+        if (interface < 0) {
+            return;
+        }
+        std::vector<int32_t> &sentidos = m_sentido_da_interface[indice_no];
+        if (sentidos.size () <= uint32_t (interface)) {
+            sentidos.resize (interface + 1, -1);
+        }
+        sentidos[interface] = sentido;
+    }
+
+    static void transmitido (MedidorCarga *medidor, uint32_t no, ns3::Ptr<const ns3::Packet> pacote, ns3::Ptr<ns3::Ipv4> ipv4, uint32_t interface) {
+        const std::vector<int32_t> &sentidos = medidor->m_sentido_da_interface[no];
+        if (interface < sentidos.size () && sentidos[interface] >= 0) {
+            medidor->m_bytes[sentidos[interface]] += pacote->GetSize ();
+        }
+    }
+
+    std::vector<uint64_t> m_bytes;
+    // Para cada noh, o sentido de enlace de cada interface IP (-1 para loopback)
+    std::vector<std::vector<int32_t> > m_sentido_da_interface;
+};
+
+struct CargaSentido {
+    std::string sentido;
+    uint64_t bytes;
+    double capacidade_bps;
+};
+
+/** Le as linhas gravadas por MedidorCarga::escrever ate o fim da entrada. */
+inline std::vector<CargaSentido> ler_carga(std::istream &entrada) {
+    std::vector<CargaSentido> cargas;
+    CargaSentido carga;
+    while (entrada >> carga.sentido >> carga.bytes >> carga.capacidade_bps) {
+        cargas.push_back (carga);
+    }
+    return cargas;
+}
+
+/**
+ * Acompanha as rotas de todos os nohs (locais) para os enderecos principais
+ * de todos os outros, a cada periodo, ate que fiquem completas e estaveis
+ * por uma janela, ou ate o fim da simulacao. Cada verificacao consulta
+ * todos os pares, entao so eh usado com roteamento_dinamico.
+ */
+class DetectorConvergencia {
+public:
+    DetectorConvergencia (const Topologia &topologia, ns3::Time periodo, ns3::Time janela)
+        : m_topologia (topologia), m_periodo (periodo), m_janela (janela) {
+    }
+
+    void iniciar () {
+        ns3::Simulator::ScheduleNow (&DetectorConvergencia::verificar, this);
+    }
+
+    bool convergiu () const {
+        return m_convergiu;
+    }
+
+    /** Ultima mudanca de rota antes da estabilidade, em s. */
+    double tempo_convergencia () const {
+        return m_ultima_mudanca.GetSeconds ();
+    }
+
+    /** Primeiro instante em que todos os pares tinham rota (-1 se nunca). */
+    double tempo_rotas_completas () const {
+        return m_rotas_completas;
+    }
+
+    uint64_t pares_sem_rota () const {
+        return m_pares_sem_rota;
+    }
+
+private:
+    void verificar () {
+        uint64_t assinatura = 1469598103934665603ULL;
+        uint64_t sem_rota = 0;
+        ns3::Ipv4Header cabecalho;
+        ns3::Socket::SocketErrno erro;
+
+        for (uint32_t i = 0; i < m_topologia.nos.size (); ++i) {
+            ns3::Ptr<ns3::Node> no = m_topologia.nos[i];
+            if (no->GetSystemId () != ns3::Simulator::GetSystemId ()) {
+                continue;
+            }
+            ns3::Ptr<ns3::Ipv4RoutingProtocol> roteamento = no->GetObject<ns3::Ipv4> ()->GetRoutingProtocol ();
+            for (uint32_t j = 0; j < m_topologia.nos.size (); ++j) {
+                ns3::Ipv4Address destino = m_topologia.endereco_principal[j];
+                if (i == j || destino == ns3::Ipv4Address ()) {
+                    continue;
+                }
+                cabecalho.SetDestination (destino);
+                ns3::Ptr<ns3::Ipv4Route> rota = roteamento->RouteOutput (ns3::Ptr<ns3::Packet> (), cabecalho, ns3::Ptr<ns3::NetDevice> (), erro);
+                uint64_t valor = 0;
+                if (rota) {
+                    valor = (uint64_t (rota->GetGateway ().Get ()) << 32) | rota->GetOutputDevice ()->GetIfIndex ();
+                } else {
+                    sem_rota++;
+                }
+                assinatura = (assinatura ^ valor) * 1099511628211ULL;
+            }
+        }
+
+        ns3::Time agora = ns3::Simulator::Now ();
+        if (!m_verificado || assinatura != m_assinatura) {
+            m_assinatura = assinatura;
+            m_ultima_mudanca = agora;
+            m_verificado = true;
+        }
+        m_pares_sem_rota = sem_rota;
+        if (sem_rota == 0 && m_rotas_completas < 0) {
+            m_rotas_completas = agora.GetSeconds ();
+        }
+        if (sem_rota == 0 && agora - m_ultima_mudanca >= m_janela) {
+            m_convergiu = true;
+            return;
+        }
+        ns3::Simulator::Schedule (m_periodo, &DetectorConvergencia::verificar, this);
+    }
+
+    const Topologia &m_topologia;
+    ns3::Time m_periodo;
+    ns3::Time m_janela;
+
+    bool m_verificado = false;
+    bool m_convergiu = false;
+    uint64_t m_assinatura = 0;
+    uint64_t m_pares_sem_rota = 0;
+    ns3::Time m_ultima_mudanca;
+    double m_rotas_completas = -1;
+};
+
+#endif /* ROTEAMENTO_H */
@@ -0,0 +1,353 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Series temporais por fluxo da matriz: bytes e pacotes recebidos, soma dos
+// atrasos e pacotes perdidos em cada faixa de tempo (ex. 100 ms).
+//
+// A recepcao eh medida no LocalDeliver do destino, como na SondaFluxos, e
+// nao no Rx do PacketSink: no TCP o segmento entregue a aplicacao eh
+// remontado e perde as etiquetas, e o receptor nao sabe de qual origem veio
+// cada pacote quando varios fluxos chegam na mesma porta. O envio marca o
+// pacote com o indice do fluxo e o instante (EtiquetaSerie), entao os
+// descartes nas disciplinas e nas filas dos dispositivos, que nao veem a
+// 5-tupla, sao atribuidos pelo indice. Os descartes da camada IP (sem rota,
+// TTL) sao localizados pelo cabecalho.
+//
+// Os fluxos sao os da matriz, conhecidos antes da simulacao, e a tabela eh
+// a mesma em todos os processos MPI, entao o indice vale de um processo
+// para outro. As colunas (fluxos x faixas, a serie de cada fluxo contigua)
+// sao alocadas na instalacao para TempoLimite inteiro; os traces so somam.
+// Cada processo grava o que viu no fim, em binario:
+//
+//   "SERI", versao (u32), largura_ns (u64), faixas (u32), fluxos (u32), e
+//   para cada fluxo: origem e destino (u16 + caracteres), protocolo (u8,
+//   6 ou 17) e porta (u16); depois as colunas, cada uma com fluxos x faixas
+//   valores, fluxo a fluxo: bytes_rx (u64), pacotes_rx (u32),
+//   soma_atraso_ns (u64) e perdas (u32). faixas vai so ate a ultima com
+//   algum registro. O atraso medio da faixa eh soma_atraso_ns / pacotes_rx.
+//   Inteiros na ordem de bytes da maquina.
+//
+
+#ifndef SERIES_FLUXOS_H
+#define SERIES_FLUXOS_H
+
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "matriz_fluxos.h"
+#include "topologia.h"
+
+class EtiquetaSerie : public ns3::Tag {
+public:
+    static ns3::TypeId GetTypeId (void) {
+        static ns3::TypeId tid = ns3::TypeId ("EtiquetaSerie")
+            .SetParent<ns3::Tag> ()
+            .AddConstructor<EtiquetaSerie> ();
+        return tid;
+    }
+    virtual ns3::TypeId GetInstanceTypeId (void) const {
+        return GetTypeId ();
+    }
+    virtual uint32_t GetSerializedSize (void) const {
+        return 12;
+    }
+    virtual void Serialize (ns3::TagBuffer buffer) const {
+        buffer.WriteU32 (fluxo);
+        buffer.WriteU64 (envio);
+    }
+    virtual void Deserialize (ns3::TagBuffer buffer) {
+        fluxo = buffer.ReadU32 ();
+        envio = buffer.ReadU64 ();
+    }
+    virtual void Print (std::ostream &saida) const {
+        saida << "fluxo=" << fluxo << " envio=" << envio;
+    }
+
+    uint32_t fluxo = 0;
+    /** Instante de envio, em ns. */
+    uint64_t envio = 0;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (EtiquetaSerie);
+
+class SeriesFluxos {
+public:
+    SeriesFluxos (const Topologia &topologia, const std::vector<FluxoMatriz> &fluxos, ns3::Time largura, ns3::Time duracao)
+        : m_topologia (topologia), m_largura_ns (largura.GetNanoSeconds ()) {
+        if (m_largura_ns <= 0) {
+            NS_FATAL_ERROR ("Series: largura das faixas precisa ser positiva");
+        }
+        m_faixas = uint32_t ((duracao.GetNanoSeconds () + m_largura_ns - 1) / m_largura_ns) + 1;
+
+        for (uint32_t i = 0; i < topologia.enlaces.size (); ++i) {
+            const Enlace &enlace = topologia.enlaces[i];
+            m_no_do_endereco[enlace.ip_a.Get ()] = enlace.a;
+            m_no_do_endereco[enlace.ip_b.Get ()] = enlace.b;
+        }
+        // Fluxos com os mesmos extremos, protocolo e porta sao indistinguiveis
+        // na rede e ficam na mesma serie
+        for (size_t i = 0; i < fluxos.size (); ++i) {
+            const FluxoMatriz &fluxo = fluxos[i];
+            uint64_t chave = chave_fluxo (fluxo.origem, fluxo.destino, fluxo.udp ? 17 : 6, fluxo.porta);
+            if (m_indice.find (chave) == m_indice.end ()) {
+                m_indice[chave] = m_series.size ();
+                m_series.push_back (fluxo);
+            }
+        }
+
+        size_t celulas = size_t (m_series.size ()) * m_faixas;
+        m_bytes_rx.assign (celulas, 0);
+        m_pacotes_rx.assign (celulas, 0);
+        m_soma_atraso.assign (celulas, 0);
+        m_perdas.assign (celulas, 0);
+    }
+
+    /** Conecta os traces da camada IP e das filas dos nohs locais. */
+    void instalar () {
+        uint32_t sistema = ns3::Simulator::GetSystemId ();
+        for (size_t i = 0; i < m_topologia.nos.size (); ++i) {
+            if (m_topologia.nos[i]->GetSystemId () != sistema) {
+                continue;
+            }
+            ns3::Ptr<ns3::Ipv4L3Protocol> ipv4 = m_topologia.nos[i]->GetObject<ns3::Ipv4L3Protocol> ();
+            ipv4->TraceConnectWithoutContext ("SendOutgoing", ns3::MakeCallback (&SeriesFluxos::enviado, this));
+            ipv4->TraceConnectWithoutContext ("LocalDeliver", ns3::MakeCallback (&SeriesFluxos::entregue, this));
+            ipv4->TraceConnectWithoutContext ("Drop", ns3::MakeCallback (&SeriesFluxos::descartado_ip, this));
+        }
+        for (uint32_t i = 0; i < m_topologia.enlaces.size (); ++i) {
+            const Enlace &enlace = m_topologia.enlaces[i];
+            if (m_topologia.nos[enlace.a]->GetSystemId () == sistema) {
+                conectar_filas (enlace.a, enlace.dispositivo_a);
+            }
+            if (m_topologia.nos[enlace.b]->GetSystemId () == sistema) {
+                conectar_filas (enlace.b, enlace.dispositivo_b);
+            }
+        }
+    }
+
+    uint32_t fluxos () const {
+        return m_series.size ();
+    }
+
+    uint32_t faixas () const {
+        return m_faixas;
+    }
+
+    uint64_t bytes_reservados () const {
+        return uint64_t (m_bytes_rx.size ()) * (sizeof (uint64_t) + sizeof (uint32_t) + sizeof (uint64_t) + sizeof (uint32_t));
+    }
+
+    bool gravar (const std::string &arquivo) const {
+        std::ofstream saida (arquivo.c_str (), std::ios::out | std::ios::binary);
+        if (!saida) {
+            return false;
+        }
+        uint32_t versao = 1;
+        uint64_t largura_ns = m_largura_ns;
+        uint32_t faixas = faixas_usadas ();
+        uint32_t quantidade = m_series.size ();
+        saida.write ("SERI", 4);
+        escrever (saida, versao);
+        escrever (saida, largura_ns);
+        escrever (saida, faixas);
+        escrever (saida, quantidade);
+        for (size_t i = 0; i < m_series.size (); ++i) {
+            const FluxoMatriz &fluxo = m_series[i];
+            uint8_t protocolo = fluxo.udp ? 17 : 6;
+            escrever_texto (saida, m_topologia.nomes[fluxo.origem]);
+            escrever_texto (saida, m_topologia.nomes[fluxo.destino]);
+            escrever (saida, protocolo);
+            escrever (saida, fluxo.porta);
+        }
+        coluna (saida, m_bytes_rx, faixas);
+        coluna (saida, m_pacotes_rx, faixas);
+        coluna (saida, m_soma_atraso, faixas);
+        coluna (saida, m_perdas, faixas);
+        return bool (saida);
+    }
+
+    void imprimir (std::ostream &saida) const {
+        uint64_t perdas = 0;
+        for (size_t i = 0; i < m_perdas.size (); ++i) {
+            perdas += m_perdas[i];
+        }
+        saida << "Series: " << m_series.size () << " fluxos x " << faixas_usadas () << " faixas de "
+              << m_largura_ns / 1e6 << " ms (" << bytes_reservados () / 1048576.0 << " MB reservados), "
+              << perdas << " perdas";
+        if (m_fora_das_faixas > 0) {
+            saida << ", " << m_fora_das_faixas << " registros fora das faixas";
+        }
+        saida << std::endl;
+    }
+
+private:
+    static uint64_t chave_fluxo (uint32_t origem, uint32_t destino, uint8_t protocolo, uint16_t porta) {
+        return (uint64_t (origem) << 40) | (uint64_t (destino) << 17) | (uint64_t (protocolo == 17) << 16) | porta;
+    }
+
+    /** Fluxo do pacote pelo cabecalho IP e pela porta de destino. */
+    bool localizar (const ns3::Ipv4Header &cabecalho, ns3::Ptr<const ns3::Packet> pacote, uint32_t &indice) const {
+        uint8_t protocolo = cabecalho.GetProtocol ();
+        if ((protocolo != 6 && protocolo != 17) || pacote->GetSize () < 4) {
+            return false;
+        }
+        std::unordered_map<uint32_t, uint32_t>::const_iterator origem = m_no_do_endereco.find (cabecalho.GetSource ().Get ());
+        std::unordered_map<uint32_t, uint32_t>::const_iterator destino = m_no_do_endereco.find (cabecalho.GetDestination ().Get ());
+        if (origem == m_no_do_endereco.end () || destino == m_no_do_endereco.end ()) {
+            return false;
+        }
+        uint8_t portas[4];
+        pacote->CopyData (portas, 4);
+        uint16_t porta_destino = (portas[2] << 8) | portas[3];
+        std::unordered_map<uint64_t, uint32_t>::const_iterator it =
+            m_indice.find (chave_fluxo (origem->second, destino->second, protocolo, porta_destino));
+        if (it == m_indice.end ()) {
+            return false;
+        }
+        indice = it->second;
+        return true;
+    }
+
+    /** Celula do fluxo na faixa de agora; -1 depois da ultima faixa. */
+    int64_t celula (uint32_t fluxo) {
+        uint64_t faixa = ns3::Simulator::Now ().GetNanoSeconds () / m_largura_ns;
+        if (faixa >= m_faixas) {
+            m_fora_das_faixas++;
+            return -1;
+        }
+        return int64_t (fluxo) * m_faixas + faixa;
+    }
+
+    void perdido (uint32_t fluxo) {
+        int64_t k = celula (fluxo);
+        if (k >= 0) {
+            m_perdas[k]++;
+        }
+    }
+
+    void enviado (const ns3::Ipv4Header &cabecalho, ns3::Ptr<const ns3::Packet> pacote, uint32_t interface) {
+        uint32_t indice;
+        if (!localizar (cabecalho, pacote, indice)) {
+            return;
+        }
+        EtiquetaSerie etiqueta;
+        etiqueta.fluxo = indice;
+        etiqueta.envio = ns3::Simulator::Now ().GetNanoSeconds ();
+        pacote->AddPacketTag (etiqueta);
+    }
+
+    void entregue (const ns3::Ipv4Header &cabecalho, ns3::Ptr<const ns3::Packet> pacote, uint32_t interface) {
+        EtiquetaSerie etiqueta;
+        if (!pacote->PeekPacketTag (etiqueta) || etiqueta.fluxo >= m_series.size ()) {
+            return;
+        }
+        int64_t k = celula (etiqueta.fluxo);
+        if (k < 0) {
+            return;
+        }
+        m_bytes_rx[k] += pacote->GetSize () + cabecalho.GetSerializedSize ();
+        m_pacotes_rx[k]++;
+        m_soma_atraso[k] += ns3::Simulator::Now ().GetNanoSeconds () - etiqueta.envio;
+    }
+
+    void descartado_ip (const ns3::Ipv4Header &cabecalho, ns3::Ptr<const ns3::Packet> pacote,
+                        ns3::Ipv4L3Protocol::DropReason motivo, ns3::Ptr<ns3::Ipv4> ipv4, uint32_t interface) {
+        uint32_t indice;
+        if (localizar (cabecalho, pacote, indice)) {
+            perdido (indice);
+        }
+    }
+
+    void descartado_pacote (ns3::Ptr<const ns3::Packet> pacote) {
+        EtiquetaSerie etiqueta;
+        if (pacote->PeekPacketTag (etiqueta) && etiqueta.fluxo < m_series.size ()) {
+            perdido (etiqueta.fluxo);
+        }
+    }
+
+    void descartado_disciplina (ns3::Ptr<const ns3::QueueDiscItem> item, const char *motivo) {
+        descartado_pacote (item->GetPacket ());
+    }
+
+    void conectar_filas (uint32_t no, ns3::Ptr<ns3::NetDevice> dispositivo) {
+        ns3::Ptr<ns3::TrafficControlLayer> controle = m_topologia.nos[no]->GetObject<ns3::TrafficControlLayer> ();
+        ns3::Ptr<ns3::QueueDisc> disciplina = controle ? controle->GetRootQueueDiscOnDevice (dispositivo) : ns3::Ptr<ns3::QueueDisc> ();
+        if (disciplina) {
+            disciplina->TraceConnectWithoutContext ("DropBeforeEnqueue", ns3::MakeCallback (&SeriesFluxos::descartado_disciplina, this));
+            disciplina->TraceConnectWithoutContext ("DropAfterDequeue", ns3::MakeCallback (&SeriesFluxos::descartado_disciplina, this));
+        }
+        ns3::Ptr<ns3::PointToPointNetDevice> p2p = ns3::DynamicCast<ns3::PointToPointNetDevice> (dispositivo);
+        if (p2p) {
+            p2p->GetQueue ()->TraceConnectWithoutContext ("Drop", ns3::MakeCallback (&SeriesFluxos::descartado_pacote, this));
+        }
+    }
+
+    /** Faixas ate a ultima com algum registro em qualquer fluxo. */
+    uint32_t faixas_usadas () const {
+        uint32_t usadas = 0;
+        for (size_t k = 0; k < m_pacotes_rx.size (); ++k) {
+            if ((m_pacotes_rx[k] > 0 || m_perdas[k] > 0) && k % m_faixas + 1 > usadas) {
+                usadas = k % m_faixas + 1;
+            }
+        }
+        return usadas;
+    }
+
+    template <typename T>
+    static void escrever (std::ostream &saida, const T &valor) {
+        saida.write (reinterpret_cast<const char *> (&valor), sizeof (valor));
+    }
+
+    static void escrever_texto (std::ostream &saida, const std::string &texto) {
+        uint16_t tamanho = texto.size ();
+        escrever (saida, tamanho);
+        saida.write (texto.data (), tamanho);
+    }
+
+    /** As primeiras faixas da serie de cada fluxo, fluxo a fluxo. */
+    template <typename T>
+    void coluna (std::ostream &saida, const std::vector<T> &valores, uint32_t faixas) const {
+        for (size_t i = 0; i < m_series.size () && faixas > 0; ++i) {
+            saida.write (reinterpret_cast<const char *> (&valores[i * m_faixas]), faixas * sizeof (T));
+        }
+    }
+
+    const Topologia &m_topologia;
+    int64_t m_largura_ns;
+    uint32_t m_faixas;
+    std::unordered_map<uint32_t, uint32_t> m_no_do_endereco;
+    std::unordered_map<uint64_t, uint32_t> m_indice;
+    std::vector<FluxoMatriz> m_series;
+    std::vector<uint64_t> m_bytes_rx;
+    std::vector<uint32_t> m_pacotes_rx;
+    std::vector<uint64_t> m_soma_atraso;
+    std::vector<uint32_t> m_perdas;
+    uint64_t m_fora_das_faixas = 0;
+};
+
+#endif /* SERIES_FLUXOS_H */
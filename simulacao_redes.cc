@@ -34,13 +34,21 @@
 // - DropTail queues 
 // - Tracing of queues and packet receptions to file "simple-global-routing.tr"
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <cassert>
 
 #include <list> 
+#include <cstdlib>
+#include <memory>
+#include <new>
 #include <iterator>
+#include <set>
+#include <sstream>
+
+#include <malloc.h>
 
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
@@ -57,520 +65,2007 @@
 #include "ns3/ipv4-static-routing-helper.h"
 #include "ns3/ipv4-routing-table-entry.h"
 
+#ifdef NS3_MPI
+#include <mpi.h>
+#include "ns3/mpi-interface.h"
+#endif
+
+#include "benchmark.h"
+#include "cache_rotas.h"
+#include "cenarios.h"
+#include "escalonador.h"
+#include "estimativa.h"
+#include "falhas.h"
+#include "gerador_topologia.h"
+#include "hibrido.h"
+#include "instantaneos.h"
+#include "lote.h"
+#include "matriz_fluxos.h"
+#include "medicao.h"
+#include "monitoramento.h"
+#include "multicast.h"
+#include "parada.h"
+#include "perfil.h"
+#include "replicacoes.h"
+#include "resumo.h"
+#include "roteamento.h"
+#include "series_fluxos.h"
+#include "sonda_fluxos.h"
+#include "telemetria_filas.h"
+#include "topologia.h"
+#include "trace_trafego.h"
+#include "varredura.h"
+#include "verificacao.h"
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("SimpleGlobalRoutingExample");
 
+// Conta as alocacoes e os bytes em uso de todo o processo (inclusive as das
+// bibliotecas do ns-3) para o perfil por fase e a memoria por noh e por
+// enlace. new[] e delete[] passam por aqui.
+void *operator new (std::size_t tamanho) {
+    contador_alocacoes ().fetch_add (1, std::memory_order_relaxed);
+    void *memoria = std::malloc (tamanho > 0 ? tamanho : 1);
+    if (memoria == 0) {
+        throw std::bad_alloc ();
+    }
+    contador_bytes ().fetch_add (malloc_usable_size (memoria), std::memory_order_relaxed);
+    return memoria;
+}
+
+void operator delete (void *memoria) noexcept {
+    if (memoria) {
+        contador_bytes ().fetch_sub (malloc_usable_size (memoria), std::memory_order_relaxed);
+    }
+    std::free (memoria);
+}
+
+void operator delete (void *memoria, std::size_t) noexcept {
+    operator delete (memoria);
+}
+
 /**
- * Cria e instala no noh origem uma aplicacao que envia pacotes de tamanho packetSize a
- * a uma taxa de dataRate para a aplicacao no noh de endereco ip_destino que  esta
- * escutando na porta porta, durante o tempo tempo_inicio ate o tempo_fim.
+ * Na simulacao distribuida cada processo instala aplicacoes e sondas apenas
+ * nos nohs que ficaram com ele. Na sequencial todos os nohs sao locais.
  */
-void aplicacao_enviadora(std::string protocol, Time tempo_inicio, Time tempo_fim, Ptr<Node> origem, Ipv4Address ip_destino, DataRate dataRate, uint32_t packetSize, uint16_t porta) {
-    
-    OnOffHelper onoff (protocol, 
-                 Address (InetSocketAddress (ip_destino, porta)));
-    onoff.SetConstantRate (dataRate, packetSize);
-    ApplicationContainer apps = onoff.Install (origem);
-    apps.Start (tempo_inicio);
-    apps.Stop (tempo_fim);              
+bool no_local(Ptr<Node> no) {
+    return no->GetSystemId () == Simulator::GetSystemId ();
 }
 
 /**
- * Cria no e instala no noh receptor uma aplicacao receptora de pacotes que chegam na porta indicada.
- * Inicia no tempo tempo_inicio e termina no tempo tempo_fim.
+ * Cria quantidade fluxos entre pares aleatorios de hosts (nohs com um unico
+ * enlace), de regioes diferentes quando houver mais de uma. Usado nas
+ * topologias geradas, que nao possuem os nohs das simulacoes fixas. Todos
+ * os fluxos usam a mesma porta, entao cada host de destino tem um so
+ * receptor.
  */
-void aplicacao_receptora(std::string protocol, Time tempo_inicio, Time tempo_fim, Ptr<Node> receptor, uint16_t porta) {
-    PacketSinkHelper sink (protocol,
-                         Address (InetSocketAddress (Ipv4Address::GetAny (), porta)));
-    ApplicationContainer apps = sink.Install (receptor);
-    apps.Start (tempo_inicio);
-    apps.Stop (tempo_fim);
+void fluxos_aleatorios(const Topologia &topologia, uint32_t quantidade, double inicio, double fim, DataRate dataRate, uint32_t packetSize, std::vector<FluxoMatriz> &fluxos) {
+    std::vector<uint32_t> grau (topologia.nos.size (), 0);
+    for (size_t i = 0; i < topologia.enlaces.size (); ++i) {
+        grau[topologia.enlaces[i].a]++;
+        grau[topologia.enlaces[i].b]++;
+    }
+
+    std::vector<uint32_t> hosts;
+    std::set<uint32_t> regioes;
+    for (uint32_t i = 0; i < topologia.nos.size (); ++i) {
+        if (grau[i] == 1 && topologia.endereco_principal[i] != Ipv4Address ()) {
+            hosts.push_back (i);
+            regioes.insert (topologia.regiao_do_no[i]);
+        }
+    }
+    if (hosts.size () < 2) {
+        NS_FATAL_ERROR ("A topologia precisa de pelo menos dois hosts para gerar fluxos");
+    }
+    bool entre_regioes = regioes.size () > 1;
+
+    Ptr<UniformRandomVariable> aleatorio = CreateObject<UniformRandomVariable> ();
+    for (uint32_t i = 0; i < quantidade; ++i) {
+        uint32_t origem = hosts[aleatorio->GetInteger (0, hosts.size () - 1)];
+        uint32_t destino;
+        do {
+            destino = hosts[aleatorio->GetInteger (0, hosts.size () - 1)];
+        } while (destino == origem || (entre_regioes && topologia.regiao_do_no[destino] == topologia.regiao_do_no[origem]));
+
+        FluxoMatriz fluxo = { origem, destino, false, dataRate, packetSize, inicio, fim, 10, false };
+        fluxos.push_back (fluxo);
+    }
 }
 
 /**
- * Criar uma aplicacao de envio de mensagem e outra recebimento nos nohs indicados
- * como origem e destino, respectivamente. Utiliza a porta indicada.
+ * Topologia usada quando nenhum arquivo eh passado em --Topologia: nucleo
+ * global (G1-G2-G3), America do Sul (L1, L2, S1-S4) e America do Norte
+ * (L3-L5, N1-N8). Formato descrito em topologia.h.
  */
-void simular_fluxo(std::string protocol, Time tempo_inicio, Time tempo_fim, Ptr<Node> origem, Ipv4Address ip_destino, Ptr<Node> receptor, DataRate dataRate, uint32_t packetSize, uint16_t porta) {
-    aplicacao_enviadora(protocol, tempo_inicio, tempo_fim, origem, ip_destino, dataRate, packetSize, porta);
-    aplicacao_receptora(protocol, tempo_inicio, tempo_fim, receptor, porta);
-}
+static const char *TOPOLOGIA_PADRAO =
+    "# classe  nome            taxa     atraso  fila\n"
+    "classe    global_20ms     100Mbps  20ms    global\n"
+    "classe    global_100ms    100Mbps  100ms   global\n"
+    "classe    acesso_sul      5Mbps    10ms    comum\n"
+    "classe    regional_sul    20Mbps   20ms    comum\n"
+    "classe    regional_norte  20Mbps   20ms    comum\n"
+    "classe    L3_G3           50Mbps   40ms    comum\n"
+    "classe    L3_L5           100Mbps  40ms    comum\n"
+    "classe    acesso_norte    10Mbps   5ms     comum\n"
+    "\n"
+    "# Global\n"
+    "no G1 global\n"
+    "no G2 global\n"
+    "no G3 global\n"
+    "\n"
+    "# America do Sul\n"
+    "no L1 america_do_sul\n"
+    "no S1 america_do_sul\n"
+    "no S2 america_do_sul\n"
+    "no S3 america_do_sul\n"
+    "no L2 america_do_sul\n"
+    "no S4 america_do_sul\n"
+    "\n"
+    "# America do Norte\n"
+    "no L3 america_do_norte\n"
+    "no N1 america_do_norte\n"
+    "no N2 america_do_norte\n"
+    "no N3 america_do_norte\n"
+    "no L4 america_do_norte\n"
+    "no N4 america_do_norte\n"
+    "no N5 america_do_norte\n"
+    "no N6 america_do_norte\n"
+    "no L5 america_do_norte\n"
+    "no N7 america_do_norte\n"
+    "no N8 america_do_norte\n"
+    "\n"
+    "enlace G1 G2 global_20ms    10.0.1.0/24\n"
+    "enlace G2 G3 global_100ms   10.0.2.0/24\n"
+    "\n"
+    "enlace S1 L1 acesso_sul     10.55.4.0/24\n"
+    "enlace S2 L1 acesso_sul     10.55.2.0/24\n"
+    "enlace S3 L1 acesso_sul     10.55.3.0/24\n"
+    "enlace S4 L2 acesso_sul     10.55.7.0/24\n"
+    "enlace L1 G2 regional_sul   10.55.1.0/24\n"
+    "enlace L2 G1 regional_sul   10.55.5.0/24\n"
+    "enlace L1 L2 regional_sul   10.55.6.0/24\n"
+    "\n"
+    "# L3_G3 nunca recebeu endereco IP na montagem original; L3 sai pelo L4/L5\n"
+    "enlace L3 G3 L3_G3          -\n"
+    "enlace L3 L5 L3_L5          10.1.10.0/24\n"
+    "enlace L3 L4 regional_norte 10.1.4.0/24\n"
+    "enlace L4 G3 regional_norte 10.1.1.0/24\n"
+    "enlace N1 L3 acesso_norte   10.1.7.0/24\n"
+    "enlace N2 L3 acesso_norte   10.1.8.0/24\n"
+    "enlace N3 L3 acesso_norte   10.1.9.0/24\n"
+    "enlace N4 L4 acesso_norte   10.1.3.0/24\n"
+    "enlace N5 L4 acesso_norte   10.1.5.0/24\n"
+    "enlace N6 L4 acesso_norte   10.1.2.0/24\n"
+    "enlace N7 L5 acesso_norte   10.1.11.0/24\n"
+    "enlace N8 L5 acesso_norte   10.1.12.0/24\n"
+    "enlace L5 G3 acesso_norte   10.1.13.0/24\n";
+
+/**
+ * Opcoes de uma execucao, lidas da linha de comando.
+ */
+struct Parametros {
+    bool enableFlowMonitor = true;
+    // FlowMonitor em todos os nohs ou so nos extremos dos fluxos
+    std::string monitoramento = "todos";
+    uint32_t amostragem_atraso = 0;
+    double largura_histograma_ms = 1.0;
+    bool comparar_monitoramento = false;
+    std::string resultado_monitoramento = "monitoramento.csv";
+    std::string arquivo_topologia = "";
+    bool relatorio = true;
+    // Sem IPv6, rota padrao nos hosts (global) e FlowMonitor so nos extremos
+    bool enxuto = false;
+
+    bool gerar = false;
+    ParametrosGerador gerador;
+    std::string salvar_topologia = "";
+    uint32_t fluxos_gerados = 10;
+
+    std::string cenario = "simulacao_08";
+    std::string saida = "";
+    double tempo_fim = 60.0;
+    std::string matriz_fluxos = "";
+
+    // Fluxos dos cenarios e das topologias geradas
+    std::string taxa_fluxos = "4Mbps";
+    uint32_t tamanho_pacote = 1024;
+    // Filas, disciplina e classes de enlace; limiares do RED (0 mantem o padrao)
+    OpcoesTopologia opcoes_topologia;
+    double red_min_th = 0;
+    double red_max_th = 0;
+
+    // Modo hibrido: fluxos de fundo como carga fluida
+    bool hibrido = false;
+    double fracao_fundo = 0;
+    bool comparar_hibrido = false;
+    std::string resultado_hibrido = "hibrido.csv";
+    // Usado pela comparacao: arquivo onde a execucao grava os fluxos de frente
+    std::string tabela_frente = "";
+
+    // Grupos multicast; com multicast_unicast cada grupo vira um fluxo por membro
+    std::string multicast = "";
+    bool multicast_unicast = false;
+    bool comparar_multicast = false;
+    std::string resultado_multicast = "multicast.csv";
+    // Usado pela comparacao: arquivo onde a execucao grava a carga dos enlaces
+    std::string tabela_carga = "";
+
+    // Trace de pacotes reproduzido (ver trace_trafego.h)
+    std::string trace = "";
+    double inicio_trace = 0;
+    double lote_trace_ms = 10;
+    uint32_t janela_trace_mb = 64;
+    std::string importar_pcap = "";
+    std::string mapa_enderecos = "";
+
+    // Verificacao estatica das rotas (tabelas ou grafo), sem simular; tabelas
+    // so com global e ecmp, pois as do rip e do olsr so existem na simulacao
+    std::string verificar = "";
+
+    // Estimativa max-min da vazao, sem simular
+    bool estimar = false;
+    std::string ranking_estimativa = "";
+
+    bool parada_automatica = true;
+    double tempo_limite = 200.0;
+    OpcoesParada parada;
+
+    std::string roteamento = "global";
+    // Diretorio do cache das tabelas do global (vazio desliga)
+    std::string cache_rotas = "";
+    bool verificar_cache = false;
+    OpcoesMultipercurso multipercurso;
+    bool comparar_ecmp = false;
+    std::string resultado_ecmp = "ecmp.csv";
+    double periodo_convergencia = 0.1;
+    double janela_convergencia = 10.0;
+
+    std::string falhas = "";
+    std::string arquivo_falhas = "";
+    bool recalculo_completo = false;
+
+    double instantaneos_ms = 0;
+    std::string formato_instantaneos = "csv";
+    std::string arquivo_instantaneos = "";
+    double filas_ms = 0;
+    uint32_t capacidade_filas = 4096;
+    std::string arquivo_filas = "";
+    double series_ms = 0;
+    std::string arquivo_series = "";
+
+    bool mpi = false;
+    std::string tabela_fluxos = "";
+    double tempo_sequencial = 0;
+
+    std::string perfil = "";
+    bool benchmark = false;
+    std::string resultado_benchmark = "benchmark.csv";
+    std::string base_benchmark = "";
+    double tolerancia_benchmark = 0.10;
+    uint32_t repeticoes_benchmark = 3;
+    std::string escalonador = "map";
+    bool comparar_escalonadores = false;
+    std::string resultado_escalonadores = "escalonadores.csv";
 
+    std::string varredura = "";
+    std::string desenho = "grade";
+    uint32_t passos_faixa = 3;
+    uint32_t pontos_varredura = 10;
+    uint32_t semente_varredura = 1;
+    std::string resultado_varredura = "varredura.csv";
+
+    bool replicar = false;
+    uint32_t min_replicacoes = 3;
+    uint32_t max_replicacoes = 50;
+    double meia_largura = 0.05;
+    std::string resultado_replicacoes = "replicacoes.csv";
+
+    std::string lote = "";
+    uint32_t sementes = 1;
+    uint32_t processos = 0;
+    std::string resumo_lote = "resumo_lote.csv";
+};
 
 /**
- * Testa a conexao de um no de origem com uma lista de ips realizando um ping
- * para cada um desses ips.
+ * Troca a extensao de nome (o que vem depois do ultimo ponto) por extensao.
  */
-void testar_conexao(Ptr<Node> origem, std::list <Ipv4Address> enderecos) {
-
-    uint32_t packetSize = 1024;
-    Time interPacketInterval = Seconds (1.0);
-    
-    double tempo_inicio = 1.0;
-    double tempo_fim = 3.0;
-    double diferenca = tempo_fim - tempo_inicio;
-    
-    std::list <Ipv4Address> :: iterator iterador;
-    for(iterador = enderecos.begin(); iterador != enderecos.end(); ++iterador) { 
-        Ipv4Address destino = *iterador; 
-        V4PingHelper ping (destino);
-        ping.SetAttribute ("Interval", TimeValue (interPacketInterval));
-        ping.SetAttribute ("Size", UintegerValue (packetSize));
-        ping.SetAttribute ("Verbose", BooleanValue (true));
-        ApplicationContainer apps = ping.Install (origem);
-        apps.Start (Seconds (tempo_inicio));
-        apps.Stop (Seconds (tempo_fim));
-        
-        tempo_inicio += diferenca;
-        tempo_fim += diferenca;
+std::string trocar_extensao(const std::string &nome, const std::string &extensao) {
+    size_t ponto = nome.find_last_of ('.');
+    size_t barra = nome.find_last_of ('/');
+    if (ponto == std::string::npos || (barra != std::string::npos && ponto < barra)) {
+        return nome + extensao;
     }
+    return nome.substr (0, ponto) + extensao;
 }
 
-int main (int argc, char *argv[]) {
-  // Users may find it convenient to turn on explicit debugging
-  // for selected modules; the below lines suggest how to do this
-#if 1 
-  LogComponentEnable ("SimpleGlobalRoutingExample", LOG_LEVEL_INFO);
-#endif
+/**
+ * Na simulacao distribuida cada processo grava o proprio arquivo, com o
+ * numero do processo no fim do nome.
+ */
+std::string arquivo_do_processo(const std::string &nome, uint32_t sistemas) {
+    if (sistemas <= 1) {
+        return nome;
+    }
+    std::ostringstream sufixo;
+    sufixo << nome << "." << Simulator::GetSystemId ();
+    return sufixo.str ();
+}
 
-  // Set up some default values for the simulation.  Use the 
-  //Config::SetDefault ("ns3::OnOffApplication::PacketSize", UintegerValue (1024));
-  //Config::SetDefault ("ns3::OnOffApplication::DataRate", StringValue ("100Mb/s"));
+void gravar_perfil(const Parametros &parametros, uint32_t sistemas, const PerfilExecucao &perfil, const std::string &rotulo) {
+    if (parametros.perfil.empty ()) {
+        return;
+    }
+    std::string arquivo = arquivo_do_processo (parametros.perfil, sistemas);
+    std::ofstream json (arquivo.c_str ());
+    if (!json) {
+        NS_FATAL_ERROR ("Nao foi possivel criar o arquivo de perfil " << arquivo);
+    }
+    perfil.escrever_json (json, rotulo);
+}
 
-  //DefaultValue::Bind ("DropTailQueue::m_maxPackets", 30);
+/**
+ * Monta a topologia, instala os fluxos do cenario escolhido e roda a
+ * simulacao. As metricas agregadas do FlowMonitor sao devolvidas em resumo.
+ */
+int executar_simulacao (const Parametros &parametros, ResumoExecucao &resumo, PerfilExecucao *perfil_externo = 0) {
+  NS_LOG_INFO ("Create topology.");
+    PerfilExecucao perfil_local;
+    PerfilExecucao &perfil = perfil_externo ? *perfil_externo : perfil_local;
+    perfil.fase ("topologia");
+    configurar_escalonador (parametros.escalonador);
 
-  // Allow the user to override any of the defaults and the above
-  // DefaultValue::Bind ()s at run-time, via command-line arguments
-  CommandLine cmd;
-  bool enableFlowMonitor = true;
-  cmd.AddValue ("EnableMonitor", "Enable Flow Monitor", enableFlowMonitor);
-  cmd.Parse (argc, argv);
+    const OpcoesTopologia &opcoes_topologia = parametros.opcoes_topologia;
+    if (parametros.red_min_th > 0) {
+        Config::SetDefault ("ns3::RedQueueDisc::MinTh", DoubleValue (parametros.red_min_th));
+    }
+    if (parametros.red_max_th > 0) {
+        Config::SetDefault ("ns3::RedQueueDisc::MaxTh", DoubleValue (parametros.red_max_th));
+    }
+
+    std::stringstream descricao;
+    std::ifstream arquivo;
+    std::istream *entrada = &descricao;
+    if (parametros.gerar) {
+        NS_LOG_INFO ("Generate topology with " << nos_gerados (parametros.gerador) << " nodes.");
+        gerar_topologia (parametros.gerador, descricao);
+        if (!parametros.salvar_topologia.empty ()) {
+            std::ofstream salvar (parametros.salvar_topologia.c_str ());
+            salvar << descricao.str ();
+        }
+    } else if (parametros.arquivo_topologia.empty ()) {
+        descricao.str (TOPOLOGIA_PADRAO);
+    } else {
+        arquivo.open (parametros.arquivo_topologia.c_str ());
+        if (!arquivo) {
+            NS_FATAL_ERROR ("Nao foi possivel abrir o arquivo de topologia " << parametros.arquivo_topologia);
+        }
+        entrada = &arquivo;
+    }
+
+    bool processo_principal = Simulator::GetSystemId () == 0;
+    uint32_t sistemas = 1;
+#ifdef NS3_MPI
+    if (parametros.mpi) {
+        sistemas = MpiInterface::GetSize ();
+    }
+#endif
+
+    // Na simulacao distribuida a descricao eh lida duas vezes: a primeira
+    // so para decidir em qual processo fica cada noh
+    Particao particao;
+    const std::vector<uint32_t> *sistema_do_no = 0;
+    if (sistemas > 1) {
+        uint32_t nos = 0;
+        std::vector<ArestaParticao> arestas;
+        ler_grafo_topologia (*entrada, opcoes_topologia, nos, arestas);
+        entrada->clear ();
+        entrada->seekg (0);
+        if (sistemas > nos) {
+            NS_FATAL_ERROR ("Execucao distribuida com " << sistemas << " processos para uma topologia de " << nos
+                            << " nohs: use no maximo um processo por noh");
+        }
+
+        particao = particionar_por_atraso (nos, arestas, sistemas);
+        sistema_do_no = &particao.sistema_do_no;
+        if (parametros.relatorio && processo_principal) {
+            std::cout << "Particao: " << sistemas << " processos, " << particao.enlaces_cortados
+                      << " enlaces entre processos, lookahead " << particao.lookahead * 1e3 << " ms, nohs por processo:";
+            for (size_t i = 0; i < particao.nos_por_sistema.size (); ++i) {
+                std::cout << " " << particao.nos_por_sistema[i];
+            }
+            std::cout << std::endl;
+        }
+    }
 
-  NS_LOG_INFO ("Create nodes.");
-  NodeContainer c;
-
-    // Global
-    Ptr<Node> G1 = CreateObject<Node>();
-    Ptr<Node> G2 = CreateObject<Node>();
-    Ptr<Node> G3 = CreateObject<Node>();
-    
-    NodeContainer container_G1_G2(G1, G2);
-    NodeContainer container_G2_G3(G2, G3);
-
-    // America do Sul
-    Ptr<Node> L1 = CreateObject<Node>();
-    Ptr<Node> S1 = CreateObject<Node>();
-    Ptr<Node> S2 = CreateObject<Node>();
-    Ptr<Node> S3 = CreateObject<Node>();
-    Ptr<Node> L2 = CreateObject<Node>();
-    Ptr<Node> S4 = CreateObject<Node>();
-    
-    NodeContainer container_L1_G2(L1, G2);
-    NodeContainer container_S1_L1(S1, L1);
-    NodeContainer container_S2_L1(S2, L1);
-    NodeContainer container_S3_L1(S3, L1);
-    
-    NodeContainer container_L2_G1(L2, G1);
-    NodeContainer container_S4_L2(S4, L2);
-    
-    NodeContainer container_L1_L2(L1, L2);
-
-
-    // America do Norte
-    Ptr<Node> L3 = CreateObject<Node>();
-    Ptr<Node> N1 = CreateObject<Node>();
-    Ptr<Node> N2 = CreateObject<Node>();
-    Ptr<Node> N3 = CreateObject<Node>();
-    Ptr<Node> L4 = CreateObject<Node>();
-    Ptr<Node> N4 = CreateObject<Node>();
-    Ptr<Node> N5 = CreateObject<Node>();
-    Ptr<Node> N6 = CreateObject<Node>();
-    Ptr<Node> L5 = CreateObject<Node>();
-    Ptr<Node> N7 = CreateObject<Node>();
-    Ptr<Node> N8 = CreateObject<Node>();
-    
-    NodeContainer container_L3_G3(L3, G3);
-    NodeContainer container_N1_L3(N1, L3);
-    NodeContainer container_N2_L3(N2, L3);
-    NodeContainer container_N3_L3(N3, L3);
-    
-    NodeContainer container_L4_G3(L4, G3);
-    NodeContainer container_N4_L4(N4, L4);
-    NodeContainer container_N5_L4(N5, L4);
-    NodeContainer container_N6_L4(N6, L4);
-    
-    NodeContainer container_L5_G3(L5, G3);
-    NodeContainer container_N7_L5(N7, L5);
-    NodeContainer container_N8_L5(N8, L5);
-    
-    NodeContainer container_L3_L4(L3, L4);
-    NodeContainer container_L3_L5(L3, L5);
-    
-    
-    
-    // Global
-    c.Add(G1);
-    c.Add(G2);
-    c.Add(G3);
-    
-    // America do Sul
-    c.Add(L1);
-    c.Add(S1);
-    c.Add(S2);
-    c.Add(S3);
-    c.Add(L2);
-    c.Add(S4);
-    
-    // America do Norte
-    c.Add(L3);
-    c.Add(N1);
-    c.Add(N2);
-    c.Add(N3);
-    c.Add(L4);
-    c.Add(N4);
-    c.Add(N5);
-    c.Add(N6);
-    c.Add(L5);
-    c.Add(N7);
-    c.Add(N8);
-    
     InternetStackHelper internet;
-    internet.Install (c);
-
-
-    // We create the channels first without any IP addressing information
-    NS_LOG_INFO ("Create channels.");
-    PointToPointHelper p2p;
-  
-    std::string tamanho_fila_global = "10p";
-    std::string tamanho_fila_comum = "6p";
-  
-    /* ############################### GLOBAL ############################### */
-    p2p.SetDeviceAttribute ("DataRate", StringValue ("100Mbps"));
-    p2p.SetChannelAttribute ("Delay", StringValue ("20ms"));
-    p2p.SetQueue ("ns3::DropTailQueue", "MaxSize", StringValue (tamanho_fila_global));
-    NetDeviceContainer G1_G2 = p2p.Install(container_G1_G2);
-    
-    p2p.SetDeviceAttribute ("DataRate", StringValue ("100Mbps"));
-    p2p.SetChannelAttribute ("Delay", StringValue ("100ms"));
-    p2p.SetQueue ("ns3::DropTailQueue", "MaxSize", StringValue (tamanho_fila_global));
-    NetDeviceContainer G2_G3 = p2p.Install(container_G2_G3);
-
-    /* ########################### AMERICA DO SUL ########################### */
-	
-    p2p.SetDeviceAttribute ("DataRate", StringValue ("5Mbps"));
-    p2p.SetChannelAttribute ("Delay", StringValue ("10ms"));
-    p2p.SetQueue ("ns3::DropTailQueue", "MaxSize", StringValue (tamanho_fila_comum));
-    NetDeviceContainer S1_L1 = p2p.Install(container_S1_L1);
-    NetDeviceContainer S2_L1 = p2p.Install(container_S2_L1);
-    NetDeviceContainer S3_L1 = p2p.Install(container_S3_L1);
-    NetDeviceContainer S4_L2 = p2p.Install(container_S4_L2);
-
-    p2p.SetDeviceAttribute ("DataRate", StringValue ("20Mbps"));
-    p2p.SetChannelAttribute ("Delay", StringValue ("20ms"));
-    p2p.SetQueue ("ns3::DropTailQueue", "MaxSize", StringValue (tamanho_fila_comum));
-    NetDeviceContainer L1_G2 = p2p.Install(container_L1_G2);
-    NetDeviceContainer L2_G1 = p2p.Install(container_L2_G1);
-    NetDeviceContainer L1_L2 = p2p.Install(container_L1_L2);
-
-    /* ########################## AMERICA DO NORTE ########################## */
-    p2p.SetDeviceAttribute ("DataRate", StringValue ("50Mbps"));
-    p2p.SetChannelAttribute ("Delay", StringValue ("40ms"));
-    p2p.SetQueue ("ns3::DropTailQueue", "MaxSize", StringValue (tamanho_fila_comum));
-    NetDeviceContainer L3_G3 = p2p.Install(container_L3_G3);
-    
-    p2p.SetDeviceAttribute ("DataRate", StringValue ("100Mbps"));
-    p2p.SetChannelAttribute ("Delay", StringValue ("40ms"));
-    p2p.SetQueue ("ns3::DropTailQueue", "MaxSize", StringValue (tamanho_fila_comum));
-    NetDeviceContainer L3_L5 = p2p.Install(container_L3_L5);
-    
-    p2p.SetDeviceAttribute ("DataRate", StringValue ("20Mbps"));
-    p2p.SetChannelAttribute ("Delay", StringValue ("20ms"));
-    p2p.SetQueue ("ns3::DropTailQueue", "MaxSize", StringValue (tamanho_fila_comum));
-    NetDeviceContainer L3_L4 = p2p.Install(container_L3_L4);
-    NetDeviceContainer L4_G3 = p2p.Install(container_L4_G3);
-
-    p2p.SetDeviceAttribute ("DataRate", StringValue ("10Mbps"));
-    p2p.SetChannelAttribute ("Delay", StringValue ("5ms"));
-    p2p.SetQueue ("ns3::DropTailQueue", "MaxSize", StringValue (tamanho_fila_comum));
-    NetDeviceContainer N1_L3 = p2p.Install(container_N1_L3);
-    NetDeviceContainer N2_L3 = p2p.Install(container_N2_L3);
-    NetDeviceContainer N3_L3 = p2p.Install(container_N3_L3);
-    NetDeviceContainer N4_L4 = p2p.Install(container_N4_L4);
-    NetDeviceContainer N5_L4 = p2p.Install(container_N5_L4);
-    NetDeviceContainer N6_L4 = p2p.Install(container_N6_L4);
-    NetDeviceContainer N7_L5 = p2p.Install(container_N7_L5);
-    NetDeviceContainer N8_L5 = p2p.Install(container_N8_L5);
-    NetDeviceContainer L5_G3 = p2p.Install(container_L5_G3);
-
-    TrafficControlHelper tch;
-    tch.SetRootQueueDisc ("ns3::RedQueueDisc");
-    tch.Install (G1_G2);
-    tch.Install (G2_G3);
-    
-    tch.Install (S1_L1);
-    tch.Install (S2_L1);
-    tch.Install (S3_L1);
-    tch.Install (S4_L2);
-    
-    tch.Install (L1_G2);
-    tch.Install (L2_G1);
-    tch.Install (L1_L2);
-    
-    tch.Install (L3_G3);
-    tch.Install (L3_L5);
-    tch.Install (L3_L4);
-    tch.Install (L4_G3);
-    
-    tch.Install (N1_L3);
-    tch.Install (N2_L3);
-    tch.Install (N3_L3);
-    tch.Install (N4_L4);
-    tch.Install (N5_L4);
-    tch.Install (N6_L4);
-    tch.Install (N7_L5);
-    tch.Install (N8_L5);
-    tch.Install (L5_G3);
-
-
-    /* ##################### ATRIBUICAO DE ENDERECOS IPS ##################### */
-    NS_LOG_INFO ("Assign IP Addresses.");
-    Ipv4AddressHelper ipv4;
-
-    // Global
-    ipv4.SetBase ("10.0.1.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_G1_G2 = ipv4.Assign(G1_G2);
-    
-    ipv4.SetBase ("10.0.2.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_G2_G3 = ipv4.Assign(G2_G3);
-    
-    // America do Sul
-    ipv4.SetBase ("10.55.4.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_S1_L1 = ipv4.Assign(S1_L1);
-    
-    ipv4.SetBase ("10.55.2.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_S2_L1 = ipv4.Assign(S2_L1);
-    
-    ipv4.SetBase ("10.55.3.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_S3_L1 = ipv4.Assign(S3_L1);
-    
-    ipv4.SetBase ("10.55.7.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_S4_L2 = ipv4.Assign(S4_L2);
-    
-    ipv4.SetBase ("10.55.1.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_L1_G2 = ipv4.Assign(L1_G2);
-    
-    ipv4.SetBase ("10.55.5.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_L2_G1 = ipv4.Assign(L2_G1);
-    
-    ipv4.SetBase ("10.55.6.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_L1_L2 = ipv4.Assign(L1_L2);
-    
-    // America do Norte
-    ipv4.SetBase ("10.1.10.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_L3_L5 = ipv4.Assign(L3_L5);
-    
-    ipv4.SetBase ("10.1.7.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_N1_L3 = ipv4.Assign(N1_L3);
-    
-    ipv4.SetBase ("10.1.8.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_N2_L3 = ipv4.Assign(N2_L3);
-    
-    ipv4.SetBase ("10.1.9.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_N3_L3 = ipv4.Assign(N3_L3);
-    
-    ipv4.SetBase ("10.1.1.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_L4_G3 = ipv4.Assign(L4_G3);
-    
-    ipv4.SetBase ("10.1.3.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_N4_L4 = ipv4.Assign(N4_L4);
-    
-    ipv4.SetBase ("10.1.5.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_N5_L4 = ipv4.Assign(N5_L4);
-    
-    ipv4.SetBase ("10.1.2.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_N6_L4 = ipv4.Assign(N6_L4);
-    
-    ipv4.SetBase ("10.1.13.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_L5_G3 = ipv4.Assign(L5_G3);
-    
-    ipv4.SetBase ("10.1.11.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_N7_L5 = ipv4.Assign(N7_L5);
-    
-    ipv4.SetBase ("10.1.12.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_N8_L5 = ipv4.Assign(N8_L5);
-    
-    ipv4.SetBase ("10.1.4.0", "255.255.255.0");
-    Ipv4InterfaceContainer interface_global_L3_L4 = ipv4.Assign(L3_L4);
-
-
-    Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
-    
-
-    /* ######################## CONFIGURAR MULTICAST ######################## */
-    #if 0
-    
-       Ptr<Node> sender = N1;
-       Ptr<NetDevice> senderIf = N1_L3.Get(0);
-       multicast.SetDefaultMulticastRoute (sender, senderIf);
-       
-       
-    #endif
-
-
-    /* ##################### TESTE PING DE N1 PARA TODOS #################### */
-    #if 0
-        std::list <Ipv4Address> lista_de_ips;
-        lista_de_ips.push_back(Ipv4Address("10.1.7.1")); // N1
-        lista_de_ips.push_back(Ipv4Address("10.1.8.1")); // N2
-        lista_de_ips.push_back(Ipv4Address("10.1.9.1")); // N3
-        lista_de_ips.push_back(Ipv4Address("10.1.3.1")); // N4
-        lista_de_ips.push_back(Ipv4Address("10.1.5.1")); // N5
-        lista_de_ips.push_back(Ipv4Address("10.1.2.1")); // N6
-        lista_de_ips.push_back(Ipv4Address("10.1.11.1")); // N7
-        lista_de_ips.push_back(Ipv4Address("10.1.12.1")); // N8
-        lista_de_ips.push_back(Ipv4Address("10.55.4.1")); // S1
-        lista_de_ips.push_back(Ipv4Address("10.55.2.1")); // S2
-        lista_de_ips.push_back(Ipv4Address("10.55.3.1")); // S3
-        lista_de_ips.push_back(Ipv4Address("10.55.7.1")); // S4
-
-        testar_conexao(N1, lista_de_ips);
-    #endif
+    configurar_roteamento (parametros.roteamento, internet);
+    if (parametros.enxuto) {
+        internet.SetIpv6StackInstall (false);
+    }
+    Topologia topologia;
+    carregar_topologia (*entrada, opcoes_topologia, internet, topologia, sistema_do_no);
 
+    perfil.registrar_topologia (topologia);
+    if (parametros.relatorio && processo_principal) {
+        imprimir_tempos_montagem (topologia, std::cout);
+    }
+
+    // RIP e OLSR montam as tabelas durante a simulacao; o global eh calculado
+    // aqui e o ECMP calcula as distancias sob demanda
+    perfil.fase ("roteamento");
+    std::shared_ptr<TabelaMultipercurso> multipercurso;
+    int64_t bytes_roteamento = bytes_em_uso ();
+    // A compactacao so libera depois que o global montou todas as tabelas,
+    // entao o pico (heap e RSS) ainda inclui as dos hosts
+    int64_t pico_roteamento = 0;
+    long pico_rss_kb = pico_memoria_kb ();
+    if (parametros.roteamento == "global") {
+        // Na simulacao distribuida cada processo so calcula os nohs dele
+        if (!parametros.cache_rotas.empty () && sistemas == 1) {
+            ResumoCacheRotas cache = popular_rotas_com_cache (topologia, parametros.cache_rotas, parametros.verificar_cache);
+            if (parametros.relatorio) {
+                imprimir_cache_rotas (cache, std::cout);
+            }
+            if (cache.nos_divergentes > 0) {
+                NS_FATAL_ERROR ("Cache de rotas " << cache.arquivo << " diverge das tabelas calculadas em "
+                                << cache.nos_divergentes << " nohs");
+            }
+        } else {
+            Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+        }
+        if (parametros.enxuto) {
+            pico_roteamento = bytes_em_uso () - bytes_roteamento;
+            ResumoCompactacao compactacao = compactar_rotas_dos_hosts (topologia);
+            if (parametros.relatorio && processo_principal) {
+                std::cout << "Modo enxuto: " << compactacao.hosts << " hosts so com rota padrao ("
+                          << compactacao.rotas_removidas << " rotas removidas)" << std::endl;
+            }
+        }
+    } else if (parametros.roteamento == "ecmp") {
+        multipercurso = preparar_multipercurso (topologia, parametros.multipercurso);
+    }
+    bytes_roteamento = bytes_em_uso () - bytes_roteamento;
+    pico_rss_kb = pico_memoria_kb () - pico_rss_kb;
+    perfil.registrar_roteamento (bytes_roteamento);
+    if (parametros.relatorio && processo_principal && !topologia.nos.empty ()) {
+        std::cout << "Tabelas de roteamento: " << bytes_roteamento / int64_t (topologia.nos.size ()) << " bytes/noh nas tabelas";
+        if (pico_roteamento > 0) {
+            std::cout << " (" << pico_roteamento / int64_t (topologia.nos.size ()) << " bytes/noh antes da compactacao)";
+        }
+        std::cout << ", pico de RSS +" << pico_rss_kb << " KB" << std::endl;
+    }
+
+    if (!parametros.verificar.empty ()) {
+        perfil.fase ("verificacao");
+        if (parametros.verificar == "tabelas" && parametros.roteamento != "global" && parametros.roteamento != "ecmp") {
+            NS_FATAL_ERROR ("As tabelas do " << parametros.roteamento << " so existem durante a simulacao; use --Verificar=grafo");
+        }
+        VerificacaoRotas verificacao (topologia);
+        verificacao.verificar (parametros.verificar, parametros.processos, multipercurso.get ());
+        if (processo_principal) {
+            std::string base = parametros.saida.empty () ? "verificacao" : parametros.saida;
+            std::string nome_rotas = trocar_extensao (base, ".rotas.csv");
+            std::string nome_problemas = trocar_extensao (base, ".problemas.csv");
+            std::ofstream rotas (nome_rotas.c_str ());
+            std::ofstream problemas (nome_problemas.c_str ());
+            if (!rotas || !problemas) {
+                NS_FATAL_ERROR ("Nao foi possivel criar " << nome_rotas << " e " << nome_problemas);
+            }
+            verificacao.escrever_origens_csv (rotas);
+            verificacao.escrever_problemas_csv (problemas);
+            verificacao.imprimir (std::cout);
+        }
+
+        perfil.fase ("destruicao");
+        Simulator::Destroy ();
+        perfil.terminar ();
+        gravar_perfil (parametros, sistemas, perfil, "verificacao");
+        return verificacao.problemas () == 0 ? 0 : 1;
+    }
+
+    MedidorControle medidor_controle;
+    medidor_controle.instalar (topologia, parametros.roteamento);
+    // Com rotas estaticas (global, ecmp) nao ha o que acompanhar: as
+    // tabelas estao completas antes do inicio e a convergencia eh 0
+    std::unique_ptr<DetectorConvergencia> detector;
+    if (roteamento_dinamico (parametros.roteamento)) {
+        detector.reset (new DetectorConvergencia (topologia, Seconds (parametros.periodo_convergencia), Seconds (parametros.janela_convergencia)));
+        detector->iniciar ();
+    }
 
     /* ##################### CONFIGURACAO DAS SIMULACOES #################### */
 
-    DataRate dataRate = DataRate ("4Mbps");
-    uint32_t packetSize = 1024;
-    std::string protocolo_TCP = "ns3::TcpSocketFactory";
-    std::string protocolo_UDP = "ns3::TcpSocketFactory";
+    if (!taxa_valida (parametros.taxa_fluxos)) {
+        NS_FATAL_ERROR ("Taxa dos fluxos invalida: " << parametros.taxa_fluxos);
+    }
+    std::string dataRate = parametros.taxa_fluxos;
+    uint32_t packetSize = parametros.tamanho_pacote;
 
     std::string nome_arquivo_saida = "padrao_simple-global-routing.flowmon";
 
 
     /* ####################### SIMULACOES EXECUTADAS ######################## */
+    perfil.fase ("fluxos");
 
-    // simular_fluxo(protocolo_TCP, Seconds (.0), Seconds (.0), , Ipv4Address(""), , dataRate, packetSize, 10);
+    std::vector<FluxoMatriz> fluxos;
+    if (!parametros.matriz_fluxos.empty ()) {
+        std::ifstream matriz (parametros.matriz_fluxos.c_str ());
+        if (!matriz) {
+            NS_FATAL_ERROR ("Nao foi possivel abrir a matriz de fluxos " << parametros.matriz_fluxos);
+        }
+        ler_matriz_fluxos (matriz, topologia, fluxos);
+        nome_arquivo_saida = trocar_extensao (parametros.matriz_fluxos, ".xml");
+    } else if (parametros.gerar) {
+        nome_arquivo_saida = "simulacao_gerada.xml";
+        fluxos_aleatorios (topologia, parametros.fluxos_gerados, 0.0, parametros.tempo_fim, DataRate (dataRate), packetSize, fluxos);
+    } else if (parametros.multicast.empty () && parametros.trace.empty ()) {
+        std::vector<Cenario> cenarios = cenarios_padrao (parametros.tempo_fim);
+        const Cenario *cenario = buscar_cenario (cenarios, parametros.cenario);
+        if (cenario == 0) {
+            NS_FATAL_ERROR ("Cenario desconhecido: " << parametros.cenario);
+        }
+        nome_arquivo_saida = cenario->nome + ".xml";
+        matriz_do_cenario (topologia, *cenario, dataRate, packetSize, fluxos);
+    }
+    std::vector<GrupoMulticast> grupos;
+    if (!parametros.multicast.empty ()) {
+        std::ifstream especificacao (parametros.multicast.c_str ());
+        if (!especificacao) {
+            NS_FATAL_ERROR ("Nao foi possivel abrir os grupos multicast " << parametros.multicast);
+        }
+        ler_grupos_multicast (especificacao, topologia, grupos);
+        if (fluxos.empty ()) {
+            nome_arquivo_saida = trocar_extensao (parametros.multicast, ".xml");
+        }
+        if (parametros.multicast_unicast) {
+            fluxos_dos_grupos (grupos, fluxos);
+            grupos.clear ();
+        }
+    }
+    marcar_fundo (fluxos, parametros.fracao_fundo);
+    if (!parametros.saida.empty ()) {
+        nome_arquivo_saida = parametros.saida;
+    }
 
-    double tempo_fim = 60.0;
+    // Estimativa: divide as capacidades entre os fluxos e termina sem o Run
+    if (parametros.estimar) {
+        perfil.fase ("estimativa");
+        if (parametros.roteamento != "global" && parametros.relatorio && processo_principal) {
+            std::cout << "Estimativa: sem tabelas antes da simulacao com " << parametros.roteamento
+                      << "; usando os caminhos de menor custo" << std::endl;
+        }
+        EstimativaVazao estimativa (topologia, fluxos);
+        ResumoEstimativa estimado = estimativa.calcular (parametros.roteamento == "global");
+        if (processo_principal) {
+            std::string nome_fluxos = trocar_extensao (nome_arquivo_saida, ".estimativa_fluxos.csv");
+            std::string nome_enlaces = trocar_extensao (nome_arquivo_saida, ".estimativa_enlaces.csv");
+            std::ofstream tabela_fluxos (nome_fluxos.c_str ());
+            std::ofstream tabela_enlaces (nome_enlaces.c_str ());
+            if (!tabela_fluxos || !tabela_enlaces) {
+                NS_FATAL_ERROR ("Nao foi possivel criar " << nome_fluxos << " e " << nome_enlaces);
+            }
+            estimativa.escrever_fluxos_csv (tabela_fluxos);
+            estimativa.escrever_enlaces_csv (tabela_enlaces);
+            if (!parametros.ranking_estimativa.empty ()) {
+                bool novo = !std::ifstream (parametros.ranking_estimativa.c_str ());
+                std::ofstream ranking (parametros.ranking_estimativa.c_str (), std::ios::app);
+                if (novo) {
+                    ranking << "cenario," << cabecalho_estimativa_csv () << std::endl;
+                }
+                ranking << nome_arquivo_saida << ',';
+                escrever_estimativa_csv (ranking, estimado);
+                ranking << std::endl;
+            }
+            if (parametros.relatorio) {
+                std::cout << "Estimativa: " << estimado.fluxos << " fluxos (" << estimado.sem_rota << " sem rota, "
+                          << estimado.limitados << " limitados pela rede), vazao " << estimado.vazao_mbps << " de "
+                          << estimado.demanda_mbps << " Mbps, " << estimado.enlaces_saturados
+                          << " sentidos saturados, utilizacao maxima " << estimado.utilizacao_maxima << " em "
+                          << estimado.gargalo << "; " << estimado.tempo_ms << " ms" << std::endl;
+            }
+        }
+        resumo.fluxos = estimado.fluxos;
+        resumo.vazao_mbps = estimado.vazao_mbps;
+        resumo.tempo_execucao_s = estimado.tempo_ms / 1e3;
+
+        perfil.fase ("destruicao");
+        Simulator::Destroy ();
+        perfil.terminar ();
+        gravar_perfil (parametros, sistemas, perfil, nome_arquivo_saida);
+        return 0;
+    }
+
+    std::vector<FluxoMatriz> pacotes;
+    for (size_t i = 0; i < fluxos.size (); ++i) {
+        if (!parametros.hibrido || !fluxos[i].fundo) {
+            pacotes.push_back (fluxos[i]);
+        }
+    }
+    ResumoInstalacao instalacao = instalar_fluxos (topologia, pacotes);
+    if (!grupos.empty ()) {
+        ResumoMulticast resumo_multicast = instalar_multicast (topologia, grupos);
+        if (parametros.relatorio && processo_principal) {
+            std::cout << "Multicast: " << resumo_multicast.grupos << " grupos, " << resumo_multicast.membros << " membros, "
+                      << resumo_multicast.enlaces_arvore << " enlaces nas arvores (" << resumo_multicast.enlaces_unicast
+                      << " copias por pacote em unicast)" << std::endl;
+        }
+    }
+    std::unique_ptr<LeitorTrace> leitor_trace;
+    std::unique_ptr<ReprodutorTrace> reprodutor;
+    if (!parametros.trace.empty ()) {
+        leitor_trace.reset (new LeitorTrace (uint64_t (parametros.janela_trace_mb) << 20));
+        leitor_trace->abrir (parametros.trace);
+        reprodutor.reset (new ReprodutorTrace (topologia, *leitor_trace, parametros.inicio_trace, parametros.lote_trace_ms / 1e3));
+        ResumoInstalacao instalacao_trace = reprodutor->instalar ();
+        instalacao.enviadores += instalacao_trace.enviadores;
+        instalacao.receptores += instalacao_trace.receptores;
+        if (fluxos.empty () && grupos.empty ()) {
+            nome_arquivo_saida = trocar_extensao (parametros.trace, ".xml");
+        }
+        if (parametros.relatorio && processo_principal) {
+            std::cout << "Trace: " << leitor_trace->fluxos ().size () << " fluxos, " << leitor_trace->registros ()
+                      << " pacotes ate " << reprodutor->fim ().GetSeconds () << " s" << std::endl;
+        }
+    }
+    ModeloFluido fluido (topologia, parametros.hibrido ? fluxos : std::vector<FluxoMatriz> ());
+    if (parametros.hibrido) {
+        fluido.agendar ();
+    }
+    if (parametros.relatorio && processo_principal) {
+        std::cout << "Fluxos: " << fluxos.size () << " (" << instalacao.enviadores << " enviadores, "
+                  << instalacao.receptores << " receptores) instalados em " << instalacao.tempo_s << " s" << std::endl;
+    }
+
+    perfil.fase ("instrumentacao");
 
-    #if 0
-        nome_arquivo_saida = "simulacao_01.xml";
-        
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 10);
-        
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 11);
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N1, Ipv4Address("10.1.9.1"), N3, dataRate, packetSize, 12);
-        
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 13);
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), S1, Ipv4Address("10.55.2.1"), S2, dataRate, packetSize, 14);
-        
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N1, Ipv4Address("10.1.9.1"), N3, dataRate, packetSize, 15);
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), S1, Ipv4Address("10.55.2.1"), S2, dataRate, packetSize, 16);
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N1, Ipv4Address("10.1.9.1"), N3, dataRate, packetSize, 17);
-    #endif
-    
-    #if 0
-        nome_arquivo_saida = "simulacao_02.xml";
-        
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N1, Ipv4Address("10.1.9.1"), N3, dataRate, packetSize, 18);
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), S1, Ipv4Address("10.55.2.1"), S2, dataRate, packetSize, 19);
-        
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N1, Ipv4Address("10.1.9.1"), N3, dataRate, packetSize, 20);
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), S1, Ipv4Address("10.55.2.1"), S2, dataRate, packetSize, 21);
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 22);
-    #endif
-    
-    #if 0
-        nome_arquivo_saida = "simulacao_03.xml";
-        
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 23);
-        
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 24);
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N1, Ipv4Address("10.1.9.1"), N3, dataRate, packetSize, 25);
-        
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 26);
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), S1, Ipv4Address("10.55.2.1"), S2, dataRate, packetSize, 27);
-        
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), S1, Ipv4Address("10.55.2.1"), S2, dataRate, packetSize, 28);
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N1, Ipv4Address("10.1.9.1"), N3, dataRate, packetSize, 29);
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 30);
-    #endif
-   
-    #if 0
-        nome_arquivo_saida = "simulacao_04.xml";
-        
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N1, Ipv4Address("10.1.9.1"), N3, dataRate, packetSize, 31);
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), S1, Ipv4Address("10.55.2.1"), S2, dataRate, packetSize, 32);
-        
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N1, Ipv4Address("10.1.9.1"), N3, dataRate, packetSize, 33);
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), S1, Ipv4Address("10.55.2.1"), S2, dataRate, packetSize, 34);
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 35);
-    #endif
-    
-    #if 0
-        nome_arquivo_saida = "simulacao_05.xml";
-        
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 36);
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N1, Ipv4Address("10.1.9.1"), N3, dataRate, packetSize, 37);
-        
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 38);
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), S1, Ipv4Address("10.55.2.1"), S2, dataRate, packetSize, 39);
-        
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 40);
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), S1, Ipv4Address("10.55.2.1"), S2, dataRate, packetSize, 41);
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N1, Ipv4Address("10.1.9.1"), N3, dataRate, packetSize, 42);
-    #endif
-    
-    #if 0
-        nome_arquivo_saida = "simulacao_06.xml";
-        
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N1, Ipv4Address("10.1.9.1"), N3, dataRate, packetSize, 43);
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), S1, Ipv4Address("10.55.2.1"), S2, dataRate, packetSize, 44);
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 45);
-    #endif
-    
-    #if 0
-        nome_arquivo_saida = "simulacao_07.xml";
-        
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 46);
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N1, Ipv4Address("10.1.9.1"), N3, dataRate, packetSize, 47);
-        
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 48);
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), S1, Ipv4Address("10.55.2.1"), S2, dataRate, packetSize, 49);
-        
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 50);
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), S1, Ipv4Address("10.55.2.1"), S2, dataRate, packetSize, 51);
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N1, Ipv4Address("10.1.9.1"), N3, dataRate, packetSize, 52);
-    #endif
-    
-    #if 1
-        nome_arquivo_saida = "simulacao_08.xml";
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), N1, Ipv4Address("10.1.9.1"), N3, dataRate, packetSize, 53);
-        simular_fluxo(protocolo_UDP, Seconds (0.0), Seconds (tempo_fim), S1, Ipv4Address("10.55.2.1"), S2, dataRate, packetSize, 54);
-        simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (tempo_fim), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 55);
-    #endif
-
-    //nome_arquivo_saida = "pode_me_excluir.xml";
-    //simular_fluxo(protocolo_TCP, Seconds (0.0), Seconds (3.0), N2, Ipv4Address("10.55.3.1"), S3, dataRate, packetSize, 10);
+    // Falhas de enlace
+    std::vector<EventoFalha> eventos_falha;
+    if (!parametros.arquivo_falhas.empty ()) {
+        std::ifstream arquivo_falhas (parametros.arquivo_falhas.c_str ());
+        if (!arquivo_falhas) {
+            NS_FATAL_ERROR ("Nao foi possivel abrir o arquivo de falhas " << parametros.arquivo_falhas);
+        }
+        ler_falhas (arquivo_falhas, topologia, eventos_falha);
+    }
+    if (!parametros.falhas.empty ()) {
+        std::string lista = parametros.falhas;
+        std::replace (lista.begin (), lista.end (), ',', '\n');
+        std::istringstream falhas (lista);
+        ler_falhas (falhas, topologia, eventos_falha);
+    }
+    if (!eventos_falha.empty () && sistemas > 1) {
+        NS_FATAL_ERROR ("Falhas de enlace nao sao suportadas na simulacao distribuida");
+    }
+    std::unique_ptr<RoteamentoIncremental> incremental;
+    if (!eventos_falha.empty () && parametros.roteamento == "global") {
+        incremental.reset (new RoteamentoIncremental (topologia, parametros.recalculo_completo));
+    }
+    AgendaFalhas agenda_falhas (topologia, eventos_falha, incremental.get ());
+    agenda_falhas.agendar ();
+    MedidorRecuperacao recuperacao (eventos_falha);
 
     // Flow Monitor
+    // O FlowMonitor nao acompanha pacotes que mudam de processo; na
+    // simulacao distribuida as estatisticas vem da SondaFluxos
+    bool usar_flowmon = parametros.enableFlowMonitor && sistemas == 1;
     FlowMonitorHelper flowmonHelper;
-    if (enableFlowMonitor) {
-        flowmonHelper.InstallAll ();  
+    Ptr<FlowMonitor> monitor;
+    uint32_t nos_monitorados = 0;
+    // Com instantaneos periodicos o XML do fim da simulacao nao eh escrito
+    bool usar_instantaneos = usar_flowmon && parametros.instantaneos_ms > 0;
+    if (usar_flowmon) {
+        if (usar_instantaneos) {
+            desligar_histogramas (flowmonHelper);
+        }
+        if (parametros.monitoramento == "extremos" || parametros.enxuto) {
+            NodeContainer extremos = nos_extremos (topologia);
+            monitor = flowmonHelper.Install (extremos);
+            nos_monitorados = extremos.GetN ();
+        } else if (parametros.monitoramento == "todos") {
+            monitor = flowmonHelper.InstallAll ();
+            nos_monitorados = topologia.nos.size ();
+        } else {
+            NS_FATAL_ERROR ("Monitoramento desconhecido: " << parametros.monitoramento << " (use todos ou extremos)");
+        }
+        if (parametros.relatorio) {
+            std::cout << "FlowMonitor em " << nos_monitorados << " de " << topologia.nos.size () << " nos" << std::endl;
+        }
+    }
+
+    // Histogramas de atraso e jitter amostrados nos extremos
+    std::unique_ptr<HistogramasAmostrados> histogramas;
+    if (parametros.amostragem_atraso > 0) {
+        histogramas.reset (new HistogramasAmostrados (parametros.amostragem_atraso, parametros.largura_histograma_ms));
+        NodeContainer extremos = nos_extremos (topologia);
+        for (uint32_t i = 0; i < extremos.GetN (); ++i) {
+            if (no_local (extremos.Get (i))) {
+                histogramas->instalar (extremos.Get (i));
+            }
+        }
+    }
+
+    std::unique_ptr<EscritorInstantaneos> escritor;
+    std::unique_ptr<AmostradorFluxos> amostrador;
+    if (usar_instantaneos) {
+        bool binario = parametros.formato_instantaneos == "binario";
+        if (!binario && parametros.formato_instantaneos != "csv") {
+            NS_FATAL_ERROR ("Formato de instantaneos desconhecido: " << parametros.formato_instantaneos);
+        }
+        std::string arquivo = parametros.arquivo_instantaneos;
+        if (arquivo.empty ()) {
+            arquivo = trocar_extensao (nome_arquivo_saida, binario ? ".instantaneos.bin" : ".instantaneos.csv");
+        }
+        escritor.reset (new EscritorInstantaneos (arquivo, binario));
+        if (!escritor->aberto ()) {
+            NS_FATAL_ERROR ("Nao foi possivel criar o arquivo de instantaneos " << arquivo);
+        }
+        amostrador.reset (new AmostradorFluxos (monitor, DynamicCast<Ipv4FlowClassifier> (flowmonHelper.GetClassifier ()),
+                                                MilliSeconds (parametros.instantaneos_ms), *escritor));
+        amostrador->iniciar ();
+    }
+
+    bool usar_sonda = sistemas > 1 || !parametros.tabela_fluxos.empty () || !eventos_falha.empty ();
+    SondaFluxos sonda;
+    if (usar_sonda) {
+        for (size_t i = 0; i < topologia.nos.size (); ++i) {
+            if (no_local (topologia.nos[i])) {
+                sonda.instalar (topologia.nos[i]);
+            }
+        }
+    }
+    if (!eventos_falha.empty ()) {
+        recuperacao.observar (sonda);
+    }
+
+    MedidorCarga carga;
+    if (!parametros.tabela_carga.empty ()) {
+        carga.instalar (topologia);
+    }
+
+    TelemetriaFilas telemetria (topologia, MilliSeconds (parametros.filas_ms), parametros.capacidade_filas);
+    if (parametros.filas_ms > 0) {
+        telemetria.instalar ();
+    }
+
+    // Series por fluxo: as colunas cobrem ate TempoLimite
+    std::unique_ptr<SeriesFluxos> series;
+    if (parametros.series_ms > 0) {
+        series.reset (new SeriesFluxos (topologia, pacotes, Seconds (parametros.series_ms / 1e3), Seconds (parametros.tempo_limite)));
+        series->instalar ();
     }
 
     NS_LOG_INFO ("Run Simulation.");
-    Simulator::Stop (Seconds (200));
+    // Na simulacao distribuida todos os processos precisam parar no mesmo
+    // instante, entao fica so o limite de tempo
+    ControleParada parada (topologia, parametros.parada);
+    if (parametros.parada_automatica && sistemas == 1) {
+        if (reprodutor) {
+            parada.acrescentar_fonte (reprodutor->inicio (), reprodutor->fim ());
+        }
+        parada.armar ();
+    }
+
+    perfil.fase ("execucao");
+    std::chrono::steady_clock::time_point inicio_execucao = std::chrono::steady_clock::now ();
+    Simulator::Stop (Seconds (parametros.tempo_limite));
     Simulator::Run ();
+    double tempo_execucao = segundos_desde (inicio_execucao);
+    perfil.registrar_execucao (Simulator::GetEventCount (), tempo_execucao);
+    perfil.fase ("relatorios");
+    double tempo_simulado = Simulator::Now ().GetSeconds ();
     NS_LOG_INFO ("Done.");
+    if (processo_principal) {
+        parada.imprimir (std::cout);
+    }
+
+#ifdef NS3_MPI
+    if (sistemas > 1) {
+        // O tempo da execucao distribuida eh o do processo mais lento
+        double tempo_local = tempo_execucao;
+        MPI_Reduce (&tempo_local, &tempo_execucao, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        if (processo_principal) {
+            std::cout << "Execucao distribuida: " << sistemas << " processos, " << tempo_execucao << " s";
+            if (parametros.tempo_sequencial > 0) {
+                std::cout << ", speedup " << parametros.tempo_sequencial / tempo_execucao;
+            }
+            std::cout << std::endl;
+        }
+    }
+#endif
 
-    if (enableFlowMonitor) {
+    if (parametros.hibrido && parametros.relatorio && processo_principal) {
+        fluido.imprimir (std::cout);
+    }
+    if (reprodutor && parametros.relatorio) {
+        reprodutor->imprimir (std::cout);
+    }
+    if (!parametros.tabela_carga.empty ()) {
+        std::ofstream tabela (parametros.tabela_carga.c_str ());
+        tabela << Simulator::GetEventCount () << ' ' << tempo_execucao << std::endl;
+        carga.escrever (tabela, topologia);
+    }
+    if (!parametros.tabela_frente.empty () && usar_flowmon) {
+        std::ofstream frente (parametros.tabela_frente.c_str ());
+        frente << Simulator::GetEventCount () << ' ' << tempo_execucao << std::endl;
+        escrever_fluxos_frente (frente, monitor, DynamicCast<Ipv4FlowClassifier> (flowmonHelper.GetClassifier ()), topologia, fluxos);
+    }
+
+    if (parametros.relatorio) {
+        std::cout << "Simulacao: " << tempo_execucao << " s de execucao, pico de memoria "
+                  << pico_memoria_kb () / 1024.0 << " MB" << std::endl;
+    }
+
+    if (processo_principal) {
+        std::cout << "Roteamento " << parametros.roteamento << ": ";
+        if (!detector) {
+            std::cout << "tabelas instaladas antes do inicio, convergencia em 0 s";
+        } else if (detector->convergiu ()) {
+            std::cout << "convergencia em " << detector->tempo_convergencia () << " s";
+        } else {
+            std::cout << "nao convergiu (" << detector->pares_sem_rota () << " pares sem rota no fim)";
+        }
+        if (detector) {
+            std::cout << ", rotas completas em " << detector->tempo_rotas_completas () << " s";
+        }
+        std::cout << ", " << medidor_controle.bytes_total () << " bytes de controle" << std::endl;
+    }
+    if (multipercurso && parametros.relatorio) {
+        multipercurso->imprimir (std::cout);
+    }
+    if (roteamento_dinamico (parametros.roteamento)) {
+        std::ofstream controle (trocar_extensao (nome_arquivo_saida, ".controle.csv").c_str ());
+        medidor_controle.escrever_csv (controle, topologia);
+    }
+
+    if (usar_instantaneos) {
+        amostrador->finalizar ();
+        escritor->fechar ();
+        if (parametros.relatorio) {
+            std::cout << "Instantaneos: " << escritor->instantaneos_gravados () << " gravados, "
+                      << escritor->registros_gravados () << " registros de fluxo" << std::endl;
+        }
+    } else if (usar_flowmon) {
+        perfil.fase ("serializacao");
         flowmonHelper.SerializeToXmlFile (nome_arquivo_saida, false, false);
+        perfil.fase ("relatorios");
+    }
+
+    if (histogramas) {
+        std::string arquivo = arquivo_do_processo (trocar_extensao (nome_arquivo_saida, ".histogramas.csv"), sistemas);
+        std::ofstream tabela (arquivo.c_str ());
+        if (!tabela) {
+            NS_FATAL_ERROR ("Nao foi possivel criar o arquivo de histogramas " << arquivo);
+        }
+        histogramas->escrever_csv (tabela);
+        if (parametros.relatorio) {
+            std::cout << "Histogramas: " << histogramas->amostras () << " pacotes amostrados (1 em "
+                      << parametros.amostragem_atraso << ") em " << arquivo << std::endl;
+        }
     }
 
+    if (parametros.filas_ms > 0) {
+        // Cada processo grava as filas dos seus proprios nohs
+        std::string arquivo = parametros.arquivo_filas.empty () ? trocar_extensao (nome_arquivo_saida, ".filas.bin") : parametros.arquivo_filas;
+        arquivo = arquivo_do_processo (arquivo, sistemas);
+        if (!telemetria.gravar (arquivo)) {
+            NS_FATAL_ERROR ("Nao foi possivel gravar a telemetria das filas em " << arquivo);
+        }
+        if (parametros.relatorio) {
+            telemetria.imprimir (std::cout);
+        }
+    }
+
+    if (series) {
+        std::string arquivo = parametros.arquivo_series.empty () ? trocar_extensao (nome_arquivo_saida, ".series.bin") : parametros.arquivo_series;
+        arquivo = arquivo_do_processo (arquivo, sistemas);
+        if (!series->gravar (arquivo)) {
+            NS_FATAL_ERROR ("Nao foi possivel gravar as series dos fluxos em " << arquivo);
+        }
+        if (parametros.relatorio) {
+            series->imprimir (std::cout);
+        }
+    }
+
+    if (!eventos_falha.empty ()) {
+        agenda_falhas.imprimir (std::cout);
+        recuperacao.imprimir (std::cout, topologia);
+        std::ofstream falhas (trocar_extensao (nome_arquivo_saida, ".falhas.csv").c_str ());
+        recuperacao.escrever_csv (falhas, topologia, sonda.estatisticas ());
+    }
+
+    if (usar_sonda) {
+        std::vector<EstatisticaFluxo> estatisticas = sonda.estatisticas ();
+#ifdef NS3_MPI
+        if (sistemas > 1) {
+            estatisticas = juntar_entre_processos (estatisticas);
+        }
+#endif
+        juntar_estatisticas (estatisticas);
+        if (processo_principal) {
+            std::string nome_tabela = parametros.tabela_fluxos.empty () ? nome_arquivo_saida + ".fluxos.csv" : parametros.tabela_fluxos;
+            std::ofstream tabela (nome_tabela.c_str ());
+            escrever_estatisticas_csv (tabela, estatisticas);
+        }
+    }
+
+    if (usar_flowmon) {
+        resumo = resumir_fluxos (monitor, DynamicCast<Ipv4FlowClassifier> (flowmonHelper.GetClassifier ()));
+    }
+    resumo.nos_monitorados = nos_monitorados;
+    resumo.tempo_execucao_s = tempo_execucao;
+    resumo.tempo_simulado_s = tempo_simulado;
+    if (!detector) {
+        resumo.convergencia_s = 0;
+    } else {
+        resumo.convergencia_s = detector->convergiu () ? detector->tempo_convergencia () : -1;
+    }
+    resumo.bytes_controle = medidor_controle.bytes_total ();
+
+    perfil.fase ("destruicao");
     Simulator::Destroy ();
+    perfil.terminar ();
 
+    gravar_perfil (parametros, sistemas, perfil, nome_arquivo_saida);
     return 0;
 }
+
+std::string arquivo_parcial(const std::string &resumo_lote, uint32_t indice) {
+    std::ostringstream nome;
+    nome << resumo_lote << "." << indice << ".parcial";
+    return nome.str ();
+}
+
+/**
+ * Roda cada cenario da lista com as sementes 1..sementes, cada execucao em
+ * um processo proprio, e junta os resumos em um unico CSV.
+ */
+int executar_lote (const Parametros &parametros) {
+    std::vector<Cenario> cenarios = cenarios_padrao (parametros.tempo_fim);
+    std::vector<std::string> nomes = separar_nomes (cenarios, parametros.lote);
+    for (size_t i = 0; i < nomes.size (); ++i) {
+        if (buscar_cenario (cenarios, nomes[i]) == 0) {
+            NS_FATAL_ERROR ("Cenario desconhecido no lote: " << nomes[i]);
+        }
+    }
+    uint32_t sementes = parametros.sementes > 0 ? parametros.sementes : 1;
+    uint32_t total = nomes.size () * sementes;
+
+    std::ofstream consolidado (parametros.resumo_lote.c_str ());
+    consolidado << "cenario,semente," << cabecalho_resumo_csv () << std::endl;
+
+    NS_LOG_INFO ("Run " << total << " simulations in batch.");
+    std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now ();
+    uint32_t falhas = 0;
+
+    executar_em_processos (parametros.processos,
+        [&] (uint32_t indice) {
+            return indice < total;
+        },
+        [&] (uint32_t indice) {
+            Parametros execucao = parametros;
+            execucao.lote = "";
+            execucao.relatorio = false;
+            execucao.cenario = nomes[indice / sementes];
+            uint32_t semente = indice % sementes + 1;
+            std::ostringstream saida;
+            saida << execucao.cenario << "_" << semente << ".xml";
+            execucao.saida = saida.str ();
+
+            RngSeedManager::SetRun (semente);
+            ResumoExecucao resumo;
+            int codigo = executar_simulacao (execucao, resumo);
+
+            std::ofstream parcial (arquivo_parcial (parametros.resumo_lote, indice).c_str ());
+            parcial << execucao.cenario << ',' << semente << ',';
+            escrever_resumo_csv (parcial, resumo);
+            parcial << std::endl;
+            return codigo;
+        },
+        [&] (uint32_t indice, bool sucesso) {
+            if (!sucesso || !juntar_arquivo (arquivo_parcial (parametros.resumo_lote, indice), consolidado)) {
+                std::cerr << "Execucao " << nomes[indice / sementes] << ", semente " << indice % sementes + 1 << " falhou" << std::endl;
+                falhas++;
+            }
+        });
+
+    std::cout << "Lote: " << total - falhas << " de " << total << " execucoes concluidas em "
+              << segundos_desde (inicio) << " s, resumo em " << parametros.resumo_lote << std::endl;
+    return falhas == 0 ? 0 : 1;
+}
+
+/**
+ * Execucoes de referencia do benchmark: os cenarios fixos e topologias
+ * geradas cada vez maiores.
+ */
+std::vector<std::pair<std::string, Parametros> > referencias_benchmark(const Parametros &parametros) {
+    std::vector<std::pair<std::string, Parametros> > referencias;
+    Parametros base = parametros;
+    base.relatorio = false;
+    base.benchmark = false;
+    base.perfil = "";
+
+    std::vector<Cenario> cenarios = cenarios_padrao (parametros.tempo_fim);
+    for (size_t i = 0; i < cenarios.size (); ++i) {
+        Parametros execucao = base;
+        execucao.gerar = false;
+        execucao.cenario = cenarios[i].nome;
+        execucao.saida = "benchmark_" + cenarios[i].nome + ".xml";
+        referencias.push_back (std::make_pair (cenarios[i].nome, execucao));
+    }
+
+    const uint32_t regioes[] = { 4, 16, 64 };
+    for (size_t i = 0; i < sizeof (regioes) / sizeof (regioes[0]); ++i) {
+        Parametros execucao = base;
+        execucao.gerar = true;
+        execucao.gerador = ParametrosGerador ();
+        execucao.gerador.regioes = regioes[i];
+        execucao.fluxos_gerados = 5 * regioes[i];
+        std::ostringstream nome;
+        nome << "gerada_" << nos_gerados (execucao.gerador);
+        execucao.saida = "benchmark_" + nome.str () + ".xml";
+        referencias.push_back (std::make_pair (nome.str (), execucao));
+    }
+    return referencias;
+}
+
+/** Resultado de uma execucao de referencia, a partir do perfil dela. */
+ResultadoBenchmark resultado_do_perfil(const std::string &referencia, const PerfilExecucao &perfil) {
+    ResultadoBenchmark resultado;
+    resultado.referencia = referencia;
+    resultado.nos = perfil.nos ();
+    resultado.enlaces = perfil.enlaces ();
+    resultado.eventos = perfil.eventos ();
+    resultado.tempo_total_s = perfil.total_segundos ();
+    resultado.tempo_montagem_s = perfil.segundos ("topologia") + perfil.segundos ("roteamento") + perfil.segundos ("fluxos");
+    resultado.tempo_execucao_s = perfil.segundos ("execucao");
+    resultado.eventos_por_s = perfil.eventos_por_segundo ();
+    resultado.pico_memoria_kb = pico_memoria_kb ();
+    resultado.alocacoes = perfil.alocacoes ();
+    resultado.bytes_por_no = perfil.bytes_por_no ();
+    resultado.bytes_por_enlace = perfil.bytes_por_enlace ();
+    return resultado;
+}
+
+/**
+ * Roda as execucoes de referencia, uma de cada vez e cada uma em um
+ * processo proprio (para nao disputarem CPU nem herdarem memoria), grava os
+ * resultados e compara com a base, se houver. Com repeticoes, fica a
+ * execucao mais rapida de cada referencia.
+ */
+int executar_benchmark (const Parametros &parametros) {
+    std::vector<std::pair<std::string, Parametros> > referencias = referencias_benchmark (parametros);
+    uint32_t repeticoes = parametros.repeticoes_benchmark > 0 ? parametros.repeticoes_benchmark : 1;
+    uint32_t total = referencias.size () * repeticoes;
+    std::string parciais = parametros.resultado_benchmark;
+
+    std::vector<ResultadoBenchmark> resultados (referencias.size ());
+    std::vector<bool> obtido (referencias.size (), false);
+    uint32_t falhas = 0;
+
+    executar_em_processos (1,
+        [&] (uint32_t indice) {
+            return indice < total;
+        },
+        [&] (uint32_t indice) {
+            const std::pair<std::string, Parametros> &referencia = referencias[indice / repeticoes];
+            RngSeedManager::SetRun (1);
+            ResumoExecucao resumo;
+            PerfilExecucao perfil;
+            int codigo = executar_simulacao (referencia.second, resumo, &perfil);
+
+            ResultadoBenchmark resultado = resultado_do_perfil (referencia.first, perfil);
+            std::ofstream parcial (arquivo_parcial (parciais, indice).c_str ());
+            escrever_benchmark_csv (parcial, resultado);
+            return codigo;
+        },
+        [&] (uint32_t indice, bool sucesso) {
+            uint32_t referencia = indice / repeticoes;
+            std::string nome = arquivo_parcial (parciais, indice);
+            std::ifstream parcial (nome.c_str ());
+            std::map<std::string, ResultadoBenchmark> lido = ler_benchmark_csv (parcial);
+            parcial.close ();
+            std::remove (nome.c_str ());
+            if (!sucesso || lido.empty ()) {
+                std::cerr << "Benchmark " << referencias[referencia].first << " falhou" << std::endl;
+                falhas++;
+                return;
+            }
+            const ResultadoBenchmark &resultado = lido.begin ()->second;
+            if (!obtido[referencia] || resultado.tempo_total_s < resultados[referencia].tempo_total_s) {
+                resultados[referencia] = resultado;
+                obtido[referencia] = true;
+            }
+            std::cout << "Benchmark " << resultado.referencia << ": " << resultado.tempo_total_s << " s, "
+                      << resultado.eventos_por_s << " eventos/s, " << resultado.pico_memoria_kb / 1024.0 << " MB, "
+                      << resultado.bytes_por_no << " bytes/noh, " << resultado.bytes_por_enlace << " bytes/enlace" << std::endl;
+        });
+
+    std::vector<ResultadoBenchmark> atuais;
+    std::ofstream saida (parametros.resultado_benchmark.c_str ());
+    saida << cabecalho_benchmark_csv () << std::endl;
+    for (size_t i = 0; i < resultados.size (); ++i) {
+        if (obtido[i]) {
+            escrever_benchmark_csv (saida, resultados[i]);
+            atuais.push_back (resultados[i]);
+        }
+    }
+    std::cout << "Resultados do benchmark em " << parametros.resultado_benchmark << std::endl;
+
+    if (parametros.base_benchmark.empty ()) {
+        return falhas == 0 ? 0 : 1;
+    }
+    std::ifstream arquivo_base (parametros.base_benchmark.c_str ());
+    if (!arquivo_base) {
+        NS_FATAL_ERROR ("Nao foi possivel abrir a base do benchmark " << parametros.base_benchmark);
+    }
+    std::map<std::string, ResultadoBenchmark> base = ler_benchmark_csv (arquivo_base);
+    std::cout << "Comparacao com " << parametros.base_benchmark << " (tolerancia "
+              << parametros.tolerancia_benchmark * 100 << "%):" << std::endl;
+    uint32_t regressoes = comparar_benchmark (base, atuais, parametros.tolerancia_benchmark, std::cout);
+    std::cout << regressoes << " regressoes" << std::endl;
+    return falhas == 0 && regressoes == 0 ? 0 : 1;
+}
+
+/**
+ * Roda as referencias do benchmark com cada escalonador, cada execucao em
+ * um processo proprio e com a mesma semente, entao cada referencia gera a
+ * mesma sequencia de eventos em todos os escalonadores. Com repeticoes,
+ * fica a execucao mais rapida de cada par.
+ */
+int executar_comparacao_escalonadores (const Parametros &parametros) {
+    std::vector<std::pair<std::string, Parametros> > referencias = referencias_benchmark (parametros);
+    std::vector<std::string> escalonadores = nomes_escalonadores ();
+    uint32_t repeticoes = parametros.repeticoes_benchmark > 0 ? parametros.repeticoes_benchmark : 1;
+    uint32_t execucoes = referencias.size () * escalonadores.size ();
+    uint32_t total = execucoes * repeticoes;
+    std::string parciais = parametros.resultado_escalonadores;
+
+    std::vector<ResultadoBenchmark> resultados (execucoes);
+    std::vector<bool> obtido (execucoes, false);
+    uint32_t falhas = 0;
+
+    executar_em_processos (1,
+        [&] (uint32_t indice) {
+            return indice < total;
+        },
+        [&] (uint32_t indice) {
+            uint32_t execucao = indice / repeticoes;
+            const std::pair<std::string, Parametros> &referencia = referencias[execucao / escalonadores.size ()];
+            Parametros com_escalonador = referencia.second;
+            com_escalonador.escalonador = escalonadores[execucao % escalonadores.size ()];
+            RngSeedManager::SetRun (1);
+            ResumoExecucao resumo;
+            PerfilExecucao perfil;
+            int codigo = executar_simulacao (com_escalonador, resumo, &perfil);
+
+            ResultadoBenchmark resultado = resultado_do_perfil (referencia.first, perfil);
+            std::ofstream parcial (arquivo_parcial (parciais, indice).c_str ());
+            escrever_benchmark_csv (parcial, resultado);
+            return codigo;
+        },
+        [&] (uint32_t indice, bool sucesso) {
+            uint32_t execucao = indice / repeticoes;
+            const std::string &escalonador = escalonadores[execucao % escalonadores.size ()];
+            std::string nome = arquivo_parcial (parciais, indice);
+            std::ifstream parcial (nome.c_str ());
+            std::map<std::string, ResultadoBenchmark> lido = ler_benchmark_csv (parcial);
+            parcial.close ();
+            std::remove (nome.c_str ());
+            if (!sucesso || lido.empty ()) {
+                std::cerr << "Escalonador " << escalonador << " em " << referencias[execucao / escalonadores.size ()].first
+                          << " falhou" << std::endl;
+                falhas++;
+                return;
+            }
+            const ResultadoBenchmark &resultado = lido.begin ()->second;
+            if (!obtido[execucao] || resultado.tempo_execucao_s < resultados[execucao].tempo_execucao_s) {
+                resultados[execucao] = resultado;
+                obtido[execucao] = true;
+            }
+            std::cout << "Escalonador " << escalonador << " em " << resultado.referencia << ": " << resultado.eventos_por_s
+                      << " eventos/s, " << resultado.pico_memoria_kb / 1024.0 << " MB" << std::endl;
+        });
+
+    std::ofstream saida (parametros.resultado_escalonadores.c_str ());
+    saida << "escalonador," << cabecalho_benchmark_csv () << std::endl;
+    for (size_t r = 0; r < referencias.size (); ++r) {
+        int32_t melhor = -1;
+        for (size_t e = 0; e < escalonadores.size (); ++e) {
+            uint32_t execucao = r * escalonadores.size () + e;
+            if (!obtido[execucao]) {
+                continue;
+            }
+            saida << escalonadores[e] << ',';
+            escrever_benchmark_csv (saida, resultados[execucao]);
+            if (melhor < 0 || resultados[execucao].eventos_por_s > resultados[melhor].eventos_por_s) {
+                melhor = execucao;
+            }
+            // A mesma semente tem que dar os mesmos eventos em qualquer escalonador
+            uint32_t primeira = r * escalonadores.size ();
+            if (obtido[primeira] && resultados[execucao].eventos != resultados[primeira].eventos) {
+                std::cerr << referencias[r].first << ": " << escalonadores[e] << " executou " << resultados[execucao].eventos
+                          << " eventos e " << escalonadores[0] << " " << resultados[primeira].eventos << std::endl;
+            }
+        }
+        if (melhor >= 0) {
+            std::cout << referencias[r].first << ": mais rapido " << escalonadores[melhor % escalonadores.size ()] << " ("
+                      << resultados[melhor].eventos_por_s << " eventos/s)" << std::endl;
+        }
+    }
+    std::cout << "Resultados dos escalonadores em " << parametros.resultado_escalonadores << std::endl;
+    return falhas == 0 ? 0 : 1;
+}
+
+/**
+ * Aplica um parametro da varredura. Devolve false para nomes desconhecidos.
+ */
+bool aplicar_parametro (Parametros &parametros, const std::string &nome, const std::string &valor) {
+    if (nome == "taxa") {
+        parametros.taxa_fluxos = valor;
+    } else if (nome == "tamanho") {
+        parametros.tamanho_pacote = std::strtoul (valor.c_str (), 0, 10);
+    } else if (nome == "fila_global") {
+        parametros.opcoes_topologia.fila_global = valor;
+    } else if (nome == "fila_comum") {
+        parametros.opcoes_topologia.fila_comum = valor;
+    } else if (nome == "disciplina") {
+        parametros.opcoes_topologia.disciplina_fila = valor;
+    } else if (nome == "red_min") {
+        parametros.red_min_th = std::atof (valor.c_str ());
+    } else if (nome == "red_max") {
+        parametros.red_max_th = std::atof (valor.c_str ());
+    } else if (nome == "cenario") {
+        parametros.cenario = valor;
+    } else if (nome.compare (0, 7, "classe.") == 0 && nome.size () > 7) {
+        size_t ponto = nome.find_last_of ('.');
+        std::string classe = nome.substr (7, ponto - 7);
+        std::string atributo = nome.substr (ponto + 1);
+        if (ponto <= 7 || (atributo != "taxa" && atributo != "atraso")) {
+            return false;
+        }
+        std::map<std::string, std::string> &valores = atributo == "taxa" ? parametros.opcoes_topologia.taxa_classe
+                                                                         : parametros.opcoes_topologia.atraso_classe;
+        valores[classe] = valor;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Roda os pontos de uma varredura de parametros em processos paralelos. A
+ * tabela de resultados tem uma linha por ponto, com os valores dos
+ * parametros seguidos do resumo da execucao, e cada ponto eh gravado assim
+ * que termina: rodar de novo com a mesma tabela pula os pontos ja feitos.
+ */
+int executar_varredura (const Parametros &parametros) {
+    std::ifstream arquivo (parametros.varredura.c_str ());
+    if (!arquivo) {
+        NS_FATAL_ERROR ("Nao foi possivel abrir a varredura " << parametros.varredura);
+    }
+    std::vector<DimensaoVarredura> dimensoes;
+    ler_dimensoes_varredura (arquivo, dimensoes);
+
+    DesenhoVarredura desenho;
+    if (parametros.desenho == "grade") {
+        desenho = desenho_grade (dimensoes, parametros.passos_faixa);
+    } else if (parametros.desenho == "lhs") {
+        desenho = desenho_hipercubo (dimensoes, parametros.pontos_varredura, parametros.semente_varredura);
+    } else {
+        NS_FATAL_ERROR ("Desenho de varredura desconhecido: " << parametros.desenho << " (use grade ou lhs)");
+    }
+    Parametros teste = parametros;
+    for (size_t i = 0; i < desenho.parametros.size (); ++i) {
+        if (!aplicar_parametro (teste, desenho.parametros[i], desenho.pontos[0][i])) {
+            NS_FATAL_ERROR ("Parametro de varredura desconhecido: " << desenho.parametros[i]
+                            << " (use taxa, tamanho, fila_global, fila_comum, disciplina, red_min, red_max, cenario,"
+                            << " classe.<nome>.taxa ou classe.<nome>.atraso)");
+        }
+    }
+
+    std::string cabecalho = "ponto," + chave_do_ponto (desenho.parametros) + "," + cabecalho_resumo_csv ();
+    std::set<std::string> concluidos;
+    {
+        std::ifstream anterior (parametros.resultado_varredura.c_str ());
+        std::string linha;
+        if (std::getline (anterior, linha)) {
+            if (linha != cabecalho) {
+                NS_FATAL_ERROR ("A tabela " << parametros.resultado_varredura << " eh de outra varredura (cabecalho diferente)");
+            }
+            while (std::getline (anterior, linha)) {
+                size_t inicio = linha.find (',') + 1;
+                size_t fim = inicio;
+                for (size_t i = 0; i < desenho.parametros.size () && fim != std::string::npos; ++i) {
+                    fim = linha.find (',', fim + (i > 0 ? 1 : 0));
+                }
+                if (inicio > 0 && fim != std::string::npos) {
+                    concluidos.insert (linha.substr (inicio, fim - inicio));
+                }
+            }
+        }
+    }
+    std::vector<uint32_t> pendentes;
+    for (uint32_t i = 0; i < desenho.pontos.size (); ++i) {
+        if (concluidos.count (chave_do_ponto (desenho.pontos[i])) == 0) {
+            pendentes.push_back (i);
+        }
+    }
+
+    std::ofstream tabela;
+    if (concluidos.empty ()) {
+        tabela.open (parametros.resultado_varredura.c_str ());
+        tabela << cabecalho << std::endl;
+    } else {
+        tabela.open (parametros.resultado_varredura.c_str (), std::ios::app);
+    }
+    std::cout << "Varredura: " << desenho.pontos.size () << " pontos (" << parametros.desenho << "), "
+              << desenho.pontos.size () - pendentes.size () << " ja concluidos" << std::endl;
+
+    std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now ();
+    uint32_t falhas = 0;
+    executar_em_processos (parametros.processos,
+        [&] (uint32_t indice) {
+            return indice < pendentes.size ();
+        },
+        [&] (uint32_t indice) {
+            uint32_t ponto = pendentes[indice];
+            Parametros execucao = parametros;
+            execucao.varredura = "";
+            execucao.relatorio = false;
+            for (size_t i = 0; i < desenho.parametros.size (); ++i) {
+                aplicar_parametro (execucao, desenho.parametros[i], desenho.pontos[ponto][i]);
+            }
+            std::ostringstream saida;
+            saida << "varredura_" << ponto << ".xml";
+            execucao.saida = saida.str ();
+
+            ResumoExecucao resumo;
+            int codigo = executar_simulacao (execucao, resumo);
+
+            std::ofstream parcial (arquivo_parcial (parametros.resultado_varredura, ponto).c_str ());
+            parcial << ponto << ',' << chave_do_ponto (desenho.pontos[ponto]) << ',';
+            escrever_resumo_csv (parcial, resumo);
+            parcial << std::endl;
+            return codigo;
+        },
+        [&] (uint32_t indice, bool sucesso) {
+            uint32_t ponto = pendentes[indice];
+            if (!sucesso || !juntar_arquivo (arquivo_parcial (parametros.resultado_varredura, ponto), tabela)) {
+                std::cerr << "Ponto " << ponto << " (" << chave_do_ponto (desenho.pontos[ponto]) << ") falhou" << std::endl;
+                falhas++;
+            }
+        });
+
+    std::cout << "Varredura: " << pendentes.size () - falhas << " de " << pendentes.size () << " pontos executados em "
+              << segundos_desde (inicio) << " s, tabela em " << parametros.resultado_varredura << std::endl;
+    return falhas == 0 ? 0 : 1;
+}
+
+/**
+ * Replica cada cenario (os do Lote, ou o Cenario) com RngRun 1, 2, ... em
+ * processos paralelos ate que o intervalo de confianca das metricas alvo
+ * fique estreito o bastante. Cada cenario para por conta propria, entao os
+ * mais ruidosos recebem mais replicacoes.
+ */
+int executar_replicacoes (const Parametros &parametros) {
+    std::vector<Cenario> cenarios = cenarios_padrao (parametros.tempo_fim);
+    std::vector<std::string> nomes;
+    if (parametros.lote.empty ()) {
+        nomes.push_back (parametros.cenario);
+    } else {
+        nomes = separar_nomes (cenarios, parametros.lote);
+    }
+    for (size_t i = 0; i < nomes.size (); ++i) {
+        if (buscar_cenario (cenarios, nomes[i]) == 0) {
+            NS_FATAL_ERROR ("Cenario desconhecido: " << nomes[i]);
+        }
+    }
+    uint32_t processos = parametros.processos > 0 ? parametros.processos : processadores_disponiveis ();
+
+    std::vector<ControleReplicacoes> controles (nomes.size (), ControleReplicacoes (parametros.min_replicacoes, parametros.max_replicacoes, parametros.meia_largura));
+    std::vector<uint32_t> rodando (nomes.size (), 0);
+    std::vector<uint32_t> iniciadas (nomes.size (), 0);
+    std::vector<bool> abandonado (nomes.size (), false);
+    // Cenario e numero da replicacao de cada tarefa
+    std::vector<std::pair<uint32_t, uint32_t> > tarefas;
+
+    std::ofstream tabela (parametros.resultado_replicacoes.c_str ());
+    tabela << "cenario,replicacao," << cabecalho_resumo_csv () << std::endl;
+
+    std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now ();
+    uint32_t falhas = 0;
+    executar_em_processos (processos,
+        [&] (uint32_t indice) {
+            // O cenario com menos replicacoes iniciadas que ainda precisa de mais
+            int32_t escolhido = -1;
+            for (uint32_t c = 0; c < nomes.size (); ++c) {
+                if (!abandonado[c] && controles[c].iniciar_mais (rodando[c], processos)
+                    && (escolhido < 0 || iniciadas[c] < iniciadas[escolhido])) {
+                    escolhido = c;
+                }
+            }
+            if (escolhido < 0) {
+                return false;
+            }
+            tarefas.resize (indice + 1);
+            tarefas[indice] = std::make_pair (uint32_t (escolhido), ++iniciadas[escolhido]);
+            rodando[escolhido]++;
+            return true;
+        },
+        [&] (uint32_t indice) {
+            Parametros execucao = parametros;
+            execucao.replicar = false;
+            execucao.relatorio = false;
+            execucao.cenario = nomes[tarefas[indice].first];
+            uint32_t replicacao = tarefas[indice].second;
+            std::ostringstream saida;
+            saida << execucao.cenario << "_r" << replicacao << ".xml";
+            execucao.saida = saida.str ();
+
+            RngSeedManager::SetRun (replicacao);
+            ResumoExecucao resumo;
+            int codigo = executar_simulacao (execucao, resumo);
+
+            std::ofstream parcial (arquivo_parcial (parametros.resultado_replicacoes, indice).c_str ());
+            escrever_resumo_csv (parcial, resumo);
+            parcial << std::endl;
+            return codigo;
+        },
+        [&] (uint32_t indice, bool sucesso) {
+            uint32_t cenario = tarefas[indice].first;
+            uint32_t replicacao = tarefas[indice].second;
+            rodando[cenario]--;
+            std::string nome = arquivo_parcial (parametros.resultado_replicacoes, indice);
+            std::ifstream parcial (nome.c_str ());
+            std::string linha;
+            ResumoExecucao resumo;
+            bool lido = std::getline (parcial, linha) && ler_resumo_csv (linha, resumo);
+            parcial.close ();
+            std::remove (nome.c_str ());
+            if (!sucesso || !lido) {
+                // Uma replicacao que falha tende a falhar de novo; o cenario para aqui
+                std::cerr << "Replicacao " << replicacao << " de " << nomes[cenario] << " falhou" << std::endl;
+                abandonado[cenario] = true;
+                falhas++;
+                return;
+            }
+            controles[cenario].adicionar (replicacao, resumo);
+            tabela << nomes[cenario] << ',' << replicacao << ',' << linha << std::endl;
+        });
+
+    std::string nome_intervalos = trocar_extensao (parametros.resultado_replicacoes, ".ic.csv");
+    std::ofstream intervalos (nome_intervalos.c_str ());
+    intervalos << "cenario,replicacoes,metrica,media,meia_largura_95,convergiu" << std::endl;
+    uint32_t total = 0;
+    for (size_t c = 0; c < nomes.size (); ++c) {
+        controles[c].imprimir (std::cout, nomes[c]);
+        controles[c].escrever_csv (intervalos, nomes[c]);
+        total += controles[c].replicacoes ();
+    }
+    std::cout << "Replicacoes: " << total << " execucoes em " << segundos_desde (inicio) << " s, resultados em "
+              << parametros.resultado_replicacoes << " e " << nome_intervalos << std::endl;
+    return falhas == 0 ? 0 : 1;
+}
+
+/**
+ * Roda o mesmo conjunto de fluxos duas vezes, todo em pacotes e no modo
+ * hibrido, e compara as medidas dos fluxos de frente, os eventos
+ * processados e o tempo de execucao.
+ */
+int executar_comparacao_hibrido (const Parametros &parametros) {
+    const char *modos[] = { "completo", "hibrido" };
+    std::vector<std::map<std::string, MedidaFrente> > medidas (2);
+    std::vector<uint64_t> eventos (2, 0);
+    std::vector<double> tempos (2, 0);
+    uint32_t falhas = 0;
+
+    executar_em_processos (1,
+        [&] (uint32_t indice) {
+            return indice < 2;
+        },
+        [&] (uint32_t indice) {
+            Parametros execucao = parametros;
+            execucao.comparar_hibrido = false;
+            execucao.relatorio = false;
+            execucao.hibrido = indice == 1;
+            execucao.saida = std::string ("comparacao_") + modos[indice] + ".xml";
+            execucao.tabela_frente = arquivo_parcial (parametros.resultado_hibrido, indice);
+            ResumoExecucao resumo;
+            return executar_simulacao (execucao, resumo);
+        },
+        [&] (uint32_t indice, bool sucesso) {
+            std::string nome = arquivo_parcial (parametros.resultado_hibrido, indice);
+            std::ifstream parcial (nome.c_str ());
+            if (!sucesso || !(parcial >> eventos[indice] >> tempos[indice])) {
+                std::cerr << "Execucao " << modos[indice] << " falhou" << std::endl;
+                falhas++;
+            } else {
+                medidas[indice] = ler_fluxos_frente (parcial);
+            }
+            parcial.close ();
+            std::remove (nome.c_str ());
+        });
+    if (falhas > 0) {
+        return 1;
+    }
+
+    std::cout << "Completo: " << eventos[0] << " eventos em " << tempos[0] << " s; hibrido: "
+              << eventos[1] << " eventos em " << tempos[1] << " s";
+    if (eventos[1] > 0 && tempos[1] > 0) {
+        std::cout << " (" << double (eventos[0]) / eventos[1] << "x menos eventos, speedup " << tempos[0] / tempos[1] << ")";
+    }
+    std::cout << std::endl;
+    std::ofstream tabela (parametros.resultado_hibrido.c_str ());
+    comparar_hibrido (medidas[0], medidas[1], tabela, std::cout);
+    std::cout << "Erro por fluxo em " << parametros.resultado_hibrido << std::endl;
+    return 0;
+}
+
+/**
+ * Roda o mesmo cenario com o FlowMonitor em todos os nohs e so nos
+ * extremos dos fluxos e informa quanto o monitoramento seletivo economiza
+ * em tempo, alocacoes e memoria, conferindo que o resumo dos fluxos nao muda.
+ */
+int executar_comparacao_monitoramento (const Parametros &parametros) {
+    const char *modos[] = { "todos", "extremos" };
+    struct Custo {
+        uint32_t nos = 0;
+        double instrumentacao_s = 0;
+        double execucao_s = 0;
+        uint64_t alocacoes = 0;
+        long pico_memoria_kb = 0;
+        ResumoExecucao resumo;
+    };
+    std::vector<Custo> custos (2);
+    uint32_t falhas = 0;
+
+    executar_em_processos (1,
+        [&] (uint32_t indice) {
+            return indice < 2;
+        },
+        [&] (uint32_t indice) {
+            Parametros execucao = parametros;
+            execucao.comparar_monitoramento = false;
+            execucao.relatorio = false;
+            execucao.enableFlowMonitor = true;
+            execucao.monitoramento = modos[indice];
+            execucao.saida = std::string ("monitoramento_") + modos[indice] + ".xml";
+            PerfilExecucao perfil;
+            ResumoExecucao resumo;
+            int codigo = executar_simulacao (execucao, resumo, &perfil);
+
+            std::ofstream parcial (arquivo_parcial (parametros.resultado_monitoramento, indice).c_str ());
+            parcial << resumo.nos_monitorados << ' ' << perfil.segundos ("instrumentacao") << ' ' << perfil.segundos ("execucao") << ' '
+                    << perfil.alocacoes () << ' ' << pico_memoria_kb () << std::endl;
+            escrever_resumo_csv (parcial, resumo);
+            parcial << std::endl;
+            return codigo;
+        },
+        [&] (uint32_t indice, bool sucesso) {
+            std::string nome = arquivo_parcial (parametros.resultado_monitoramento, indice);
+            std::ifstream parcial (nome.c_str ());
+            Custo &custo = custos[indice];
+            std::string linha;
+            bool lido = parcial >> custo.nos >> custo.instrumentacao_s >> custo.execucao_s >> custo.alocacoes >> custo.pico_memoria_kb
+                && std::getline (parcial >> std::ws, linha) && ler_resumo_csv (linha, custo.resumo);
+            if (!sucesso || !lido) {
+                std::cerr << "Execucao com monitoramento " << modos[indice] << " falhou" << std::endl;
+                falhas++;
+            }
+            parcial.close ();
+            std::remove (nome.c_str ());
+        });
+    if (falhas > 0) {
+        return 1;
+    }
+
+    std::ofstream tabela (parametros.resultado_monitoramento.c_str ());
+    tabela << "monitoramento,nos_monitorados,instrumentacao_s,execucao_s,alocacoes,pico_memoria_kb," << cabecalho_resumo_csv () << std::endl;
+    for (uint32_t i = 0; i < 2; ++i) {
+        const Custo &custo = custos[i];
+        tabela << modos[i] << ',' << custo.nos << ',' << custo.instrumentacao_s << ',' << custo.execucao_s << ','
+               << custo.alocacoes << ',' << custo.pico_memoria_kb << ',';
+        escrever_resumo_csv (tabela, custo.resumo);
+        tabela << std::endl;
+        std::cout << "Monitoramento " << modos[i] << ": " << custo.nos << " nos, execucao " << custo.execucao_s << " s, "
+                  << custo.alocacoes << " alocacoes, pico " << custo.pico_memoria_kb << " kB" << std::endl;
+    }
+    const Custo &todos = custos[0];
+    const Custo &extremos = custos[1];
+    if (extremos.execucao_s > 0 && todos.alocacoes > 0) {
+        std::cout << "Economia dos extremos: speedup " << todos.execucao_s / extremos.execucao_s << " no Run, "
+                  << 100.0 * (1.0 - double (extremos.alocacoes) / todos.alocacoes) << "% menos alocacoes, "
+                  << todos.pico_memoria_kb - extremos.pico_memoria_kb << " kB a menos de pico" << std::endl;
+    }
+    if (todos.resumo.pacotes_tx != extremos.resumo.pacotes_tx || todos.resumo.pacotes_rx != extremos.resumo.pacotes_rx) {
+        std::cout << "Atencao: pacotes diferentes entre os modos (tx " << todos.resumo.pacotes_tx << " x " << extremos.resumo.pacotes_tx
+                  << ", rx " << todos.resumo.pacotes_rx << " x " << extremos.resumo.pacotes_rx << ")" << std::endl;
+    }
+    std::cout << "Resultados em " << parametros.resultado_monitoramento << std::endl;
+    return 0;
+}
+
+/**
+ * Roda os grupos multicast e o envio unicast equivalente (um fluxo da
+ * origem para cada membro) e compara a carga dos enlaces, os eventos e o
+ * tempo de execucao.
+ */
+int executar_comparacao_multicast (const Parametros &parametros) {
+    const char *modos[] = { "multicast", "unicast" };
+    std::vector<std::vector<CargaSentido> > cargas (2);
+    std::vector<uint64_t> eventos (2, 0);
+    std::vector<double> tempos (2, 0);
+    uint32_t falhas = 0;
+
+    executar_em_processos (1,
+        [&] (uint32_t indice) {
+            return indice < 2;
+        },
+        [&] (uint32_t indice) {
+            Parametros execucao = parametros;
+            execucao.comparar_multicast = false;
+            execucao.relatorio = false;
+            execucao.multicast_unicast = indice == 1;
+            execucao.saida = std::string ("comparacao_") + modos[indice] + ".xml";
+            execucao.tabela_carga = arquivo_parcial (parametros.resultado_multicast, indice);
+            ResumoExecucao resumo;
+            return executar_simulacao (execucao, resumo);
+        },
+        [&] (uint32_t indice, bool sucesso) {
+            std::string nome = arquivo_parcial (parametros.resultado_multicast, indice);
+            std::ifstream parcial (nome.c_str ());
+            if (!sucesso || !(parcial >> eventos[indice] >> tempos[indice])) {
+                std::cerr << "Execucao " << modos[indice] << " falhou" << std::endl;
+                falhas++;
+            } else {
+                cargas[indice] = ler_carga (parcial);
+            }
+            parcial.close ();
+            std::remove (nome.c_str ());
+        });
+    if (falhas > 0 || cargas[0].size () != cargas[1].size ()) {
+        return 1;
+    }
+
+    std::ofstream tabela (parametros.resultado_multicast.c_str ());
+    tabela << "sentido,bytes_multicast,bytes_unicast" << std::endl;
+    uint64_t total[2] = { 0, 0 };
+    uint64_t maior[2] = { 0, 0 };
+    for (size_t s = 0; s < cargas[0].size (); ++s) {
+        for (uint32_t i = 0; i < 2; ++i) {
+            total[i] += cargas[i][s].bytes;
+            maior[i] = std::max (maior[i], cargas[i][s].bytes);
+        }
+        if (cargas[0][s].bytes > 0 || cargas[1][s].bytes > 0) {
+            tabela << cargas[0][s].sentido << ',' << cargas[0][s].bytes << ',' << cargas[1][s].bytes << std::endl;
+        }
+    }
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        std::cout << "Envio " << modos[i] << ": " << total[i] << " bytes nos enlaces (maior sentido " << maior[i] << "), "
+                  << eventos[i] << " eventos em " << tempos[i] << " s" << std::endl;
+    }
+    if (total[0] > 0 && eventos[0] > 0 && tempos[0] > 0) {
+        std::cout << "Multicast: " << double (total[1]) / total[0] << "x menos bytes, " << double (eventos[1]) / eventos[0]
+                  << "x menos eventos, speedup " << tempos[1] / tempos[0] << std::endl;
+    }
+    std::cout << "Carga por sentido de enlace em " << parametros.resultado_multicast << std::endl;
+    return 0;
+}
+
+/**
+ * Roda cada cenario (os do Lote, ou a configuracao atual) com roteamento
+ * global e ecmp e compara a vazao agregada e o equilibrio da utilizacao
+ * dos enlaces. O equilibrio (indice de Jain) eh medido nos sentidos que
+ * levaram trafego em pelo menos um dos dois roteamentos.
+ */
+int executar_comparacao_ecmp (const Parametros &parametros) {
+    const char *modos[] = { "global", "ecmp" };
+    std::vector<std::string> nomes;
+    if (parametros.lote.empty ()) {
+        nomes.push_back (parametros.gerar ? "gerada" : !parametros.matriz_fluxos.empty () ? parametros.matriz_fluxos : parametros.cenario);
+    } else {
+        std::vector<Cenario> cenarios = cenarios_padrao (parametros.tempo_fim);
+        nomes = separar_nomes (cenarios, parametros.lote);
+        for (size_t i = 0; i < nomes.size (); ++i) {
+            if (buscar_cenario (cenarios, nomes[i]) == 0) {
+                NS_FATAL_ERROR ("Cenario desconhecido: " << nomes[i]);
+            }
+        }
+    }
+    std::string resultado_carga = parametros.resultado_ecmp + ".carga";
+    uint32_t execucoes = 2 * nomes.size ();
+    std::vector<ResumoExecucao> resumos (execucoes);
+    std::vector<std::vector<CargaSentido> > cargas (execucoes);
+    std::vector<uint64_t> eventos (execucoes, 0);
+    std::vector<bool> concluida (execucoes, false);
+
+    executar_em_processos (parametros.processos,
+        [&] (uint32_t indice) {
+            return indice < execucoes;
+        },
+        [&] (uint32_t indice) {
+            Parametros execucao = parametros;
+            execucao.comparar_ecmp = false;
+            execucao.relatorio = false;
+            execucao.roteamento = modos[indice % 2];
+            std::string rotulo = "comparacao";
+            if (!parametros.lote.empty ()) {
+                execucao.cenario = rotulo = nomes[indice / 2];
+            }
+            execucao.saida = rotulo + "_" + modos[indice % 2] + ".xml";
+            execucao.tabela_carga = arquivo_parcial (resultado_carga, indice);
+            ResumoExecucao resumo;
+            int codigo = executar_simulacao (execucao, resumo);
+
+            std::ofstream parcial (arquivo_parcial (parametros.resultado_ecmp, indice).c_str ());
+            escrever_resumo_csv (parcial, resumo);
+            parcial << std::endl;
+            return codigo;
+        },
+        [&] (uint32_t indice, bool sucesso) {
+            std::string nome_resumo = arquivo_parcial (parametros.resultado_ecmp, indice);
+            std::string nome_carga = arquivo_parcial (resultado_carga, indice);
+            std::ifstream parcial (nome_resumo.c_str ());
+            std::ifstream carga (nome_carga.c_str ());
+            std::string linha;
+            double tempo;
+            concluida[indice] = sucesso && std::getline (parcial, linha) && ler_resumo_csv (linha, resumos[indice])
+                                && (carga >> eventos[indice] >> tempo);
+            if (concluida[indice]) {
+                cargas[indice] = ler_carga (carga);
+            } else {
+                std::cerr << "Execucao " << modos[indice % 2] << " de " << nomes[indice / 2] << " falhou" << std::endl;
+            }
+            parcial.close ();
+            carga.close ();
+            std::remove (nome_resumo.c_str ());
+            std::remove (nome_carga.c_str ());
+        });
+
+    std::ofstream tabela (parametros.resultado_ecmp.c_str ());
+    tabela << "cenario,roteamento,vazao_mbps,pacotes_perdidos,atraso_medio_ms,utilizacao_maxima,utilizacao_media,jain_utilizacao,sentidos_usados,eventos,tempo_execucao_s" << std::endl;
+    std::string nome_enlaces = trocar_extensao (parametros.resultado_ecmp, ".enlaces.csv");
+    std::ofstream enlaces (nome_enlaces.c_str ());
+    enlaces << "cenario,sentido,utilizacao_global,utilizacao_ecmp" << std::endl;
+    uint32_t falhas = 0;
+    for (size_t c = 0; c < nomes.size (); ++c) {
+        uint32_t global = 2 * c;
+        uint32_t ecmp = 2 * c + 1;
+        if (!concluida[global] || !concluida[ecmp] || cargas[global].size () != cargas[ecmp].size ()) {
+            falhas++;
+            continue;
+        }
+        double maxima[2] = { 0, 0 };
+        double soma[2] = { 0, 0 };
+        double quadrados[2] = { 0, 0 };
+        uint32_t usados = 0;
+        for (size_t s = 0; s < cargas[global].size (); ++s) {
+            if (cargas[global][s].bytes == 0 && cargas[ecmp][s].bytes == 0) {
+                continue;
+            }
+            usados++;
+            double utilizacao[2];
+            for (uint32_t m = 0; m < 2; ++m) {
+                const CargaSentido &carga = cargas[2 * c + m][s];
+                double tempo = resumos[2 * c + m].tempo_simulado_s;
+                utilizacao[m] = tempo > 0 ? carga.bytes * 8.0 / (carga.capacidade_bps * tempo) : 0;
+                maxima[m] = std::max (maxima[m], utilizacao[m]);
+                soma[m] += utilizacao[m];
+                quadrados[m] += utilizacao[m] * utilizacao[m];
+            }
+            enlaces << nomes[c] << ',' << cargas[global][s].sentido << ',' << utilizacao[0] << ',' << utilizacao[1] << std::endl;
+        }
+        double jain[2];
+        for (uint32_t m = 0; m < 2; ++m) {
+            const ResumoExecucao &resumo = resumos[2 * c + m];
+            jain[m] = quadrados[m] > 0 ? soma[m] * soma[m] / (usados * quadrados[m]) : 1;
+            tabela << nomes[c] << ',' << modos[m] << ',' << resumo.vazao_mbps << ',' << resumo.pacotes_perdidos << ','
+                   << resumo.atraso_medio_ms << ',' << maxima[m] << ',' << (usados > 0 ? soma[m] / usados : 0) << ','
+                   << jain[m] << ',' << usados << ',' << eventos[2 * c + m] << ',' << resumo.tempo_execucao_s << std::endl;
+        }
+        std::cout << nomes[c] << ": vazao " << resumos[global].vazao_mbps << " -> " << resumos[ecmp].vazao_mbps << " Mbps";
+        if (resumos[global].vazao_mbps > 0) {
+            std::cout << " (" << (resumos[ecmp].vazao_mbps / resumos[global].vazao_mbps - 1) * 100 << "%)";
+        }
+        std::cout << ", utilizacao maxima " << maxima[0] << " -> " << maxima[1] << ", Jain " << jain[0] << " -> " << jain[1] << std::endl;
+    }
+    std::cout << "Resultados em " << parametros.resultado_ecmp << " e " << nome_enlaces << std::endl;
+    return falhas == 0 ? 0 : 1;
+}
+
+/**
+ * Converte o pcap de --ImportarPcap no trace de --Trace, com os enderecos
+ * traduzidos para nohs pelo --MapaEnderecos.
+ */
+int executar_importacao_pcap (const Parametros &parametros) {
+    if (parametros.trace.empty () || parametros.mapa_enderecos.empty ()) {
+        NS_FATAL_ERROR ("ImportarPcap precisa do arquivo de saida em --Trace e do mapa em --MapaEnderecos");
+    }
+    std::ifstream mapa (parametros.mapa_enderecos.c_str ());
+    if (!mapa) {
+        NS_FATAL_ERROR ("Nao foi possivel abrir o mapa de enderecos " << parametros.mapa_enderecos);
+    }
+    std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now ();
+    ResumoImportacao resumo = importar_pcap (parametros.importar_pcap, mapa, parametros.trace);
+    std::cout << "Importacao: " << resumo.pacotes << " pacotes lidos, " << resumo.importados << " importados em "
+              << resumo.fluxos << " fluxos; descartados " << resumo.sem_mapa << " fora do mapa, " << resumo.sem_dados
+              << " sem dados e " << resumo.outros << " nao TCP/UDP; " << resumo.reordenados << " fora de ordem; "
+              << segundos_desde (inicio) << " s" << std::endl;
+    return 0;
+}
+
+int main (int argc, char *argv[]) {
+  // Users may find it convenient to turn on explicit debugging
+  // for selected modules; the below lines suggest how to do this
+#if 1 
+  LogComponentEnable ("SimpleGlobalRoutingExample", LOG_LEVEL_INFO);
+#endif
+
+  // Set up some default values for the simulation.  Use the 
+  //Config::SetDefault ("ns3::OnOffApplication::PacketSize", UintegerValue (1024));
+  //Config::SetDefault ("ns3::OnOffApplication::DataRate", StringValue ("100Mb/s"));
+
+  //DefaultValue::Bind ("DropTailQueue::m_maxPackets", 30);
+
+  // Allow the user to override any of the defaults and the above
+  // DefaultValue::Bind ()s at run-time, via command-line arguments
+  CommandLine cmd;
+  Parametros parametros;
+  cmd.AddValue ("EnableMonitor", "Enable Flow Monitor", parametros.enableFlowMonitor);
+  cmd.AddValue ("Monitoramento", "Nohs com sonda do FlowMonitor: todos ou extremos (so origens e destinos dos fluxos)", parametros.monitoramento);
+  cmd.AddValue ("CacheRotas", "Diretorio do cache das tabelas do roteamento global, reutilizadas pelas execucoes com a mesma topologia e enderecos (vazio desliga)", parametros.cache_rotas);
+  cmd.AddValue ("VerificarCache", "CacheRotas: recalcula as tabelas mesmo com cache e falha se forem diferentes", parametros.verificar_cache);
+  cmd.AddValue ("Enxuto", "Modo enxuto para topologias grandes: sem pilha IPv6, hosts so com rota padrao (global) e FlowMonitor so nos extremos", parametros.enxuto);
+  cmd.AddValue ("AmostragemAtraso", "Histogramas de atraso e jitter com 1 em cada N pacotes, gravados em <saida>.histogramas.csv (0 desliga)", parametros.amostragem_atraso);
+  cmd.AddValue ("LarguraHistograma", "Largura das faixas dos histogramas de atraso e jitter, em ms", parametros.largura_histograma_ms);
+  cmd.AddValue ("CompararMonitoramento", "Roda com o FlowMonitor em todos os nohs e so nos extremos e compara o custo", parametros.comparar_monitoramento);
+  cmd.AddValue ("ResultadoMonitoramento", "CompararMonitoramento: CSV com o custo e o resumo de cada modo", parametros.resultado_monitoramento);
+  cmd.AddValue ("Topologia", "Arquivo com a descricao da topologia (vazio usa a topologia padrao)", parametros.arquivo_topologia);
+  cmd.AddValue ("Relatorio", "Imprime o tempo de cada etapa da montagem e o tempo/memoria da simulacao", parametros.relatorio);
+  cmd.AddValue ("Gerar", "Gera uma topologia hierarquica em vez de usar a padrao", parametros.gerar);
+  cmd.AddValue ("Nucleo", "Topologia gerada: roteadores do nucleo global", parametros.gerador.nucleo);
+  cmd.AddValue ("Regioes", "Topologia gerada: numero de regioes", parametros.gerador.regioes);
+  cmd.AddValue ("RoteadoresPorRegiao", "Topologia gerada: roteadores por regiao", parametros.gerador.roteadores_por_regiao);
+  cmd.AddValue ("HostsPorRoteador", "Topologia gerada: hosts por roteador", parametros.gerador.hosts_por_roteador);
+  cmd.AddValue ("Redundancia", "Topologia gerada: enlaces laterais por regiao (como L1_L2, L3_L4, L3_L5)", parametros.gerador.redundancia);
+  cmd.AddValue ("Prefixo", "Topologia gerada: prefixo das sub-redes dos enlaces (24 ou 30)", parametros.gerador.prefixo);
+  cmd.AddValue ("SalvarTopologia", "Topologia gerada: arquivo onde a descricao gerada eh salva", parametros.salvar_topologia);
+  cmd.AddValue ("FluxosGerados", "Topologia gerada: numero de fluxos entre hosts aleatorios", parametros.fluxos_gerados);
+  cmd.AddValue ("Cenario", "Conjunto de fluxos simulado (simulacao_01 ... simulacao_08)", parametros.cenario);
+  cmd.AddValue ("MatrizFluxos", "Arquivo com a matriz de fluxos '<origem> <destino> tcp|udp <taxa> <tamanho> <inicio> <fim> <porta>' (substitui Cenario)", parametros.matriz_fluxos);
+  cmd.AddValue ("TaxaFluxos", "Taxa dos fluxos dos cenarios e das topologias geradas", parametros.taxa_fluxos);
+  cmd.AddValue ("TamanhoPacote", "Tamanho, em bytes, dos pacotes dos fluxos dos cenarios e das topologias geradas", parametros.tamanho_pacote);
+  cmd.AddValue ("FilaGlobal", "Fila DropTail dos dispositivos das classes de enlace com fila \"global\"", parametros.opcoes_topologia.fila_global);
+  cmd.AddValue ("FilaComum", "Fila DropTail dos dispositivos das classes de enlace com fila \"comum\"", parametros.opcoes_topologia.fila_comum);
+  cmd.AddValue ("DisciplinaFila", "Disciplina de fila raiz de todos os enlaces", parametros.opcoes_topologia.disciplina_fila);
+  cmd.AddValue ("RedMinTh", "Limiar minimo do RED, em pacotes (0 mantem o padrao do ns-3)", parametros.red_min_th);
+  cmd.AddValue ("RedMaxTh", "Limiar maximo do RED, em pacotes (0 mantem o padrao do ns-3)", parametros.red_max_th);
+  cmd.AddValue ("Hibrido", "Fluxos de fundo viram carga fluida nos enlaces do caminho; so os de frente geram pacotes", parametros.hibrido);
+  cmd.AddValue ("FracaoFundo", "Fracao dos fluxos marcada como fundo, alem dos marcados com \"fundo\" na matriz", parametros.fracao_fundo);
+  cmd.AddValue ("CompararHibrido", "Roda em pacotes e no modo hibrido e informa o erro do atraso, perda e vazao dos fluxos de frente", parametros.comparar_hibrido);
+  cmd.AddValue ("ResultadoHibrido", "CompararHibrido: CSV com o erro de cada fluxo de frente", parametros.resultado_hibrido);
+  cmd.AddValue ("Trace", "Trace binario de pacotes a reproduzir (ver trace_trafego.h); sem --MatrizFluxos ou --Gerar, substitui o cenario", parametros.trace);
+  cmd.AddValue ("InicioTrace", "Trace: instante, em s, em que comeca a reproducao", parametros.inicio_trace);
+  cmd.AddValue ("LoteTrace", "Trace: horizonte, em ms de tempo simulado, de cada leitura de registros", parametros.lote_trace_ms);
+  cmd.AddValue ("JanelaTrace", "Trace: MB do arquivo mapeados na memoria por vez", parametros.janela_trace_mb);
+  cmd.AddValue ("ImportarPcap", "Converte este pcap no trace de --Trace e sai", parametros.importar_pcap);
+  cmd.AddValue ("MapaEnderecos", "ImportarPcap: arquivo com linhas '<ip> <noh>' ligando os enderecos do pcap aos nohs da topologia", parametros.mapa_enderecos);
+  cmd.AddValue ("Multicast", "Arquivo com os grupos multicast (ver multicast.h); sem --MatrizFluxos ou --Gerar, substitui o cenario", parametros.multicast);
+  cmd.AddValue ("CompararMulticast", "Roda os grupos em multicast e como um fluxo unicast por membro e compara carga dos enlaces, eventos e tempo", parametros.comparar_multicast);
+  cmd.AddValue ("ResultadoMulticast", "CompararMulticast: CSV com os bytes de cada sentido de enlace nos dois modos", parametros.resultado_multicast);
+  cmd.AddValue ("Verificar", "Verifica todas as rotas sem simular: tabelas (as instaladas, so global e ecmp) ou grafo (menor custo); sai com 1 se houver pares sem rota, buracos ou lacos", parametros.verificar);
+  cmd.AddValue ("Estimar", "Estima a vazao max-min justa de cada fluxo e a utilizacao de cada enlace, sem simular", parametros.estimar);
+  cmd.AddValue ("RankingEstimativa", "Estimar: CSV onde cada execucao acrescenta uma linha com o resumo da estimativa", parametros.ranking_estimativa);
+  cmd.AddValue ("Saida", "Arquivo XML do FlowMonitor (vazio usa <cenario>.xml)", parametros.saida);
+  cmd.AddValue ("Roteamento", "Algoritmo de roteamento: global (tabelas calculadas antes), ecmp (global com divisao dos fluxos entre caminhos de mesmo custo), rip (vetor de distancias) ou olsr (estado de enlace)", parametros.roteamento);
+  cmd.AddValue ("ToleranciaEcmp", "ECMP: fracao a mais de custo aceita em relacao ao caminho minimo (0 so caminhos de mesmo custo)", parametros.multipercurso.tolerancia);
+  cmd.AddValue ("CustoEcmp", "ECMP: custo dos caminhos, saltos (metrica das interfaces) ou atraso (dos enlaces)", parametros.multipercurso.custo);
+  cmd.AddValue ("EcmpPonderado", "ECMP: divide os fluxos na proporcao da taxa dos enlaces de saida, em vez de igualmente", parametros.multipercurso.ponderado);
+  cmd.AddValue ("CompararEcmp", "Roda os cenarios do Lote (ou a configuracao atual) com roteamento global e ecmp e compara vazao e utilizacao dos enlaces", parametros.comparar_ecmp);
+  cmd.AddValue ("ResultadoEcmp", "CompararEcmp: CSV com uma linha por cenario e roteamento", parametros.resultado_ecmp);
+  cmd.AddValue ("PeriodoConvergencia", "Intervalo, em s, entre as verificacoes das rotas de todos os nohs", parametros.periodo_convergencia);
+  cmd.AddValue ("JanelaConvergencia", "Tempo, em s, que as rotas precisam ficar completas e sem mudar para considerar convergido", parametros.janela_convergencia);
+  cmd.AddValue ("Falhas", "Mudancas de enlaces separadas por virgula, no formato tempo:enlace:down|up (ex.: 10:L1_G2:down,20:L1_G2:up)", parametros.falhas);
+  cmd.AddValue ("ArquivoFalhas", "Arquivo com a agenda de falhas, uma mudanca '<tempo> <enlace> down|up' por linha", parametros.arquivo_falhas);
+  cmd.AddValue ("RecalculoCompleto", "Falhas com roteamento global: recalcula as tabelas de todos os roteadores a cada mudanca (para comparar com o incremental)", parametros.recalculo_completo);
+  cmd.AddValue ("Instantaneos", "Periodo, em ms de tempo simulado, dos instantaneos do FlowMonitor gravados durante a simulacao (0 grava so o XML no fim)", parametros.instantaneos_ms);
+  cmd.AddValue ("FormatoInstantaneos", "Instantaneos: csv ou binario (colunar)", parametros.formato_instantaneos);
+  cmd.AddValue ("ArquivoInstantaneos", "Instantaneos: arquivo de saida (vazio usa <saida>.instantaneos.csv/.bin)", parametros.arquivo_instantaneos);
+  cmd.AddValue ("Filas", "Periodo, em ms de tempo simulado, da amostragem das filas de cada enlace (0 desliga)", parametros.filas_ms);
+  cmd.AddValue ("CapacidadeFilas", "Filas: amostras guardadas por sentido de enlace (as mais antigas sao sobrescritas)", parametros.capacidade_filas);
+  cmd.AddValue ("ArquivoFilas", "Filas: arquivo binario de saida (vazio usa <saida>.filas.bin)", parametros.arquivo_filas);
+  cmd.AddValue ("Series", "Largura, em ms de tempo simulado, das faixas das series por fluxo (bytes, atraso e perdas; 0 desliga)", parametros.series_ms);
+  cmd.AddValue ("ArquivoSeries", "Series: arquivo binario de saida (vazio usa <saida>.series.bin)", parametros.arquivo_series);
+  cmd.AddValue ("ParadaAutomatica", "Termina quando as aplicacoes acabam e as filas esvaziam, em vez de rodar ate TempoLimite", parametros.parada_automatica);
+  cmd.AddValue ("TempoLimite", "Tempo simulado maximo, em s", parametros.tempo_limite);
+  cmd.AddValue ("Silencio", "Parada automatica: s sem envio de pacotes de dados para considerar a rede drenada", parametros.parada.silencio);
+  cmd.AddValue ("Estacionario", "Parada automatica: termina antes quando a vazao de cada fluxo se estabiliza", parametros.parada.estacionario);
+  cmd.AddValue ("PeriodoEstacionario", "Estacionario: intervalo, em s, de cada amostra de vazao", parametros.parada.periodo_estacionario);
+  cmd.AddValue ("JanelaEstacionario", "Estacionario: janela deslizante, em s, em que a vazao precisa ficar estavel", parametros.parada.janela_estacionario);
+  cmd.AddValue ("ToleranciaEstacionario", "Estacionario: variacao relativa maxima da vazao em torno da media da janela", parametros.parada.tolerancia_estacionario);
+  cmd.AddValue ("Mpi", "Simulacao distribuida (mpirun -np N), com os nohs particionados pelo atraso dos enlaces", parametros.mpi);
+  cmd.AddValue ("TabelaFluxos", "Arquivo CSV com as estatisticas por fluxo da SondaFluxos (comparavel entre execucao sequencial e distribuida)", parametros.tabela_fluxos);
+  cmd.AddValue ("TempoSequencial", "Mpi: tempo da execucao sequencial de referencia, em s, para calcular o speedup", parametros.tempo_sequencial);
+  cmd.AddValue ("Perfil", "Arquivo JSON com tempo, alocacoes e pico de memoria de cada fase e eventos/s do Run", parametros.perfil);
+  cmd.AddValue ("Benchmark", "Roda os cenarios fixos e topologias geradas de referencia e grava tempo, eventos/s e memoria de cada um", parametros.benchmark);
+  cmd.AddValue ("ResultadoBenchmark", "Benchmark: arquivo CSV com os resultados (serve de base para as proximas execucoes)", parametros.resultado_benchmark);
+  cmd.AddValue ("BaseBenchmark", "Benchmark: CSV de uma execucao anterior para comparar; regressoes fazem o programa sair com erro", parametros.base_benchmark);
+  cmd.AddValue ("ToleranciaBenchmark", "Benchmark: piora relativa aceita antes de acusar regressao", parametros.tolerancia_benchmark);
+  cmd.AddValue ("RepeticoesBenchmark", "Benchmark: execucoes de cada referencia (fica a mais rapida)", parametros.repeticoes_benchmark);
+  cmd.AddValue ("Escalonador", "Escalonador de eventos: map (padrao do ns-3), heap, list, calendar ou heap4 (heap 4-ario contiguo)", parametros.escalonador);
+  cmd.AddValue ("CompararEscalonadores", "Roda as referencias do benchmark com cada escalonador e grava eventos/s e memoria de cada um", parametros.comparar_escalonadores);
+  cmd.AddValue ("ResultadoEscalonadores", "CompararEscalonadores: arquivo CSV com os resultados", parametros.resultado_escalonadores);
+  cmd.AddValue ("Varredura", "Arquivo com as dimensoes de uma varredura de parametros ('<parametro> <valores...>' ou '<parametro> faixa <min> <max> [unidade]')", parametros.varredura);
+  cmd.AddValue ("Desenho", "Varredura: grade (produto cartesiano) ou lhs (hipercubo latino)", parametros.desenho);
+  cmd.AddValue ("PassosFaixa", "Varredura em grade: valores de cada faixa", parametros.passos_faixa);
+  cmd.AddValue ("PontosVarredura", "Varredura lhs: numero de pontos", parametros.pontos_varredura);
+  cmd.AddValue ("SementeVarredura", "Varredura lhs: semente do sorteio (a mesma semente permite retomar a varredura)", parametros.semente_varredura);
+  cmd.AddValue ("ResultadoVarredura", "Varredura: tabela CSV com os resultados, que tambem serve de checkpoint", parametros.resultado_varredura);
+  cmd.AddValue ("Replicar", "Replica o Cenario (ou os cenarios do Lote) ate o intervalo de 95% de confianca de vazao por fluxo, atraso e perda ficar estreito", parametros.replicar);
+  cmd.AddValue ("MinReplicacoes", "Replicar: replicacoes antes de avaliar o intervalo de confianca", parametros.min_replicacoes);
+  cmd.AddValue ("MaxReplicacoes", "Replicar: limite de replicacoes por cenario", parametros.max_replicacoes);
+  cmd.AddValue ("MeiaLargura", "Replicar: meia largura maxima do intervalo de 95%, relativa a media de cada metrica", parametros.meia_largura);
+  cmd.AddValue ("ResultadoReplicacoes", "Replicar: CSV com o resumo de cada replicacao (os intervalos vao para <arquivo>.ic.csv)", parametros.resultado_replicacoes);
+  cmd.AddValue ("Lote", "Cenarios separados por virgula (ou \"todos\") rodados em paralelo, um processo por execucao", parametros.lote);
+  cmd.AddValue ("Sementes", "Lote: execucoes por cenario, com RngRun 1..Sementes", parametros.sementes);
+  cmd.AddValue ("Processos", "Lote: processos simultaneos (0 usa todos os nucleos)", parametros.processos);
+  cmd.AddValue ("ResumoLote", "Lote: arquivo CSV com o resumo de todas as execucoes", parametros.resumo_lote);
+  cmd.Parse (argc, argv);
+
+  if (parametros.mpi) {
+#ifdef NS3_MPI
+      GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::DistributedSimulatorImpl"));
+      MpiInterface::Enable (&argc, &argv);
+      ResumoExecucao resumo;
+      int codigo = executar_simulacao (parametros, resumo);
+      MpiInterface::Disable ();
+      return codigo;
+#else
+      NS_FATAL_ERROR ("Simulacao distribuida requer o ns-3 compilado com --enable-mpi");
+#endif
+  }
+
+  if (!parametros.importar_pcap.empty ()) {
+      return executar_importacao_pcap (parametros);
+  }
+
+  if (parametros.benchmark) {
+      return executar_benchmark (parametros);
+  }
+  if (parametros.comparar_escalonadores) {
+      return executar_comparacao_escalonadores (parametros);
+  }
+
+  if (!parametros.varredura.empty ()) {
+      return executar_varredura (parametros);
+  }
+
+  if (parametros.comparar_hibrido) {
+      return executar_comparacao_hibrido (parametros);
+  }
+  if (parametros.comparar_monitoramento) {
+      return executar_comparacao_monitoramento (parametros);
+  }
+  if (parametros.comparar_ecmp) {
+      return executar_comparacao_ecmp (parametros);
+  }
+  if (parametros.comparar_multicast) {
+      if (parametros.multicast.empty ()) {
+          NS_FATAL_ERROR ("CompararMulticast precisa dos grupos em --Multicast");
+      }
+      return executar_comparacao_multicast (parametros);
+  }
+
+  if (parametros.replicar) {
+      return executar_replicacoes (parametros);
+  }
+
+  if (!parametros.lote.empty ()) {
+      return executar_lote (parametros);
+  }
+
+  ResumoExecucao resumo;
+  return executar_simulacao (parametros, resumo);
+}
@@ -0,0 +1,315 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Estatisticas por fluxo que funcionam tambem na simulacao distribuida.
+//
+// O FlowMonitor guarda o instante de envio de cada pacote numa tabela local
+// do noh de origem, entao quando origem e destino ficam em processos MPI
+// diferentes o destino nunca encontra o pacote e nao conta a recepcao. Aqui
+// o instante de envio viaja no proprio pacote (EtiquetaEnvio), que eh
+// serializada junto com ele entre os processos. As mesmas grandezas do
+// FlowMonitor sao medidas nos mesmos pontos da camada IP (SendOutgoing na
+// origem, LocalDeliver no destino), por 5-tupla, e as tabelas dos
+// processos sao somadas no processo 0.
+//
+
+#ifndef SONDA_FLUXOS_H
+#define SONDA_FLUXOS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#ifdef NS3_MPI
+#include <mpi.h>
+#endif
+
+class EtiquetaEnvio : public ns3::Tag {
+public:
+    static ns3::TypeId GetTypeId (void) {
+        static ns3::TypeId tid = ns3::TypeId ("EtiquetaEnvio")
+            .SetParent<ns3::Tag> ()
+            .AddConstructor<EtiquetaEnvio> ();
+        return tid;
+    }
+    virtual ns3::TypeId GetInstanceTypeId (void) const {
+        return GetTypeId ();
+    }
+    virtual uint32_t GetSerializedSize (void) const {
+        return 8;
+    }
+    virtual void Serialize (ns3::TagBuffer buffer) const {
+        buffer.WriteU64 (envio);
+    }
+    virtual void Deserialize (ns3::TagBuffer buffer) {
+        envio = buffer.ReadU64 ();
+    }
+    virtual void Print (std::ostream &saida) const {
+        saida << "envio=" << envio;
+    }
+
+    /** Instante de envio, em ns. */
+    uint64_t envio = 0;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (EtiquetaEnvio);
+
+/**
+ * Estatisticas de um fluxo (5-tupla). Estrutura sem ponteiros, para poder
+ * ser enviada como bytes entre os processos MPI. Instantes em ns, -1 quando
+ * ainda nao houve o evento.
+ */
+struct EstatisticaFluxo {
+    uint32_t origem;
+    uint32_t destino;
+    uint16_t porta_origem;
+    uint16_t porta_destino;
+    uint32_t protocolo;
+
+    uint64_t pacotes_tx;
+    uint64_t bytes_tx;
+    uint64_t pacotes_rx;
+    uint64_t bytes_rx;
+    int64_t primeiro_tx;
+    int64_t ultimo_tx;
+    int64_t primeiro_rx;
+    int64_t ultimo_rx;
+    int64_t soma_atraso;
+    int64_t soma_jitter;
+    int64_t ultimo_atraso;
+};
+
+inline bool mesma_tupla(const EstatisticaFluxo &x, const EstatisticaFluxo &y) {
+    return x.origem == y.origem && x.destino == y.destino && x.porta_origem == y.porta_origem
+        && x.porta_destino == y.porta_destino && x.protocolo == y.protocolo;
+}
+
+inline bool tupla_menor(const EstatisticaFluxo &x, const EstatisticaFluxo &y) {
+    if (x.origem != y.origem) return x.origem < y.origem;
+    if (x.destino != y.destino) return x.destino < y.destino;
+    if (x.protocolo != y.protocolo) return x.protocolo < y.protocolo;
+    if (x.porta_origem != y.porta_origem) return x.porta_origem < y.porta_origem;
+    return x.porta_destino < y.porta_destino;
+}
+
+inline int64_t menor_instante(int64_t x, int64_t y) {
+    if (x < 0) return y;
+    if (y < 0) return x;
+    return std::min (x, y);
+}
+
+/**
+ * Ordena pela 5-tupla e soma as entradas repetidas (o mesmo fluxo visto
+ * pelo processo da origem e pelo do destino).
+ */
+inline void juntar_estatisticas(std::vector<EstatisticaFluxo> &estatisticas) {
+    std::sort (estatisticas.begin (), estatisticas.end (), tupla_menor);
+    size_t saida = 0;
+    for (size_t i = 0; i < estatisticas.size (); ++i) {
+        if (saida > 0 && mesma_tupla (estatisticas[saida - 1], estatisticas[i])) {
+            EstatisticaFluxo &total = estatisticas[saida - 1];
+            const EstatisticaFluxo &parte = estatisticas[i];
+            total.pacotes_tx += parte.pacotes_tx;
+            total.bytes_tx += parte.bytes_tx;
+            total.pacotes_rx += parte.pacotes_rx;
+            total.bytes_rx += parte.bytes_rx;
+            total.primeiro_tx = menor_instante (total.primeiro_tx, parte.primeiro_tx);
+            total.ultimo_tx = std::max (total.ultimo_tx, parte.ultimo_tx);
+            total.primeiro_rx = menor_instante (total.primeiro_rx, parte.primeiro_rx);
+            total.ultimo_rx = std::max (total.ultimo_rx, parte.ultimo_rx);
+            total.soma_atraso += parte.soma_atraso;
+            total.soma_jitter += parte.soma_jitter;
+        } else {
+            estatisticas[saida++] = estatisticas[i];
+        }
+    }
+    estatisticas.resize (saida);
+}
+
+inline void escrever_estatisticas_csv(std::ostream &saida, const std::vector<EstatisticaFluxo> &estatisticas) {
+    saida << "origem,destino,protocolo,porta_origem,porta_destino,pacotes_tx,bytes_tx,pacotes_rx,bytes_rx,"
+          << "pacotes_perdidos,atraso_medio_ms,jitter_medio_ms,primeiro_tx_s,ultimo_rx_s" << std::endl;
+    for (size_t i = 0; i < estatisticas.size (); ++i) {
+        const EstatisticaFluxo &fluxo = estatisticas[i];
+        double atraso = fluxo.pacotes_rx > 0 ? fluxo.soma_atraso / 1e6 / fluxo.pacotes_rx : 0;
+        double jitter = fluxo.pacotes_rx > 1 ? fluxo.soma_jitter / 1e6 / (fluxo.pacotes_rx - 1) : 0;
+        saida << ns3::Ipv4Address (fluxo.origem) << ',' << ns3::Ipv4Address (fluxo.destino) << ','
+              << fluxo.protocolo << ',' << fluxo.porta_origem << ',' << fluxo.porta_destino << ','
+              << fluxo.pacotes_tx << ',' << fluxo.bytes_tx << ',' << fluxo.pacotes_rx << ',' << fluxo.bytes_rx << ','
+              << (fluxo.pacotes_tx > fluxo.pacotes_rx ? fluxo.pacotes_tx - fluxo.pacotes_rx : 0) << ','
+              << atraso << ',' << jitter << ','
+              << fluxo.primeiro_tx / 1e9 << ',' << fluxo.ultimo_rx / 1e9 << std::endl;
+    }
+}
+
+/**
+ * Sonda instalada na camada IP dos nohs locais.
+ */
+class SondaFluxos {
+public:
+    void instalar(ns3::Ptr<ns3::Node> no) {
+        ns3::Ptr<ns3::Ipv4L3Protocol> ipv4 = no->GetObject<ns3::Ipv4L3Protocol> ();
+        ipv4->TraceConnectWithoutContext ("SendOutgoing", ns3::MakeCallback (&SondaFluxos::enviado, this));
+        ipv4->TraceConnectWithoutContext ("LocalDeliver", ns3::MakeCallback (&SondaFluxos::entregue, this));
+    }
+
+    const std::vector<EstatisticaFluxo> &estatisticas() const {
+        return m_estatisticas;
+    }
+
+    /**
+     * Funcoes chamadas a cada pacote enviado e entregue, com o indice do
+     * fluxo em estatisticas(), o instante de envio e (na entrega) o de
+     * chegada, em ns.
+     */
+    void observar(std::function<void (uint32_t, int64_t)> enviado, std::function<void (uint32_t, int64_t, int64_t)> entregue) {
+        m_observar_envio = enviado;
+        m_observar_entrega = entregue;
+    }
+
+private:
+    typedef std::map<std::pair<uint64_t, uint64_t>, uint32_t> IndiceFluxos;
+
+    /**
+     * Localiza (ou cria) o fluxo do pacote. Devolve false para protocolos
+     * que nao sejam TCP ou UDP.
+     */
+    bool localizar(const ns3::Ipv4Header &cabecalho, ns3::Ptr<const ns3::Packet> pacote, uint32_t &indice) {
+        uint8_t protocolo = cabecalho.GetProtocol ();
+        if ((protocolo != 6 && protocolo != 17) || pacote->GetSize () < 4) {
+            return false;
+        }
+        uint8_t portas[4];
+        pacote->CopyData (portas, 4);
+        uint16_t porta_origem = (portas[0] << 8) | portas[1];
+        uint16_t porta_destino = (portas[2] << 8) | portas[3];
+
+        std::pair<uint64_t, uint64_t> chave (
+            (uint64_t (cabecalho.GetSource ().Get ()) << 32) | cabecalho.GetDestination ().Get (),
+            (uint64_t (protocolo) << 32) | (uint64_t (porta_origem) << 16) | porta_destino);
+        IndiceFluxos::iterator it = m_indice.find (chave);
+        if (it != m_indice.end ()) {
+            indice = it->second;
+            return true;
+        }
+
+        EstatisticaFluxo fluxo = EstatisticaFluxo ();
+        fluxo.origem = cabecalho.GetSource ().Get ();
+        fluxo.destino = cabecalho.GetDestination ().Get ();
+        fluxo.porta_origem = porta_origem;
+        fluxo.porta_destino = porta_destino;
+        fluxo.protocolo = protocolo;
+        fluxo.primeiro_tx = fluxo.ultimo_tx = -1;
+        fluxo.primeiro_rx = fluxo.ultimo_rx = -1;
+        indice = m_estatisticas.size ();
+        m_estatisticas.push_back (fluxo);
+        m_indice[chave] = indice;
+        return true;
+    }
+
+    void enviado(const ns3::Ipv4Header &cabecalho, ns3::Ptr<const ns3::Packet> pacote, uint32_t interface) {
+        uint32_t indice;
+        if (!localizar (cabecalho, pacote, indice)) {
+            return;
+        }
+        int64_t agora = ns3::Simulator::Now ().GetNanoSeconds ();
+        EtiquetaEnvio etiqueta;
+        etiqueta.envio = agora;
+        pacote->AddPacketTag (etiqueta);
+
+        EstatisticaFluxo &fluxo = m_estatisticas[indice];
+        fluxo.pacotes_tx++;
+        fluxo.bytes_tx += pacote->GetSize () + cabecalho.GetSerializedSize ();
+        fluxo.primeiro_tx = menor_instante (fluxo.primeiro_tx, agora);
+        fluxo.ultimo_tx = agora;
+        if (m_observar_envio) {
+            m_observar_envio (indice, agora);
+        }
+    }
+
+    void entregue(const ns3::Ipv4Header &cabecalho, ns3::Ptr<const ns3::Packet> pacote, uint32_t interface) {
+        EtiquetaEnvio etiqueta;
+        uint32_t indice;
+        if (!pacote->PeekPacketTag (etiqueta) || !localizar (cabecalho, pacote, indice)) {
+            return;
+        }
+        int64_t agora = ns3::Simulator::Now ().GetNanoSeconds ();
+        int64_t atraso = agora - int64_t (etiqueta.envio);
+
+        EstatisticaFluxo &fluxo = m_estatisticas[indice];
+        if (fluxo.pacotes_rx > 0) {
+            fluxo.soma_jitter += atraso > fluxo.ultimo_atraso ? atraso - fluxo.ultimo_atraso : fluxo.ultimo_atraso - atraso;
+        }
+        fluxo.ultimo_atraso = atraso;
+        fluxo.soma_atraso += atraso;
+        fluxo.pacotes_rx++;
+        fluxo.bytes_rx += pacote->GetSize () + cabecalho.GetSerializedSize ();
+        fluxo.primeiro_rx = menor_instante (fluxo.primeiro_rx, agora);
+        fluxo.ultimo_rx = agora;
+        if (m_observar_entrega) {
+            m_observar_entrega (indice, etiqueta.envio, agora);
+        }
+    }
+
+    IndiceFluxos m_indice;
+    std::vector<EstatisticaFluxo> m_estatisticas;
+    std::function<void (uint32_t, int64_t)> m_observar_envio;
+    std::function<void (uint32_t, int64_t, int64_t)> m_observar_entrega;
+};
+
+#ifdef NS3_MPI
+/**
+ * Junta no processo 0 as estatisticas de todos os processos. Nos demais
+ * processos o vetor devolvido fica vazio.
+ */
+inline std::vector<EstatisticaFluxo> juntar_entre_processos(const std::vector<EstatisticaFluxo> &locais) {
+    int processo;
+    int processos;
+    MPI_Comm_rank (MPI_COMM_WORLD, &processo);
+    MPI_Comm_size (MPI_COMM_WORLD, &processos);
+
+    int tamanho = locais.size () * sizeof (EstatisticaFluxo);
+    std::vector<int> tamanhos (processos, 0);
+    MPI_Gather (&tamanho, 1, MPI_INT, &tamanhos[0], 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    std::vector<int> deslocamentos (processos, 0);
+    int total = 0;
+    for (int i = 0; i < processos; ++i) {
+        deslocamentos[i] = total;
+        total += tamanhos[i];
+    }
+
+    std::vector<EstatisticaFluxo> todas (processo == 0 ? total / sizeof (EstatisticaFluxo) : 0);
+    MPI_Gatherv (locais.empty () ? 0 : (void *) &locais[0], tamanho, MPI_BYTE,
+                 todas.empty () ? 0 : (void *) &todas[0], &tamanhos[0], &deslocamentos[0], MPI_BYTE,
+                 0, MPI_COMM_WORLD);
+    if (processo == 0) {
+        juntar_estatisticas (todas);
+    }
+    return todas;
+}
+#endif
+
+#endif /* SONDA_FLUXOS_H */
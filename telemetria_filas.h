@@ -0,0 +1,332 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Telemetria das filas de cada enlace, nos dois sentidos: ocupacao da
+// disciplina de fila (RED por padrao) e da fila do dispositivo, e contagem
+// de enfileiramentos, desenfileiramentos e descartes (precoces, forcados e
+// na fila do dispositivo) entre amostras.
+//
+// Os traces so incrementam contadores e a amostragem eh um unico evento por
+// periodo para todos os enlaces. As amostras vao para um buffer circular
+// por sentido, alocado no inicio; se a simulacao gerar mais amostras que a
+// capacidade, ficam as mais recentes. Os contadores acumulados depois da
+// ultima amostra entram nos totais e, ao gravar, numa amostra final no
+// instante corrente. Tudo eh gravado no fim, em binario:
+//
+//   "FILA", versao (u32), periodo_ns (u64), sentidos (u32), e para cada
+//   sentido: enlace (u16 + caracteres, ex. "L1_G2"), noh de saida (u16 +
+//   caracteres), n (u32), amostras sobrescritas (u64) e as colunas, cada
+//   uma com n valores: tempo_ns (u64), pacotes_disciplina (u32),
+//   bytes_disciplina (u32), pacotes_dispositivo (u32), enfileirados (u32),
+//   desenfileirados (u32), descartes_precoces (u32), descartes_forcados
+//   (u32), descartes_dispositivo (u32). Inteiros na ordem de bytes da
+//   maquina.
+//
+
+#ifndef TELEMETRIA_FILAS_H
+#define TELEMETRIA_FILAS_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "topologia.h"
+
+struct AmostraFila {
+    uint64_t tempo_ns;
+    uint32_t pacotes_disciplina;
+    uint32_t bytes_disciplina;
+    uint32_t pacotes_dispositivo;
+    uint32_t enfileirados;
+    uint32_t desenfileirados;
+    uint32_t descartes_precoces;
+    uint32_t descartes_forcados;
+    uint32_t descartes_dispositivo;
+};
+
+class TelemetriaFilas {
+public:
+    TelemetriaFilas (const Topologia &topologia, ns3::Time periodo, uint32_t capacidade)
+        : m_topologia (topologia), m_periodo (periodo), m_capacidade (capacidade > 0 ? capacidade : 1) {
+    }
+
+    /**
+     * Conecta os traces das filas dos nohs locais e agenda a amostragem.
+     * Deve ser chamada depois de carregar_topologia.
+     */
+    void instalar () {
+        uint32_t sistema = ns3::Simulator::GetSystemId ();
+        for (uint32_t i = 0; i < m_topologia.enlaces.size (); ++i) {
+            const Enlace &enlace = m_topologia.enlaces[i];
+            if (m_topologia.nos[enlace.a]->GetSystemId () == sistema) {
+                adicionar (i, enlace.a, enlace.dispositivo_a);
+            }
+            if (m_topologia.nos[enlace.b]->GetSystemId () == sistema) {
+                adicionar (i, enlace.b, enlace.dispositivo_b);
+            }
+        }
+        for (size_t i = 0; i < m_sentidos.size (); ++i) {
+            Sentido &sentido = m_sentidos[i];
+            ContadoresFila *contadores = &sentido.contadores;
+            if (sentido.disciplina) {
+                sentido.disciplina->TraceConnectWithoutContext ("Enqueue", ns3::MakeBoundCallback (&TelemetriaFilas::enfileirado, contadores));
+                sentido.disciplina->TraceConnectWithoutContext ("Dequeue", ns3::MakeBoundCallback (&TelemetriaFilas::desenfileirado, contadores));
+                sentido.disciplina->TraceConnectWithoutContext ("DropBeforeEnqueue", ns3::MakeBoundCallback (&TelemetriaFilas::descartado_antes, contadores));
+                sentido.disciplina->TraceConnectWithoutContext ("DropAfterDequeue", ns3::MakeBoundCallback (&TelemetriaFilas::descartado_depois, contadores));
+            }
+            if (sentido.fila) {
+                sentido.fila->TraceConnectWithoutContext ("Drop", ns3::MakeBoundCallback (&TelemetriaFilas::descartado_dispositivo, contadores));
+            }
+        }
+        ns3::Simulator::Schedule (m_periodo, &TelemetriaFilas::amostrar, this);
+    }
+
+    uint32_t sentidos () const {
+        return m_sentidos.size ();
+    }
+
+    uint64_t amostras () const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < m_sentidos.size (); ++i) {
+            total += m_sentidos[i].total;
+        }
+        return total;
+    }
+
+    uint64_t descartes_precoces () const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < m_sentidos.size (); ++i) {
+            total += m_sentidos[i].descartes_precoces + m_sentidos[i].contadores.descartes_precoces;
+        }
+        return total;
+    }
+
+    uint64_t descartes_forcados () const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < m_sentidos.size (); ++i) {
+            total += m_sentidos[i].descartes_forcados + m_sentidos[i].contadores.descartes_forcados;
+        }
+        return total;
+    }
+
+    /** Descartes na fila do dispositivo, contados a parte dos da disciplina. */
+    uint64_t descartes_dispositivo () const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < m_sentidos.size (); ++i) {
+            total += m_sentidos[i].descartes_dispositivo + m_sentidos[i].contadores.descartes_dispositivo;
+        }
+        return total;
+    }
+
+    bool gravar (const std::string &arquivo) const {
+        std::ofstream saida (arquivo.c_str (), std::ios::out | std::ios::binary);
+        if (!saida) {
+            return false;
+        }
+        uint32_t versao = 1;
+        uint64_t periodo_ns = m_periodo.GetNanoSeconds ();
+        uint32_t quantidade = m_sentidos.size ();
+        saida.write ("FILA", 4);
+        escrever (saida, versao);
+        escrever (saida, periodo_ns);
+        escrever (saida, quantidade);
+
+        std::vector<AmostraFila> ordenadas;
+        for (size_t i = 0; i < m_sentidos.size (); ++i) {
+            const Sentido &sentido = m_sentidos[i];
+            escrever_texto (saida, nome_do_enlace (m_topologia, m_topologia.enlaces[sentido.enlace]));
+            escrever_texto (saida, m_topologia.nomes[sentido.no]);
+
+            // Do mais antigo para o mais recente, mais a amostra final se
+            // houve atividade depois da ultima
+            uint32_t guardadas = sentido.total < m_capacidade ? uint32_t (sentido.total) : m_capacidade;
+            size_t primeira = sentido.total < m_capacidade ? 0 : sentido.proxima;
+            uint64_t total = sentido.total;
+            ordenadas.clear ();
+            for (uint32_t k = 0; k < guardadas; ++k) {
+                ordenadas.push_back (sentido.amostras[(primeira + k) % m_capacidade]);
+            }
+            if (pendente (sentido.contadores)) {
+                if (ordenadas.size () == m_capacidade) {
+                    ordenadas.erase (ordenadas.begin ());
+                }
+                ordenadas.push_back (amostra_atual (sentido));
+                total++;
+            }
+            uint32_t n = ordenadas.size ();
+            uint64_t sobrescritas = total - n;
+            escrever (saida, n);
+            escrever (saida, sobrescritas);
+            coluna (saida, ordenadas, &AmostraFila::tempo_ns);
+            coluna (saida, ordenadas, &AmostraFila::pacotes_disciplina);
+            coluna (saida, ordenadas, &AmostraFila::bytes_disciplina);
+            coluna (saida, ordenadas, &AmostraFila::pacotes_dispositivo);
+            coluna (saida, ordenadas, &AmostraFila::enfileirados);
+            coluna (saida, ordenadas, &AmostraFila::desenfileirados);
+            coluna (saida, ordenadas, &AmostraFila::descartes_precoces);
+            coluna (saida, ordenadas, &AmostraFila::descartes_forcados);
+            coluna (saida, ordenadas, &AmostraFila::descartes_dispositivo);
+        }
+        return bool (saida);
+    }
+
+    void imprimir (std::ostream &saida) const {
+        saida << "Filas: " << m_sentidos.size () << " sentidos de enlace, " << amostras () << " amostras, "
+              << descartes_precoces () << " descartes precoces, " << descartes_forcados () << " forcados, "
+              << descartes_dispositivo () << " no dispositivo" << std::endl;
+    }
+
+private:
+    struct ContadoresFila {
+        uint32_t enfileirados = 0;
+        uint32_t desenfileirados = 0;
+        uint32_t descartes_precoces = 0;
+        uint32_t descartes_forcados = 0;
+        uint32_t descartes_dispositivo = 0;
+    };
+
+    struct Sentido {
+        uint32_t enlace;
+        uint32_t no;
+        ns3::Ptr<ns3::QueueDisc> disciplina;
+        ns3::Ptr<ns3::Queue<ns3::Packet> > fila;
+        ContadoresFila contadores;
+        std::vector<AmostraFila> amostras;
+        size_t proxima = 0;
+        uint64_t total = 0;
+        uint64_t descartes_precoces = 0;
+        uint64_t descartes_forcados = 0;
+        uint64_t descartes_dispositivo = 0;
+    };
+
+    void adicionar (uint32_t enlace, uint32_t no, ns3::Ptr<ns3::NetDevice> dispositivo) {
+        m_sentidos.push_back (Sentido ());
+        Sentido &sentido = m_sentidos.back ();
+        sentido.enlace = enlace;
+        sentido.no = no;
+        ns3::Ptr<ns3::TrafficControlLayer> controle = m_topologia.nos[no]->GetObject<ns3::TrafficControlLayer> ();
+        if (controle) {
+            sentido.disciplina = controle->GetRootQueueDiscOnDevice (dispositivo);
+        }
+        ns3::Ptr<ns3::PointToPointNetDevice> p2p = ns3::DynamicCast<ns3::PointToPointNetDevice> (dispositivo);
+        if (p2p) {
+            sentido.fila = p2p->GetQueue ();
+        }
+        sentido.amostras.resize (m_capacidade);
+    }
+
+    static bool pendente (const ContadoresFila &contadores) {
+        return contadores.enfileirados || contadores.desenfileirados || contadores.descartes_precoces
+               || contadores.descartes_forcados || contadores.descartes_dispositivo;
+    }
+
+    /** Estado das filas agora, com os contadores desde a amostra anterior. */
+    static AmostraFila amostra_atual (const Sentido &sentido) {
+        const ContadoresFila &contadores = sentido.contadores;
+        AmostraFila amostra;
+        amostra.tempo_ns = ns3::Simulator::Now ().GetNanoSeconds ();
+        amostra.pacotes_disciplina = sentido.disciplina ? sentido.disciplina->GetNPackets () : 0;
+        amostra.bytes_disciplina = sentido.disciplina ? sentido.disciplina->GetNBytes () : 0;
+        amostra.pacotes_dispositivo = sentido.fila ? sentido.fila->GetNPackets () : 0;
+        amostra.enfileirados = contadores.enfileirados;
+        amostra.desenfileirados = contadores.desenfileirados;
+        amostra.descartes_precoces = contadores.descartes_precoces;
+        amostra.descartes_forcados = contadores.descartes_forcados;
+        amostra.descartes_dispositivo = contadores.descartes_dispositivo;
+        return amostra;
+    }
+
+    void amostrar () {
+        for (size_t i = 0; i < m_sentidos.size (); ++i) {
+            Sentido &sentido = m_sentidos[i];
+            ContadoresFila &contadores = sentido.contadores;
+            sentido.amostras[sentido.proxima] = amostra_atual (sentido);
+            sentido.descartes_precoces += contadores.descartes_precoces;
+            sentido.descartes_forcados += contadores.descartes_forcados;
+            sentido.descartes_dispositivo += contadores.descartes_dispositivo;
+            contadores = ContadoresFila ();
+
+            sentido.proxima = (sentido.proxima + 1) % m_capacidade;
+            sentido.total++;
+        }
+        ns3::Simulator::Schedule (m_periodo, &TelemetriaFilas::amostrar, this);
+    }
+
+    static void enfileirado (ContadoresFila *contadores, ns3::Ptr<const ns3::QueueDiscItem> item) {
+        contadores->enfileirados++;
+    }
+
+    static void desenfileirado (ContadoresFila *contadores, ns3::Ptr<const ns3::QueueDiscItem> item) {
+        contadores->desenfileirados++;
+    }
+
+    /**
+     * Descartes na chegada: o RED marca os aleatorios (entre os limiares)
+     * como UNFORCED_DROP; acima do limiar maximo ou com a fila cheia o
+     * descarte eh forcado.
+     */
+    static void descartado_antes (ContadoresFila *contadores, ns3::Ptr<const ns3::QueueDiscItem> item, const char *motivo) {
+        if (std::strcmp (motivo, ns3::RedQueueDisc::UNFORCED_DROP) == 0) {
+            contadores->descartes_precoces++;
+        } else {
+            contadores->descartes_forcados++;
+        }
+    }
+
+    /** Descartes na saida so acontecem nas AQM (CoDel e afins), sempre precoces. */
+    static void descartado_depois (ContadoresFila *contadores, ns3::Ptr<const ns3::QueueDiscItem> item, const char *motivo) {
+        contadores->descartes_precoces++;
+    }
+
+    static void descartado_dispositivo (ContadoresFila *contadores, ns3::Ptr<const ns3::Packet> pacote) {
+        contadores->descartes_dispositivo++;
+    }
+
+    template <typename T>
+    static void escrever (std::ostream &saida, const T &valor) {
+        saida.write (reinterpret_cast<const char *> (&valor), sizeof (valor));
+    }
+
+    static void escrever_texto (std::ostream &saida, const std::string &texto) {
+        uint16_t tamanho = texto.size ();
+        escrever (saida, tamanho);
+        saida.write (texto.data (), tamanho);
+    }
+
+    template <typename T>
+    static void coluna (std::ostream &saida, const std::vector<AmostraFila> &amostras, T AmostraFila::*campo) {
+        for (size_t i = 0; i < amostras.size (); ++i) {
+            escrever (saida, amostras[i].*campo);
+        }
+    }
+
+    const Topologia &m_topologia;
+    ns3::Time m_periodo;
+    uint32_t m_capacidade;
+    std::vector<Sentido> m_sentidos;
+};
+
+#endif /* TELEMETRIA_FILAS_H */
@@ -0,0 +1,196 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+//
+// Testes das partes do simulador que nao dependem de uma simulacao. Sai
+// com codigo 1 se alguma verificacao falhar.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../estimativa.h"
+#include "../medicao.h"
+#include "../particao.h"
+
+static uint32_t falhas = 0;
+
+#define VERIFICAR(condicao)                                                          \
+  do {                                                                               \
+      if (!(condicao)) {                                                             \
+          std::cerr << __FILE__ << ":" << __LINE__ << ": falhou " #condicao << std::endl; \
+          falhas++;                                                                  \
+      }                                                                              \
+  } while (0)
+
+static void adicionar_aresta (std::vector<ArestaParticao> &arestas, uint32_t a, uint32_t b, double atraso) {
+    ArestaParticao aresta = { a, b, atraso };
+    arestas.push_back (aresta);
+}
+
+/** Dois triangulos de 10ms ligados por um enlace de 100ms: o corte fica nele. */
+static void testar_particao_por_atraso () {
+    std::vector<ArestaParticao> arestas;
+    adicionar_aresta (arestas, 0, 1, 0.01);
+    adicionar_aresta (arestas, 1, 2, 0.01);
+    adicionar_aresta (arestas, 2, 0, 0.01);
+    adicionar_aresta (arestas, 3, 4, 0.01);
+    adicionar_aresta (arestas, 4, 5, 0.01);
+    adicionar_aresta (arestas, 5, 3, 0.01);
+    adicionar_aresta (arestas, 2, 3, 0.1);
+
+    Particao particao = particionar_por_atraso (6, arestas, 2);
+    VERIFICAR (particao.sistema_do_no.size () == 6);
+    VERIFICAR (particao.enlaces_cortados == 1);
+    VERIFICAR (std::fabs (particao.lookahead - 0.1) < 1e-12);
+    VERIFICAR (particao.sistema_do_no[0] == particao.sistema_do_no[2]);
+    VERIFICAR (particao.sistema_do_no[3] == particao.sistema_do_no[5]);
+    VERIFICAR (particao.sistema_do_no[2] != particao.sistema_do_no[3]);
+}
+
+/** Mais processos que nohs: todos os nohs ganham sistema, sem acesso fora do vetor. */
+static void testar_particao_com_mais_sistemas_que_nos () {
+    std::vector<ArestaParticao> arestas;
+    adicionar_aresta (arestas, 0, 1, 0.02);
+    adicionar_aresta (arestas, 1, 2, 0.01);
+
+    Particao particao = particionar_por_atraso (3, arestas, 5);
+    VERIFICAR (particao.sistema_do_no.size () == 3);
+    VERIFICAR (particao.nos_por_sistema.size () == 5);
+    for (uint32_t i = 0; i < particao.sistema_do_no.size (); ++i) {
+        VERIFICAR (particao.sistema_do_no[i] < 5);
+    }
+    VERIFICAR (particao.sistema_do_no[0] != particao.sistema_do_no[1]);
+    VERIFICAR (particao.sistema_do_no[1] != particao.sistema_do_no[2]);
+    VERIFICAR (particao.enlaces_cortados == 2);
+    VERIFICAR (std::fabs (particao.lookahead - 0.01) < 1e-12);
+}
+
+/**
+ * Condicoes de uma divisao max-min justa: nenhum sentido passa da
+ * capacidade, nenhum fluxo passa da demanda, e quem ficou abaixo da demanda
+ * tem um gargalo saturado onde nenhum outro fluxo recebe mais que ele.
+ */
+static void verificar_max_min (const std::vector<double> &capacidade, const std::vector<std::vector<uint32_t> > &caminhos,
+                               const std::vector<double> &demanda, const std::vector<double> &taxa, const std::vector<int32_t> &gargalo) {
+    const double tolerancia = 1e-6;
+    std::vector<double> usada (capacidade.size (), 0);
+    std::vector<double> maior (capacidade.size (), 0);
+    for (size_t f = 0; f < caminhos.size (); ++f) {
+        for (size_t k = 0; k < caminhos[f].size (); ++k) {
+            usada[caminhos[f][k]] += taxa[f];
+            maior[caminhos[f][k]] = std::max (maior[caminhos[f][k]], taxa[f]);
+        }
+    }
+    uint32_t excedidos = 0;
+    for (size_t s = 0; s < capacidade.size (); ++s) {
+        if (usada[s] > capacidade[s] * (1 + tolerancia)) {
+            excedidos++;
+        }
+    }
+    VERIFICAR (excedidos == 0);
+    uint32_t injustos = 0;
+    for (size_t f = 0; f < caminhos.size (); ++f) {
+        if (taxa[f] > demanda[f] * (1 + tolerancia)) {
+            injustos++;
+        } else if (gargalo[f] >= 0) {
+            uint32_t s = gargalo[f];
+            if (usada[s] < capacidade[s] * (1 - tolerancia) || maior[s] > taxa[f] * (1 + tolerancia)) {
+                injustos++;
+            }
+        } else if (!caminhos[f].empty () && taxa[f] < demanda[f] * (1 - tolerancia)) {
+            injustos++;
+        }
+    }
+    VERIFICAR (injustos == 0);
+}
+
+/** Tres fluxos em dois enlaces de 10: o que passa nos dois fica com 5, os outros dividem o resto. */
+static void testar_max_min_pequeno () {
+    std::vector<double> capacidade (2, 10);
+    std::vector<std::vector<uint32_t> > caminhos (3);
+    caminhos[0].push_back (0);
+    caminhos[0].push_back (1);
+    caminhos[1].push_back (0);
+    caminhos[2].push_back (1);
+    std::vector<double> demanda (3, 100);
+    demanda[2] = 2;
+    std::vector<double> taxa;
+    std::vector<int32_t> gargalo;
+    max_min_justo (capacidade, caminhos, demanda, taxa, gargalo);
+    VERIFICAR (std::fabs (taxa[0] - 5) < 1e-9);
+    VERIFICAR (std::fabs (taxa[1] - 5) < 1e-9);
+    VERIFICAR (std::fabs (taxa[2] - 2) < 1e-9);
+    VERIFICAR (gargalo[0] == 0 && gargalo[1] == 0 && gargalo[2] == -1);
+    verificar_max_min (capacidade, caminhos, demanda, taxa, gargalo);
+}
+
+/**
+ * Escala do modo de estimativa: 100 mil fluxos com caminhos de 4 a 10
+ * saltos sobre 40 mil sentidos de enlace, capacidades e demandas variadas.
+ */
+static void testar_max_min_grande () {
+    const uint32_t sentidos = 40000;
+    const uint32_t fluxos = 100000;
+    std::mt19937 gerador (7);
+    std::uniform_int_distribution<uint32_t> sentido (0, sentidos - 1);
+    std::uniform_int_distribution<uint32_t> saltos (4, 10);
+    std::uniform_real_distribution<double> fator (0.1, 10);
+
+    std::vector<double> capacidade (sentidos);
+    for (uint32_t s = 0; s < sentidos; ++s) {
+        capacidade[s] = 10e6 * fator (gerador);
+    }
+    std::vector<std::vector<uint32_t> > caminhos (fluxos);
+    std::vector<double> demanda (fluxos);
+    for (uint32_t f = 0; f < fluxos; ++f) {
+        uint32_t n = saltos (gerador);
+        for (uint32_t k = 0; k < n; ++k) {
+            uint32_t s = sentido (gerador);
+            if (std::find (caminhos[f].begin (), caminhos[f].end (), s) == caminhos[f].end ()) {
+                caminhos[f].push_back (s);
+            }
+        }
+        demanda[f] = 1e6 * fator (gerador);
+    }
+
+    std::vector<double> taxa;
+    std::vector<int32_t> gargalo;
+    std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now ();
+    max_min_justo (capacidade, caminhos, demanda, taxa, gargalo);
+    double segundos = segundos_desde (inicio);
+    std::cout << "max_min_justo: " << fluxos << " fluxos, " << sentidos << " sentidos em " << segundos * 1e3 << " ms" << std::endl;
+    verificar_max_min (capacidade, caminhos, demanda, taxa, gargalo);
+}
+
+int main (int argc, char *argv[]) {
+  testar_particao_por_atraso ();
+  testar_particao_com_mais_sistemas_que_nos ();
+  testar_max_min_pequeno ();
+  testar_max_min_grande ();
+
+  if (falhas > 0) {
+      std::cerr << falhas << " verificacoes falharam" << std::endl;
+      return 1;
+  }
+  std::cout << "Testes: ok" << std::endl;
+  return 0;
+}
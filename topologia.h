@@ -0,0 +1,431 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Montagem da topologia a partir de uma descricao textual.
+//
+// O arquivo eh lido linha a linha (nao eh carregado inteiro na memoria) e
+// cada diretiva eh aplicada assim que eh lida. Linhas vazias e o que vier
+// depois de '#' sao ignorados. Diretivas aceitas:
+//
+//   classe <nome> <taxa> <atraso> <fila>
+//       Classe de enlace. <fila> eh o tamanho da fila DropTail do
+//       dispositivo ("10p") ou um dos nomes "global"/"comum", que usam os
+//       tamanhos configurados em OpcoesTopologia. A taxa e o atraso podem
+//       ser substituidos, por classe, pelas OpcoesTopologia.
+//
+//   no <nome> <regiao>
+//       Cria um noh com a pilha de internet instalada.
+//
+//   enderecamento <rede> <prefixo>
+//       Faixa usada pelos enlaces sem endereco explicito. Cada enlace
+//       recebe a proxima sub-rede /<prefixo> da faixa (tipicamente /24 ou /30).
+//
+//   enlace <a> <b> <classe> [<rede>/<prefixo> | -]
+//       Enlace ponto a ponto entre os nohs a e b, com a disciplina de fila
+//       raiz instalada nos dois dispositivos. Sem endereco, usa a faixa de
+//       "enderecamento"; com "-", o enlace fica sem endereco IP.
+//
+// Nohs e classes precisam ser declarados antes dos enlaces que os usam.
+// Nohs, classes e enlaces (pelo par a_b) nao podem se repetir.
+//
+
+#ifndef TOPOLOGIA_H
+#define TOPOLOGIA_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "medicao.h"
+#include "particao.h"
+
+/**
+ * Parametros de um tipo de enlace. O PointToPointHelper fica configurado
+ * uma unica vez por classe e eh reutilizado por todos os enlaces dela.
+ */
+struct ClasseEnlace {
+    std::string nome;
+    std::string taxa;
+    std::string atraso;
+    std::string fila;
+    ns3::PointToPointHelper p2p;
+};
+
+/**
+ * Enlace instalado. Guarda apenas os dispositivos e os enderecos, sem manter
+ * NetDeviceContainer/Ipv4InterfaceContainer vivos para cada enlace.
+ */
+struct Enlace {
+    uint32_t a;
+    uint32_t b;
+    uint32_t classe;
+    ns3::Ptr<ns3::NetDevice> dispositivo_a;
+    ns3::Ptr<ns3::NetDevice> dispositivo_b;
+    ns3::Ipv4Address ip_a;
+    ns3::Ipv4Address ip_b;
+    ns3::Ipv4Mask mascara;
+};
+
+/**
+ * Tempo de parede (em segundos) gasto em cada etapa da montagem.
+ */
+struct TemposMontagem {
+    double leitura = 0;
+    double nos = 0;
+    double dispositivos = 0;
+    double filas = 0;
+    double enderecos = 0;
+    double total = 0;
+};
+
+/**
+ * Bytes do heap que a montagem deixou alocados: pelos nohs (Node e pilha
+ * IP) e pelos enlaces (dispositivos, canal, filas, disciplina e enderecos).
+ */
+struct MemoriaMontagem {
+    int64_t nos = 0;
+    int64_t enlaces = 0;
+};
+
+struct OpcoesTopologia {
+    std::string fila_global = "10p";
+    std::string fila_comum = "6p";
+    std::string disciplina_fila = "ns3::RedQueueDisc";
+    // Substituem a taxa/atraso declarados na classe com o mesmo nome
+    std::map<std::string, std::string> taxa_classe;
+    std::map<std::string, std::string> atraso_classe;
+};
+
+struct Topologia {
+    std::vector<ns3::Ptr<ns3::Node> > nos;
+    std::vector<std::string> nomes;
+    std::vector<uint32_t> regiao_do_no;
+    std::vector<ns3::Ipv4Address> endereco_principal;
+    std::vector<std::string> regioes;
+    std::vector<ClasseEnlace> classes;
+    std::vector<Enlace> enlaces;
+
+    std::unordered_map<std::string, uint32_t> indice_nos;
+    std::unordered_map<std::string, uint32_t> indice_regioes;
+    std::unordered_map<std::string, uint32_t> indice_classes;
+    std::unordered_map<std::string, uint32_t> indice_enlaces;
+
+    TemposMontagem tempos;
+    MemoriaMontagem memoria;
+};
+
+
+/**
+ * Separa a linha em palavras, ignorando o que vier depois de '#'. O vetor
+ * palavras eh reaproveitado entre chamadas para nao alocar a cada linha.
+ */
+inline void separar_palavras(const std::string &linha, std::vector<std::string> &palavras) {
+    size_t usadas = 0;
+    size_t i = 0;
+    while (i < linha.size () && linha[i] != '#') {
+        if (linha[i] == ' ' || linha[i] == '\t' || linha[i] == '\r') {
+            ++i;
+            continue;
+        }
+        size_t inicio = i;
+        while (i < linha.size () && linha[i] != ' ' && linha[i] != '\t' && linha[i] != '\r' && linha[i] != '#') {
+            ++i;
+        }
+        if (usadas == palavras.size ()) {
+            palavras.push_back (std::string ());
+        }
+        palavras[usadas++].assign (linha, inicio, i - inicio);
+    }
+    palavras.resize (usadas);
+}
+
+inline uint32_t indice_ou_erro(const std::unordered_map<std::string, uint32_t> &indice, const std::string &nome, const char *tipo, uint64_t numero_linha) {
+    std::unordered_map<std::string, uint32_t>::const_iterator it = indice.find (nome);
+    if (it == indice.end ()) {
+        NS_FATAL_ERROR ("Topologia, linha " << numero_linha << ": " << tipo << " desconhecido(a): " << nome);
+    }
+    return it->second;
+}
+
+/**
+ * Le a descricao da topologia de entrada e monta nohs, dispositivos ponto a
+ * ponto, disciplinas de fila e enderecos, preenchendo os indices de
+ * topologia. A pilha de internet eh instalada com o helper recebido, para que
+ * quem chama possa escolher o roteamento. Na simulacao distribuida,
+ * sistema_do_no diz em qual processo fica cada noh (na ordem de declaracao).
+ */
+inline void carregar_topologia(std::istream &entrada, const OpcoesTopologia &opcoes, ns3::InternetStackHelper &internet, Topologia &topologia, const std::vector<uint32_t> *sistema_do_no = 0) {
+    using namespace ns3;
+    typedef std::chrono::steady_clock relogio;
+
+    relogio::time_point inicio_total = relogio::now ();
+    TemposMontagem &tempos = topologia.tempos;
+
+    TrafficControlHelper tch;
+    tch.SetRootQueueDisc (opcoes.disciplina_fila);
+
+    Ipv4AddressHelper ipv4_explicito;
+    Ipv4AddressHelper ipv4_automatico;
+    bool possui_faixa_automatica = false;
+
+    std::string linha;
+    std::vector<std::string> palavras;
+    uint64_t numero_linha = 0;
+
+    while (true) {
+        relogio::time_point inicio = relogio::now ();
+        if (!std::getline (entrada, linha)) {
+            tempos.leitura += segundos_desde (inicio);
+            break;
+        }
+        ++numero_linha;
+        separar_palavras (linha, palavras);
+        tempos.leitura += segundos_desde (inicio);
+
+        if (palavras.empty ()) {
+            continue;
+        }
+        const std::string &diretiva = palavras[0];
+
+        if (diretiva == "no") {
+            if (palavras.size () != 3) {
+                NS_FATAL_ERROR ("Topologia, linha " << numero_linha << ": esperado 'no <nome> <regiao>'");
+            }
+            if (topologia.indice_nos.count (palavras[1])) {
+                NS_FATAL_ERROR ("Topologia, linha " << numero_linha << ": noh repetido: " << palavras[1]);
+            }
+            inicio = relogio::now ();
+            int64_t bytes = bytes_em_uso ();
+
+            uint32_t regiao;
+            std::unordered_map<std::string, uint32_t>::iterator it = topologia.indice_regioes.find (palavras[2]);
+            if (it == topologia.indice_regioes.end ()) {
+                regiao = topologia.regioes.size ();
+                topologia.regioes.push_back (palavras[2]);
+                topologia.indice_regioes[palavras[2]] = regiao;
+            } else {
+                regiao = it->second;
+            }
+
+            uint32_t sistema = sistema_do_no ? sistema_do_no->at (topologia.nos.size ()) : 0;
+            Ptr<Node> no = CreateObject<Node> (sistema);
+            internet.Install (no);
+
+            topologia.indice_nos[palavras[1]] = topologia.nos.size ();
+            topologia.nos.push_back (no);
+            topologia.nomes.push_back (palavras[1]);
+            topologia.regiao_do_no.push_back (regiao);
+            topologia.endereco_principal.push_back (Ipv4Address ());
+            tempos.nos += segundos_desde (inicio);
+            topologia.memoria.nos += bytes_em_uso () - bytes;
+
+        } else if (diretiva == "classe") {
+            if (palavras.size () != 5) {
+                NS_FATAL_ERROR ("Topologia, linha " << numero_linha << ": esperado 'classe <nome> <taxa> <atraso> <fila>'");
+            }
+            if (topologia.indice_classes.count (palavras[1])) {
+                NS_FATAL_ERROR ("Topologia, linha " << numero_linha << ": classe repetida: " << palavras[1]);
+            }
+            ClasseEnlace classe;
+            classe.nome = palavras[1];
+            classe.taxa = palavras[2];
+            classe.atraso = palavras[3];
+            classe.fila = palavras[4];
+            std::map<std::string, std::string>::const_iterator substituta = opcoes.taxa_classe.find (classe.nome);
+            if (substituta != opcoes.taxa_classe.end ()) {
+                classe.taxa = substituta->second;
+            }
+            substituta = opcoes.atraso_classe.find (classe.nome);
+            if (substituta != opcoes.atraso_classe.end ()) {
+                classe.atraso = substituta->second;
+            }
+            if (classe.fila == "global") {
+                classe.fila = opcoes.fila_global;
+            } else if (classe.fila == "comum") {
+                classe.fila = opcoes.fila_comum;
+            }
+            classe.p2p.SetDeviceAttribute ("DataRate", StringValue (classe.taxa));
+            classe.p2p.SetChannelAttribute ("Delay", StringValue (classe.atraso));
+            classe.p2p.SetQueue ("ns3::DropTailQueue", "MaxSize", StringValue (classe.fila));
+
+            topologia.indice_classes[classe.nome] = topologia.classes.size ();
+            topologia.classes.push_back (classe);
+
+        } else if (diretiva == "enderecamento") {
+            if (palavras.size () != 3) {
+                NS_FATAL_ERROR ("Topologia, linha " << numero_linha << ": esperado 'enderecamento <rede> <prefixo>'");
+            }
+            std::string prefixo = "/" + palavras[2];
+            ipv4_automatico.SetBase (Ipv4Address (palavras[1].c_str ()), Ipv4Mask (prefixo.c_str ()));
+            possui_faixa_automatica = true;
+
+        } else if (diretiva == "enlace") {
+            if (palavras.size () != 4 && palavras.size () != 5) {
+                NS_FATAL_ERROR ("Topologia, linha " << numero_linha << ": esperado 'enlace <a> <b> <classe> [<rede>/<prefixo> | -]'");
+            }
+            Enlace enlace;
+            enlace.a = indice_ou_erro (topologia.indice_nos, palavras[1], "noh", numero_linha);
+            enlace.b = indice_ou_erro (topologia.indice_nos, palavras[2], "noh", numero_linha);
+            enlace.classe = indice_ou_erro (topologia.indice_classes, palavras[3], "classe", numero_linha);
+            std::string nome = palavras[1] + "_" + palavras[2];
+            if (topologia.indice_enlaces.count (nome)) {
+                NS_FATAL_ERROR ("Topologia, linha " << numero_linha << ": enlace repetido: " << nome);
+            }
+
+            int64_t bytes = bytes_em_uso ();
+            inicio = relogio::now ();
+            NetDeviceContainer dispositivos = topologia.classes[enlace.classe].p2p.Install (topologia.nos[enlace.a], topologia.nos[enlace.b]);
+            enlace.dispositivo_a = dispositivos.Get (0);
+            enlace.dispositivo_b = dispositivos.Get (1);
+            tempos.dispositivos += segundos_desde (inicio);
+
+            inicio = relogio::now ();
+            tch.Install (dispositivos);
+            tempos.filas += segundos_desde (inicio);
+
+            inicio = relogio::now ();
+            Ipv4InterfaceContainer interfaces;
+            if (palavras.size () == 4) {
+                if (!possui_faixa_automatica) {
+                    NS_FATAL_ERROR ("Topologia, linha " << numero_linha << ": enlace sem endereco e nenhuma diretiva 'enderecamento' antes dele");
+                }
+                interfaces = ipv4_automatico.Assign (dispositivos);
+                ipv4_automatico.NewNetwork ();
+            } else if (palavras[4] != "-") {
+                size_t barra = palavras[4].find ('/');
+                if (barra == std::string::npos) {
+                    NS_FATAL_ERROR ("Topologia, linha " << numero_linha << ": endereco deve estar no formato <rede>/<prefixo>: " << palavras[4]);
+                }
+                std::string rede = palavras[4].substr (0, barra);
+                std::string prefixo = palavras[4].substr (barra);
+                ipv4_explicito.SetBase (Ipv4Address (rede.c_str ()), Ipv4Mask (prefixo.c_str ()));
+                interfaces = ipv4_explicito.Assign (dispositivos);
+            }
+            if (interfaces.GetN () == 2) {
+                enlace.ip_a = interfaces.GetAddress (0);
+                enlace.ip_b = interfaces.GetAddress (1);
+                enlace.mascara = interfaces.Get (0).first->GetAddress (interfaces.Get (0).second, 0).GetMask ();
+                if (topologia.endereco_principal[enlace.a] == Ipv4Address ()) {
+                    topologia.endereco_principal[enlace.a] = enlace.ip_a;
+                }
+                if (topologia.endereco_principal[enlace.b] == Ipv4Address ()) {
+                    topologia.endereco_principal[enlace.b] = enlace.ip_b;
+                }
+            }
+            tempos.enderecos += segundos_desde (inicio);
+
+            topologia.indice_enlaces[nome] = topologia.enlaces.size ();
+            topologia.enlaces.push_back (enlace);
+            topologia.memoria.enlaces += bytes_em_uso () - bytes;
+
+        } else {
+            NS_FATAL_ERROR ("Topologia, linha " << numero_linha << ": diretiva desconhecida: " << diretiva);
+        }
+    }
+
+    tempos.total = segundos_desde (inicio_total);
+}
+
+/**
+ * Primeira passada sobre a descricao, sem criar nada no ns-3: conta os nohs
+ * e le os atrasos dos enlaces, usados para particionar a topologia antes de
+ * monta-la. Os atrasos substituidos nas opcoes valem aqui tambem.
+ */
+inline void ler_grafo_topologia(std::istream &entrada, const OpcoesTopologia &opcoes, uint32_t &nos,
+                                std::vector<ArestaParticao> &arestas) {
+    std::unordered_map<std::string, uint32_t> indice_nos;
+    std::unordered_map<std::string, double> atraso_da_classe;
+    std::string linha;
+    std::vector<std::string> palavras;
+    uint64_t numero_linha = 0;
+
+    while (std::getline (entrada, linha)) {
+        ++numero_linha;
+        separar_palavras (linha, palavras);
+        if (palavras.size () < 3) {
+            continue;
+        }
+        if (palavras[0] == "no") {
+            uint32_t indice = indice_nos.size ();
+            indice_nos[palavras[1]] = indice;
+        } else if (palavras[0] == "classe" && palavras.size () == 5) {
+            std::map<std::string, std::string>::const_iterator substituto = opcoes.atraso_classe.find (palavras[1]);
+            const std::string &atraso = substituto != opcoes.atraso_classe.end () ? substituto->second : palavras[3];
+            atraso_da_classe[palavras[1]] = ns3::Time (atraso).GetSeconds ();
+        } else if (palavras[0] == "enlace" && palavras.size () >= 4) {
+            ArestaParticao aresta;
+            aresta.a = indice_ou_erro (indice_nos, palavras[1], "noh", numero_linha);
+            aresta.b = indice_ou_erro (indice_nos, palavras[2], "noh", numero_linha);
+            std::unordered_map<std::string, double>::const_iterator it = atraso_da_classe.find (palavras[3]);
+            if (it == atraso_da_classe.end ()) {
+                NS_FATAL_ERROR ("Topologia, linha " << numero_linha << ": classe desconhecido(a): " << palavras[3]);
+            }
+            aresta.atraso = it->second;
+            arestas.push_back (aresta);
+        }
+    }
+    nos = indice_nos.size ();
+}
+
+inline ns3::Ptr<ns3::Node> no_da_topologia(const Topologia &topologia, const std::string &nome) {
+    return topologia.nos[indice_ou_erro (topologia.indice_nos, nome, "noh", 0)];
+}
+
+/**
+ * Endereco do primeiro enlace com IP do noh. Para os hosts (S*, N*) eh o
+ * endereco do enlace de acesso.
+ */
+inline ns3::Ipv4Address endereco_do_no(const Topologia &topologia, const std::string &nome) {
+    return topologia.endereco_principal[indice_ou_erro (topologia.indice_nos, nome, "noh", 0)];
+}
+
+inline const Enlace &enlace_da_topologia(const Topologia &topologia, const std::string &nome) {
+    return topologia.enlaces[indice_ou_erro (topologia.indice_enlaces, nome, "enlace", 0)];
+}
+
+inline std::string nome_do_enlace(const Topologia &topologia, const Enlace &enlace) {
+    return topologia.nomes[enlace.a] + "_" + topologia.nomes[enlace.b];
+}
+
+inline void imprimir_tempos_montagem(const Topologia &topologia, std::ostream &saida) {
+    const TemposMontagem &tempos = topologia.tempos;
+    saida << "Montagem da topologia: " << topologia.nos.size () << " nohs, "
+          << topologia.enlaces.size () << " enlaces, " << tempos.total << " s" << std::endl;
+    saida << "  leitura:       " << tempos.leitura << " s" << std::endl;
+    saida << "  nohs/pilha IP: " << tempos.nos << " s" << std::endl;
+    saida << "  dispositivos:  " << tempos.dispositivos << " s" << std::endl;
+    saida << "  filas:         " << tempos.filas << " s" << std::endl;
+    saida << "  enderecos:     " << tempos.enderecos << " s" << std::endl;
+    const MemoriaMontagem &memoria = topologia.memoria;
+    saida << "  memoria:       " << (topologia.nos.empty () ? 0 : memoria.nos / int64_t (topologia.nos.size ())) << " bytes/noh, "
+          << (topologia.enlaces.empty () ? 0 : memoria.enlaces / int64_t (topologia.enlaces.size ())) << " bytes/enlace" << std::endl;
+}
+
+#endif /* TOPOLOGIA_H */
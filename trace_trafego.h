@@ -0,0 +1,654 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Reproducao de traces de trafego: cada pacote eh enviado no instante e
+// com o tamanho gravados, em vez da taxa constante do OnOff.
+//
+// Formato binario (little-endian, na ordem de escrita):
+//
+//   cabecalho   "SIMTRACE", versao (u32), fluxos (u32), registros (u64),
+//               posicao da tabela de fluxos (u64)            32 bytes
+//   registros   tempo em ns (u64), fluxo (u32), tamanho (u32)  16 bytes cada,
+//               em ordem de tempo
+//   fluxos      protocolo (u8, 6 ou 17), porta de destino (u16), primeiro
+//               e ultimo instante em ns (u64), pacotes e bytes (u64),
+//               origem e destino (u16 com o tamanho + nome do noh)
+//
+// A tabela de fluxos fica no fim para que o arquivo seja escrito de uma
+// vez, sem saber antes quantos fluxos existem. Os fluxos ligam nomes de
+// nohs da topologia; o importador de pcap traduz os enderecos IP por um
+// mapa "<ip> <noh>".
+//
+// O leitor mapeia (mmap) so uma janela dos registros por vez, entao traces
+// de varios GB nao precisam caber na memoria. O ReprodutorTrace le os
+// registros em lotes: um evento por lote agenda o envio de todos os
+// pacotes ate o fim do lote, em vez de um evento de leitura por pacote.
+//
+
+#ifndef TRACE_TRAFEGO_H
+#define TRACE_TRAFEGO_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include "matriz_fluxos.h"
+#include "topologia.h"
+
+static const char MAGICO_TRACE[8] = { 'S', 'I', 'M', 'T', 'R', 'A', 'C', 'E' };
+static const uint32_t VERSAO_TRACE = 1;
+static const uint64_t CABECALHO_TRACE = 32;
+
+struct RegistroTrace {
+    uint64_t tempo_ns;
+    uint32_t fluxo;
+    uint32_t tamanho;
+};
+
+struct FluxoTrace {
+    std::string origem;
+    std::string destino;
+    bool udp = true;
+    uint16_t porta = 0;
+    uint64_t primeiro_ns = 0;
+    uint64_t ultimo_ns = 0;
+    uint64_t pacotes = 0;
+    uint64_t bytes = 0;
+};
+
+/**
+ * Grava um trace. Os registros precisam chegar em ordem de tempo; a tabela
+ * de fluxos e o cabecalho definitivo sao escritos em fechar.
+ */
+class EscritorTrace {
+public:
+    explicit EscritorTrace (const std::string &nome)
+        : m_nome (nome) {
+        m_saida.rdbuf ()->pubsetbuf (m_buffer, sizeof (m_buffer));
+        m_saida.open (nome.c_str (), std::ios::binary | std::ios::trunc);
+        if (!m_saida) {
+            NS_FATAL_ERROR ("Nao foi possivel criar o trace " << nome);
+        }
+        char vazio[CABECALHO_TRACE] = { 0 };
+        m_saida.write (vazio, sizeof (vazio));
+    }
+
+    /** Cria um fluxo e devolve seu indice. */
+    uint32_t criar_fluxo (const std::string &origem, const std::string &destino, bool udp, uint16_t porta) {
+        FluxoTrace fluxo;
+        fluxo.origem = origem;
+        fluxo.destino = destino;
+        fluxo.udp = udp;
+        fluxo.porta = porta;
+        m_fluxos.push_back (fluxo);
+        return m_fluxos.size () - 1;
+    }
+
+    void registrar (uint64_t tempo_ns, uint32_t fluxo, uint32_t tamanho) {
+        if (tempo_ns < m_ultimo_ns) {
+            NS_FATAL_ERROR ("Trace " << m_nome << ": registro fora de ordem (" << tempo_ns << " ns depois de " << m_ultimo_ns << " ns)");
+        }
+        m_ultimo_ns = tempo_ns;
+        RegistroTrace registro = { tempo_ns, fluxo, tamanho };
+        m_saida.write (reinterpret_cast<const char *> (&registro), sizeof (registro));
+        m_registros++;
+
+        FluxoTrace &dados = m_fluxos[fluxo];
+        if (dados.pacotes == 0) {
+            dados.primeiro_ns = tempo_ns;
+        }
+        dados.ultimo_ns = tempo_ns;
+        dados.pacotes++;
+        dados.bytes += tamanho;
+    }
+
+    uint64_t registros () const {
+        return m_registros;
+    }
+
+    const std::vector<FluxoTrace> &fluxos () const {
+        return m_fluxos;
+    }
+
+    void fechar () {
+        uint64_t posicao = CABECALHO_TRACE + m_registros * sizeof (RegistroTrace);
+        for (size_t i = 0; i < m_fluxos.size (); ++i) {
+            const FluxoTrace &fluxo = m_fluxos[i];
+            escrever<uint8_t> (fluxo.udp ? 17 : 6);
+            escrever<uint16_t> (fluxo.porta);
+            escrever<uint64_t> (fluxo.primeiro_ns);
+            escrever<uint64_t> (fluxo.ultimo_ns);
+            escrever<uint64_t> (fluxo.pacotes);
+            escrever<uint64_t> (fluxo.bytes);
+            escrever_nome (fluxo.origem);
+            escrever_nome (fluxo.destino);
+        }
+        m_saida.seekp (0);
+        m_saida.write (MAGICO_TRACE, sizeof (MAGICO_TRACE));
+        escrever<uint32_t> (VERSAO_TRACE);
+        escrever<uint32_t> (m_fluxos.size ());
+        escrever<uint64_t> (m_registros);
+        escrever<uint64_t> (posicao);
+        m_saida.close ();
+        if (!m_saida) {
+            NS_FATAL_ERROR ("Erro ao gravar o trace " << m_nome);
+        }
+    }
+
+private:
+    template <typename T>
+    void escrever (T valor) {
+        m_saida.write (reinterpret_cast<const char *> (&valor), sizeof (valor));
+    }
+
+    void escrever_nome (const std::string &nome) {
+        escrever<uint16_t> (nome.size ());
+        m_saida.write (nome.data (), nome.size ());
+    }
+
+    std::string m_nome;
+    char m_buffer[1 << 16];
+    std::ofstream m_saida;
+    std::vector<FluxoTrace> m_fluxos;
+    uint64_t m_registros = 0;
+    uint64_t m_ultimo_ns = 0;
+};
+
+/**
+ * Leitura sequencial de um trace por uma janela mapeada de tamanho fixo.
+ * Quando os registros da janela acabam, ela eh desmapeada e a seguinte eh
+ * mapeada, entao a memoria residente nao passa do tamanho da janela.
+ */
+class LeitorTrace {
+public:
+    explicit LeitorTrace (uint64_t janela_bytes)
+        : m_janela (std::max<uint64_t> (janela_bytes, 1 << 20)) {
+    }
+
+    ~LeitorTrace () {
+        desmapear ();
+        if (m_descritor >= 0) {
+            close (m_descritor);
+        }
+    }
+
+    void abrir (const std::string &nome) {
+        m_nome = nome;
+        m_descritor = open (nome.c_str (), O_RDONLY);
+        struct stat estado;
+        if (m_descritor < 0 || fstat (m_descritor, &estado) != 0) {
+            NS_FATAL_ERROR ("Nao foi possivel abrir o trace " << nome);
+        }
+        m_tamanho_arquivo = estado.st_size;
+
+        char cabecalho[CABECALHO_TRACE];
+        uint32_t versao;
+        uint32_t fluxos;
+        uint64_t posicao_fluxos;
+        if (!ler_em (0, cabecalho, sizeof (cabecalho)) || std::memcmp (cabecalho, MAGICO_TRACE, sizeof (MAGICO_TRACE)) != 0) {
+            NS_FATAL_ERROR ("Trace " << nome << ": arquivo nao eh um trace (cabecalho SIMTRACE)");
+        }
+        std::memcpy (&versao, cabecalho + 8, 4);
+        std::memcpy (&fluxos, cabecalho + 12, 4);
+        std::memcpy (&m_registros, cabecalho + 16, 8);
+        std::memcpy (&posicao_fluxos, cabecalho + 24, 8);
+        if (versao != VERSAO_TRACE) {
+            NS_FATAL_ERROR ("Trace " << nome << ": versao " << versao << " nao suportada");
+        }
+        if (posicao_fluxos != CABECALHO_TRACE + m_registros * sizeof (RegistroTrace) || posicao_fluxos > m_tamanho_arquivo) {
+            NS_FATAL_ERROR ("Trace " << nome << ": arquivo truncado");
+        }
+
+        // A tabela de fluxos eh pequena perto dos registros; vai inteira para a memoria
+        std::vector<char> tabela (m_tamanho_arquivo - posicao_fluxos);
+        if (!ler_em (posicao_fluxos, tabela.data (), tabela.size ())) {
+            NS_FATAL_ERROR ("Trace " << nome << ": erro ao ler a tabela de fluxos");
+        }
+        size_t cursor = 0;
+        m_fluxos.resize (fluxos);
+        for (uint32_t i = 0; i < fluxos; ++i) {
+            FluxoTrace &fluxo = m_fluxos[i];
+            uint8_t protocolo;
+            if (!extrair (tabela, cursor, protocolo) || !extrair (tabela, cursor, fluxo.porta)
+                || !extrair (tabela, cursor, fluxo.primeiro_ns) || !extrair (tabela, cursor, fluxo.ultimo_ns)
+                || !extrair (tabela, cursor, fluxo.pacotes) || !extrair (tabela, cursor, fluxo.bytes)
+                || !extrair_nome (tabela, cursor, fluxo.origem) || !extrair_nome (tabela, cursor, fluxo.destino)) {
+                NS_FATAL_ERROR ("Trace " << nome << ": tabela de fluxos truncada no fluxo " << i);
+            }
+            fluxo.udp = protocolo == 17;
+        }
+    }
+
+    const std::vector<FluxoTrace> &fluxos () const {
+        return m_fluxos;
+    }
+
+    uint64_t registros () const {
+        return m_registros;
+    }
+
+    uint64_t janelas_mapeadas () const {
+        return m_janelas_mapeadas;
+    }
+
+    /**
+     * O proximo registro, sem avancar, ou 0 no fim do trace. O ponteiro so
+     * vale ate a proxima chamada de avancar.
+     */
+    const RegistroTrace *proximo () {
+        if (m_atual >= m_registros) {
+            return 0;
+        }
+        if (m_atual >= m_fim_janela) {
+            mapear (m_atual);
+        }
+        return m_inicio_registros + (m_atual - m_primeiro_janela);
+    }
+
+    void avancar () {
+        m_atual++;
+    }
+
+private:
+    /** Mapeia a janela que comeca no registro indicado (alinhada a pagina). */
+    void mapear (uint64_t registro) {
+        desmapear ();
+        uint64_t pagina = sysconf (_SC_PAGESIZE);
+        uint64_t posicao = CABECALHO_TRACE + registro * sizeof (RegistroTrace);
+        uint64_t base = posicao - posicao % pagina;
+        uint64_t fim_registros = CABECALHO_TRACE + m_registros * sizeof (RegistroTrace);
+        m_tamanho_mapa = std::min (m_janela, fim_registros - base);
+        m_mapa = mmap (0, m_tamanho_mapa, PROT_READ, MAP_PRIVATE, m_descritor, base);
+        if (m_mapa == MAP_FAILED) {
+            m_mapa = 0;
+            NS_FATAL_ERROR ("Trace " << m_nome << ": mmap falhou");
+        }
+        madvise (m_mapa, m_tamanho_mapa, MADV_SEQUENTIAL);
+        m_inicio_registros = reinterpret_cast<const RegistroTrace *> (static_cast<const char *> (m_mapa) + (posicao - base));
+        m_primeiro_janela = registro;
+        m_fim_janela = registro + (base + m_tamanho_mapa - posicao) / sizeof (RegistroTrace);
+        m_janelas_mapeadas++;
+    }
+
+    void desmapear () {
+        if (m_mapa) {
+            munmap (m_mapa, m_tamanho_mapa);
+            m_mapa = 0;
+        }
+    }
+
+    bool ler_em (uint64_t posicao, char *destino, size_t bytes) {
+        while (bytes > 0) {
+            ssize_t lidos = pread (m_descritor, destino, bytes, posicao);
+            if (lidos <= 0) {
+                return false;
+            }
+            destino += lidos;
+            posicao += lidos;
+            bytes -= lidos;
+        }
+        return true;
+    }
+
+    template <typename T>
+    static bool extrair (const std::vector<char> &tabela, size_t &cursor, T &valor) {
+        if (cursor + sizeof (T) > tabela.size ()) {
+            return false;
+        }
+        std::memcpy (&valor, tabela.data () + cursor, sizeof (T));
+        cursor += sizeof (T);
+        return true;
+    }
+
+    static bool extrair_nome (const std::vector<char> &tabela, size_t &cursor, std::string &nome) {
+        uint16_t tamanho;
+        if (!extrair (tabela, cursor, tamanho) || cursor + tamanho > tabela.size ()) {
+            return false;
+        }
+        nome.assign (tabela.data () + cursor, tamanho);
+        cursor += tamanho;
+        return true;
+    }
+
+    std::string m_nome;
+    uint64_t m_janela;
+    int m_descritor = -1;
+    uint64_t m_tamanho_arquivo = 0;
+    uint64_t m_registros = 0;
+    std::vector<FluxoTrace> m_fluxos;
+
+    void *m_mapa = 0;
+    uint64_t m_tamanho_mapa = 0;
+    const RegistroTrace *m_inicio_registros = 0;
+    uint64_t m_primeiro_janela = 0;
+    uint64_t m_fim_janela = 0;
+    uint64_t m_atual = 0;
+    uint64_t m_janelas_mapeadas = 0;
+};
+
+struct ResumoImportacao {
+    uint64_t pacotes = 0;
+    uint64_t importados = 0;
+    // Descartados: nao IPv4/TCP/UDP ou fragmentos, sem dados (ACKs puros) e
+    // com endereco fora do mapa (ou os dois no mesmo noh)
+    uint64_t outros = 0;
+    uint64_t sem_dados = 0;
+    uint64_t sem_mapa = 0;
+    // Importados com o tempo adiantado ate o do anterior (capturas fora de ordem)
+    uint64_t reordenados = 0;
+    uint32_t fluxos = 0;
+};
+
+/**
+ * Converte um pcap (formato classico, em us ou ns) em trace. Cada 5-tupla
+ * TCP/UDP vira um fluxo entre os nohs dados pelo mapa de enderecos; o
+ * tamanho registrado eh o da carga de transporte e os tempos comecam em 0
+ * no primeiro pacote. Capturas de placas com varias filas ou juntadas
+ * podem ter tempos um pouco fora de ordem: um pacote mais antigo que o
+ * ultimo importado fica com o tempo dele. Enlaces suportados: Ethernet, IP
+ * puro e Linux SLL.
+ */
+inline ResumoImportacao importar_pcap(const std::string &pcap, std::istream &mapa, const std::string &saida) {
+    std::unordered_map<uint32_t, std::string> no_do_endereco;
+    std::string linha;
+    std::vector<std::string> palavras;
+    uint64_t numero_linha = 0;
+    while (std::getline (mapa, linha)) {
+        numero_linha++;
+        separar_palavras (linha, palavras);
+        if (palavras.empty ()) {
+            continue;
+        }
+        if (palavras.size () != 2) {
+            NS_FATAL_ERROR ("Mapa de enderecos, linha " << numero_linha << ": esperado '<ip> <noh>'");
+        }
+        no_do_endereco[ns3::Ipv4Address (palavras[0].c_str ()).Get ()] = palavras[1];
+    }
+
+    std::ifstream entrada (pcap.c_str (), std::ios::binary);
+    if (!entrada) {
+        NS_FATAL_ERROR ("Nao foi possivel abrir o pcap " << pcap);
+    }
+    unsigned char global[24];
+    if (!entrada.read (reinterpret_cast<char *> (global), sizeof (global))) {
+        NS_FATAL_ERROR ("Pcap " << pcap << ": cabecalho incompleto");
+    }
+    uint32_t magico = global[0] | (global[1] << 8) | (global[2] << 16) | (uint32_t (global[3]) << 24);
+    bool invertido;
+    bool nanossegundos;
+    if (magico == 0xa1b2c3d4 || magico == 0xa1b23c4d) {
+        invertido = false;
+        nanossegundos = magico == 0xa1b23c4d;
+    } else if (magico == 0xd4c3b2a1 || magico == 0x4d3cb2a1) {
+        invertido = true;
+        nanossegundos = magico == 0x4d3cb2a1;
+    } else {
+        NS_FATAL_ERROR ("Pcap " << pcap << ": formato desconhecido (pcapng nao eh suportado)");
+    }
+    auto ler32 = [invertido] (const unsigned char *p) {
+        return invertido ? (uint32_t (p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]
+                         : p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t (p[3]) << 24);
+    };
+    uint32_t enlace = ler32 (global + 20);
+    size_t cabecalho_enlace;
+    if (enlace == 1) {
+        cabecalho_enlace = 14;
+    } else if (enlace == 101 || enlace == 228) {
+        cabecalho_enlace = 0;
+    } else if (enlace == 113) {
+        cabecalho_enlace = 16;
+    } else {
+        NS_FATAL_ERROR ("Pcap " << pcap << ": tipo de enlace " << enlace << " nao suportado (use Ethernet, IP puro ou Linux SLL)");
+    }
+
+    ResumoImportacao resumo;
+    EscritorTrace escritor (saida);
+    // (origem << 32 | destino, protocolo << 32 | portas) -> fluxo
+    std::map<std::pair<uint64_t, uint64_t>, uint32_t> fluxos;
+    std::vector<unsigned char> pacote;
+    unsigned char registro[16];
+    uint64_t primeiro_ns = 0;
+    uint64_t ultimo_ns = 0;
+    while (entrada.read (reinterpret_cast<char *> (registro), sizeof (registro))) {
+        uint64_t tempo_ns = uint64_t (ler32 (registro)) * 1000000000ULL + uint64_t (ler32 (registro + 4)) * (nanossegundos ? 1 : 1000);
+        uint32_t capturado = ler32 (registro + 8);
+        pacote.resize (capturado);
+        if (!entrada.read (reinterpret_cast<char *> (pacote.data ()), capturado)) {
+            break;
+        }
+        if (resumo.pacotes++ == 0) {
+            primeiro_ns = tempo_ns;
+        }
+
+        // Localiza o cabecalho IPv4
+        size_t ip = cabecalho_enlace;
+        uint16_t tipo = 0x0800;
+        if (enlace == 1 && capturado >= 14) {
+            tipo = (pacote[12] << 8) | pacote[13];
+            if (tipo == 0x8100 && capturado >= 18) {
+                tipo = (pacote[16] << 8) | pacote[17];
+                ip += 4;
+            }
+        } else if (enlace == 113 && capturado >= 16) {
+            tipo = (pacote[14] << 8) | pacote[15];
+        }
+        if (tipo != 0x0800 || capturado < ip + 20 || (pacote[ip] >> 4) != 4) {
+            resumo.outros++;
+            continue;
+        }
+        size_t tamanho_ip = (pacote[ip] & 0x0f) * 4;
+        uint32_t total = (pacote[ip + 2] << 8) | pacote[ip + 3];
+        uint8_t protocolo = pacote[ip + 9];
+        // Qualquer fragmento, inclusive o primeiro (MF ligado, deslocamento 0)
+        bool fragmento = (pacote[ip + 6] & 0x20) != 0 || (((pacote[ip + 6] & 0x1f) << 8) | pacote[ip + 7]) != 0;
+        size_t transporte = ip + tamanho_ip;
+        if ((protocolo != 6 && protocolo != 17) || fragmento || capturado < transporte + (protocolo == 6 ? 20 : 8)) {
+            resumo.outros++;
+            continue;
+        }
+        size_t tamanho_transporte = protocolo == 6 ? (pacote[transporte + 12] >> 4) * 4 : 8;
+        if (total <= tamanho_ip + tamanho_transporte) {
+            resumo.sem_dados++;
+            continue;
+        }
+        uint32_t carga = total - tamanho_ip - tamanho_transporte;
+
+        uint32_t origem = (uint32_t (pacote[ip + 12]) << 24) | (pacote[ip + 13] << 16) | (pacote[ip + 14] << 8) | pacote[ip + 15];
+        uint32_t destino = (uint32_t (pacote[ip + 16]) << 24) | (pacote[ip + 17] << 16) | (pacote[ip + 18] << 8) | pacote[ip + 19];
+        uint32_t portas = (uint32_t (pacote[transporte]) << 24) | (pacote[transporte + 1] << 16) | (pacote[transporte + 2] << 8) | pacote[transporte + 3];
+        std::pair<uint64_t, uint64_t> chave ((uint64_t (origem) << 32) | destino, (uint64_t (protocolo) << 32) | portas);
+        std::map<std::pair<uint64_t, uint64_t>, uint32_t>::iterator it = fluxos.find (chave);
+        if (it == fluxos.end ()) {
+            std::unordered_map<uint32_t, std::string>::const_iterator de = no_do_endereco.find (origem);
+            std::unordered_map<uint32_t, std::string>::const_iterator para = no_do_endereco.find (destino);
+            uint16_t porta = portas & 0xffff;
+            if (de == no_do_endereco.end () || para == no_do_endereco.end () || de->second == para->second || porta == 0) {
+                // Lembra a 5-tupla como descartada para nao procurar no mapa de novo
+                fluxos[chave] = UINT32_MAX;
+                resumo.sem_mapa++;
+                continue;
+            }
+            it = fluxos.insert (std::make_pair (chave, escritor.criar_fluxo (de->second, para->second, protocolo == 17, porta))).first;
+        }
+        if (it->second == UINT32_MAX) {
+            resumo.sem_mapa++;
+            continue;
+        }
+        uint64_t relativo = tempo_ns > primeiro_ns ? tempo_ns - primeiro_ns : 0;
+        if (relativo < ultimo_ns) {
+            relativo = ultimo_ns;
+            resumo.reordenados++;
+        }
+        ultimo_ns = relativo;
+        escritor.registrar (relativo, it->second, carga);
+        resumo.importados++;
+    }
+    escritor.fechar ();
+    resumo.fluxos = escritor.fluxos ().size ();
+    return resumo;
+}
+
+/**
+ * Envia os pacotes de um trace pelos nohs da topologia. Cada fluxo tem um
+ * socket na origem, criado no primeiro pacote; no TCP os tamanhos viram
+ * escritas no socket, e o que nao cabe no buffer de envio eh contado como
+ * recusado.
+ */
+class ReprodutorTrace {
+public:
+    /** inicio desloca todo o trace; lote eh o horizonte de cada leitura, em s. */
+    ReprodutorTrace (const Topologia &topologia, LeitorTrace &leitor, double inicio, double lote)
+        : m_topologia (topologia), m_leitor (leitor), m_inicio (ns3::Seconds (inicio)), m_lote (ns3::Seconds (lote)) {
+    }
+
+    /**
+     * Resolve os nomes dos nohs, instala os receptores e agenda o primeiro
+     * lote.
+     */
+    ResumoInstalacao instalar () {
+        ResumoInstalacao resumo;
+        const std::vector<FluxoTrace> &fluxos = m_leitor.fluxos ();
+        uint32_t sistema = ns3::Simulator::GetSystemId ();
+        std::vector<FluxoMatriz> receptores;
+        m_origem.resize (fluxos.size ());
+        m_destino.resize (fluxos.size ());
+        m_sockets.resize (fluxos.size ());
+        for (size_t i = 0; i < fluxos.size (); ++i) {
+            const FluxoTrace &fluxo = fluxos[i];
+            std::unordered_map<std::string, uint32_t>::const_iterator de = m_topologia.indice_nos.find (fluxo.origem);
+            std::unordered_map<std::string, uint32_t>::const_iterator para = m_topologia.indice_nos.find (fluxo.destino);
+            if (de == m_topologia.indice_nos.end () || para == m_topologia.indice_nos.end ()) {
+                NS_FATAL_ERROR ("Trace, fluxo " << i << ": noh desconhecido na topologia (" << fluxo.origem << " -> " << fluxo.destino << ")");
+            }
+            if (m_topologia.endereco_principal[para->second] == ns3::Ipv4Address ()) {
+                NS_FATAL_ERROR ("Trace, fluxo " << i << ": destino " << fluxo.destino << " nao tem endereco IP");
+            }
+            m_origem[i] = de->second;
+            m_destino[i] = para->second;
+            if (fluxo.pacotes == 0) {
+                continue;
+            }
+            // Receptor ativo do primeiro pacote ate 1 s depois do ultimo, para os que ainda estao em transito
+            double inicio = m_inicio.GetSeconds () + fluxo.primeiro_ns / 1e9;
+            double fim = m_inicio.GetSeconds () + fluxo.ultimo_ns / 1e9 + 1.0;
+            FluxoMatriz receptor = { m_origem[i], m_destino[i], fluxo.udp, ns3::DataRate (), 0, inicio, fim, fluxo.porta, false };
+            receptores.push_back (receptor);
+            m_fim = std::max (m_fim, m_inicio + ns3::NanoSeconds (fluxo.ultimo_ns));
+            if (m_topologia.nos[m_origem[i]]->GetSystemId () == sistema) {
+                resumo.enviadores++;
+            }
+        }
+        resumo.receptores = instalar_receptores (m_topologia, receptores);
+
+        const RegistroTrace *registro = m_leitor.proximo ();
+        if (registro) {
+            ns3::Simulator::Schedule (m_inicio + ns3::NanoSeconds (registro->tempo_ns), &ReprodutorTrace::ler_lote, this);
+        }
+        return resumo;
+    }
+
+    /** Instante do ultimo pacote do trace. */
+    ns3::Time fim () const {
+        return m_fim;
+    }
+
+    ns3::Time inicio () const {
+        return m_inicio;
+    }
+
+    void imprimir (std::ostream &saida) const {
+        saida << "Trace: " << m_enviados << " pacotes enviados de " << m_leitor.registros () << " registros em "
+              << m_lotes << " lotes (" << m_leitor.janelas_mapeadas () << " janelas mapeadas)";
+        if (m_recusados > 0) {
+            saida << ", " << m_recusados << " recusados pelo socket";
+        }
+        saida << std::endl;
+    }
+
+private:
+    /** Agenda os envios de todos os registros ate o fim do lote. */
+    void ler_lote () {
+        m_lotes++;
+        ns3::Time agora = ns3::Simulator::Now ();
+        ns3::Time horizonte = agora + m_lote;
+        uint32_t sistema = ns3::Simulator::GetSystemId ();
+        const RegistroTrace *registro;
+        while ((registro = m_leitor.proximo ()) != 0) {
+            ns3::Time instante = m_inicio + ns3::NanoSeconds (registro->tempo_ns);
+            if (instante >= horizonte) {
+                // O proximo lote comeca no proximo pacote, pulando os intervalos vazios
+                ns3::Simulator::Schedule (instante - agora, &ReprodutorTrace::ler_lote, this);
+                return;
+            }
+            if (registro->fluxo >= m_origem.size ()) {
+                NS_FATAL_ERROR ("Trace: registro do fluxo " << registro->fluxo << ", mas a tabela so tem " << m_origem.size () << " fluxos");
+            }
+            if (m_topologia.nos[m_origem[registro->fluxo]]->GetSystemId () == sistema) {
+                ns3::Simulator::Schedule (instante - agora, &ReprodutorTrace::enviar, this, registro->fluxo, registro->tamanho);
+            }
+            m_leitor.avancar ();
+        }
+    }
+
+    void enviar (uint32_t fluxo, uint32_t tamanho) {
+        ns3::Ptr<ns3::Socket> &socket = m_sockets[fluxo];
+        if (!socket) {
+            const FluxoTrace &dados = m_leitor.fluxos ()[fluxo];
+            ns3::TypeId fabrica = ns3::TypeId::LookupByName (dados.udp ? FABRICA_UDP : FABRICA_TCP);
+            socket = ns3::Socket::CreateSocket (m_topologia.nos[m_origem[fluxo]], fabrica);
+            socket->Bind ();
+            socket->Connect (ns3::InetSocketAddress (m_topologia.endereco_principal[m_destino[fluxo]], dados.porta));
+        }
+        if (socket->Send (ns3::Create<ns3::Packet> (tamanho)) < 0) {
+            m_recusados++;
+        } else {
+            m_enviados++;
+        }
+    }
+
+    const Topologia &m_topologia;
+    LeitorTrace &m_leitor;
+    ns3::Time m_inicio;
+    ns3::Time m_lote;
+    ns3::Time m_fim;
+    std::vector<uint32_t> m_origem;
+    std::vector<uint32_t> m_destino;
+    std::vector<ns3::Ptr<ns3::Socket> > m_sockets;
+    uint64_t m_lotes = 0;
+    uint64_t m_enviados = 0;
+    uint64_t m_recusados = 0;
+};
+
+#endif /* TRACE_TRAFEGO_H */
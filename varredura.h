@@ -0,0 +1,209 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Desenho de uma varredura de parametros. O arquivo tem uma dimensao por
+// linha ('#' inicia comentario):
+//
+//   <parametro> <valor> [<valor> ...]
+//   <parametro> faixa <minimo> <maximo> [<unidade>]
+//
+// Ex.: "taxa 1Mbps 4Mbps 8Mbps", "fila_global faixa 5 50 p" ou
+// "classe.global_20ms.atraso faixa 5 40 ms". Numa faixa com minimo e maximo
+// inteiros os valores sao arredondados.
+//
+// - grade: produto cartesiano das dimensoes; cada faixa vira "passos"
+//   valores igualmente espacados;
+// - lhs (hipercubo latino): "pontos" pontos; cada dimensao eh dividida em
+//   "pontos" estratos e cada estrato eh usado por exatamente um ponto. Numa
+//   faixa o valor eh sorteado dentro do estrato; numa lista o estrato
+//   escolhe o valor. A semente torna o desenho reproduzivel, o que permite
+//   retomar uma varredura interrompida.
+//
+
+#ifndef VARREDURA_H
+#define VARREDURA_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <istream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+
+#include "topologia.h"
+
+struct DimensaoVarredura {
+    std::string parametro;
+    std::vector<std::string> valores;
+    bool faixa = false;
+    double minimo = 0;
+    double maximo = 0;
+    bool inteira = false;
+    std::string unidade;
+};
+
+struct DesenhoVarredura {
+    std::vector<std::string> parametros;
+    std::vector<std::vector<std::string> > pontos;
+};
+
+inline bool numero_inteiro(const std::string &texto) {
+    return !texto.empty () && texto.find_first_not_of ("-0123456789") == std::string::npos;
+}
+
+inline void ler_dimensoes_varredura(std::istream &entrada, std::vector<DimensaoVarredura> &dimensoes) {
+    std::string linha;
+    std::vector<std::string> palavras;
+    uint64_t numero_linha = 0;
+    while (std::getline (entrada, linha)) {
+        numero_linha++;
+        separar_palavras (linha, palavras);
+        if (palavras.empty ()) {
+            continue;
+        }
+        if (palavras.size () < 2) {
+            NS_FATAL_ERROR ("Varredura, linha " << numero_linha << ": esperado '<parametro> <valor> [<valor> ...]' ou '<parametro> faixa <minimo> <maximo> [<unidade>]'");
+        }
+        for (size_t i = 0; i < dimensoes.size (); ++i) {
+            if (dimensoes[i].parametro == palavras[0]) {
+                NS_FATAL_ERROR ("Varredura, linha " << numero_linha << ": parametro repetido: " << palavras[0]);
+            }
+        }
+        DimensaoVarredura dimensao;
+        dimensao.parametro = palavras[0];
+        if (palavras[1] == "faixa") {
+            if (palavras.size () != 4 && palavras.size () != 5) {
+                NS_FATAL_ERROR ("Varredura, linha " << numero_linha << ": esperado '<parametro> faixa <minimo> <maximo> [<unidade>]'");
+            }
+            dimensao.faixa = true;
+            dimensao.minimo = std::atof (palavras[2].c_str ());
+            dimensao.maximo = std::atof (palavras[3].c_str ());
+            dimensao.inteira = numero_inteiro (palavras[2]) && numero_inteiro (palavras[3]);
+            dimensao.unidade = palavras.size () == 5 ? palavras[4] : "";
+            if (dimensao.maximo < dimensao.minimo) {
+                NS_FATAL_ERROR ("Varredura, linha " << numero_linha << ": faixa com maximo menor que o minimo");
+            }
+        } else {
+            dimensao.valores.assign (palavras.begin () + 1, palavras.end ());
+        }
+        dimensoes.push_back (dimensao);
+    }
+    if (dimensoes.empty ()) {
+        NS_FATAL_ERROR ("Varredura sem nenhum parametro");
+    }
+}
+
+/** Valor da faixa na posicao relativa fracao (0 = minimo, 1 = maximo). */
+inline std::string valor_da_faixa(const DimensaoVarredura &dimensao, double fracao) {
+    double valor = dimensao.minimo + fracao * (dimensao.maximo - dimensao.minimo);
+    std::ostringstream texto;
+    if (dimensao.inteira) {
+        texto << (long long) std::llround (valor);
+    } else {
+        texto.precision (6);
+        texto << valor;
+    }
+    texto << dimensao.unidade;
+    return texto.str ();
+}
+
+inline DesenhoVarredura desenho_grade(const std::vector<DimensaoVarredura> &dimensoes, uint32_t passos) {
+    passos = std::max<uint32_t> (passos, 1);
+    std::vector<std::vector<std::string> > valores (dimensoes.size ());
+    DesenhoVarredura desenho;
+    for (size_t i = 0; i < dimensoes.size (); ++i) {
+        const DimensaoVarredura &dimensao = dimensoes[i];
+        desenho.parametros.push_back (dimensao.parametro);
+        if (!dimensao.faixa) {
+            valores[i] = dimensao.valores;
+            continue;
+        }
+        for (uint32_t k = 0; k < passos; ++k) {
+            std::string valor = valor_da_faixa (dimensao, passos == 1 ? 0.5 : double (k) / (passos - 1));
+            if (valores[i].empty () || valores[i].back () != valor) {
+                valores[i].push_back (valor);
+            }
+        }
+    }
+
+    // Contador com um digito por dimensao; a ultima varia mais rapido
+    std::vector<size_t> indice (dimensoes.size (), 0);
+    while (true) {
+        std::vector<std::string> ponto (dimensoes.size ());
+        for (size_t i = 0; i < dimensoes.size (); ++i) {
+            ponto[i] = valores[i][indice[i]];
+        }
+        desenho.pontos.push_back (ponto);
+
+        size_t i = dimensoes.size ();
+        while (i > 0 && ++indice[i - 1] == valores[i - 1].size ()) {
+            indice[i - 1] = 0;
+            --i;
+        }
+        if (i == 0) {
+            break;
+        }
+    }
+    return desenho;
+}
+
+inline DesenhoVarredura desenho_hipercubo(const std::vector<DimensaoVarredura> &dimensoes, uint32_t pontos, uint32_t semente) {
+    pontos = std::max<uint32_t> (pontos, 1);
+    std::mt19937 gerador (semente);
+    std::uniform_real_distribution<double> uniforme (0.0, 1.0);
+
+    DesenhoVarredura desenho;
+    desenho.pontos.assign (pontos, std::vector<std::string> (dimensoes.size ()));
+    std::vector<uint32_t> estratos (pontos);
+    for (size_t i = 0; i < dimensoes.size (); ++i) {
+        const DimensaoVarredura &dimensao = dimensoes[i];
+        desenho.parametros.push_back (dimensao.parametro);
+        for (uint32_t k = 0; k < pontos; ++k) {
+            estratos[k] = k;
+        }
+        std::shuffle (estratos.begin (), estratos.end (), gerador);
+        for (uint32_t k = 0; k < pontos; ++k) {
+            if (dimensao.faixa) {
+                double fracao = (estratos[k] + uniforme (gerador)) / pontos;
+                desenho.pontos[k][i] = valor_da_faixa (dimensao, fracao);
+            } else {
+                desenho.pontos[k][i] = dimensao.valores[uint64_t (estratos[k]) * dimensao.valores.size () / pontos];
+            }
+        }
+    }
+    return desenho;
+}
+
+/** Valores de um ponto separados por virgula: a chave do ponto na tabela. */
+inline std::string chave_do_ponto(const std::vector<std::string> &valores) {
+    std::string chave;
+    for (size_t i = 0; i < valores.size (); ++i) {
+        if (i > 0) {
+            chave += ',';
+        }
+        chave += valores[i];
+    }
+    return chave;
+}
+
+#endif /* VARREDURA_H */
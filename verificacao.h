@@ -0,0 +1,618 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Verificacao estatica do roteamento, sem rodar a simulacao: para todos os
+// pares (origem, destino) segue o proximo salto de cada noh ate o endereco
+// principal do destino e informa alcancabilidade, saltos, atraso de
+// propagacao e gargalo (menor taxa) do caminho. Problemas:
+// - sem_rota: a origem nao tem rota para o destino;
+// - buraco: um roteador no meio do caminho nao tem rota;
+// - laco: o caminho volta a um noh ja visitado.
+//
+// Os proximos saltos vem de uma de duas fontes:
+// - tabelas: as tabelas instaladas, so com global e ecmp (as do RIP e do
+//   OLSR so existem durante a simulacao). A de cada noh eh lida em uma
+//   passada (as rotas de cada protocolo da lista, na ordem de prioridade,
+//   ver ler_rotas), com os nohs
+//   divididos entre threads: cada thread so toca os objetos do ns-3 dos
+//   seus nohs. As rotas ficam agrupadas por mascara, da mais longa para a
+//   mais curta, em vetores ordenados pela rede, e o proximo salto eh a
+//   primeira que casa com o endereco principal do destino. No ecmp o
+//   multipercurso nao tem tabela: o que nao casa com o estatico segue o
+//   caminho de menor custo do grafo dele, um dos que ele aceita;
+// - grafo: caminhos de menor custo do grafo IP (mesma metrica do roteamento
+//   global), um Dijkstra reverso por destino; escala para dezenas de
+//   milhares de nohs, mas nao enxerga rotas instaladas a mao.
+//
+// Com os proximos saltos de um destino, o caminho de cada origem eh
+// resolvido uma vez so (cada noh reaproveita o resultado do seguinte), e os
+// destinos sao divididos entre threads.
+//
+
+#ifndef VERIFICACAO_H
+#define VERIFICACAO_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/ipv4-list-routing.h"
+#include "ns3/ipv4-routing-table-entry.h"
+
+#include "grafo_roteamento.h"
+#include "medicao.h"
+#include "multipercurso.h"
+#include "topologia.h"
+
+enum TipoProblemaRota {
+    ROTA_SEM_ROTA,
+    ROTA_BURACO,
+    ROTA_LACO
+};
+
+inline const char *nome_problema_rota(TipoProblemaRota tipo) {
+    static const char *nomes[] = { "sem_rota", "buraco", "laco" };
+    return nomes[tipo];
+}
+
+struct ProblemaRota {
+    uint32_t origem;
+    uint32_t destino;
+    TipoProblemaRota tipo;
+    // Noh sem rota ou onde o laco fecha
+    uint32_t no;
+};
+
+/** Caminhos que saem de um noh. */
+struct ResumoOrigem {
+    uint32_t alcancaveis = 0;
+    uint32_t sem_rota = 0;
+    uint32_t buracos = 0;
+    uint32_t lacos = 0;
+    uint64_t soma_saltos = 0;
+    uint32_t saltos_max = 0;
+    double atraso_max_s = 0;
+    double gargalo_min_bps = std::numeric_limits<double>::infinity ();
+
+    void juntar (const ResumoOrigem &outro) {
+        alcancaveis += outro.alcancaveis;
+        sem_rota += outro.sem_rota;
+        buracos += outro.buracos;
+        lacos += outro.lacos;
+        soma_saltos += outro.soma_saltos;
+        saltos_max = std::max (saltos_max, outro.saltos_max);
+        atraso_max_s = std::max (atraso_max_s, outro.atraso_max_s);
+        gargalo_min_bps = std::min (gargalo_min_bps, outro.gargalo_min_bps);
+    }
+};
+
+class VerificacaoRotas {
+public:
+    /** Limite de problemas guardados para a listagem; todos sao contados. */
+    static const uint32_t PROBLEMAS_LISTADOS = 10000;
+
+    VerificacaoRotas (const Topologia &topologia)
+        : m_topologia (topologia) {
+        m_atraso.resize (2 * topologia.enlaces.size ());
+        m_taxa.resize (2 * topologia.enlaces.size ());
+        for (size_t i = 0; i < topologia.enlaces.size (); ++i) {
+            const ClasseEnlace &classe = topologia.classes[topologia.enlaces[i].classe];
+            m_atraso[2 * i] = m_atraso[2 * i + 1] = ns3::Time (classe.atraso).GetSeconds ();
+            m_taxa[2 * i] = m_taxa[2 * i + 1] = ns3::DataRate (classe.taxa).GetBitRate ();
+        }
+    }
+
+    /**
+     * fonte: "tabelas" ou "grafo"; threads = 0 usa um por processador. Com
+     * ecmp, multipercurso eh a tabela compartilhada pelos protocolos.
+     */
+    void verificar (const std::string &fonte, uint32_t threads, const TabelaMultipercurso *multipercurso = 0) {
+        std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now ();
+        uint32_t nos = m_topologia.nos.size ();
+        if (threads == 0) {
+            threads = std::thread::hardware_concurrency ();
+        }
+        threads = std::max<uint32_t> (1, std::min (threads, std::max<uint32_t> (nos, 1)));
+        m_fonte = fonte;
+        m_tabelas.clear ();
+        m_reverso.clear ();
+        if (fonte == "tabelas") {
+            ler_tabelas (threads);
+            if (multipercurso) {
+                montar_reverso (multipercurso->grafo ());
+            }
+        } else if (fonte == "grafo") {
+            GrafoRoteamento grafo;
+            montar_grafo_roteamento (m_topologia, grafo);
+            montar_reverso (grafo);
+        } else {
+            NS_FATAL_ERROR ("Fonte de verificacao desconhecida: " << fonte << " (use tabelas ou grafo)");
+        }
+        m_segundos_leitura = segundos_desde (inicio);
+
+        std::vector<Parcial> parciais (threads);
+        std::vector<std::thread> trabalhadores;
+        for (uint32_t t = 0; t < threads; ++t) {
+            trabalhadores.push_back (std::thread ([this, t, threads, nos, &parciais] () {
+                Parcial &parcial = parciais[t];
+                parcial.origens.assign (nos, ResumoOrigem ());
+                Coluna coluna (nos);
+                for (uint32_t destino = t; destino < nos; destino += threads) {
+                    verificar_destino (destino, coluna, parcial);
+                }
+            }));
+        }
+        for (size_t t = 0; t < trabalhadores.size (); ++t) {
+            trabalhadores[t].join ();
+        }
+
+        m_origens.assign (nos, ResumoOrigem ());
+        m_problemas.clear ();
+        m_total_problemas = 0;
+        for (uint32_t t = 0; t < threads; ++t) {
+            for (uint32_t no = 0; no < nos; ++no) {
+                m_origens[no].juntar (parciais[t].origens[no]);
+            }
+            m_total_problemas += parciais[t].total_problemas;
+            for (size_t k = 0; k < parciais[t].problemas.size () && m_problemas.size () < PROBLEMAS_LISTADOS; ++k) {
+                m_problemas.push_back (parciais[t].problemas[k]);
+            }
+        }
+        std::sort (m_problemas.begin (), m_problemas.end (), [] (const ProblemaRota &a, const ProblemaRota &b) {
+            return a.origem != b.origem ? a.origem < b.origem : a.destino < b.destino;
+        });
+        m_threads = threads;
+        m_segundos = segundos_desde (inicio);
+    }
+
+    uint64_t problemas () const {
+        return m_total_problemas;
+    }
+
+    void imprimir (std::ostream &saida) const {
+        ResumoOrigem total;
+        for (size_t no = 0; no < m_origens.size (); ++no) {
+            total.juntar (m_origens[no]);
+        }
+        uint64_t pares = uint64_t (m_origens.size ()) * (m_origens.size () > 0 ? m_origens.size () - 1 : 0);
+        saida << "Verificacao (" << m_fonte << "): " << pares << " pares, " << total.alcancaveis << " alcancaveis, "
+              << total.sem_rota << " sem rota, " << total.buracos << " buracos, " << total.lacos << " lacos; ";
+        if (total.alcancaveis > 0) {
+            saida << "saltos medio " << double (total.soma_saltos) / total.alcancaveis << " e maximo " << total.saltos_max
+                  << ", atraso maximo " << total.atraso_max_s * 1e3 << " ms, gargalo minimo " << total.gargalo_min_bps / 1e6 << " Mbps; ";
+        }
+        saida << m_segundos << " s (" << m_segundos_leitura << " s lendo as rotas, " << m_threads << " threads)" << std::endl;
+    }
+
+    /** Uma linha por origem. */
+    void escrever_origens_csv (std::ostream &saida) const {
+        saida << "no,alcancaveis,sem_rota,buracos,lacos,saltos_medio,saltos_max,atraso_max_ms,gargalo_min_mbps" << std::endl;
+        for (size_t no = 0; no < m_origens.size (); ++no) {
+            const ResumoOrigem &origem = m_origens[no];
+            saida << m_topologia.nomes[no] << ',' << origem.alcancaveis << ',' << origem.sem_rota << ',' << origem.buracos << ','
+                  << origem.lacos << ',' << (origem.alcancaveis > 0 ? double (origem.soma_saltos) / origem.alcancaveis : 0) << ','
+                  << origem.saltos_max << ',' << origem.atraso_max_s * 1e3 << ','
+                  << (origem.alcancaveis > 0 ? origem.gargalo_min_bps / 1e6 : 0) << std::endl;
+        }
+    }
+
+    void escrever_problemas_csv (std::ostream &saida) const {
+        saida << "origem,destino,problema,no" << std::endl;
+        for (size_t k = 0; k < m_problemas.size (); ++k) {
+            const ProblemaRota &problema = m_problemas[k];
+            saida << m_topologia.nomes[problema.origem] << ',' << m_topologia.nomes[problema.destino] << ','
+                  << nome_problema_rota (problema.tipo) << ',' << m_topologia.nomes[problema.no] << std::endl;
+        }
+    }
+
+private:
+    struct EntradaReversa {
+        uint32_t vizinho;
+        uint32_t sentido;
+        uint32_t custo;
+    };
+
+    /** Rotas de uma mascara, pares (rede, sentido) ordenados pela rede. */
+    struct GrupoRotas {
+        uint32_t mascara;
+        std::vector<std::pair<uint32_t, int32_t> > rotas;
+    };
+
+    /** Tabela de um noh, com os grupos na ordem de consulta. */
+    struct TabelaNo {
+        std::vector<GrupoRotas> grupos;
+        // Depois dos grupos vem o multipercurso
+        bool multipercurso = false;
+    };
+
+    /** Rota lida do ns-3; sentido -1 quando sai por fora da topologia. */
+    struct RotaLida {
+        uint32_t mascara;
+        uint32_t rede;
+        int32_t sentido;
+    };
+
+    // Nenhuma rota da tabela casa com o destino
+    static const int32_t FORA_DA_TABELA = -2;
+
+    struct Parcial {
+        std::vector<ResumoOrigem> origens;
+        std::vector<ProblemaRota> problemas;
+        uint64_t total_problemas = 0;
+    };
+
+    enum Estado {
+        NAO_VISITADO,
+        NA_PILHA,
+        RESOLVIDO
+    };
+
+    /** Vetores de trabalho de uma thread, reaproveitados entre destinos. */
+    struct Coluna {
+        explicit Coluna (uint32_t nos)
+            : proximo (nos), estado (nos), saltos (nos), atraso (nos), gargalo (nos), problema (nos), no_problema (nos),
+              distancia (nos) {
+        }
+        std::vector<int32_t> proximo;
+        std::vector<uint8_t> estado;
+        std::vector<uint32_t> saltos;
+        std::vector<double> atraso;
+        std::vector<double> gargalo;
+        // -1 quando o caminho chega ao destino
+        std::vector<int8_t> problema;
+        std::vector<uint32_t> no_problema;
+        std::vector<uint32_t> distancia;
+        std::vector<uint32_t> pilha;
+        std::vector<std::vector<uint32_t> > baldes;
+    };
+
+    static const uint32_t CUSTO_MAXIMO_BALDES = 1024;
+
+    void ler_tabelas (uint32_t threads) {
+        uint32_t nos = m_topologia.nos.size ();
+        // Sentidos que saem de cada noh, para traduzir a interface das rotas
+        std::vector<std::vector<uint32_t> > saidas (nos);
+        for (uint32_t i = 0; i < m_topologia.enlaces.size (); ++i) {
+            saidas[m_topologia.enlaces[i].a].push_back (2 * i);
+            saidas[m_topologia.enlaces[i].b].push_back (2 * i + 1);
+        }
+        m_tabelas.assign (nos, TabelaNo ());
+        std::vector<std::thread> trabalhadores;
+        for (uint32_t t = 0; t < threads; ++t) {
+            trabalhadores.push_back (std::thread ([this, t, threads, nos, &saidas] () {
+                for (uint32_t no = t; no < nos; no += threads) {
+                    ler_tabela (no, saidas[no], m_tabelas[no]);
+                }
+            }));
+        }
+        for (size_t t = 0; t < trabalhadores.size (); ++t) {
+            trabalhadores[t].join ();
+        }
+    }
+
+    /**
+     * Copia as rotas do estatico e do global de no, na ordem em que a lista
+     * consulta os protocolos, cada tabela em uma passada (ler_rotas). Os
+     * protocolos abaixo do multipercurso nao sao lidos, pois ele responde
+     * por todo destino alcancavel. RIP e OLSR nao sao lidos: as tabelas
+     * deles so existem durante a simulacao.
+     */
+    void ler_tabela (uint32_t no, const std::vector<uint32_t> &saidas, TabelaNo &tabela) const {
+        ns3::Ptr<ns3::Ipv4> ipv4 = m_topologia.nos[no]->GetObject<ns3::Ipv4> ();
+        std::vector<int32_t> sentido_da_interface (ipv4->GetNInterfaces (), -1);
+        for (size_t k = 0; k < saidas.size (); ++k) {
+            const Enlace &enlace = m_topologia.enlaces[saidas[k] / 2];
+            int32_t interface = ipv4->GetInterfaceForDevice (saidas[k] % 2 == 0 ? enlace.dispositivo_a : enlace.dispositivo_b);
+            if (interface >= 0) {
+                sentido_da_interface[interface] = saidas[k];
+            }
+        }
+
+        std::vector<ns3::Ptr<ns3::Ipv4RoutingProtocol> > protocolos;
+        ns3::Ptr<ns3::Ipv4ListRouting> lista = ns3::DynamicCast<ns3::Ipv4ListRouting> (ipv4->GetRoutingProtocol ());
+        if (lista) {
+            for (uint32_t k = 0; k < lista->GetNRoutingProtocols (); ++k) {
+                int16_t prioridade;
+                protocolos.push_back (lista->GetRoutingProtocol (k, prioridade));
+            }
+        } else {
+            protocolos.push_back (ipv4->GetRoutingProtocol ());
+        }
+
+        std::vector<ns3::Ipv4RoutingTableEntry> entradas;
+        std::vector<RotaLida> rotas;
+        for (size_t p = 0; p < protocolos.size () && !tabela.multipercurso; ++p) {
+            entradas.clear ();
+            ns3::Ptr<ns3::Ipv4StaticRouting> estatico = ns3::DynamicCast<ns3::Ipv4StaticRouting> (protocolos[p]);
+            ns3::Ptr<ns3::Ipv4GlobalRouting> global = ns3::DynamicCast<ns3::Ipv4GlobalRouting> (protocolos[p]);
+            if (estatico) {
+                ler_rotas (estatico, entradas);
+            } else if (global) {
+                ler_rotas (global, entradas);
+            } else if (ns3::DynamicCast<RoteamentoMultipercurso> (protocolos[p])) {
+                tabela.multipercurso = true;
+            }
+            rotas.clear ();
+            for (size_t k = 0; k < entradas.size (); ++k) {
+                rotas.push_back (ler_rota (entradas[k], sentido_da_interface));
+            }
+            agrupar (rotas, tabela);
+        }
+    }
+
+    static RotaLida ler_rota (const ns3::Ipv4RoutingTableEntry &entrada, const std::vector<int32_t> &sentido_da_interface) {
+        RotaLida rota;
+        rota.mascara = entrada.IsHost () ? 0xffffffff : entrada.GetDestNetworkMask ().Get ();
+        rota.rede = (entrada.IsHost () ? entrada.GetDest () : entrada.GetDestNetwork ()).Get () & rota.mascara;
+        uint32_t interface = entrada.GetInterface ();
+        rota.sentido = interface < sentido_da_interface.size () ? sentido_da_interface[interface] : -1;
+        return rota;
+    }
+
+    /**
+     * Acrescenta as rotas de um protocolo, um grupo por mascara. Com a mesma
+     * rede mais de uma vez fica a primeira, como nas listas do ns-3.
+     */
+    static void agrupar (std::vector<RotaLida> &rotas, TabelaNo &tabela) {
+        std::stable_sort (rotas.begin (), rotas.end (), [] (const RotaLida &a, const RotaLida &b) {
+            return a.mascara != b.mascara ? a.mascara > b.mascara : a.rede < b.rede;
+        });
+        for (size_t k = 0; k < rotas.size (); ++k) {
+            if (k == 0 || rotas[k].mascara != rotas[k - 1].mascara) {
+                GrupoRotas grupo;
+                grupo.mascara = rotas[k].mascara;
+                tabela.grupos.push_back (grupo);
+            } else if (rotas[k].rede == rotas[k - 1].rede) {
+                continue;
+            }
+            tabela.grupos.back ().rotas.push_back (std::make_pair (rotas[k].rede, rotas[k].sentido));
+        }
+    }
+
+    /** Sentido da primeira rota que casa com endereco, ou FORA_DA_TABELA. */
+    static int32_t consultar (const TabelaNo &tabela, uint32_t endereco) {
+        for (size_t g = 0; g < tabela.grupos.size (); ++g) {
+            const std::vector<std::pair<uint32_t, int32_t> > &rotas = tabela.grupos[g].rotas;
+            uint32_t rede = endereco & tabela.grupos[g].mascara;
+            std::vector<std::pair<uint32_t, int32_t> >::const_iterator it = std::lower_bound (
+                rotas.begin (), rotas.end (), rede, [] (const std::pair<uint32_t, int32_t> &rota, uint32_t valor) {
+                    return rota.first < valor;
+                });
+            if (it != rotas.end () && it->first == rede) {
+                return it->second;
+            }
+        }
+        return FORA_DA_TABELA;
+    }
+
+    /**
+     * Proximo salto de cada noh pela sua tabela. Nos nohs com multipercurso
+     * o que nao casa com as rotas lidas vai pelo grafo dele (m_reverso).
+     */
+    void proximos_das_tabelas (uint32_t destino, Coluna &coluna) const {
+        if (!m_reverso.empty ()) {
+            proximos_do_grafo (destino, coluna);
+        }
+        uint32_t endereco = m_topologia.endereco_principal[destino].Get ();
+        for (uint32_t no = 0; no < m_tabelas.size (); ++no) {
+            int32_t sentido = no == destino ? -1 : consultar (m_tabelas[no], endereco);
+            if (sentido == FORA_DA_TABELA) {
+                sentido = m_tabelas[no].multipercurso && !m_reverso.empty () ? coluna.proximo[no] : -1;
+            }
+            coluna.proximo[no] = sentido;
+        }
+    }
+
+    /** Para cada noh, os vizinhos que chegam a ele e o sentido usado. */
+    void montar_reverso (const GrafoRoteamento &grafo) {
+        m_reverso.assign (grafo.adjacencias.size (), std::vector<EntradaReversa> ());
+        m_custo_maximo = 0;
+        for (uint32_t no = 0; no < grafo.adjacencias.size (); ++no) {
+            for (size_t k = 0; k < grafo.adjacencias[no].size (); ++k) {
+                const Adjacencia &adjacencia = grafo.adjacencias[no][k];
+                EntradaReversa entrada = { no, 2 * adjacencia.enlace + (m_topologia.enlaces[adjacencia.enlace].a == no ? 0u : 1u),
+                                           adjacencia.custo };
+                m_reverso[adjacencia.vizinho].push_back (entrada);
+                m_custo_maximo = std::max (m_custo_maximo, adjacencia.custo);
+            }
+        }
+    }
+
+    /**
+     * Dijkstra reverso: proximo salto de cada noh ate destino. Com metricas
+     * pequenas (o normal eh 1 por interface) a fila eh de baldes por
+     * distancia (Dial), circular com custo maximo + 1 baldes.
+     */
+    void proximos_do_grafo (uint32_t destino, Coluna &coluna) const {
+        std::fill (coluna.proximo.begin (), coluna.proximo.end (), -1);
+        std::fill (coluna.distancia.begin (), coluna.distancia.end (), DISTANCIA_INFINITA);
+        coluna.distancia[destino] = 0;
+        if (m_custo_maximo <= CUSTO_MAXIMO_BALDES) {
+            std::vector<std::vector<uint32_t> > &baldes = coluna.baldes;
+            baldes.resize (m_custo_maximo + 1);
+            baldes[0].push_back (destino);
+            uint64_t pendentes = 1;
+            for (uint32_t distancia = 0; pendentes > 0; ++distancia) {
+                std::vector<uint32_t> &balde = baldes[distancia % baldes.size ()];
+                // Custo 0 volta ao mesmo balde, por isso o indice
+                for (size_t k = 0; k < balde.size (); ++k) {
+                    uint32_t no = balde[k];
+                    pendentes--;
+                    if (coluna.distancia[no] != distancia) {
+                        continue;
+                    }
+                    const std::vector<EntradaReversa> &entradas = m_reverso[no];
+                    for (size_t j = 0; j < entradas.size (); ++j) {
+                        const EntradaReversa &entrada = entradas[j];
+                        uint32_t nova = distancia + entrada.custo;
+                        if (nova < coluna.distancia[entrada.vizinho]) {
+                            coluna.distancia[entrada.vizinho] = nova;
+                            coluna.proximo[entrada.vizinho] = entrada.sentido;
+                            baldes[nova % baldes.size ()].push_back (entrada.vizinho);
+                            pendentes++;
+                        }
+                    }
+                }
+                balde.clear ();
+            }
+            return;
+        }
+
+        typedef std::pair<uint32_t, uint32_t> Entrada;
+        std::priority_queue<Entrada, std::vector<Entrada>, std::greater<Entrada> > fila;
+        fila.push (Entrada (0, destino));
+        while (!fila.empty ()) {
+            Entrada atual = fila.top ();
+            fila.pop ();
+            uint32_t no = atual.second;
+            if (atual.first > coluna.distancia[no]) {
+                continue;
+            }
+            const std::vector<EntradaReversa> &entradas = m_reverso[no];
+            for (size_t k = 0; k < entradas.size (); ++k) {
+                const EntradaReversa &entrada = entradas[k];
+                uint32_t nova = coluna.distancia[no] + entrada.custo;
+                if (nova < coluna.distancia[entrada.vizinho]) {
+                    coluna.distancia[entrada.vizinho] = nova;
+                    coluna.proximo[entrada.vizinho] = entrada.sentido;
+                    fila.push (Entrada (nova, entrada.vizinho));
+                }
+            }
+        }
+    }
+
+    void verificar_destino (uint32_t destino, Coluna &coluna, Parcial &parcial) const {
+        uint32_t nos = m_topologia.nos.size ();
+        if (m_fonte == "tabelas") {
+            proximos_das_tabelas (destino, coluna);
+        } else {
+            proximos_do_grafo (destino, coluna);
+        }
+        std::fill (coluna.estado.begin (), coluna.estado.end (), uint8_t (NAO_VISITADO));
+        coluna.estado[destino] = RESOLVIDO;
+        coluna.saltos[destino] = 0;
+        coluna.atraso[destino] = 0;
+        coluna.gargalo[destino] = std::numeric_limits<double>::infinity ();
+        coluna.problema[destino] = -1;
+
+        for (uint32_t origem = 0; origem < nos; ++origem) {
+            if (coluna.estado[origem] != NAO_VISITADO) {
+                continue;
+            }
+            // Segue os proximos saltos ate um noh resolvido, sem rota ou ja na pilha
+            coluna.pilha.clear ();
+            uint32_t no = origem;
+            while (coluna.estado[no] == NAO_VISITADO && coluna.proximo[no] >= 0) {
+                coluna.estado[no] = NA_PILHA;
+                coluna.pilha.push_back (no);
+                no = fim_do_sentido (m_topologia, coluna.proximo[no]);
+            }
+            if (coluna.estado[no] == NAO_VISITADO) {
+                // Sem rota aqui
+                coluna.estado[no] = RESOLVIDO;
+                coluna.problema[no] = ROTA_SEM_ROTA;
+                coluna.no_problema[no] = no;
+            } else if (coluna.estado[no] == NA_PILHA) {
+                // Todos da pilha a partir de no estao no laco
+                while (coluna.pilha.back () != no) {
+                    marcar_laco (coluna, coluna.pilha.back (), no);
+                    coluna.pilha.pop_back ();
+                }
+                marcar_laco (coluna, no, no);
+                coluna.pilha.pop_back ();
+            }
+            // Desempilha resolvendo cada noh pelo seguinte
+            while (!coluna.pilha.empty ()) {
+                uint32_t atual = coluna.pilha.back ();
+                coluna.pilha.pop_back ();
+                uint32_t sentido = coluna.proximo[atual];
+                uint32_t seguinte = fim_do_sentido (m_topologia, sentido);
+                coluna.estado[atual] = RESOLVIDO;
+                coluna.problema[atual] = coluna.problema[seguinte] == ROTA_SEM_ROTA ? int8_t (ROTA_BURACO) : coluna.problema[seguinte];
+                coluna.no_problema[atual] = coluna.no_problema[seguinte];
+                coluna.saltos[atual] = coluna.saltos[seguinte] + 1;
+                coluna.atraso[atual] = coluna.atraso[seguinte] + m_atraso[sentido];
+                coluna.gargalo[atual] = std::min (coluna.gargalo[seguinte], m_taxa[sentido]);
+            }
+        }
+
+        for (uint32_t origem = 0; origem < nos; ++origem) {
+            if (origem == destino) {
+                continue;
+            }
+            ResumoOrigem &resumo = parcial.origens[origem];
+            int8_t problema = coluna.problema[origem];
+            if (problema < 0) {
+                resumo.alcancaveis++;
+                resumo.soma_saltos += coluna.saltos[origem];
+                resumo.saltos_max = std::max (resumo.saltos_max, coluna.saltos[origem]);
+                resumo.atraso_max_s = std::max (resumo.atraso_max_s, coluna.atraso[origem]);
+                resumo.gargalo_min_bps = std::min (resumo.gargalo_min_bps, coluna.gargalo[origem]);
+                continue;
+            }
+            if (problema == ROTA_SEM_ROTA) {
+                resumo.sem_rota++;
+            } else if (problema == ROTA_BURACO) {
+                resumo.buracos++;
+            } else {
+                resumo.lacos++;
+            }
+            parcial.total_problemas++;
+            if (parcial.problemas.size () < PROBLEMAS_LISTADOS) {
+                ProblemaRota registro = { origem, destino, TipoProblemaRota (problema), coluna.no_problema[origem] };
+                parcial.problemas.push_back (registro);
+            }
+        }
+    }
+
+    void marcar_laco (Coluna &coluna, uint32_t no, uint32_t fechamento) const {
+        coluna.estado[no] = RESOLVIDO;
+        coluna.problema[no] = ROTA_LACO;
+        coluna.no_problema[no] = fechamento;
+        coluna.saltos[no] = 0;
+        coluna.atraso[no] = 0;
+        coluna.gargalo[no] = 0;
+    }
+
+    const Topologia &m_topologia;
+    std::vector<double> m_atraso;
+    std::vector<double> m_taxa;
+    std::string m_fonte;
+    std::vector<TabelaNo> m_tabelas;
+    std::vector<std::vector<EntradaReversa> > m_reverso;
+    uint32_t m_custo_maximo = 0;
+    std::vector<ResumoOrigem> m_origens;
+    std::vector<ProblemaRota> m_problemas;
+    uint64_t m_total_problemas = 0;
+    uint32_t m_threads = 1;
+    double m_segundos_leitura = 0;
+    double m_segundos = 0;
+};
+
+#endif /* VERIFICACAO_H */